@@ -42,6 +42,10 @@
  *
  * To remove the highest priority item in the heap, use egg_heap_extract().
  *
+ * To keep track of where each item is stored, so that it can be removed
+ * with egg_heap_extract_index() without searching the heap first, use
+ * egg_heap_set_index_func().
+ *
  * To free a heap, use egg_heap_unref().
  *
  * Here is an example that stores integers in a #EggHeap:
@@ -86,13 +90,14 @@ typedef struct _EggHeapReal EggHeapReal;
 
 struct _EggHeapReal
 {
-  gchar          *data;
-  gsize           len;
-  volatile gint   ref_count;
-  guint           element_size;
-  gsize           allocated_len;
-  GCompareFunc    compare;
-  gchar           tmp[0];
+  gchar            *data;
+  gsize             len;
+  volatile gint     ref_count;
+  guint             element_size;
+  gsize             allocated_len;
+  GCompareFunc      compare;
+  EggHeapIndexFunc  index_func;
+  gchar             tmp[0];
 };
 
 #define heap_parent(npos)   (((npos)-1)/2)
@@ -100,11 +105,18 @@ struct _EggHeapReal
 #define heap_right(npos)    (((npos)*2)+2)
 #define heap_index(h,i)     ((h)->data + (i * (h)->element_size))
 #define heap_compare(h,a,b) ((h)->compare(heap_index(h,a), heap_index(h,b)))
+#define heap_moved(h,i)                                                 \
+  G_STMT_START {                                                        \
+      if ((h)->index_func != NULL)                                      \
+        (h)->index_func (heap_index (h, i), i);                         \
+ } G_STMT_END
 #define heap_swap(h,a,b)                                                \
   G_STMT_START {                                                        \
       memcpy ((h)->tmp, heap_index (h, a), (h)->element_size);          \
       memcpy (heap_index (h, a), heap_index (h, b), (h)->element_size); \
       memcpy (heap_index (h, b), (h)->tmp, (h)->element_size);          \
+      heap_moved (h, a);                                                \
+      heap_moved (h, b);                                                \
  } G_STMT_END
 
 /**
@@ -135,10 +147,34 @@ egg_heap_new (guint        element_size,
     real->element_size = element_size;
     real->allocated_len = 0;
     real->compare = compare_func;
+    real->index_func = NULL;
 
     return (EggHeap *)real;
 }
 
+/**
+ * egg_heap_set_index_func:
+ * @heap: An #EggHeap
+ * @index_func: (scope notified) (nullable): An #EggHeapIndexFunc or %NULL
+ *
+ * Sets a function to be called every time an element is stored at a new
+ * position of @heap, including when it is inserted.
+ *
+ * This allows elements to remember their position so that they can be
+ * removed with egg_heap_extract_index() in O(log n) instead of having to
+ * search the heap for them.
+ */
+void
+egg_heap_set_index_func (EggHeap          *heap,
+                         EggHeapIndexFunc  index_func)
+{
+  EggHeapReal *real = (EggHeapReal *)heap;
+
+  g_return_if_fail (heap);
+
+  real->index_func = index_func;
+}
+
 /**
  * egg_heap_ref:
  * @heap: An #EggHeap
@@ -233,6 +269,8 @@ egg_heap_real_insert_val (EggHeapReal   *real,
   ipos = real->len;
   ppos = heap_parent (ipos);
 
+  heap_moved (real, ipos);
+
   while ((ipos > 0) && (heap_compare (real, ppos, ipos) < 0))
     {
       heap_swap (real, ppos, ipos);
@@ -283,6 +321,7 @@ egg_heap_extract (EggHeap  *heap,
       memmove (real->data,
                heap_index (real, real->len),
                real->element_size);
+      heap_moved (real, 0);
 
       ipos = 0;
 
@@ -341,6 +380,7 @@ egg_heap_extract_index (EggHeap  *heap,
       memcpy (heap_index (real, index_),
               heap_index (real, real->len),
               real->element_size);
+      heap_moved (real, index_);
 
       ipos = index_;
       ppos = heap_parent (ipos);
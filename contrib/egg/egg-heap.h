@@ -30,25 +30,37 @@ G_BEGIN_DECLS
 
 typedef struct _EggHeap EggHeap;
 
+/**
+ * EggHeapIndexFunc:
+ * @element: a pointer to the element within the heap
+ * @index_: the new position of the element
+ *
+ * Called when @element is stored at a new position in the heap.
+ */
+typedef void (*EggHeapIndexFunc) (gpointer element,
+                                  guint    index_);
+
 struct _EggHeap
 {
   gchar *data;
   guint  len;
 };
 
-GType      egg_heap_get_type      (void);
-EggHeap   *egg_heap_new           (guint           element_size,
-                                   GCompareFunc    compare_func);
-EggHeap   *egg_heap_ref           (EggHeap        *heap);
-void       egg_heap_unref         (EggHeap        *heap);
-void       egg_heap_insert_vals   (EggHeap        *heap,
-                                   gconstpointer   data,
-                                   guint           len);
-gboolean   egg_heap_extract       (EggHeap        *heap,
-                                   gpointer        result);
-gboolean   egg_heap_extract_index (EggHeap        *heap,
-                                   guint           index_,
-                                   gpointer        result);
+GType      egg_heap_get_type       (void);
+EggHeap   *egg_heap_new            (guint            element_size,
+                                    GCompareFunc     compare_func);
+EggHeap   *egg_heap_ref            (EggHeap         *heap);
+void       egg_heap_unref          (EggHeap         *heap);
+void       egg_heap_set_index_func (EggHeap         *heap,
+                                    EggHeapIndexFunc index_func);
+void       egg_heap_insert_vals    (EggHeap         *heap,
+                                    gconstpointer    data,
+                                    guint            len);
+gboolean   egg_heap_extract        (EggHeap         *heap,
+                                    gpointer         result);
+gboolean   egg_heap_extract_index  (EggHeap         *heap,
+                                    guint            index_,
+                                    gpointer         result);
 
 G_END_DECLS
 
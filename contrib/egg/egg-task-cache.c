@@ -24,12 +24,23 @@
 #include "egg-heap.h"
 #include "egg-task-cache.h"
 
+/*
+ * Items of caches with a cost function share a process-wide memory budget.
+ * When the total cost of those items goes over the budget, the least
+ * recently used items are evicted, whichever cache they belong to.
+ */
+#define DEFAULT_MEMORY_BUDGET (512 * 1024 * 1024)
+#define NOT_IN_HEAP           G_MAXUINT
+
 typedef struct
 {
   EggTaskCache *self;
   gpointer      key;
   gpointer      value;
   gint64        evict_at;
+  guint         heap_index;
+  gsize         cost;
+  GList         lru_link;
 } CacheItem;
 
 typedef struct
@@ -42,6 +53,8 @@ struct _EggTaskCache
 {
   GObject               parent_instance;
 
+  EggTaskCacheCostFunc  cost_func;
+
   GHashFunc             key_hash_func;
   GEqualFunc            key_equal_func;
   GBoxedCopyFunc        key_copy_func;
@@ -74,6 +87,15 @@ EGG_DEFINE_COUNTER (queued,     "EggTaskCache", "Queued",     "Number of queued
 EGG_DEFINE_COUNTER (cached,     "EggTaskCache", "Cache Size", "Number of cached items")
 EGG_DEFINE_COUNTER (hits,       "EggTaskCache", "Cache Hits", "Number of cache hits")
 EGG_DEFINE_COUNTER (misses,     "EggTaskCache", "Cache Miss", "Number of cache misses")
+EGG_DEFINE_COUNTER (evictions,  "EggTaskCache", "Evictions",  "Number of items evicted by time or memory budget")
+EGG_DEFINE_COUNTER (cost,       "EggTaskCache", "Cost",       "Estimated bytes used by items with a cost function")
+
+/*
+ * Only used from the main thread, like the rest of EggTaskCache.
+ */
+static GQueue lru = G_QUEUE_INIT;
+static gsize  lru_cost;
+static gsize  memory_budget = DEFAULT_MEMORY_BUDGET;
 
 enum {
   PROP_0,
@@ -169,6 +191,14 @@ cache_item_free (gpointer data)
 {
   CacheItem *item = data;
 
+  if (item->lru_link.data != NULL)
+    {
+      g_queue_unlink (&lru, &item->lru_link);
+      item->lru_link.data = NULL;
+      lru_cost -= item->cost;
+      EGG_COUNTER_SUB (cost, (gint64)item->cost);
+    }
+
   item->self->key_destroy_func (item->key);
   item->self->value_destroy_func (item->value);
   item->self = NULL;
@@ -201,6 +231,15 @@ cache_item_compare_evict_at (gconstpointer a,
     return 0;
 }
 
+static void
+cache_item_set_heap_index (gpointer element,
+                           guint    index_)
+{
+  CacheItem *item = *(CacheItem **)element;
+
+  item->heap_index = index_;
+}
+
 static CacheItem *
 cache_item_new (EggTaskCache  *self,
                 gconstpointer  key,
@@ -214,9 +253,19 @@ cache_item_new (EggTaskCache  *self,
   ret->self = self;
   ret->key = self->key_copy_func ((gpointer)key);
   ret->value = self->value_copy_func ((gpointer)value);
+  ret->heap_index = NOT_IN_HEAP;
   if (self->time_to_live_usec > 0)
     ret->evict_at = g_get_monotonic_time () + self->time_to_live_usec;
 
+  if (self->cost_func != NULL)
+    {
+      ret->cost = self->cost_func (ret->value);
+      ret->lru_link.data = ret;
+      g_queue_push_head_link (&lru, &ret->lru_link);
+      lru_cost += ret->cost;
+      EGG_COUNTER_ADD (cost, (gint64)ret->cost);
+    }
+
   return ret;
 }
 
@@ -231,19 +280,8 @@ egg_task_cache_evict_full (EggTaskCache  *self,
 
   if ((item = g_hash_table_lookup (self->cache, key)))
     {
-      if (check_heap)
-        {
-          gsize i;
-
-          for (i = 0; i < self->evict_heap->len; i++)
-            {
-              if (item == egg_heap_index (self->evict_heap, gpointer, i))
-                {
-                  egg_heap_extract_index (self->evict_heap, i, NULL);
-                  break;
-                }
-            }
-        }
+      if (check_heap && item->heap_index != NOT_IN_HEAP)
+        egg_heap_extract_index (self->evict_heap, item->heap_index, NULL);
 
       g_hash_table_remove (self->cache, key);
 
@@ -318,12 +356,43 @@ egg_task_cache_peek (EggTaskCache  *self,
   if ((item = g_hash_table_lookup (self->cache, key)))
     {
       EGG_COUNTER_INC (hits);
+
+      if (item->lru_link.data != NULL && lru.head != &item->lru_link)
+        {
+          g_queue_unlink (&lru, &item->lru_link);
+          g_queue_push_head_link (&lru, &item->lru_link);
+        }
+
       return item->value;
     }
 
   return NULL;
 }
 
+/*
+ * Evicts the least recently used items until the items with a cost fit in
+ * the memory budget. @keep is never evicted, so that a single item bigger
+ * than the budget does not get evicted as soon as it is inserted.
+ */
+static void
+egg_task_cache_enforce_budget (CacheItem *keep)
+{
+  while (memory_budget > 0 && lru_cost > memory_budget && lru.tail != NULL)
+    {
+      CacheItem *item = lru.tail->data;
+
+      if (item == keep)
+        break;
+
+      g_debug ("Evicting item of %"G_GSIZE_FORMAT" bytes from %s, over memory budget",
+               item->cost, item->self->name ?: "unnamed cache");
+
+      egg_task_cache_evict_full (item->self, item->key, TRUE);
+
+      EGG_COUNTER_INC (evictions);
+    }
+}
+
 static void
 egg_task_cache_propagate_error (EggTaskCache  *self,
                                 gconstpointer  key,
@@ -371,12 +440,16 @@ egg_task_cache_populate (EggTaskCache  *self,
   if (g_hash_table_contains (self->cache, key))
     egg_task_cache_evict (self, key);
   g_hash_table_insert (self->cache, item->key, item);
-  egg_heap_insert_val (self->evict_heap, item);
+  if (self->time_to_live_usec > 0)
+    egg_heap_insert_val (self->evict_heap, item);
 
   EGG_COUNTER_INC (cached);
 
   if (self->evict_source != NULL)
     evict_source_rearm (self->evict_source);
+
+  if (item->lru_link.data != NULL)
+    egg_task_cache_enforce_budget (item);
 }
 
 static void
@@ -554,6 +627,7 @@ egg_task_cache_do_eviction (gpointer user_data)
         {
           egg_heap_extract (self->evict_heap, NULL);
           egg_task_cache_evict_full (self, item->key, FALSE);
+          EGG_COUNTER_INC (evictions);
           continue;
         }
 
@@ -861,6 +935,7 @@ egg_task_cache_init (EggTaskCache *self)
 
   self->evict_heap = egg_heap_new (sizeof (gpointer),
                                    cache_item_compare_evict_at);
+  egg_heap_set_index_func (self->evict_heap, cache_item_set_heap_index);
 }
 
 /**
@@ -930,6 +1005,50 @@ egg_task_cache_get_values (EggTaskCache *self)
   return ar;
 }
 
+/**
+ * egg_task_cache_set_cost_func: (skip)
+ * @self: An #EggTaskCache
+ * @cost_func: (nullable): An #EggTaskCacheCostFunc or %NULL
+ *
+ * Sets the function used to estimate the memory used by values of @self.
+ *
+ * Items of caches with a cost function are accounted in the memory budget
+ * shared by all caches, see egg_task_cache_set_memory_budget(). This only
+ * affects items added after this call, so it should be called right after
+ * creating @self.
+ */
+void
+egg_task_cache_set_cost_func (EggTaskCache         *self,
+                              EggTaskCacheCostFunc  cost_func)
+{
+  g_return_if_fail (EGG_IS_TASK_CACHE (self));
+
+  self->cost_func = cost_func;
+}
+
+/**
+ * egg_task_cache_set_memory_budget:
+ * @budget: the number of bytes, or 0 for no limit
+ *
+ * Sets the number of bytes that items of all caches with a cost function
+ * may use together. When the budget is exceeded, the least recently used
+ * items are evicted.
+ *
+ * This must be called from the main thread.
+ */
+void
+egg_task_cache_set_memory_budget (gsize budget)
+{
+  memory_budget = budget;
+  egg_task_cache_enforce_budget (NULL);
+}
+
+gsize
+egg_task_cache_get_memory_budget (void)
+{
+  return memory_budget;
+}
+
 void
 egg_task_cache_set_name (EggTaskCache *self,
                          const gchar  *name)
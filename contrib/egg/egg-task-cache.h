@@ -49,33 +49,48 @@ typedef void (*EggTaskCacheCallback) (EggTaskCache  *self,
                                       GTask         *task,
                                       gpointer       user_data);
 
-EggTaskCache *egg_task_cache_new        (GHashFunc              key_hash_func,
-                                         GEqualFunc             key_equal_func,
-                                         GBoxedCopyFunc         key_copy_func,
-                                         GBoxedFreeFunc         key_destroy_func,
-                                         GBoxedCopyFunc         value_copy_func,
-                                         GBoxedFreeFunc         value_free_func,
-                                         gint64                 time_to_live_msec,
-                                         EggTaskCacheCallback   populate_callback,
-                                         gpointer               populate_callback_data,
-                                         GDestroyNotify         populate_callback_data_destroy);
-void          egg_task_cache_set_name   (EggTaskCache          *self,
-                                         const gchar           *name);
-void          egg_task_cache_get_async  (EggTaskCache          *self,
-                                         gconstpointer          key,
-                                         gboolean               force_update,
-                                         GCancellable          *cancellable,
-                                         GAsyncReadyCallback    callback,
-                                         gpointer               user_data);
-gpointer      egg_task_cache_get_finish (EggTaskCache          *self,
-                                         GAsyncResult          *result,
-                                         GError               **error);
-gboolean      egg_task_cache_evict      (EggTaskCache          *self,
-                                         gconstpointer          key);
-void          egg_task_cache_evict_all  (EggTaskCache          *self);
-gpointer      egg_task_cache_peek       (EggTaskCache          *self,
-                                         gconstpointer          key);
-GPtrArray    *egg_task_cache_get_values (EggTaskCache          *self);
+/**
+ * EggTaskCacheCostFunc:
+ * @value: a value of the cache
+ *
+ * Estimates the memory used by @value, so that the cache can be kept
+ * within its memory budget.
+ *
+ * Returns: the number of bytes used by @value.
+ */
+typedef gsize (*EggTaskCacheCostFunc) (gconstpointer value);
+
+EggTaskCache *egg_task_cache_new               (GHashFunc              key_hash_func,
+                                                GEqualFunc             key_equal_func,
+                                                GBoxedCopyFunc         key_copy_func,
+                                                GBoxedFreeFunc         key_destroy_func,
+                                                GBoxedCopyFunc         value_copy_func,
+                                                GBoxedFreeFunc         value_free_func,
+                                                gint64                 time_to_live_msec,
+                                                EggTaskCacheCallback   populate_callback,
+                                                gpointer               populate_callback_data,
+                                                GDestroyNotify         populate_callback_data_destroy);
+void          egg_task_cache_set_name          (EggTaskCache          *self,
+                                                const gchar           *name);
+void          egg_task_cache_set_cost_func     (EggTaskCache          *self,
+                                                EggTaskCacheCostFunc   cost_func);
+void          egg_task_cache_set_memory_budget (gsize                  budget);
+gsize         egg_task_cache_get_memory_budget (void);
+void          egg_task_cache_get_async         (EggTaskCache          *self,
+                                                gconstpointer          key,
+                                                gboolean               force_update,
+                                                GCancellable          *cancellable,
+                                                GAsyncReadyCallback    callback,
+                                                gpointer               user_data);
+gpointer      egg_task_cache_get_finish        (EggTaskCache          *self,
+                                                GAsyncResult          *result,
+                                                GError               **error);
+gboolean      egg_task_cache_evict             (EggTaskCache          *self,
+                                                gconstpointer          key);
+void          egg_task_cache_evict_all         (EggTaskCache          *self);
+gpointer      egg_task_cache_peek              (EggTaskCache          *self,
+                                                gconstpointer          key);
+GPtrArray    *egg_task_cache_get_values        (EggTaskCache          *self);
 
 G_END_DECLS
 
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "gstyle-color-convert.h"
 
@@ -191,6 +192,169 @@ pow_24 (gdouble x)
   return x * ldexp (pow75norm (s) * pow2_75[qr.rem], 7 * qr.quot);
 }
 
+/* The batch conversions below can't use pow_1_24 and pow_24: frexp, ldexp and
+ * the table lookups keep the compiler from vectorizing the loops. Instead, we
+ * compute x^y as 2^(y * log2 (x)) with branchless polynomials.
+ *
+ * log2 uses the atanh series on a mantissa centered around 1.0,
+ * so that |t| <= 0.172, and exp2 a Taylor series on the fractional part.
+ * Relative error is below 1e-8, more than enough for 8 bits channels
+ * and on par with pow_1_24 ().
+ *
+ * Integer <-> double conversions go through the 2^52 magic number and
+ * 64 bits shifts, so that plain SSE2 is enough to vectorize them.
+ */
+#define MAGIC_2_52    4503599627370496.0
+#define MAGIC_1_5_52  6755399441055744.0
+
+/* Without -fno-trapping-math, gcc refuses to if-convert a selection that has
+ * arithmetic in its arms (it might raise a FP exception not raised before),
+ * unless the target has masked vector operations. Blending arithmetically
+ * with a 0.0 or 1.0 weight vectorizes on plain SSE2 too. Beware that
+ * gcc folds a blend with a constant difference back into a selection.
+ */
+#define BLEND(cond, a, b)   ((b) + ((cond) ? 1.0 : 0.0) * ((a) - (b)))
+
+static inline gdouble
+log2_approx (gdouble x)
+{
+  guint64 bits;
+  guint64 exp_bits;
+  gdouble iexp, m, t, t2, p;
+  gboolean big;
+
+  memcpy (&bits, &x, sizeof bits);
+
+  exp_bits = ((bits >> 52) & 0x7ff) | G_GUINT64_CONSTANT (0x4330000000000000);
+  memcpy (&iexp, &exp_bits, sizeof iexp);
+  iexp -= MAGIC_2_52 + 1023.0;
+
+  bits = (bits & G_GUINT64_CONSTANT (0x000fffffffffffff)) | G_GUINT64_CONSTANT (0x3ff0000000000000);
+  memcpy (&m, &bits, sizeof m);
+
+  big = m > G_SQRT2;
+  iexp = BLEND (big, iexp + 1.0, iexp);
+  m = BLEND (big, m * 0.5, m);
+
+  t = (m - 1.0) / (m + 1.0);
+  t2 = t * t;
+  p = 1.0 / 9.0;
+  p = p * t2 + 1.0 / 7.0;
+  p = p * t2 + 1.0 / 5.0;
+  p = p * t2 + 1.0 / 3.0;
+  p = p * t2 + 1.0;
+
+  /* 2 / ln (2) */
+  return iexp + 2.8853900817779268 * t * p;
+}
+
+static inline gdouble
+exp2_approx (gdouble y)
+{
+  guint64 bits;
+  gdouble n, f, p, scale;
+
+  /* floor () would keep the loop scalar: round to nearest then adjust */
+  n = (y + MAGIC_1_5_52) - MAGIC_1_5_52;
+  n = BLEND (n > y, n - 1.0, n);
+  f = (y - n) * G_LN2;
+
+  p = 1.0 / 362880.0;
+  p = p * f + 1.0 / 40320.0;
+  p = p * f + 1.0 / 5040.0;
+  p = p * f + 1.0 / 720.0;
+  p = p * f + 1.0 / 120.0;
+  p = p * f + 1.0 / 24.0;
+  p = p * f + 1.0 / 6.0;
+  p = p * f + 0.5;
+  p = p * f + 1.0;
+  p = p * f + 1.0;
+
+  /* The low mantissa bits now hold the biased exponent */
+  scale = n + (MAGIC_2_52 + 1023.0);
+  memcpy (&bits, &scale, sizeof bits);
+  bits <<= 52;
+  memcpy (&scale, &bits, sizeof scale);
+
+  return p * scale;
+}
+
+/* Only meaningful for finite x > 0, other values give garbage but never trap */
+static inline gdouble
+pow_approx (gdouble x,
+            gdouble y)
+{
+  return exp2_approx (y * log2_approx (x));
+}
+
+/* Nested ternaries, as in CLAMP (), defeat the if-conversion of the loops,
+ * but a plain min or max selection is fine.
+ */
+static inline gdouble
+clamp_n (gdouble x,
+         gdouble low,
+         gdouble high)
+{
+  x = (x < high) ? x : high;
+  x = (x > low) ? x : low;
+
+  return x;
+}
+
+static inline gdouble
+srgb_to_rgb_component (gdouble c)
+{
+  gdouble gamma;
+  gdouble linear;
+
+  /* Both sides are evaluated and blended. Don't clamp c before
+   * pow_approx (), gcc then threads jumps through the function.
+   */
+  gamma = pow_approx (c, 1.0 / 2.4) * 1.055 - 0.055;
+  linear = c * 12.92;
+
+  return clamp_n (BLEND (c > 0.0031308, gamma, linear), 0.0, 1.0);
+}
+
+/* Applied in place, one component array at a time: with a single call site,
+ * srgb_to_rgb_component () gets inlined at -O2 too.
+ */
+static void
+srgb_to_rgb_n (gdouble * restrict c,
+               guint              n_values)
+{
+  for (guint i = 0; i < n_values; ++i)
+    c[i] = srgb_to_rgb_component (c[i]);
+}
+
+/* The switch on the hue sector is equivalent to:
+ *   c = v - v * s * CLAMP (MIN (k, 4 - k), 0, 1) with k = (n + h * 6) mod 6
+ * and n = 5, 3, 1 for red, green and blue. MIN (k, 4 - k) is 2 - |k - 2|.
+ * For a hue in [0.0-1.0], n + h * 6 is in [0.0-12.0] and rather than doing
+ * the modulo, we take the max of the two periods, the other one being <= 0.
+ *
+ * gcc turns v - vs * (cond ? a : b) into a selection with arithmetic in its
+ * arms, so max and clamp are written with fabs () only:
+ *   MAX (a, b) = (a + b + |a - b|) / 2 and CLAMP (t, 0, 1) = (|t| - |t - 1| + 1) / 2
+ */
+static inline gdouble
+hsv_to_rgb_component (gdouble h6,
+                      gdouble n,
+                      gdouble value,
+                      gdouble vs)
+{
+  gdouble k;
+  gdouble t1, t2, t;
+
+  k = h6 + n;
+  t1 = 2.0 - fabs (k - 2.0);
+  t2 = 2.0 - fabs (k - 8.0);
+  t = 0.5 * (t1 + t2 + fabs (t1 - t2));
+  t = 0.5 * (fabs (t) - fabs (t - 1.0) + 1.0);
+
+  return value - vs * t;
+}
+
 static inline gboolean
 fix_rgb_bounds (GdkRGBA *rgba)
 {
@@ -663,6 +827,103 @@ gstyle_color_convert_cielab_to_rgb (GstyleCielab *lab,
   gstyle_color_convert_srgb_to_rgb (srgb_red, srgb_green, srgb_blue, rgba);
 }
 
+/**
+ * gstyle_color_convert_cielab_to_rgb_n:
+ * @l: (array length=n_values): the L* components
+ * @a: (array length=n_values): the a* components
+ * @b: (array length=n_values): the b* components
+ * @red: (out caller-allocates) (array length=n_values): the red components
+ * @green: (out caller-allocates) (array length=n_values): the green components
+ * @blue: (out caller-allocates) (array length=n_values): the blue components
+ * @n_values: the number of colors to convert
+ *
+ * Batch version of gstyle_color_convert_cielab_to_rgb() working on
+ * separate component arrays. The loop has no branches nor library calls,
+ * so the compiler can vectorize it. Results are clamped to [0.0, 1.0].
+ *
+ * The input and output arrays must not overlap, the parameters are
+ * declared restrict so the loop can be vectorized without alias checks.
+ */
+void
+gstyle_color_convert_cielab_to_rgb_n (const gdouble * restrict l,
+                                      const gdouble * restrict a,
+                                      const gdouble * restrict b,
+                                      gdouble       * restrict red,
+                                      gdouble       * restrict green,
+                                      gdouble       * restrict blue,
+                                      guint          n_values)
+{
+  g_return_if_fail (n_values == 0 || (l != NULL && a != NULL && b != NULL));
+  g_return_if_fail (n_values == 0 || (red != NULL && green != NULL && blue != NULL));
+
+  for (guint i = 0; i < n_values; ++i)
+    {
+      gdouble tmp_x, tmp_y, tmp_z;
+      gdouble pow3_x, pow3_y, pow3_z;
+      gdouble x, y, z;
+
+      tmp_y = (l[i] + 16.0) * (1.0 / 116.0);
+      tmp_x = a[i] * (1.0 / 500.0) + tmp_y;
+      tmp_z = tmp_y - b[i] * (1.0 / 200.0);
+
+      pow3_x = tmp_x * tmp_x * tmp_x;
+      pow3_y = tmp_y * tmp_y * tmp_y;
+      pow3_z = tmp_z * tmp_z * tmp_z;
+
+      x = BLEND (pow3_x > 0.008856, pow3_x, (tmp_x - _16_d_116) * (1.0 / 7.787)) * D65_xref;
+      y = BLEND (pow3_y > 0.008856, pow3_y, (tmp_y - _16_d_116) * (1.0 / 7.787)) * D65_yref;
+      z = BLEND (pow3_z > 0.008856, pow3_z, (tmp_z - _16_d_116) * (1.0 / 7.787)) * D65_zref;
+
+      red[i]   = x *  3.2404542 + y * -1.5371385 + z * -0.4985314;
+      green[i] = x * -0.9692660 + y *  1.8760108 + z *  0.0415560;
+      blue[i]  = x *  0.0556434 + y * -0.2040259 + z *  1.0572252;
+    }
+
+  srgb_to_rgb_n (red, n_values);
+  srgb_to_rgb_n (green, n_values);
+  srgb_to_rgb_n (blue, n_values);
+}
+
+/**
+ * gstyle_color_convert_hsv_to_rgb_n:
+ * @hue: (array length=n_values): the hue components in range [0.0-1.0]
+ * @saturation: (array length=n_values): the saturation components in range [0.0-1.0]
+ * @value: (array length=n_values): the value components in range [0.0-1.0]
+ * @red: (out caller-allocates) (array length=n_values): the red components
+ * @green: (out caller-allocates) (array length=n_values): the green components
+ * @blue: (out caller-allocates) (array length=n_values): the blue components
+ * @n_values: the number of colors to convert
+ *
+ * Batch version of gstyle_color_convert_hsv_to_rgb() working on
+ * separate component arrays. The sector switch is replaced by
+ * the equivalent min/max form so the loop can be vectorized.
+ *
+ * The input and output arrays must not overlap, the parameters are
+ * declared restrict so the loop can be vectorized without alias checks.
+ */
+void
+gstyle_color_convert_hsv_to_rgb_n (const gdouble * restrict hue,
+                                   const gdouble * restrict saturation,
+                                   const gdouble * restrict value,
+                                   gdouble       * restrict red,
+                                   gdouble       * restrict green,
+                                   gdouble       * restrict blue,
+                                   guint          n_values)
+{
+  g_return_if_fail (n_values == 0 || (hue != NULL && saturation != NULL && value != NULL));
+  g_return_if_fail (n_values == 0 || (red != NULL && green != NULL && blue != NULL));
+
+  for (guint i = 0; i < n_values; ++i)
+    {
+      gdouble h6 = hue[i] * 6.0;
+      gdouble vs = value[i] * saturation[i];
+
+      red[i] = hsv_to_rgb_component (h6, 5.0, value[i], vs);
+      green[i] = hsv_to_rgb_component (h6, 3.0, value[i], vs);
+      blue[i] = hsv_to_rgb_component (h6, 1.0, value[i], vs);
+    }
+}
+
 inline void
 gstyle_color_convert_xyz_to_rgb (GstyleXYZ *xyz,
                                  GdkRGBA   *rgba)
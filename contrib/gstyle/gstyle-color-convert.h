@@ -52,6 +52,21 @@ void                  gstyle_color_convert_cielab_to_rgb    (GstyleCielab
 gdouble               gstyle_color_delta_e                  (GstyleCielab        *lab1,
                                                              GstyleCielab        *lab2);
 
+void                  gstyle_color_convert_cielab_to_rgb_n  (const gdouble       *l,
+                                                             const gdouble       *a,
+                                                             const gdouble       *b,
+                                                             gdouble             *red,
+                                                             gdouble             *green,
+                                                             gdouble             *blue,
+                                                             guint                n_values);
+void                  gstyle_color_convert_hsv_to_rgb_n     (const gdouble       *hue,
+                                                             const gdouble       *saturation,
+                                                             const gdouble       *value,
+                                                             gdouble             *red,
+                                                             gdouble             *green,
+                                                             gdouble             *blue,
+                                                             guint                n_values);
+
 void                  gstyle_color_convert_rgb_to_xyz       (GdkRGBA             *rgba,
                                                              GstyleXYZ           *xyz);
 extern void           gstyle_color_convert_cielab_to_xyz    (GstyleCielab        *lab,
@@ -410,6 +410,9 @@ gstyle_color_plane_get_filter_func (GstyleColorPlane *self)
  *
  * Set a filter to be used to change the drawing of the color plane.
  *
+ * The plane is computed by several threads, so the filter function
+ * needs to be thread-safe.
+ *
  */
 void
 gstyle_color_plane_set_filter_func (GstyleColorPlane      *self,
@@ -426,140 +429,225 @@ gstyle_color_plane_set_filter_func (GstyleColorPlane      *self,
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
+/* Rows are split in jobs of at least this size between the pool threads */
+#define COMPUTE_MIN_ROWS_PER_JOB 32
+
+typedef struct _ComputeJob
+{
+  ComputeData            data;
+  ColorSpaceId           color_space;
+  GstyleColorFilterFunc  filter;
+  gpointer               filter_user_data;
+
+  /* Index in the color space components of the fixed, x and y axes */
+  guint                  fixed_index;
+  guint                  x_index;
+  guint                  y_index;
+  gdouble                fixed_val;
+  gdouble                x_factor;
+  gdouble                x_offset;
+  gdouble                y_factor;
+  gdouble                y_offset;
+  guint                  clamp_y : 1;
+
+  gint                   y_start;
+  gint                   y_end;
+
+  /* Shared by all the jobs of a same plane */
+  GMutex                *mutex;
+  GCond                 *cond;
+  gint                  *n_pending;
+} ComputeJob;
+
 static void
-compute_plane_hue_mode (GstyleColorPlane *self,
-                        ComputeData       data)
+compute_job_init (GstyleColorPlane *self,
+                  ComputeJob       *job)
 {
   GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  gdouble hue, saturation, value;
-  GdkRGBA rgba = {0};
-  guint32 *p;
+  GstyleColorComponent ref_comp;
+  ComputeData *data = &priv->data;
 
   g_assert (GSTYLE_IS_COLOR_PLANE (self));
+  g_assert (job != NULL);
+
+  job->data = priv->data;
+  job->filter = priv->filter;
+  job->filter_user_data = priv->filter_user_data;
 
-  hue = priv->comp [GSTYLE_COLOR_COMPONENT_HSV_H].val / priv->comp [GSTYLE_COLOR_COMPONENT_HSV_H].factor;
-  for (gint y = 0; y < data.height; ++y)
+  /* HSV components are ordered h, s, v, CIELAB ones l, a, b and RGB ones r, g, b */
+  switch (priv->mode)
     {
-      value = CLAMP ((data.height - y) * data.y_factor, 0.0, 1.0);
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          saturation = x * data.x_factor;
-          gstyle_color_convert_hsv_to_rgb (hue, saturation, value, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+    case GSTYLE_COLOR_PLANE_MODE_HUE:
+      ref_comp = GSTYLE_COLOR_COMPONENT_HSV_H;
+      job->color_space = COLOR_SPACE_HSV;
+      job->fixed_index = 0;
+      job->x_index = 1;
+      job->y_index = 2;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      job->clamp_y = TRUE;
+      break;
 
-          p[x] = pack_rgba24 (&rgba);
-        }
-    }
-}
+    case GSTYLE_COLOR_PLANE_MODE_SATURATION:
+      ref_comp = GSTYLE_COLOR_COMPONENT_HSV_S;
+      job->color_space = COLOR_SPACE_HSV;
+      job->fixed_index = 1;
+      job->x_index = 0;
+      job->y_index = 2;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      job->clamp_y = TRUE;
+      break;
 
-static void
-compute_plane_saturation_mode (GstyleColorPlane *self,
-                               ComputeData       data)
-{
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  gdouble hue, saturation, value;
-  GdkRGBA rgba = {0};
-  guint32 *p;
+    case GSTYLE_COLOR_PLANE_MODE_BRIGHTNESS:
+      ref_comp = GSTYLE_COLOR_COMPONENT_HSV_V;
+      job->color_space = COLOR_SPACE_HSV;
+      job->fixed_index = 2;
+      job->x_index = 0;
+      job->y_index = 1;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      job->clamp_y = TRUE;
+      break;
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+    case GSTYLE_COLOR_PLANE_MODE_CIELAB_L:
+      ref_comp = GSTYLE_COLOR_COMPONENT_LAB_L;
+      job->color_space = COLOR_SPACE_CIELAB;
+      job->fixed_index = 0;
+      job->x_index = 1;
+      job->y_index = 2;
+      job->x_factor = data->lab_x_factor;
+      job->x_offset = -128.0;
+      job->y_factor = data->lab_y_factor;
+      job->y_offset = -128.0;
+      break;
 
-  saturation = priv->comp [GSTYLE_COLOR_COMPONENT_HSV_S].val / priv->comp [GSTYLE_COLOR_COMPONENT_HSV_S].factor;
-  for (gint y = 0; y < data.height; ++y)
-    {
-      value = CLAMP ((data.height - y) * data.y_factor, 0.0, 1.0);
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          hue = x * data.x_factor;
-          gstyle_color_convert_hsv_to_rgb (hue, saturation, value, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+    case GSTYLE_COLOR_PLANE_MODE_CIELAB_A:
+      ref_comp = GSTYLE_COLOR_COMPONENT_LAB_A;
+      job->color_space = COLOR_SPACE_CIELAB;
+      job->fixed_index = 1;
+      job->x_index = 2;
+      job->y_index = 0;
+      job->x_factor = data->lab_x_factor;
+      job->x_offset = -128.0;
+      job->y_factor = data->lab_l_factor;
+      break;
 
-          p[x] = pack_rgba24 (&rgba);
-        }
-    }
-}
+    case GSTYLE_COLOR_PLANE_MODE_CIELAB_B:
+      ref_comp = GSTYLE_COLOR_COMPONENT_LAB_B;
+      job->color_space = COLOR_SPACE_CIELAB;
+      job->fixed_index = 2;
+      job->x_index = 1;
+      job->y_index = 0;
+      job->x_factor = data->lab_x_factor;
+      job->x_offset = -128.0;
+      job->y_factor = data->lab_l_factor;
+      break;
 
-static void
-compute_plane_brightness_mode (GstyleColorPlane *self,
-                               ComputeData       data)
-{
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  gdouble hue, saturation, value;
-  GdkRGBA rgba = {0};
-  guint32 *p;
+    case GSTYLE_COLOR_PLANE_MODE_RED:
+      ref_comp = GSTYLE_COLOR_COMPONENT_RGB_RED;
+      job->color_space = COLOR_SPACE_RGB;
+      job->fixed_index = 0;
+      job->x_index = 2;
+      job->y_index = 1;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      break;
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+    case GSTYLE_COLOR_PLANE_MODE_GREEN:
+      ref_comp = GSTYLE_COLOR_COMPONENT_RGB_GREEN;
+      job->color_space = COLOR_SPACE_RGB;
+      job->fixed_index = 1;
+      job->x_index = 2;
+      job->y_index = 0;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      break;
 
-  value = priv->comp [GSTYLE_COLOR_COMPONENT_HSV_V].val / priv->comp [GSTYLE_COLOR_COMPONENT_HSV_V].factor;
-  for (gint y = 0; y < data.height - 1; ++y)
-    {
-      saturation = CLAMP ((data.height - y) * data.y_factor, 0.0, 1.0);
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          hue = x * data.x_factor;
-          gstyle_color_convert_hsv_to_rgb (hue, saturation, value, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+    case GSTYLE_COLOR_PLANE_MODE_BLUE:
+      ref_comp = GSTYLE_COLOR_COMPONENT_RGB_BLUE;
+      job->color_space = COLOR_SPACE_RGB;
+      job->fixed_index = 2;
+      job->x_index = 0;
+      job->y_index = 1;
+      job->x_factor = data->x_factor;
+      job->y_factor = data->y_factor;
+      break;
 
-          p[x] = pack_rgba24 (&rgba);
-        }
+    case GSTYLE_COLOR_PLANE_MODE_NONE:
+    default:
+      g_assert_not_reached ();
+      return;
     }
+
+  job->fixed_val = priv->comp [ref_comp].val / priv->comp [ref_comp].factor;
 }
 
+/* Fill the rows [y_start, y_end[ of the buffer. Each row is computed
+ * in component arrays so that the conversion is done by the batch
+ * functions of gstyle-color-convert.c, then packed into the buffer.
+ */
 static void
-compute_plane_cielab_l_mode (GstyleColorPlane *self,
-                             ComputeData       data)
+compute_rows (ComputeJob *job)
 {
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GstyleCielab lab;
+  ComputeData *data = &job->data;
+  g_autofree gdouble *scratch = NULL;
+  gdouble *comps [3];
+  gdouble *red, *green, *blue;
   GdkRGBA rgba = {0};
+  gdouble y_val;
   guint32 *p;
+  gint width = data->width;
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+  g_assert (job != NULL);
 
-  lab.l = priv->comp [GSTYLE_COLOR_COMPONENT_LAB_L].val / priv->comp [GSTYLE_COLOR_COMPONENT_LAB_L].factor;
-  for (gint y = 0; y < data.height; ++y)
+  scratch = g_new (gdouble, width * 6);
+  comps [0] = scratch;
+  comps [1] = scratch + width;
+  comps [2] = scratch + width * 2;
+
+  if (job->color_space == COLOR_SPACE_RGB)
     {
-      lab.b = (data.height - y) * data.lab_y_factor - 128.0;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          lab.a = x * data.lab_x_factor - 128.0;
-          gstyle_color_convert_cielab_to_rgb (&lab, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+      red = comps [0];
+      green = comps [1];
+      blue = comps [2];
+    }
+  else
+    {
+      red = scratch + width * 3;
+      green = scratch + width * 4;
+      blue = scratch + width * 5;
+    }
 
-          p[x] = pack_rgba24 (&rgba);
-        }
+  /* The x axis and the fixed component are the same for all the rows */
+  for (gint x = 0; x < width; ++x)
+    {
+      comps [job->x_index][x] = x * job->x_factor + job->x_offset;
+      comps [job->fixed_index][x] = job->fixed_val;
     }
-}
 
-static void
-compute_plane_cielab_a_mode (GstyleColorPlane *self,
-                             ComputeData       data)
-{
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GstyleCielab lab;
-  GdkRGBA rgba = {0};
-  guint32 *p;
+  for (gint y = job->y_start; y < job->y_end; ++y)
+    {
+      y_val = (data->height - y) * job->y_factor + job->y_offset;
+      if (job->clamp_y)
+        y_val = CLAMP (y_val, 0.0, 1.0);
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+      for (gint x = 0; x < width; ++x)
+        comps [job->y_index][x] = y_val;
 
-  lab.a = priv->comp [GSTYLE_COLOR_COMPONENT_LAB_A].val / priv->comp [GSTYLE_COLOR_COMPONENT_LAB_A].factor;
-  for (gint y = 0; y < data.height; ++y)
-    {
-      lab.l = (data.height - y) * data.lab_l_factor;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
+      if (job->color_space == COLOR_SPACE_HSV)
+        gstyle_color_convert_hsv_to_rgb_n (comps [0], comps [1], comps [2], red, green, blue, width);
+      else if (job->color_space == COLOR_SPACE_CIELAB)
+        gstyle_color_convert_cielab_to_rgb_n (comps [0], comps [1], comps [2], red, green, blue, width);
+
+      p = data->buffer + y * (data->stride / 4);
+      for (gint x = 0; x < width; ++x)
         {
-          lab.b = x * data.lab_x_factor - 128.0;
-          gstyle_color_convert_cielab_to_rgb (&lab, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+          rgba.red = red [x];
+          rgba.green = green [x];
+          rgba.blue = blue [x];
+          if (job->filter != NULL)
+            job->filter (&rgba, &rgba, job->filter_user_data);
 
           p[x] = pack_rgba24 (&rgba);
         }
@@ -567,109 +655,98 @@ compute_plane_cielab_a_mode (GstyleColorPlane *self,
 }
 
 static void
-compute_plane_cielab_b_mode (GstyleColorPlane *self,
-                             ComputeData       data)
+compute_rows_worker (gpointer data,
+                     gpointer user_data)
 {
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GstyleCielab lab;
-  GdkRGBA rgba = {0};
-  guint32 *p;
+  ComputeJob *job = data;
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+  g_assert (job != NULL);
 
-  lab.b = priv->comp [GSTYLE_COLOR_COMPONENT_LAB_B].val / priv->comp [GSTYLE_COLOR_COMPONENT_LAB_B].factor;
-  for (gint y = 0; y < data.height; ++y)
-    {
-      lab.l = (data.height - y) * data.lab_l_factor;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          lab.a = x * data.lab_x_factor - 128.0;
-          gstyle_color_convert_cielab_to_rgb (&lab, &rgba);
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+  compute_rows (job);
 
-          p[x] = pack_rgba24 (&rgba);
-        }
-    }
+  g_mutex_lock (job->mutex);
+  if (--(*job->n_pending) == 0)
+    g_cond_signal (job->cond);
+  g_mutex_unlock (job->mutex);
 }
 
-static void
-compute_plane_red_mode (GstyleColorPlane *self,
-                        ComputeData       data)
+static GThreadPool *
+get_compute_pool (void)
 {
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GdkRGBA rgba = {0};
-  guint32 *p;
-
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+  static GThreadPool *pool;
 
-  rgba.red = priv->comp [GSTYLE_COLOR_COMPONENT_RGB_RED].val / priv->comp [GSTYLE_COLOR_COMPONENT_RGB_RED].factor;
-  for (gint y = 0; y < data.height; ++y)
+  if (g_once_init_enter (&pool))
     {
-      rgba.green = (data.height - y) * data.y_factor;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          rgba.blue = x * data.x_factor;
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
-
-          p[x] = pack_rgba24 (&rgba);
-        }
+      GThreadPool *_pool;
+
+      _pool = g_thread_pool_new (compute_rows_worker,
+                                 NULL,
+                                 g_get_num_processors (),
+                                 FALSE,
+                                 NULL);
+      g_once_init_leave (&pool, _pool);
     }
+
+  return pool;
 }
 
+/* The rows are split between the calling thread and a shared pool,
+ * we block until all of them are done, the buffer is used right after.
+ */
 static void
-compute_plane_green_mode (GstyleColorPlane *self,
-                          ComputeData       data)
+compute_plane (GstyleColorPlane *self)
 {
   GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GdkRGBA rgba = {0};
-  guint32 *p;
+  g_autofree ComputeJob *jobs = NULL;
+  ComputeJob base = {0};
+  GThreadPool *pool;
+  GMutex mutex;
+  GCond cond;
+  gint height = priv->data.height;
+  gint n_jobs;
+  gint n_pending;
 
   g_assert (GSTYLE_IS_COLOR_PLANE (self));
 
-  rgba.green = priv->comp [GSTYLE_COLOR_COMPONENT_RGB_GREEN].val / priv->comp [GSTYLE_COLOR_COMPONENT_RGB_GREEN].factor;
-  for (gint y = 0; y < data.height; ++y)
-    {
-      rgba.red = (data.height - y) * data.y_factor;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          rgba.blue = x * data.x_factor;
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
+  compute_job_init (self, &base);
 
-          p[x] = pack_rgba24 (&rgba);
-        }
+  n_jobs = CLAMP (height / COMPUTE_MIN_ROWS_PER_JOB, 1, (gint)g_get_num_processors ());
+  if (n_jobs == 1)
+    {
+      base.y_start = 0;
+      base.y_end = height;
+      compute_rows (&base);
+      return;
     }
-}
-
-static void
-compute_plane_blue_mode (GstyleColorPlane *self,
-                         ComputeData       data)
-{
-  GstyleColorPlanePrivate *priv = gstyle_color_plane_get_instance_private (self);
-  GdkRGBA rgba = {0};
-  guint32 *p;
 
-  g_assert (GSTYLE_IS_COLOR_PLANE (self));
+  g_mutex_init (&mutex);
+  g_cond_init (&cond);
+  pool = get_compute_pool ();
+  n_pending = n_jobs - 1;
 
-  rgba.blue = priv->comp [GSTYLE_COLOR_COMPONENT_RGB_BLUE].val / priv->comp [GSTYLE_COLOR_COMPONENT_RGB_BLUE].factor;
-  for (gint y = 0; y < data.height; ++y)
+  jobs = g_new (ComputeJob, n_jobs);
+  for (gint i = 0; i < n_jobs; ++i)
     {
-      rgba.green = (data.height - y) * data.y_factor;
-      p = data.buffer + y * (data.stride / 4);
-      for (gint x = 0; x < data.width; ++x)
-        {
-          rgba.red = x * data.x_factor;
-          if (priv->filter != NULL)
-            priv->filter (&rgba, &rgba, priv->filter_user_data);
-
-          p[x] = pack_rgba24 (&rgba);
-        }
+      jobs [i] = base;
+      jobs [i].y_start = height * i / n_jobs;
+      jobs [i].y_end = height * (i + 1) / n_jobs;
+      jobs [i].mutex = &mutex;
+      jobs [i].cond = &cond;
+      jobs [i].n_pending = &n_pending;
+
+      if (i > 0)
+        g_thread_pool_push (pool, &jobs [i], NULL);
     }
+
+  compute_rows (&jobs [0]);
+
+  g_mutex_lock (&mutex);
+  while (n_pending > 0)
+    g_cond_wait (&cond, &mutex);
+  g_mutex_unlock (&mutex);
+
+  g_cond_clear (&cond);
+  g_mutex_clear (&mutex);
 }
 
 static gboolean
@@ -716,48 +793,7 @@ create_surface (GstyleColorPlane *self)
   priv->data.stride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, priv->data.width);
   priv->data.buffer = g_malloc (priv->data.height * priv->data.stride);
 
-  switch (priv->mode)
-    {
-    case GSTYLE_COLOR_PLANE_MODE_HUE:
-      compute_plane_hue_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_SATURATION:
-      compute_plane_saturation_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_BRIGHTNESS:
-      compute_plane_brightness_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_CIELAB_L:
-      compute_plane_cielab_l_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_CIELAB_A:
-      compute_plane_cielab_a_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_CIELAB_B:
-      compute_plane_cielab_b_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_RED:
-      compute_plane_red_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_GREEN:
-      compute_plane_green_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_BLUE:
-      compute_plane_blue_mode (self, priv->data);
-      break;
-
-    case GSTYLE_COLOR_PLANE_MODE_NONE:
-    default:
-      g_assert_not_reached ();
-    }
+  compute_plane (self);
 
   tmp = cairo_image_surface_create_for_data ((guchar *)priv->data.buffer, CAIRO_FORMAT_RGB24,
                                              priv->data.width, priv->data.height, priv->data.stride);
@@ -685,25 +685,28 @@ _parse_hsla_string (const gchar      *string,
 }
 
 /* TODO: add a public func to init so we can control the initial starting time ? */
+/* Colors may be parsed from worker threads, so build the table only once. */
 static Fuzzy *
 _init_predefined_table (void)
 {
   static Fuzzy *predefined_table;
   NamedColor *item;
 
-  if (predefined_table == NULL)
+  if (g_once_init_enter (&predefined_table))
     {
-      predefined_table = fuzzy_new (TRUE);
+      Fuzzy *table = fuzzy_new (TRUE);
 
-      fuzzy_begin_bulk_insert (predefined_table);
+      fuzzy_begin_bulk_insert (table);
       for (guint i = 0; i < G_N_ELEMENTS (predefined_colors_table); ++i)
         {
           item = &predefined_colors_table [i];
           item->index = i;
-          fuzzy_insert (predefined_table, item->name, (gpointer)item);
+          fuzzy_insert (table, item->name, (gpointer)item);
         }
 
-      fuzzy_end_bulk_insert (predefined_table);
+      fuzzy_end_bulk_insert (table);
+
+      g_once_init_leave (&predefined_table, table);
     }
 
   return predefined_table;
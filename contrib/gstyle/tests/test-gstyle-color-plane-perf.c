@@ -0,0 +1,121 @@
+/* test-gstyle-color-plane-perf.c
+ *
+ * Copyright (C) 2016 sebastien lafargue <slafargue@gnome.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks the plane computation of each mode, by moving the
+ * reference component like a user dragging its slider would do.
+ *
+ * usage: test-gstyle-color-plane-perf [COUNT [SIZE]]
+ */
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+#include "gstyle-color-plane.h"
+
+#define DEFAULT_COUNT 200
+#define DEFAULT_SIZE  512
+
+typedef struct
+{
+  GstyleColorPlaneMode  mode;
+  GstyleColorComponent  ref_comp;
+  const gchar          *name;
+} ModeInfo;
+
+static const ModeInfo modes [] = {
+  { GSTYLE_COLOR_PLANE_MODE_HUE,        GSTYLE_COLOR_COMPONENT_HSV_H,     "hsv hue" },
+  { GSTYLE_COLOR_PLANE_MODE_SATURATION, GSTYLE_COLOR_COMPONENT_HSV_S,     "hsv saturation" },
+  { GSTYLE_COLOR_PLANE_MODE_BRIGHTNESS, GSTYLE_COLOR_COMPONENT_HSV_V,     "hsv brightness" },
+  { GSTYLE_COLOR_PLANE_MODE_CIELAB_L,   GSTYLE_COLOR_COMPONENT_LAB_L,     "cielab l*" },
+  { GSTYLE_COLOR_PLANE_MODE_CIELAB_A,   GSTYLE_COLOR_COMPONENT_LAB_A,     "cielab a*" },
+  { GSTYLE_COLOR_PLANE_MODE_CIELAB_B,   GSTYLE_COLOR_COMPONENT_LAB_B,     "cielab b*" },
+  { GSTYLE_COLOR_PLANE_MODE_RED,        GSTYLE_COLOR_COMPONENT_RGB_RED,   "rgb red" },
+  { GSTYLE_COLOR_PLANE_MODE_GREEN,      GSTYLE_COLOR_COMPONENT_RGB_GREEN, "rgb green" },
+  { GSTYLE_COLOR_PLANE_MODE_BLUE,       GSTYLE_COLOR_COMPONENT_RGB_BLUE,  "rgb blue" },
+};
+
+static void
+bench_mode (GstyleColorPlane *plane,
+            const ModeInfo   *info,
+            guint             count)
+{
+  GtkAdjustment *adj;
+  gdouble lower;
+  gdouble range;
+  gint64 begin;
+  gint64 end;
+
+  gstyle_color_plane_set_mode (plane, info->mode);
+
+  adj = gstyle_color_plane_get_component_adjustment (plane, info->ref_comp);
+  lower = gtk_adjustment_get_lower (adj);
+  range = gtk_adjustment_get_upper (adj) - lower;
+
+  begin = g_get_monotonic_time ();
+
+  /* Each new value of the reference component recomputes the surface */
+  for (guint i = 0; i < count; ++i)
+    gtk_adjustment_set_value (adj, lower + range * ((i % 100) + 1) / 101.0);
+
+  end = g_get_monotonic_time ();
+
+  g_print ("%-16s %u planes in %.3lf msec (%.3lf msec per plane)\n",
+           info->name,
+           count,
+           (end - begin) / 1000.0,
+           (end - begin) / 1000.0 / count);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GstyleColorPlane *plane;
+  GtkWidget *window;
+  guint count = DEFAULT_COUNT;
+  gint size = DEFAULT_SIZE;
+
+  gtk_init (&argc, &argv);
+
+  if (argc > 1)
+    count = MAX (1, atoi (argv[1]));
+  if (argc > 2)
+    size = MAX (2, atoi (argv[2]));
+
+  plane = gstyle_color_plane_new ();
+  gtk_widget_set_size_request (GTK_WIDGET (plane), size, size);
+
+  window = gtk_offscreen_window_new ();
+  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (plane));
+  gtk_widget_show_all (window);
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  g_print ("Computing %dx%d planes\n", size, size);
+
+  for (guint i = 0; i < G_N_ELEMENTS (modes); ++i)
+    bench_mode (plane, &modes [i], count);
+
+  gtk_widget_destroy (window);
+
+  return EXIT_SUCCESS;
+}
@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 #include "rg-cpu-table.h"
 #include "rg-graph.h"
 #include "rg-line-renderer.h"
+#include "rg-process-table.h"
 #include "rg-renderer.h"
 #include "rg-table.h"
 
@@ -0,0 +1,664 @@
+/* rg-process-table.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rg-process-table.h"
+
+/*
+ * RgProcessTable samples the CPU, resident memory and I/O of a process and
+ * all of its descendants. Samples are pushed into the table like any other
+ * RgTable so they are kept in the column RgRing storage and can be reviewed
+ * (or graphed) after the process has exited.
+ *
+ * Sampling is adaptive. Right after spawning, and whenever the process tree
+ * changes shape, we poll quickly to catch short-lived children. While the
+ * tree is stable the interval backs off towards the interval implied by the
+ * table timespan and max-samples.
+ */
+
+#define MIN_INTERVAL_MSEC 100
+
+typedef struct
+{
+  guint64 ticks;
+  guint64 read_bytes;
+  guint64 write_bytes;
+} ProcInfo;
+
+struct _RgProcessTable
+{
+  RgTable     parent_instance;
+
+  GPid        pid;
+
+  GHashTable *last;
+  gint64      last_time;
+
+  gdouble     peak_cpu;
+  gdouble     peak_rss;
+
+  guint       poll_source;
+  guint       poll_interval_msec;
+  guint       interval_msec;
+
+  guint       running : 1;
+};
+
+G_DEFINE_TYPE (RgProcessTable, rg_process_table, RG_TYPE_TABLE)
+
+enum {
+  PROP_0,
+  PROP_PEAK_CPU,
+  PROP_PEAK_RSS,
+  PROP_PID,
+  PROP_RUNNING,
+  LAST_PROP
+};
+
+static GParamSpec *properties [LAST_PROP];
+
+static void rg_process_table_schedule (RgProcessTable *self);
+
+#ifdef __linux__
+static gboolean
+read_stat (GPid     pid,
+           guint64 *ticks,
+           GPid    *ppid)
+{
+  gchar path[64];
+  gchar *contents = NULL;
+  const gchar *endptr;
+  guint64 utime = 0;
+  guint64 stime = 0;
+  gint parent = 0;
+  gboolean ret = FALSE;
+
+  g_snprintf (path, sizeof path, "/proc/%d/stat", (gint)pid);
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return FALSE;
+
+  /* The command name may contain spaces and parens, skip past the last ')' */
+  if ((endptr = strrchr (contents, ')')) &&
+      3 == sscanf (endptr + 1,
+                   " %*c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u"
+                   " %"G_GUINT64_FORMAT" %"G_GUINT64_FORMAT,
+                   &parent, &utime, &stime))
+    {
+      if (ticks != NULL)
+        *ticks = utime + stime;
+      if (ppid != NULL)
+        *ppid = parent;
+      ret = TRUE;
+    }
+
+  g_free (contents);
+
+  return ret;
+}
+
+static guint64
+read_rss (GPid pid)
+{
+  gchar path[64];
+  gchar *contents = NULL;
+  guint64 resident = 0;
+
+  g_snprintf (path, sizeof path, "/proc/%d/statm", (gint)pid);
+
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      if (1 != sscanf (contents, "%*u %"G_GUINT64_FORMAT, &resident))
+        resident = 0;
+      g_free (contents);
+    }
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void
+read_io (GPid     pid,
+         guint64 *read_bytes,
+         guint64 *write_bytes)
+{
+  gchar path[64];
+  gchar *contents = NULL;
+  gchar **lines;
+  guint i;
+
+  *read_bytes = 0;
+  *write_bytes = 0;
+
+  g_snprintf (path, sizeof path, "/proc/%d/io", (gint)pid);
+
+  /* Not readable for processes we cannot ptrace, which is fine */
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (i = 0; lines [i]; i++)
+    {
+      if (g_str_has_prefix (lines [i], "rchar: "))
+        *read_bytes = g_ascii_strtoull (lines [i] + 7, NULL, 10);
+      else if (g_str_has_prefix (lines [i], "wchar: "))
+        *write_bytes = g_ascii_strtoull (lines [i] + 7, NULL, 10);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+static gboolean
+collect_children (GPid    pid,
+                  GArray *pids)
+{
+  gchar path[64];
+  const gchar *name;
+  GDir *dir;
+
+  /*
+   * /proc/<pid>/task/<tid>/children lists the children spawned by each
+   * thread. It requires CONFIG_PROC_CHILDREN, so let the caller know if it
+   * is missing and we need to fall back to scanning all of /proc.
+   */
+  g_snprintf (path, sizeof path, "/proc/%d/task", (gint)pid);
+
+  if (!(dir = g_dir_open (path, 0, NULL)))
+    return FALSE;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *children_path;
+      gchar *contents = NULL;
+      gchar **parts;
+      guint i;
+
+      children_path = g_build_filename (path, name, "children", NULL);
+
+      if (!g_file_get_contents (children_path, &contents, NULL, NULL))
+        {
+          g_free (children_path);
+          g_dir_close (dir);
+          return FALSE;
+        }
+
+      parts = g_strsplit (g_strstrip (contents), " ", 0);
+
+      for (i = 0; parts [i]; i++)
+        {
+          GPid child = (GPid)g_ascii_strtoll (parts [i], NULL, 10);
+
+          if (child > 0)
+            {
+              g_array_append_val (pids, child);
+              collect_children (child, pids);
+            }
+        }
+
+      g_strfreev (parts);
+      g_free (contents);
+      g_free (children_path);
+    }
+
+  g_dir_close (dir);
+
+  return TRUE;
+}
+
+static void
+collect_children_slow (GPid    pid,
+                       GArray *pids)
+{
+  GHashTable *by_parent;
+  const gchar *name;
+  GDir *dir;
+  guint i;
+
+  if (!(dir = g_dir_open ("/proc", 0, NULL)))
+    return;
+
+  by_parent = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_array_unref);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      GPid child;
+      GPid parent;
+      GArray *siblings;
+
+      if (!g_ascii_isdigit (*name))
+        continue;
+
+      child = (GPid)g_ascii_strtoll (name, NULL, 10);
+
+      if (!read_stat (child, NULL, &parent))
+        continue;
+
+      if (!(siblings = g_hash_table_lookup (by_parent, GINT_TO_POINTER (parent))))
+        {
+          siblings = g_array_new (FALSE, FALSE, sizeof (GPid));
+          g_hash_table_insert (by_parent, GINT_TO_POINTER (parent), siblings);
+        }
+
+      g_array_append_val (siblings, child);
+    }
+
+  g_dir_close (dir);
+
+  /* @pids already contains @pid, walk it breadth first as it grows */
+  for (i = 0; i < pids->len; i++)
+    {
+      GArray *children;
+
+      children = g_hash_table_lookup (by_parent,
+                                      GINT_TO_POINTER (g_array_index (pids, GPid, i)));
+
+      if (children != NULL)
+        g_array_append_vals (pids, children->data, children->len);
+    }
+
+  g_hash_table_unref (by_parent);
+}
+
+static gboolean
+rg_process_table_sample (RgProcessTable *self)
+{
+  GHashTable *current;
+  RgTableIter iter;
+  GArray *pids;
+  gboolean changed;
+  gdouble elapsed;
+  gdouble cpu;
+  gdouble rss = 0.0;
+  guint64 delta_ticks = 0;
+  guint64 delta_read = 0;
+  guint64 delta_write = 0;
+  gint64 now;
+  guint i;
+
+  g_assert (RG_IS_PROCESS_TABLE (self));
+
+  now = g_get_monotonic_time ();
+  elapsed = MAX (1, now - self->last_time) / (gdouble)G_USEC_PER_SEC;
+
+  pids = g_array_new (FALSE, FALSE, sizeof (GPid));
+  g_array_append_val (pids, self->pid);
+
+  if (!collect_children (self->pid, pids))
+    {
+      g_array_set_size (pids, 1);
+      collect_children_slow (self->pid, pids);
+    }
+
+  current = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  for (i = 0; i < pids->len; i++)
+    {
+      GPid pid = g_array_index (pids, GPid, i);
+      ProcInfo *info;
+      ProcInfo *prev;
+
+      info = g_new0 (ProcInfo, 1);
+
+      if (!read_stat (pid, &info->ticks, NULL))
+        {
+          g_free (info);
+
+          /* The root process is gone, there is nothing left to sample */
+          if (i == 0)
+            {
+              g_hash_table_unref (current);
+              g_array_unref (pids);
+              return FALSE;
+            }
+
+          continue;
+        }
+
+      read_io (pid, &info->read_bytes, &info->write_bytes);
+      rss += read_rss (pid);
+
+      /*
+       * Track counters per process so that a child exiting between two
+       * samples does not make the totals go backwards.
+       */
+      if ((prev = g_hash_table_lookup (self->last, GINT_TO_POINTER (pid))))
+        {
+          delta_ticks += info->ticks >= prev->ticks ? info->ticks - prev->ticks : 0;
+          delta_read += info->read_bytes >= prev->read_bytes ? info->read_bytes - prev->read_bytes : 0;
+          delta_write += info->write_bytes >= prev->write_bytes ? info->write_bytes - prev->write_bytes : 0;
+        }
+      else if (g_hash_table_size (self->last) > 0)
+        {
+          /* A new child since the last sample, everything it did is new */
+          delta_ticks += info->ticks;
+          delta_read += info->read_bytes;
+          delta_write += info->write_bytes;
+        }
+
+      g_hash_table_insert (current, GINT_TO_POINTER (pid), info);
+    }
+
+  changed = g_hash_table_size (current) != g_hash_table_size (self->last);
+
+  if (!changed)
+    {
+      GHashTableIter hiter;
+      gpointer key;
+
+      g_hash_table_iter_init (&hiter, current);
+      while (!changed && g_hash_table_iter_next (&hiter, &key, NULL))
+        changed = !g_hash_table_contains (self->last, key);
+    }
+
+  cpu = delta_ticks / (gdouble)sysconf (_SC_CLK_TCK) / elapsed * 100.0;
+
+  rg_table_push (RG_TABLE (self), &iter, now);
+  rg_table_iter_set (&iter,
+                     RG_PROCESS_TABLE_COLUMN_CPU, cpu,
+                     RG_PROCESS_TABLE_COLUMN_RSS, rss,
+                     RG_PROCESS_TABLE_COLUMN_READ, delta_read / elapsed,
+                     RG_PROCESS_TABLE_COLUMN_WRITE, delta_write / elapsed,
+                     -1);
+
+  if (cpu > self->peak_cpu)
+    {
+      self->peak_cpu = cpu;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_PEAK_CPU]);
+    }
+
+  if (rss > self->peak_rss)
+    {
+      self->peak_rss = rss;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_PEAK_RSS]);
+    }
+
+  if (changed)
+    self->interval_msec = MIN_INTERVAL_MSEC;
+  else
+    self->interval_msec = MIN (self->interval_msec * 2, self->poll_interval_msec);
+
+  g_hash_table_unref (self->last);
+  self->last = current;
+  self->last_time = now;
+
+  g_array_unref (pids);
+
+  return TRUE;
+}
+#else
+static gboolean
+rg_process_table_sample (RgProcessTable *self)
+{
+  /* TODO: Sample process trees on FreeBSD/etc. */
+  return FALSE;
+}
+#endif
+
+static gboolean
+rg_process_table_poll_cb (gpointer user_data)
+{
+  RgProcessTable *self = user_data;
+
+  g_assert (RG_IS_PROCESS_TABLE (self));
+
+  self->poll_source = 0;
+
+  if (rg_process_table_sample (self))
+    {
+      rg_process_table_schedule (self);
+    }
+  else
+    {
+      self->running = FALSE;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_RUNNING]);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+rg_process_table_schedule (RgProcessTable *self)
+{
+  g_assert (RG_IS_PROCESS_TABLE (self));
+  g_assert (self->poll_source == 0);
+
+  self->poll_source = g_timeout_add (self->interval_msec, rg_process_table_poll_cb, self);
+}
+
+static void
+rg_process_table_constructed (GObject *object)
+{
+  RgProcessTable *self = (RgProcessTable *)object;
+  gint64 timespan;
+  guint max_samples;
+  guint i;
+  static const gchar *names[] = {
+    "CPU",
+    "Memory",
+    "Read",
+    "Write",
+  };
+
+  G_OBJECT_CLASS (rg_process_table_parent_class)->constructed (object);
+
+  max_samples = rg_table_get_max_samples (RG_TABLE (self));
+  timespan = rg_table_get_timespan (RG_TABLE (self));
+
+  self->poll_interval_msec = (gdouble)timespan / (gdouble)(max_samples - 1) / 1000L;
+
+  if (self->poll_interval_msec == 0)
+    {
+      g_critical ("Implausible timespan/max_samples combination for graph.");
+      self->poll_interval_msec = 1000;
+    }
+
+  self->poll_interval_msec = MAX (self->poll_interval_msec, MIN_INTERVAL_MSEC);
+  self->interval_msec = MIN_INTERVAL_MSEC;
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      RgColumn *column;
+
+      column = rg_column_new (names [i], G_TYPE_DOUBLE);
+      rg_table_add_column (RG_TABLE (self), column);
+      g_object_unref (column);
+    }
+
+  if (self->pid > 0)
+    {
+      self->running = TRUE;
+      self->last_time = g_get_monotonic_time ();
+      rg_process_table_schedule (self);
+    }
+}
+
+static void
+rg_process_table_finalize (GObject *object)
+{
+  RgProcessTable *self = (RgProcessTable *)object;
+
+  if (self->poll_source != 0)
+    {
+      g_source_remove (self->poll_source);
+      self->poll_source = 0;
+    }
+
+  g_clear_pointer (&self->last, g_hash_table_unref);
+
+  G_OBJECT_CLASS (rg_process_table_parent_class)->finalize (object);
+}
+
+static void
+rg_process_table_get_property (GObject    *object,
+                               guint       prop_id,
+                               GValue     *value,
+                               GParamSpec *pspec)
+{
+  RgProcessTable *self = RG_PROCESS_TABLE (object);
+
+  switch (prop_id)
+    {
+    case PROP_PEAK_CPU:
+      g_value_set_double (value, self->peak_cpu);
+      break;
+
+    case PROP_PEAK_RSS:
+      g_value_set_double (value, self->peak_rss);
+      break;
+
+    case PROP_PID:
+      g_value_set_int (value, self->pid);
+      break;
+
+    case PROP_RUNNING:
+      g_value_set_boolean (value, self->running);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+rg_process_table_set_property (GObject      *object,
+                               guint         prop_id,
+                               const GValue *value,
+                               GParamSpec   *pspec)
+{
+  RgProcessTable *self = RG_PROCESS_TABLE (object);
+
+  switch (prop_id)
+    {
+    case PROP_PID:
+      self->pid = g_value_get_int (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+rg_process_table_class_init (RgProcessTableClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = rg_process_table_constructed;
+  object_class->finalize = rg_process_table_finalize;
+  object_class->get_property = rg_process_table_get_property;
+  object_class->set_property = rg_process_table_set_property;
+
+  properties [PROP_PEAK_CPU] =
+    g_param_spec_double ("peak-cpu",
+                         "Peak CPU",
+                         "The highest CPU usage of the process tree, in percent of one CPU",
+                         0.0, G_MAXDOUBLE,
+                         0.0,
+                         (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_PEAK_RSS] =
+    g_param_spec_double ("peak-rss",
+                         "Peak RSS",
+                         "The highest resident memory of the process tree, in bytes",
+                         0.0, G_MAXDOUBLE,
+                         0.0,
+                         (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_PID] =
+    g_param_spec_int ("pid",
+                      "Pid",
+                      "The process id of the root of the process tree",
+                      0, G_MAXINT,
+                      0,
+                      (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_RUNNING] =
+    g_param_spec_boolean ("running",
+                          "Running",
+                          "If the root process is still being sampled",
+                          FALSE,
+                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+rg_process_table_init (RgProcessTable *self)
+{
+  self->last = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  g_object_set (self,
+                "value-min", 0.0,
+                "value-max", 100.0 * g_get_num_processors (),
+                NULL);
+}
+
+/**
+ * rg_process_table_new:
+ * @pid: the process id of the root of the process tree
+ *
+ * Creates a new table that samples @pid and all of its descendants until
+ * @pid exits. Samples stay in the table afterwards so that peaks can be
+ * reviewed.
+ *
+ * Returns: (transfer full): An #RgTable.
+ */
+RgTable *
+rg_process_table_new (GPid pid)
+{
+  return g_object_new (RG_TYPE_PROCESS_TABLE,
+                       "pid", pid,
+                       NULL);
+}
+
+GPid
+rg_process_table_get_pid (RgProcessTable *self)
+{
+  g_return_val_if_fail (RG_IS_PROCESS_TABLE (self), 0);
+
+  return self->pid;
+}
+
+gboolean
+rg_process_table_get_running (RgProcessTable *self)
+{
+  g_return_val_if_fail (RG_IS_PROCESS_TABLE (self), FALSE);
+
+  return self->running;
+}
+
+gdouble
+rg_process_table_get_peak_cpu (RgProcessTable *self)
+{
+  g_return_val_if_fail (RG_IS_PROCESS_TABLE (self), 0.0);
+
+  return self->peak_cpu;
+}
+
+gdouble
+rg_process_table_get_peak_rss (RgProcessTable *self)
+{
+  g_return_val_if_fail (RG_IS_PROCESS_TABLE (self), 0.0);
+
+  return self->peak_rss;
+}
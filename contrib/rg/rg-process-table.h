@@ -0,0 +1,46 @@
+/* rg-process-table.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RG_PROCESS_TABLE_H
+#define RG_PROCESS_TABLE_H
+
+#include "rg-table.h"
+
+G_BEGIN_DECLS
+
+#define RG_TYPE_PROCESS_TABLE (rg_process_table_get_type())
+
+G_DECLARE_FINAL_TYPE (RgProcessTable, rg_process_table, RG, PROCESS_TABLE, RgTable)
+
+typedef enum
+{
+  RG_PROCESS_TABLE_COLUMN_CPU,
+  RG_PROCESS_TABLE_COLUMN_RSS,
+  RG_PROCESS_TABLE_COLUMN_READ,
+  RG_PROCESS_TABLE_COLUMN_WRITE,
+} RgProcessTableColumn;
+
+RgTable  *rg_process_table_new          (GPid            pid);
+GPid      rg_process_table_get_pid      (RgProcessTable *self);
+gboolean  rg_process_table_get_running  (RgProcessTable *self);
+gdouble   rg_process_table_get_peak_cpu (RgProcessTable *self);
+gdouble   rg_process_table_get_peak_rss (RgProcessTable *self);
+
+G_END_DECLS
+
+#endif /* RG_PROCESS_TABLE_H */
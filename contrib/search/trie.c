@@ -43,6 +43,11 @@
  * To insert a key and value pair into the #Trie use trie_insert().
  * To remove a key from the #Trie use trie_remove().
  * To traverse all children of the #Trie from a given key use trie_traverse().
+ *
+ * Nodes are allocated from an arena owned by the #Trie. Once a #Trie has
+ * been filled, trie_freeze() compacts it into a single contiguous array that
+ * is faster to walk. Inserting into or removing from a frozen #Trie thaws
+ * it back first, so freezing is only an optimization.
  */
 
 typedef struct _TrieNode      TrieNode;
@@ -66,6 +71,14 @@ typedef struct _TrieNodeChunk TrieNodeChunk;
 #define TRIE_NODE_CHUNK_KEYS(c) (((c)->is_inline) ? 3 : 5)
 #endif
 
+/*
+ * Nodes and chunks have the same size, so the arena hands out slots of
+ * TRIE_NODE_SIZE bytes aligned on TRIE_NODE_SIZE. Blocks start small,
+ * many tries only contain a handful of keys, and double up to the max.
+ */
+#define TRIE_ARENA_MIN_SLOTS    16
+#define TRIE_ARENA_MAX_SLOTS  1024
+
 /**
  * TrieNodeChunk:
  * @flags: Flags describing behaviors of the TrieNodeChunk.
@@ -104,24 +117,134 @@ struct _TrieNode
 };
 #pragma pack(pop)
 
+/**
+ * TrieArenaBlock:
+ * @next: The previously allocated block.
+ *
+ * Header of a block of memory the nodes and chunks are allocated from.
+ * The slots follow the header, aligned on TRIE_NODE_SIZE.
+ */
+typedef struct _TrieArenaBlock TrieArenaBlock;
+
+struct _TrieArenaBlock
+{
+   TrieArenaBlock *next;
+};
+
+/**
+ * TrieFrozenNode:
+ * @value: A pointer to the user provided value, or %NULL.
+ * @children: The index of the first child of the node.
+ * @n_children: The number of children of the node.
+ * @key: The key leading from the parent to this node.
+ *
+ * A node of a frozen #Trie. Nodes are numbered breadth-first, so the
+ * children of a node are contiguous and sorted by key. Finding a child
+ * scans the siblings, which also loads the matching child, so a lookup
+ * usually costs a single cache line per level.
+ *
+ * Only indexes are used, so that the layout doesn't depend on where it is
+ * loaded in memory.
+ */
+typedef struct
+{
+   gpointer value;
+   guint32  children;
+   guint16  n_children;
+   guint8   key;
+} TrieFrozenNode;
+
 /**
  * Trie:
  * @value_destroy: A #GDestroyNotify to free data pointers.
- * @root: The root TrieNode.
+ * @root: The root TrieNode, or %NULL if the trie is frozen.
+ * @blocks: The arena blocks, most recent first.
+ * @arena_pos: The next free slot in the current block.
+ * @arena_end: The end of the current block.
+ * @arena_slots: The number of slots of the next block.
+ * @free_slots: A list of released slots, linked through their first word.
+ * @frozen: The frozen nodes, or %NULL if the trie isn't frozen.
+ * @n_frozen: The number of frozen nodes.
  */
 struct _Trie
 {
    GDestroyNotify  value_destroy;
    TrieNode       *root;
+
+   TrieArenaBlock *blocks;
+   guint8         *arena_pos;
+   guint8         *arena_end;
+   guint           arena_slots;
+   gpointer        free_slots;
+
+   TrieFrozenNode *frozen;
+   guint32         n_frozen;
 };
 
+/**
+ * trie_arena_grow:
+ * @trie: A #Trie
+ *
+ * Allocates a new block for the arena of @trie and makes it current.
+ * Remaining slots of the previous block, if any, are lost.
+ */
+static void
+trie_arena_grow (Trie *trie)
+{
+   TrieArenaBlock *block;
+   guintptr pos;
+
+   g_assert(trie);
+
+   if (!trie->arena_slots) {
+      trie->arena_slots = TRIE_ARENA_MIN_SLOTS;
+   }
+
+   block = g_malloc(sizeof *block + (trie->arena_slots + 1) * TRIE_NODE_SIZE);
+   block->next = trie->blocks;
+   trie->blocks = block;
+
+   pos = (guintptr)(block + 1);
+   pos = (pos + TRIE_NODE_SIZE - 1) & ~(guintptr)(TRIE_NODE_SIZE - 1);
+
+   trie->arena_pos = (guint8 *)pos;
+   trie->arena_end = trie->arena_pos + trie->arena_slots * TRIE_NODE_SIZE;
+
+   trie->arena_slots = MIN(trie->arena_slots * 2, TRIE_ARENA_MAX_SLOTS);
+}
+
+/**
+ * trie_arena_clear:
+ * @trie: A #Trie
+ *
+ * Releases all the memory of the arena at once. Every node and chunk
+ * allocated from it becomes invalid.
+ */
+static void
+trie_arena_clear (Trie *trie)
+{
+   TrieArenaBlock *block;
+
+   g_assert(trie);
+
+   while ((block = trie->blocks)) {
+      trie->blocks = block->next;
+      g_free(block);
+   }
+
+   trie->arena_pos = NULL;
+   trie->arena_end = NULL;
+   trie->arena_slots = 0;
+   trie->free_slots = NULL;
+}
+
 /**
  * trie_malloc0:
  * @trie: A #Trie
  * @size: Number of bytes to allocate.
  *
- * Wrapper function to allocate a memory chunk. This gives us somewhere to
- * perform the abstraction if we want to use mmap()'d I/O at some point.
+ * Allocates a memory chunk from the arena of @trie, reusing slots released
+ * by trie_free() first. @size must not be bigger than TRIE_NODE_SIZE.
  * The memory will be zero'd before being returned.
  *
  * Returns: A pointer to the allocation.
@@ -130,7 +253,23 @@ static gpointer
 trie_malloc0 (Trie  *trie,
               gsize  size)
 {
-   return g_malloc0(size);
+   gpointer ret;
+
+   g_assert(trie);
+   g_assert(size <= TRIE_NODE_SIZE);
+
+   if (trie->free_slots) {
+      ret = trie->free_slots;
+      trie->free_slots = *(gpointer *)ret;
+   } else {
+      if (trie->arena_pos == trie->arena_end) {
+         trie_arena_grow(trie);
+      }
+      ret = trie->arena_pos;
+      trie->arena_pos += TRIE_NODE_SIZE;
+   }
+
+   return memset(ret, 0, TRIE_NODE_SIZE);
 }
 
 /**
@@ -138,13 +277,14 @@ trie_malloc0 (Trie  *trie,
  * @trie: A #Trie.
  * @data: The data to free.
  *
- * Frees a portion of memory allocated by @trie.
+ * Gives a portion of memory allocated by @trie back to its arena.
  */
 static void
 trie_free (Trie     *trie,
            gpointer  data)
 {
-   g_free(data);
+   *(gpointer *)data = trie->free_slots;
+   trie->free_slots = data;
 }
 
 /**
@@ -156,7 +296,7 @@ trie_free (Trie     *trie,
  * embedded in it that may contain only 4 pointers instead of the full 6 do
  * to the overhead of the TrieNode itself.
  *
- * Returns: A newly allocated TrieNode that should be freed with g_free().
+ * Returns: A newly allocated TrieNode that should be freed with trie_free().
  */
 TrieNode *
 trie_node_new (Trie     *trie,
@@ -471,6 +611,262 @@ trie_destroy_node (Trie           *trie,
    trie_free(trie, node);
 }
 
+/**
+ * trie_node_destroy_values:
+ * @node: A #TrieNode.
+ * @value_destroy: A #GDestroyNotify.
+ *
+ * Calls @value_destroy for the value of @node and all of its children,
+ * without releasing any node. This is used when the whole arena is about
+ * to be released at once.
+ */
+static void
+trie_node_destroy_values (TrieNode       *node,
+                          GDestroyNotify  value_destroy)
+{
+   TrieNodeChunk *iter;
+   guint i;
+
+   g_assert(node);
+   g_assert(value_destroy);
+
+   for (iter = &node->chunk; iter; iter = iter->next) {
+      for (i = 0; i < iter->count; i++) {
+         trie_node_destroy_values(iter->children[i], value_destroy);
+      }
+   }
+
+   if (node->value) {
+      value_destroy(node->value);
+   }
+}
+
+/**
+ * trie_node_count:
+ * @node: A #TrieNode.
+ *
+ * Counts @node and all of its children.
+ *
+ * Returns: The number of nodes in the subtree.
+ */
+static guint
+trie_node_count (TrieNode *node)
+{
+   TrieNodeChunk *iter;
+   guint count = 1;
+   guint i;
+
+   g_assert(node);
+
+   for (iter = &node->chunk; iter; iter = iter->next) {
+      for (i = 0; i < iter->count; i++) {
+         count += trie_node_count(iter->children[i]);
+      }
+   }
+
+   return count;
+}
+
+/**
+ * trie_freeze_children:
+ * @trie: A #Trie being frozen.
+ * @nodes: The regular node matching each frozen node.
+ * @index: The index of a frozen node.
+ * @n_nodes: A location for the number of frozen nodes so far.
+ *
+ * Appends the children of the frozen node at @index to the frozen arrays,
+ * sorted by key.
+ */
+static void
+trie_freeze_children (Trie      *trie,
+                      TrieNode **nodes,
+                      guint32    index,
+                      guint32   *n_nodes)
+{
+   TrieFrozenNode *frozen;
+   TrieNodeChunk *iter;
+   TrieNode *child;
+   guint32 first;
+   guint32 i;
+   guint32 j;
+   guint8 key;
+
+   g_assert(trie);
+   g_assert(nodes);
+   g_assert(n_nodes);
+
+   frozen = &trie->frozen[index];
+   first = *n_nodes;
+
+   for (iter = &nodes[index]->chunk; iter; iter = iter->next) {
+      for (i = 0; i < iter->count; i++) {
+         key = iter->keys[i];
+         child = iter->children[i];
+
+         /*
+          * Nodes rarely have more than a few children, an insertion sort
+          * is all we need.
+          */
+         for (j = *n_nodes; j > first && trie->frozen[j - 1].key > key; j--) {
+            trie->frozen[j].key = trie->frozen[j - 1].key;
+            nodes[j] = nodes[j - 1];
+         }
+
+         trie->frozen[j].key = key;
+         nodes[j] = child;
+         (*n_nodes)++;
+      }
+   }
+
+   frozen->value = nodes[index]->value;
+   frozen->children = first;
+   frozen->n_children = *n_nodes - first;
+}
+
+/**
+ * trie_frozen_find_node:
+ * @trie: A frozen #Trie.
+ * @node: A #TrieFrozenNode.
+ * @key: The key of the child.
+ *
+ * Finds the child of @node for @key.
+ *
+ * Returns: (transfer none): A #TrieFrozenNode or %NULL.
+ */
+static inline const TrieFrozenNode *
+trie_frozen_find_node (Trie                 *trie,
+                       const TrieFrozenNode *node,
+                       guint8                key)
+{
+   const TrieFrozenNode *children;
+   guint32 i;
+
+   children = &trie->frozen[node->children];
+
+   for (i = 0; i < node->n_children; i++) {
+      if (children[i].key == key) {
+         return &children[i];
+      }
+   }
+
+   return NULL;
+}
+
+/**
+ * trie_thaw_node:
+ * @trie: A frozen #Trie.
+ * @parent: The parent of the new node, or %NULL.
+ * @index: The index of the frozen node.
+ *
+ * Recreates the frozen node at @index and all of its children as regular
+ * nodes allocated from the arena of @trie.
+ *
+ * Returns: (transfer full): A #TrieNode.
+ */
+static TrieNode *
+trie_thaw_node (Trie     *trie,
+                TrieNode *parent,
+                guint32   index)
+{
+   const TrieFrozenNode *frozen;
+   TrieNodeChunk *last;
+   TrieNode *node;
+   TrieNode *child;
+   guint32 i;
+
+   g_assert(trie);
+   g_assert(trie->frozen);
+
+   frozen = &trie->frozen[index];
+
+   node = trie_node_new(trie, parent);
+   node->value = frozen->value;
+   last = &node->chunk;
+
+   for (i = frozen->children; i < frozen->children + frozen->n_children; i++) {
+      child = trie_thaw_node(trie, node, i);
+      trie_append_to_node(trie, node, last, trie->frozen[i].key, child);
+      if (last->next) {
+         last = last->next;
+      }
+   }
+
+   return node;
+}
+
+/**
+ * trie_thaw:
+ * @trie: A #Trie.
+ *
+ * Converts a frozen #Trie back to regular nodes so that it can be
+ * modified. This does nothing if @trie is not frozen.
+ */
+static void
+trie_thaw (Trie *trie)
+{
+   g_assert(trie);
+
+   if (trie->frozen) {
+      trie->root = trie_thaw_node(trie, NULL, 0);
+      g_free(trie->frozen);
+      trie->frozen = NULL;
+      trie->n_frozen = 0;
+   }
+}
+
+/**
+ * trie_freeze:
+ * @trie: A #Trie.
+ *
+ * Compacts @trie into a read-only layout. All of the nodes are moved to a
+ * single allocation, their children sorted by key, and the memory used by
+ * the regular nodes is released.
+ *
+ * Lookups and traversals on a frozen #Trie touch far less memory and do
+ * not reorder nodes, so they are safe to run from multiple threads.
+ * Inserting or removing a key thaws @trie back to regular nodes, so this
+ * is best called once @trie has been filled.
+ */
+void
+trie_freeze (Trie *trie)
+{
+   TrieNode **nodes;
+   guint32 n_nodes;
+   guint32 count;
+   guint32 i;
+
+   g_return_if_fail(trie);
+
+   if (trie->frozen) {
+      return;
+   }
+
+   count = trie_node_count(trie->root);
+
+   trie->frozen = g_new(TrieFrozenNode, count);
+   trie->frozen[0].key = '\0';
+   trie->n_frozen = count;
+
+   /*
+    * The frozen array is filled breadth-first, the nodes not visited yet
+    * acting as the queue.
+    */
+   nodes = g_new(TrieNode *, count);
+   nodes[0] = trie->root;
+   n_nodes = 1;
+
+   for (i = 0; i < n_nodes; i++) {
+      trie_freeze_children(trie, nodes, i, &n_nodes);
+   }
+
+   g_assert(n_nodes == count);
+
+   g_free(nodes);
+
+   trie_arena_clear(trie);
+   trie->root = NULL;
+}
+
 /**
  * trie_new:
  * @value_destroy: A #GDestroyNotify, or %NULL.
@@ -520,6 +916,8 @@ trie_insert (Trie        *trie,
    g_return_if_fail(key);
    g_return_if_fail(value);
 
+   trie_thaw(trie);
+
    node = trie->root;
 
    while (*key) {
@@ -555,6 +953,17 @@ trie_lookup (Trie        *trie,
    g_return_val_if_fail(trie, NULL);
    g_return_val_if_fail(key, NULL);
 
+   if (trie->frozen) {
+      const TrieFrozenNode *frozen = trie->frozen;
+
+      while (*key && frozen) {
+         frozen = trie_frozen_find_node(trie, frozen, *key);
+         key++;
+      }
+
+      return frozen ? frozen->value : NULL;
+   }
+
    node = trie->root;
 
    while (*key && node) {
@@ -584,6 +993,13 @@ trie_remove (Trie        *trie,
    g_return_val_if_fail(trie, FALSE);
    g_return_val_if_fail(key, FALSE);
 
+   if (trie->frozen) {
+      if (!trie_lookup(trie, key)) {
+         return FALSE;
+      }
+      trie_thaw(trie);
+   }
+
    node = trie->root;
 
    while (*key && node) {
@@ -736,6 +1152,76 @@ trie_traverse_node_post_order (Trie             *trie,
    return ret;
 }
 
+/**
+ * trie_frozen_traverse_node:
+ * @trie: A frozen #Trie.
+ * @index: The index of a #TrieFrozenNode.
+ * @str: The prefix for this node.
+ * @order: The order to traverse, %G_PRE_ORDER or %G_POST_ORDER.
+ * @flags: The flags for which nodes to callback.
+ * @max_depth: the maximum depth to process.
+ * @func: The func to execute for each matching node.
+ * @user_data: User data for @func.
+ *
+ * Traverses the frozen node at @index and all of its children according
+ * to the parameters provided. @func is called for each matching node.
+ *
+ * Returns: %TRUE if traversal was cancelled; otherwise %FALSE.
+ */
+static gboolean
+trie_frozen_traverse_node (Trie             *trie,
+                           guint32           index,
+                           GString          *str,
+                           GTraverseType     order,
+                           GTraverseFlags    flags,
+                           gint              max_depth,
+                           TrieTraverseFunc  func,
+                           gpointer          user_data)
+{
+   const TrieFrozenNode *node;
+   gboolean matches;
+   guint32 i;
+
+   g_assert(trie);
+   g_assert(trie->frozen);
+   g_assert(str);
+
+   if (!max_depth) {
+      return FALSE;
+   }
+
+   node = &trie->frozen[index];
+   matches = ((!node->value && (flags & G_TRAVERSE_NON_LEAVES)) ||
+              (node->value && (flags & G_TRAVERSE_LEAVES)));
+
+   if (matches && (order == G_PRE_ORDER)) {
+      if (func(trie, str->str, node->value, user_data)) {
+         return TRUE;
+      }
+   }
+
+   for (i = node->children; i < node->children + node->n_children; i++) {
+      g_string_append_c(str, trie->frozen[i].key);
+      if (trie_frozen_traverse_node(trie,
+                                    i,
+                                    str,
+                                    order,
+                                    flags,
+                                    max_depth - 1,
+                                    func,
+                                    user_data)) {
+         return TRUE;
+      }
+      g_string_truncate(str, str->len - 1);
+   }
+
+   if (matches && (order == G_POST_ORDER)) {
+      return func(trie, str->str, node->value, user_data);
+   }
+
+   return FALSE;
+}
+
 /**
  * trie_traverse:
  * @trie: A #Trie.
@@ -753,6 +1239,11 @@ trie_traverse_node_post_order (Trie             *trie,
  *
  * If @max_depth is less than zero, the entire tree will be traversed.
  * If max_depth is 1, then only the root will be traversed.
+ *
+ * Children of a frozen #Trie are visited sorted by key, otherwise the
+ * order of siblings is unspecified.
+ *
+ * @trie must not be modified from @func.
  */
 void
 trie_traverse (Trie             *trie,
@@ -774,6 +1265,27 @@ trie_traverse (Trie             *trie,
 
    str = g_string_new(key);
 
+   if (trie->frozen) {
+      const TrieFrozenNode *frozen = trie->frozen;
+
+      while (*key && frozen) {
+         frozen = trie_frozen_find_node(trie, frozen, *key);
+         key++;
+      }
+
+      if (!frozen) {
+         /* Nothing to do */
+      } else if ((order == G_PRE_ORDER) || (order == G_POST_ORDER)) {
+         trie_frozen_traverse_node(trie, frozen - trie->frozen, str, order,
+                                   flags, max_depth, func, user_data);
+      } else {
+         g_warning(_("Traversal order %u is not supported on Trie."), order);
+      }
+
+      g_string_free(str, TRUE);
+      return;
+   }
+
    while (*key && node) {
       node = trie_find_node(trie, node, *key);
       key++;
@@ -803,9 +1315,28 @@ trie_traverse (Trie             *trie,
 void
 trie_destroy (Trie *trie)
 {
+   guint32 i;
+
    if (trie) {
-      trie_destroy_node(trie, trie->root, trie->value_destroy);
+      /*
+       * Nodes live in the arena, or in the frozen arrays, so only the
+       * values need to be released one by one.
+       */
+      if (trie->value_destroy) {
+         if (trie->frozen) {
+            for (i = 0; i < trie->n_frozen; i++) {
+               if (trie->frozen[i].value) {
+                  trie->value_destroy(trie->frozen[i].value);
+               }
+            }
+         } else {
+            trie_node_destroy_values(trie->root, trie->value_destroy);
+         }
+      }
+      trie_arena_clear(trie);
+      g_free(trie->frozen);
       trie->root = NULL;
+      trie->frozen = NULL;
       trie->value_destroy = NULL;
       g_free(trie);
    }
@@ -31,6 +31,7 @@ typedef gboolean (*TrieTraverseFunc) (Trie        *trie,
                                       gpointer     user_data);
 
 void      trie_destroy  (Trie             *trie);
+void      trie_freeze   (Trie             *trie);
 void      trie_insert   (Trie             *trie,
                          const gchar      *key,
                          gpointer          value);
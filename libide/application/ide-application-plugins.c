@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "ide-application"
 
+#include <egg-counter.h>
 #include <libpeas/peas.h>
 #include <girepository.h>
 
@@ -26,8 +27,18 @@
 #include "application/ide-application.h"
 #include "application/ide-application-addin.h"
 #include "application/ide-application-private.h"
+#include "plugins/ide-extension-util.h"
 #include "theming/ide-css-provider.h"
 
+/*
+ * Startup phase timings, in microseconds. These can be inspected with the
+ * counters tooling while Builder is running.
+ */
+EGG_DEFINE_COUNTER (DiscoverUsec, "Startup", "Plugin Discovery", "Microseconds spent discovering plugins.")
+EGG_DEFINE_COUNTER (LoadUsec, "Startup", "Plugin Loading", "Microseconds spent loading plugins.")
+EGG_DEFINE_COUNTER (AddinsUsec, "Startup", "Application Addins", "Microseconds spent loading application addins.")
+EGG_DEFINE_COUNTER (Deferred, "Startup", "Deferred Plugins", "Number of plugins deferred until first use.")
+
 static gboolean
 ide_application_can_load_plugin (IdeApplication *self,
                                  PeasPluginInfo *plugin_info)
@@ -75,15 +86,45 @@ ide_application_can_load_plugin (IdeApplication *self,
   return TRUE;
 }
 
+static gboolean
+ide_application_can_defer_plugin (IdeApplication *self,
+                                  PeasPluginInfo *plugin_info)
+{
+  const gchar *load_on_demand;
+
+  g_assert (IDE_IS_APPLICATION (self));
+  g_assert (plugin_info != NULL);
+
+  /*
+   * Workers and tools run a single plugin, and the tests expect plugins to
+   * be available, so we only defer loading within the primary instance.
+   */
+  if (self->mode != IDE_APPLICATION_MODE_PRIMARY)
+    return FALSE;
+
+  /*
+   * Plugins that are expensive to load, such as Python plugins importing
+   * large modules, can set X-Load-On-Demand=true. They are loaded when an
+   * extension adapter first matches them, so they must only provide
+   * extensions matched by a key such as X-Completion-Provider-Languages.
+   */
+  load_on_demand = peas_plugin_info_get_external_data (plugin_info, "Load-On-Demand");
+
+  return ide_str_equal0 (load_on_demand, "true");
+}
+
 void
 ide_application_discover_plugins (IdeApplication *self)
 {
   PeasEngine *engine = peas_engine_get_default ();
   const GList *list;
   gchar *path;
+  gint64 begin;
 
   g_return_if_fail (IDE_IS_APPLICATION (self));
 
+  begin = g_get_monotonic_time ();
+
   peas_engine_enable_loader (engine, "python3");
 
   if (g_getenv ("GB_IN_TREE_PLUGINS") != NULL)
@@ -136,6 +177,11 @@ ide_application_discover_plugins (IdeApplication *self)
       g_debug ("Discovered plugin \"%s\"",
                peas_plugin_info_get_module_name (plugin_info));
     }
+
+  EGG_COUNTER_ADD (DiscoverUsec, g_get_monotonic_time () - begin);
+
+  g_debug ("Discovered plugins in %.3lf msec",
+           (g_get_monotonic_time () - begin) / 1000.0);
 }
 
 static void
@@ -161,9 +207,19 @@ ide_application_plugins_enabled_changed (IdeApplication *self,
   if (enabled &&
       ide_application_can_load_plugin (self, plugin_info) &&
       !peas_plugin_info_is_loaded (plugin_info))
-    peas_engine_load_plugin (engine, plugin_info);
-  else if (!enabled && peas_plugin_info_is_loaded (plugin_info))
-    peas_engine_unload_plugin (engine, plugin_info);
+    {
+      if (ide_application_can_defer_plugin (self, plugin_info))
+        ide_extension_util_set_load_on_demand (plugin_info, TRUE);
+      else
+        peas_engine_load_plugin (engine, plugin_info);
+    }
+  else if (!enabled)
+    {
+      ide_extension_util_set_load_on_demand (plugin_info, FALSE);
+
+      if (peas_plugin_info_is_loaded (plugin_info))
+        peas_engine_unload_plugin (engine, plugin_info);
+    }
 }
 
 static GSettings *
@@ -195,9 +251,12 @@ ide_application_load_plugins (IdeApplication *self)
 {
   PeasEngine *engine;
   const GList *list;
+  gint64 begin;
 
   g_return_if_fail (IDE_IS_APPLICATION (self));
 
+  begin = g_get_monotonic_time ();
+
   engine = peas_engine_get_default ();
   list = peas_engine_get_plugin_list (engine);
 
@@ -221,13 +280,32 @@ ide_application_load_plugins (IdeApplication *self)
       if (!g_settings_get_boolean (settings, "enabled"))
         continue;
 
-      if (ide_application_can_load_plugin (self, plugin_info))
+      if (!ide_application_can_load_plugin (self, plugin_info))
+        continue;
+
+      /*
+       * Plugins providing an IdeWorker set X-Has-Worker=true so that their
+       * first worker process can be started while the application is idle.
+       */
+      if (ide_str_equal0 (peas_plugin_info_get_external_data (plugin_info, "Has-Worker"), "true"))
+        ide_application_warm_worker (self, module_name);
+
+      if (ide_application_can_defer_plugin (self, plugin_info))
         {
-          g_debug ("Loading plugin \"%s\"",
-                   peas_plugin_info_get_module_name (plugin_info));
-          peas_engine_load_plugin (engine, plugin_info);
+          g_debug ("Deferring plugin \"%s\" until first use", module_name);
+          ide_extension_util_set_load_on_demand (plugin_info, TRUE);
+          EGG_COUNTER_INC (Deferred);
+          continue;
         }
+
+      g_debug ("Loading plugin \"%s\"", module_name);
+      peas_engine_load_plugin (engine, plugin_info);
     }
+
+  EGG_COUNTER_ADD (LoadUsec, g_get_monotonic_time () - begin);
+
+  g_debug ("Loaded plugins in %.3lf msec",
+           (g_get_monotonic_time () - begin) / 1000.0);
 }
 
 static void
@@ -263,8 +341,12 @@ ide_application_addin_removed (PeasExtensionSet *set,
 void
 ide_application_load_addins (IdeApplication *self)
 {
+  gint64 begin;
+
   g_return_if_fail (IDE_IS_APPLICATION (self));
 
+  begin = g_get_monotonic_time ();
+
   self->addins = peas_extension_set_new (peas_engine_get_default (),
                                          IDE_TYPE_APPLICATION_ADDIN,
                                          NULL);
@@ -284,6 +366,11 @@ ide_application_load_addins (IdeApplication *self)
   peas_extension_set_foreach (self->addins,
                               ide_application_addin_added,
                               self);
+
+  EGG_COUNTER_ADD (AddinsUsec, g_get_monotonic_time () - begin);
+
+  g_debug ("Loaded application addins in %.3lf msec",
+           (g_get_monotonic_time () - begin) / 1000.0);
 }
 
 static void
@@ -42,8 +42,10 @@
 #include "application/ide-application-tool.h"
 #include "modelines/modeline-parser.h"
 #include "resources/ide-resources.h"
+#include "subprocess/ide-host-spawner.h"
 #include "theming/ide-css-provider.h"
 #include "theming/ide-theme-manager.h"
+#include "util/ide-flatpak.h"
 #include "workbench/ide-workbench.h"
 #include "workers/ide-worker.h"
 
@@ -390,6 +392,10 @@ ide_application_startup (GApplication *application)
       modeline_parser_init ();
     }
 
+  /* Connect to the host early, opening a project spawns many processes there */
+  if (self->mode == IDE_APPLICATION_MODE_PRIMARY && ide_is_flatpak ())
+    ide_host_spawner_prewarm (ide_host_spawner_get_default ());
+
   _ide_battery_monitor_init ();
 
   G_APPLICATION_CLASS (ide_application_parent_class)->startup (application);
@@ -625,6 +631,155 @@ ide_application_get_worker_finish (IdeApplication  *self,
   return g_task_propagate_pointer (task, error);
 }
 
+static void
+ide_application_call_worker_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  IdeWorkerManager *worker_manager = (IdeWorkerManager *)object;
+  g_autoptr(GTask) task = user_data;
+  GUnixFDList *out_fd_list = NULL;
+  GError *error = NULL;
+  GVariant *ret;
+
+  g_assert (IDE_IS_WORKER_MANAGER (worker_manager));
+
+  ret = ide_worker_manager_call_finish (worker_manager, result, &out_fd_list, &error);
+
+  if (ret == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (out_fd_list != NULL)
+    g_task_set_task_data (task, out_fd_list, g_object_unref);
+
+  g_task_return_pointer (task, ret, (GDestroyNotify)g_variant_unref);
+}
+
+/**
+ * ide_application_call_worker_async:
+ * @self: A #IdeApplication
+ * @plugin_name: The name of the plugin.
+ * @method_name: The name of the D-Bus method to call.
+ * @parameters: (allow-none): A #GVariant tuple with parameters, or %NULL.
+ * @fd_list: (allow-none): A #GUnixFDList, or %NULL.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: A #GAsyncReadyCallback or %NULL.
+ * @user_data: user data for @callback.
+ *
+ * Calls @method_name on the proxy created by the #IdeWorker implemented by
+ * the plugin named @plugin_name.
+ *
+ * Unlike ide_application_get_worker_async(), the request is dispatched to
+ * the least busy worker process in a pool, allowing requests to run in
+ * parallel. Additional workers are spawned in the background as needed.
+ *
+ * Large payloads, such as the contents of a buffer, should be created with
+ * ide_worker_create_payload() and passed in @fd_list so that only the
+ * handle is sent over D-Bus.
+ *
+ * @callback should call ide_application_call_worker_finish() with the result
+ * provided to retrieve the result.
+ */
+void
+ide_application_call_worker_async (IdeApplication      *self,
+                                   const gchar         *plugin_name,
+                                   const gchar         *method_name,
+                                   GVariant            *parameters,
+                                   GUnixFDList         *fd_list,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_APPLICATION (self));
+  g_return_if_fail (plugin_name != NULL);
+  g_return_if_fail (method_name != NULL);
+  g_return_if_fail (!fd_list || G_IS_UNIX_FD_LIST (fd_list));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+
+  if (self->mode != IDE_APPLICATION_MODE_PRIMARY)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Workers are only available in the primary instance");
+      return;
+    }
+
+  if (self->worker_manager == NULL)
+    self->worker_manager = ide_worker_manager_new ();
+
+  ide_worker_manager_call_async (self->worker_manager,
+                                 plugin_name,
+                                 method_name,
+                                 parameters,
+                                 fd_list,
+                                 cancellable,
+                                 ide_application_call_worker_cb,
+                                 g_object_ref (task));
+}
+
+/*
+ * Spawns the first worker of @plugin_name at idle priority, so that the
+ * first request to it finds a process that has already started up.
+ */
+void
+ide_application_warm_worker (IdeApplication *self,
+                             const gchar    *plugin_name)
+{
+  g_assert (IDE_IS_APPLICATION (self));
+  g_assert (plugin_name != NULL);
+
+  if (self->mode != IDE_APPLICATION_MODE_PRIMARY)
+    return;
+
+  if (self->worker_manager == NULL)
+    self->worker_manager = ide_worker_manager_new ();
+
+  ide_worker_manager_warm (self->worker_manager, plugin_name);
+}
+
+/**
+ * ide_application_call_worker_finish:
+ * @self: An #IdeApplication.
+ * @result: A #GAsyncResult
+ * @out_fd_list: (out) (optional) (transfer full): A location for a #GUnixFDList, or %NULL.
+ * @error: a location for a #GError, or %NULL.
+ *
+ * Completes an asynchronous request to call a method on a worker process.
+ *
+ * Returns: (transfer full): A #GVariant tuple or %NULL.
+ */
+GVariant *
+ide_application_call_worker_finish (IdeApplication  *self,
+                                    GAsyncResult    *result,
+                                    GUnixFDList    **out_fd_list,
+                                    GError         **error)
+{
+  GTask *task = (GTask *)result;
+  GVariant *ret;
+
+  g_return_val_if_fail (IDE_IS_APPLICATION (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (task), NULL);
+
+  ret = g_task_propagate_pointer (task, error);
+
+  if (out_fd_list != NULL)
+    {
+      GUnixFDList *fd_list = g_task_get_task_data (task);
+
+      *out_fd_list = fd_list ? g_object_ref (fd_list) : NULL;
+    }
+
+  return ret;
+}
+
 /**
  * ide_application_get_recent_projects:
  * @self: An #IdeApplication.
@@ -19,6 +19,7 @@
 #ifndef IDE_APPLICATION_H
 #define IDE_APPLICATION_H
 
+#include <gio/gunixfdlist.h>
 #include <gtk/gtk.h>
 
 #include "projects/ide-recent-projects.h"
@@ -54,6 +55,18 @@ void                ide_application_get_worker_async     (IdeApplication       *
 GDBusProxy         *ide_application_get_worker_finish    (IdeApplication       *self,
                                                           GAsyncResult         *result,
                                                           GError              **error);
+void                ide_application_call_worker_async    (IdeApplication       *self,
+                                                          const gchar          *plugin_name,
+                                                          const gchar          *method_name,
+                                                          GVariant             *parameters,
+                                                          GUnixFDList          *fd_list,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
+GVariant           *ide_application_call_worker_finish   (IdeApplication       *self,
+                                                          GAsyncResult         *result,
+                                                          GUnixFDList         **out_fd_list,
+                                                          GError              **error);
 GMenu              *ide_application_get_menu_by_id       (IdeApplication       *self,
                                                           const gchar          *id);
 gboolean            ide_application_open_project         (IdeApplication       *self,
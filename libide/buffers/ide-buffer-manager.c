@@ -47,6 +47,9 @@
 
 #define AUTO_SAVE_TIMEOUT_DEFAULT    60
 #define MAX_FILE_SIZE_BYTES_DEFAULT  (1024UL * 1024UL * 10UL)
+#define MEMORY_BUDGET_DEFAULT        (1024UL * 1024UL * 256UL)
+#define RECLAIM_INTERVAL_SECS        60
+#define TRIM_IDLE_USEC               (G_USEC_PER_SEC * 60 * 5)
 
 struct _IdeBufferManager
 {
@@ -59,6 +62,9 @@ struct _IdeBufferManager
   GSettings                *settings;
 
   gsize                     max_file_size;
+  gsize                     memory_budget;
+
+  guint                     reclaim_source;
 
   guint                     auto_save_timeout;
   guint                     auto_save : 1;
@@ -103,6 +109,10 @@ G_DEFINE_TYPE_EXTENDED (IdeBufferManager, ide_buffer_manager, IDE_TYPE_OBJECT, 0
 
 EGG_DEFINE_COUNTER (registered, "IdeBufferManager", "Registered Buffers",
                     "The number of buffers registered with the buffer manager.")
+EGG_DEFINE_COUNTER (trimmed, "IdeBufferManager", "Trimmed Buffers",
+                    "The number of times derived state was dropped from an idle buffer.")
+EGG_DEFINE_COUNTER (compacted, "IdeBufferManager", "Compacted Buffers",
+                    "The number of times an idle buffer dropped its undo history to stay within the memory budget.")
 
 enum {
   PROP_0,
@@ -121,6 +131,7 @@ enum {
   LOAD_BUFFER,
   BUFFER_LOADED,
   BUFFER_UNLOADED,
+  BUFFER_TRIMMED,
 
   BUFFER_FOCUS_ENTER,
   BUFFER_FOCUS_LEAVE,
@@ -615,7 +626,8 @@ ide_buffer_manager_load_file__load_cb (GObject      *object,
 emit_signal:
   _ide_buffer_set_loading (state->buffer, FALSE);
 
-  if (!_ide_context_is_restoring (context))
+  if (!_ide_context_is_restoring (context) &&
+      !(state->flags & IDE_WORKBENCH_OPEN_FLAGS_BACKGROUND))
     ide_buffer_manager_set_focus_buffer (self, state->buffer);
 
   g_signal_emit (self, signals [BUFFER_LOADED], 0, state->buffer);
@@ -1268,6 +1280,12 @@ ide_buffer_manager_dispose (GObject *object)
 
   ide_clear_weak_pointer (&self->focus_buffer);
 
+  if (self->reclaim_source != 0)
+    {
+      g_source_remove (self->reclaim_source);
+      self->reclaim_source = 0;
+    }
+
   while (self->buffers->len)
     {
       IdeBuffer *buffer;
@@ -1537,6 +1555,116 @@ ide_buffer_manager_class_init (IdeBufferManagerClass *klass)
                                             G_SIGNAL_RUN_LAST,
                                             0, NULL, NULL, NULL,
                                             G_TYPE_NONE, 1, IDE_TYPE_BUFFER);
+
+  /**
+   * IdeBufferManager::buffer-trimmed:
+   * @self: An #IdeBufferManager
+   * @buffer: An #IdeBuffer
+   *
+   * This signal is emitted when a buffer has not been viewed for a while and
+   * the buffer manager has dropped state derived from its contents, such as
+   * highlighting and change-monitor caches.
+   *
+   * Services holding expensive per-file state, such as parsed translation
+   * units, may connect to this signal to release it as well. The state will
+   * be requested again the next time the buffer is viewed.
+   */
+  signals [BUFFER_TRIMMED] = g_signal_new ("buffer-trimmed",
+                                           G_TYPE_FROM_CLASS (klass),
+                                           G_SIGNAL_RUN_LAST,
+                                           0, NULL, NULL, NULL,
+                                           G_TYPE_NONE, 1, IDE_TYPE_BUFFER);
+}
+
+static gint
+compare_by_last_viewed (gconstpointer a,
+                        gconstpointer b)
+{
+  IdeBuffer *buffer_a = *(IdeBuffer **)a;
+  IdeBuffer *buffer_b = *(IdeBuffer **)b;
+  gint64 last_a = _ide_buffer_get_last_viewed (buffer_a);
+  gint64 last_b = _ide_buffer_get_last_viewed (buffer_b);
+
+  return (last_a < last_b) ? -1 : (last_a > last_b) ? 1 : 0;
+}
+
+/*
+ * Modified buffers keep their undo history, as it is the only way back to
+ * the contents of the file on disk.
+ */
+static gboolean
+ide_buffer_manager_can_compact (IdeBuffer *buffer)
+{
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  return !_ide_buffer_get_mapped (buffer) &&
+         !_ide_buffer_get_loading (buffer) &&
+         !gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (buffer)) &&
+         _ide_buffer_get_undo_size (buffer) > 0;
+}
+
+/*
+ * Periodically walks the buffers and drops derived state from those that
+ * have not been viewed recently. If we are still over the memory budget
+ * afterwards, the least recently viewed clean buffers also drop their undo
+ * history. The text of a buffer is never dropped, since language servers,
+ * the symbol tree, and completion all work from the open buffers.
+ */
+static gboolean
+ide_buffer_manager_reclaim_cb (gpointer data)
+{
+  IdeBufferManager *self = data;
+  g_autoptr(GPtrArray) candidates = NULL;
+  gint64 now = g_get_monotonic_time ();
+  gsize total = 0;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+
+  candidates = g_ptr_array_new ();
+
+  for (guint i = 0; i < self->buffers->len; i++)
+    {
+      IdeBuffer *buffer = g_ptr_array_index (self->buffers, i);
+
+      if (!_ide_buffer_get_mapped (buffer) &&
+          !_ide_buffer_get_loading (buffer) &&
+          !_ide_buffer_get_trimmed (buffer) &&
+          (now - _ide_buffer_get_last_viewed (buffer)) > TRIM_IDLE_USEC)
+        {
+          _ide_buffer_trim (buffer);
+          EGG_COUNTER_INC (trimmed);
+          g_signal_emit (self, signals [BUFFER_TRIMMED], 0, buffer);
+        }
+
+      total += ide_buffer_get_memory_usage (buffer);
+
+      if (ide_buffer_manager_can_compact (buffer))
+        g_ptr_array_add (candidates, buffer);
+    }
+
+  IDE_TRACE_MSG ("Buffers are using approximately %"G_GSIZE_FORMAT" bytes", total);
+
+  if (self->memory_budget == 0 || total <= self->memory_budget)
+    IDE_RETURN (G_SOURCE_CONTINUE);
+
+  g_ptr_array_sort (candidates, compare_by_last_viewed);
+
+  for (guint i = 0; i < candidates->len && total > self->memory_budget; i++)
+    {
+      IdeBuffer *buffer = g_ptr_array_index (candidates, i);
+      gsize before = ide_buffer_get_memory_usage (buffer);
+      gsize after;
+
+      _ide_buffer_compact (buffer);
+      EGG_COUNTER_INC (compacted);
+
+      after = ide_buffer_get_memory_usage (buffer);
+      total -= MIN (total, before - MIN (before, after));
+    }
+
+  IDE_RETURN (G_SOURCE_CONTINUE);
 }
 
 static void
@@ -1546,6 +1674,10 @@ ide_buffer_manager_init (IdeBufferManager *self)
   self->auto_save_timeout = AUTO_SAVE_TIMEOUT_DEFAULT;
   self->buffers = g_ptr_array_new ();
   self->max_file_size = MAX_FILE_SIZE_BYTES_DEFAULT;
+  self->memory_budget = MEMORY_BUDGET_DEFAULT;
+  self->reclaim_source = g_timeout_add_seconds (RECLAIM_INTERVAL_SECS,
+                                                ide_buffer_manager_reclaim_cb,
+                                                self);
   self->timeouts = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->word_completion = g_object_new (IDE_TYPE_COMPLETION_WORDS, NULL);
   self->settings = g_settings_new ("org.gnome.builder.editor");
@@ -1730,6 +1862,65 @@ ide_buffer_manager_set_max_file_size (IdeBufferManager *self,
     self->max_file_size = max_file_size;
 }
 
+/**
+ * ide_buffer_manager_get_memory_budget:
+ * @self: An #IdeBufferManager.
+ *
+ * Gets the approximate number of bytes that open buffers may use before
+ * the least recently viewed, unmodified buffers drop their undo history.
+ *
+ * If zero, undo history is never dropped, although other derived state is
+ * still dropped from buffers that have not been viewed in a while.
+ *
+ * Returns: A #gsize in bytes or zero.
+ */
+gsize
+ide_buffer_manager_get_memory_budget (IdeBufferManager *self)
+{
+  g_return_val_if_fail (IDE_IS_BUFFER_MANAGER (self), 0);
+
+  return self->memory_budget;
+}
+
+/**
+ * ide_buffer_manager_set_memory_budget:
+ * @self: An #IdeBufferManager.
+ * @memory_budget: The memory budget in bytes, or zero for no limit.
+ *
+ * Sets the approximate number of bytes that open buffers may use. See
+ * ide_buffer_manager_get_memory_budget() for details.
+ */
+void
+ide_buffer_manager_set_memory_budget (IdeBufferManager *self,
+                                      gsize             memory_budget)
+{
+  g_return_if_fail (IDE_IS_BUFFER_MANAGER (self));
+
+  self->memory_budget = memory_budget;
+}
+
+/**
+ * ide_buffer_manager_get_memory_usage:
+ * @self: An #IdeBufferManager.
+ *
+ * Gets the approximate memory usage of all buffers, as the sum of
+ * ide_buffer_get_memory_usage() for each buffer.
+ *
+ * Returns: A #gsize in bytes.
+ */
+gsize
+ide_buffer_manager_get_memory_usage (IdeBufferManager *self)
+{
+  gsize total = 0;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_MANAGER (self), 0);
+
+  for (guint i = 0; i < self->buffers->len; i++)
+    total += ide_buffer_get_memory_usage (g_ptr_array_index (self->buffers, i));
+
+  return total;
+}
+
 /**
  * ide_buffer_manager_create_temporary_buffer:
  *
@@ -76,6 +76,10 @@ IdeBuffer                *ide_buffer_manager_find_buffer         (IdeBufferManag
 gsize                     ide_buffer_manager_get_max_file_size   (IdeBufferManager     *self);
 void                      ide_buffer_manager_set_max_file_size   (IdeBufferManager     *self,
                                                                   gsize                 max_file_size);
+gsize                     ide_buffer_manager_get_memory_budget   (IdeBufferManager     *self);
+void                      ide_buffer_manager_set_memory_budget   (IdeBufferManager     *self,
+                                                                  gsize                 memory_budget);
+gsize                     ide_buffer_manager_get_memory_usage    (IdeBufferManager     *self);
 void                      ide_buffer_manager_apply_edits_async   (IdeBufferManager     *self,
                                                                   GPtrArray            *edits,
                                                                   GCancellable         *cancellable,
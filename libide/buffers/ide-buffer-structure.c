@@ -0,0 +1,1850 @@
+/* ide-buffer-structure.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-buffer-structure"
+
+#include <string.h>
+
+#include "ide-debug.h"
+#include "ide-internal.h"
+#include "ide-macros.h"
+
+#include "buffers/ide-buffer-structure.h"
+
+/*
+ * IdeBufferStructure is a lightweight index of the structural tokens in a
+ * buffer: brackets, comments, strings, and preprocessor conditionals. It is
+ * used by indenters and movements so they do not have to walk the buffer one
+ * GtkTextIter at a time asking GtkSourceView for context classes.
+ *
+ * Tokens are stored sorted by character offset, in chunks of at most
+ * CHUNK_TOKENS. A chunk knows the offset of its first token and the offsets
+ * of its tokens are relative to that, so an edit only rewrites the tokens of
+ * the chunk it lands in. Moving the chunks that follow is deferred: all
+ * chunks from step_chunk onwards are offset by step_delta, and moving
+ * step_chunk to the next edit only touches the chunks in between, which are
+ * few while typing.
+ *
+ * Edits also mark a dirty range. The dirty range is re-lexed lazily on the
+ * next query, starting from the beginning of the first dirty line and
+ * continuing until the lexer reaches a line start, past the dirty range,
+ * where the previous lexing was in the same state. From there on the
+ * existing tokens are reused, and only the chunks holding the replaced
+ * tokens are rebuilt.
+ *
+ * Matching brackets and conditionals are not stored, as they would need to
+ * be renumbered after every re-lex. Instead, each chunk counts the brackets
+ * of each kind left unmatched within it, and a segment tree over the chunks
+ * combines those counts for runs of chunks. A search for a match scans the
+ * tokens of the chunk it starts in, then descends the tree to the chunk
+ * holding the match in O(log n) and scans that one, so a query costs
+ * O(CHUNK_TOKENS + log n) however far away the match is.
+ *
+ * The tree is brought up to date on the next query. When edits only
+ * replaced chunks, the leaves in between the first and last touched chunk
+ * are updated along with their parents. When the number of chunks changed,
+ * the positions of all following chunks moved, so the tree is rebuilt in
+ * O(n). That happens when a chunk is split or merged, which already costs
+ * O(n) to move the pointers in the chunk array.
+ *
+ * The lexer understands C-like languages only. For other languages the
+ * buffer does not expose a structure and callers fall back to scanning.
+ */
+
+#define CHUNK_LINES  256
+#define CHUNK_TOKENS 128
+#define SPAN_TO_END  G_MAXUINT
+
+struct _IdeBufferStructure
+{
+  GObject        parent_instance;
+
+  /* Weak pointer, the buffer owns us */
+  GtkTextBuffer *buffer;
+
+  GPtrArray     *chunks;
+
+  /* Chunks at or after step_chunk are offset by step_delta */
+  guint          step_chunk;
+  gint           step_delta;
+
+  guint          dirty_begin;
+  guint          dirty_end;
+
+  /*
+   * Segment tree of chunk summaries. Node 1 is the root and the leaf of
+   * chunk i is node summary_size + i. Chunks from summary_begin up to the
+   * last summary_tail chunks are stale.
+   */
+  GArray        *summaries;
+  guint          summary_size;
+  guint          summary_len;
+  guint          summary_begin;
+  guint          summary_tail;
+
+  guint          enabled : 1;
+  guint          preprocessor : 1;
+  guint          dirty : 1;
+  guint          invalid : 1;
+};
+
+typedef enum
+{
+  TOKEN_OPEN,
+  TOKEN_CLOSE,
+  TOKEN_COMMENT,
+  TOKEN_LINE_COMMENT,
+  TOKEN_STRING,
+  TOKEN_DIRECTIVE,
+} TokenKind;
+
+typedef enum
+{
+  BRACKET_PAREN,
+  BRACKET_SQUARE,
+  BRACKET_CURLY,
+  N_BRACKETS
+} BracketKind;
+
+typedef enum
+{
+  DIRECTIVE_IF,
+  DIRECTIVE_ELSE,
+  DIRECTIVE_ENDIF,
+} DirectiveKind;
+
+typedef struct
+{
+  guint  begin;
+  guint  end;
+  guint8 kind;
+  guint8 sub;
+} Token;
+
+/* Searching with the summaries for directives rather than brackets */
+#define SUMMARY_DIRECTIVES N_BRACKETS
+
+typedef struct
+{
+  /* Brackets of each kind left unmatched within a run of tokens */
+  guint n_open[N_BRACKETS];
+  guint n_close[N_BRACKETS];
+
+  guint n_directives;
+} Summary;
+
+typedef struct
+{
+  /* Offset of the first token, see chunk_base() */
+  guint    base;
+
+  /* Tokens with offsets relative to base */
+  GArray  *tokens;
+
+  Summary  summary;
+} Chunk;
+
+typedef struct
+{
+  guint chunk;
+  guint index;
+} TokenPos;
+
+typedef enum
+{
+  LEX_NORMAL,
+  LEX_BLOCK_COMMENT,
+  LEX_LINE_COMMENT,
+  LEX_STRING,
+  LEX_DIRECTIVE,
+} LexState;
+
+typedef struct
+{
+  GArray   *tokens;
+  guint     offset;
+  guint     span_begin;
+  gunichar  prev;
+  gunichar  quote;
+  guint     keyword_len;
+  gchar     keyword[8];
+  guint     state : 3;
+  guint     escaped : 1;
+  guint     line_start : 1;
+  guint     preprocessor : 1;
+} Lexer;
+
+G_DEFINE_TYPE (IdeBufferStructure, ide_buffer_structure, G_TYPE_OBJECT)
+
+static const struct {
+  const gchar *id;
+  gboolean     preprocessor;
+} c_like_languages[] = {
+  { "c",       TRUE },
+  { "chdr",    TRUE },
+  { "cpp",     TRUE },
+  { "cpphdr",  TRUE },
+  { "objc",    TRUE },
+  { "cuda",    TRUE },
+  { "vala",    TRUE },
+  { "java",    FALSE },
+  { "c-sharp", TRUE },
+};
+
+static inline gint
+bracket_kind (gunichar  ch,
+              gboolean *is_open)
+{
+  switch (ch)
+    {
+    case '(': *is_open = TRUE; return BRACKET_PAREN;
+    case ')': *is_open = FALSE; return BRACKET_PAREN;
+    case '[': *is_open = TRUE; return BRACKET_SQUARE;
+    case ']': *is_open = FALSE; return BRACKET_SQUARE;
+    case '{': *is_open = TRUE; return BRACKET_CURLY;
+    case '}': *is_open = FALSE; return BRACKET_CURLY;
+    default:  return -1;
+    }
+}
+
+static void
+lexer_emit (Lexer *lexer,
+            guint  begin,
+            guint  end,
+            guint  kind,
+            guint  sub)
+{
+  Token token = { begin, end, kind, sub };
+
+  g_array_append_val (lexer->tokens, token);
+}
+
+static void
+lexer_emit_directive (Lexer *lexer)
+{
+  const gchar *kw = lexer->keyword;
+  gint sub = -1;
+
+  lexer->keyword[lexer->keyword_len] = '\0';
+
+  if (strcmp (kw, "if") == 0 || strcmp (kw, "ifdef") == 0 || strcmp (kw, "ifndef") == 0)
+    sub = DIRECTIVE_IF;
+  else if (strcmp (kw, "elif") == 0 || strcmp (kw, "else") == 0)
+    sub = DIRECTIVE_ELSE;
+  else if (strcmp (kw, "endif") == 0)
+    sub = DIRECTIVE_ENDIF;
+
+  if (sub != -1)
+    lexer_emit (lexer, lexer->span_begin, lexer->offset, TOKEN_DIRECTIVE, sub);
+}
+
+static void
+lexer_push (Lexer    *lexer,
+            gunichar  ch)
+{
+  gboolean is_open;
+  gint bracket;
+
+again:
+  switch (lexer->state)
+    {
+    case LEX_NORMAL:
+      if (ch == '#' && lexer->line_start && lexer->preprocessor)
+        {
+          lexer->state = LEX_DIRECTIVE;
+          lexer->span_begin = lexer->offset;
+          lexer->keyword_len = 0;
+        }
+      else if (ch == '*' && lexer->prev == '/')
+        {
+          lexer->state = LEX_BLOCK_COMMENT;
+          lexer->span_begin = lexer->offset - 1;
+          ch = 0;
+        }
+      else if (ch == '/' && lexer->prev == '/')
+        {
+          lexer->state = LEX_LINE_COMMENT;
+          lexer->span_begin = lexer->offset - 1;
+        }
+      else if (ch == '"' || ch == '\'')
+        {
+          lexer->state = LEX_STRING;
+          lexer->span_begin = lexer->offset;
+          lexer->quote = ch;
+          lexer->escaped = FALSE;
+        }
+      else if (-1 != (bracket = bracket_kind (ch, &is_open)))
+        {
+          lexer_emit (lexer, lexer->offset, lexer->offset + 1,
+                      is_open ? TOKEN_OPEN : TOKEN_CLOSE, bracket);
+        }
+      break;
+
+    case LEX_BLOCK_COMMENT:
+      if (ch == '/' && lexer->prev == '*')
+        {
+          lexer_emit (lexer, lexer->span_begin, lexer->offset + 1, TOKEN_COMMENT, 0);
+          lexer->state = LEX_NORMAL;
+          ch = 0;
+        }
+      break;
+
+    case LEX_LINE_COMMENT:
+      if (ch == '\n')
+        {
+          lexer_emit (lexer, lexer->span_begin, lexer->offset, TOKEN_LINE_COMMENT, 0);
+          lexer->state = LEX_NORMAL;
+        }
+      break;
+
+    case LEX_STRING:
+      if (lexer->escaped)
+        lexer->escaped = FALSE;
+      else if (ch == '\\')
+        lexer->escaped = TRUE;
+      else if (ch == lexer->quote)
+        {
+          lexer_emit (lexer, lexer->span_begin, lexer->offset + 1, TOKEN_STRING, 0);
+          lexer->state = LEX_NORMAL;
+          ch = 0;
+        }
+      else if (ch == '\n')
+        {
+          /* Unterminated literals stop at the end of the line */
+          lexer_emit (lexer, lexer->span_begin, lexer->offset, TOKEN_STRING, 0);
+          lexer->state = LEX_NORMAL;
+        }
+      break;
+
+    case LEX_DIRECTIVE:
+      if (lexer->keyword_len == 0 && (ch == ' ' || ch == '\t'))
+        break;
+
+      if (g_ascii_isalpha (ch) && lexer->keyword_len < sizeof lexer->keyword - 1)
+        {
+          lexer->keyword[lexer->keyword_len++] = ch;
+          break;
+        }
+
+      lexer_emit_directive (lexer);
+      lexer->state = LEX_NORMAL;
+      lexer->line_start = FALSE;
+      goto again;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  if (ch == '\n')
+    lexer->line_start = TRUE;
+  else if (ch != 0 && !g_unichar_isspace (ch))
+    lexer->line_start = FALSE;
+
+  lexer->prev = ch;
+  lexer->offset++;
+}
+
+static void
+lexer_finish (Lexer *lexer)
+{
+  switch (lexer->state)
+    {
+    case LEX_BLOCK_COMMENT:
+      lexer_emit (lexer, lexer->span_begin, SPAN_TO_END, TOKEN_COMMENT, 0);
+      break;
+
+    case LEX_LINE_COMMENT:
+      lexer_emit (lexer, lexer->span_begin, SPAN_TO_END, TOKEN_LINE_COMMENT, 0);
+      break;
+
+    case LEX_STRING:
+      lexer_emit (lexer, lexer->span_begin, SPAN_TO_END, TOKEN_STRING, 0);
+      break;
+
+    case LEX_DIRECTIVE:
+      lexer_emit_directive (lexer);
+      break;
+
+    case LEX_NORMAL:
+    default:
+      break;
+    }
+
+  lexer->state = LEX_NORMAL;
+}
+
+static void
+chunk_free (gpointer data)
+{
+  Chunk *chunk = data;
+
+  g_clear_pointer (&chunk->tokens, g_array_unref);
+  g_slice_free (Chunk, chunk);
+}
+
+static void
+chunk_update_summary (Chunk *chunk)
+{
+  Summary *summary = &chunk->summary;
+  guint i;
+
+  memset (summary, 0, sizeof *summary);
+
+  for (i = 0; i < chunk->tokens->len; i++)
+    {
+      const Token *token = &g_array_index (chunk->tokens, Token, i);
+
+      switch (token->kind)
+        {
+        case TOKEN_OPEN:
+          summary->n_open[token->sub]++;
+          break;
+
+        case TOKEN_CLOSE:
+          if (summary->n_open[token->sub] > 0)
+            summary->n_open[token->sub]--;
+          else
+            summary->n_close[token->sub]++;
+          break;
+
+        case TOKEN_DIRECTIVE:
+          summary->n_directives++;
+          break;
+
+        default:
+          break;
+        }
+    }
+}
+
+/* Combines the summaries of two adjacent runs of tokens */
+static inline void
+summary_concat (Summary       *dest,
+                const Summary *a,
+                const Summary *b)
+{
+  guint i;
+
+  for (i = 0; i < N_BRACKETS; i++)
+    {
+      guint matched = MIN (a->n_open[i], b->n_close[i]);
+
+      dest->n_open[i] = a->n_open[i] - matched + b->n_open[i];
+      dest->n_close[i] = a->n_close[i] + b->n_close[i] - matched;
+    }
+
+  dest->n_directives = a->n_directives + b->n_directives;
+}
+
+/*
+ * Checks if a search moving forward through the tokens of @summary can
+ * skip them, consuming them from @depth if so.
+ */
+static inline gboolean
+summary_skip_forward (const Summary *summary,
+                      guint          what,
+                      guint         *depth)
+{
+  if (what == SUMMARY_DIRECTIVES)
+    return summary->n_directives == 0;
+
+  if (summary->n_close[what] >= *depth)
+    return FALSE;
+
+  *depth = *depth - summary->n_close[what] + summary->n_open[what];
+
+  return TRUE;
+}
+
+static inline gboolean
+summary_skip_backward (const Summary *summary,
+                       guint          what,
+                       guint         *depth)
+{
+  if (what == SUMMARY_DIRECTIVES)
+    return summary->n_directives == 0;
+
+  if (summary->n_open[what] >= *depth)
+    return FALSE;
+
+  *depth = *depth - summary->n_open[what] + summary->n_close[what];
+
+  return TRUE;
+}
+
+/* Creates a chunk from tokens with absolute offsets */
+static Chunk *
+chunk_new (const Token *tokens,
+           guint        n_tokens)
+{
+  Chunk *chunk;
+  guint i;
+
+  g_assert (n_tokens > 0);
+  g_assert (n_tokens <= CHUNK_TOKENS);
+
+  chunk = g_slice_new0 (Chunk);
+  chunk->base = tokens[0].begin;
+  chunk->tokens = g_array_sized_new (FALSE, FALSE, sizeof (Token), n_tokens);
+  g_array_append_vals (chunk->tokens, tokens, n_tokens);
+
+  for (i = 0; i < n_tokens; i++)
+    {
+      Token *token = &g_array_index (chunk->tokens, Token, i);
+
+      token->begin -= chunk->base;
+      if (token->end != SPAN_TO_END)
+        token->end -= chunk->base;
+    }
+
+  chunk_update_summary (chunk);
+
+  return chunk;
+}
+
+/* Makes the offsets relative to the first token again after removing it */
+static void
+chunk_rebase (Chunk *chunk)
+{
+  guint shift;
+  guint i;
+
+  g_assert (chunk->tokens->len > 0);
+
+  shift = g_array_index (chunk->tokens, Token, 0).begin;
+
+  if (shift == 0)
+    return;
+
+  chunk->base += shift;
+
+  for (i = 0; i < chunk->tokens->len; i++)
+    {
+      Token *token = &g_array_index (chunk->tokens, Token, i);
+
+      token->begin -= shift;
+      if (token->end != SPAN_TO_END)
+        token->end -= shift;
+    }
+}
+
+static inline Chunk *
+get_chunk (IdeBufferStructure *self,
+           guint               chunk)
+{
+  return g_ptr_array_index (self->chunks, chunk);
+}
+
+static inline guint
+chunk_base (IdeBufferStructure *self,
+            guint               chunk)
+{
+  guint base = get_chunk (self, chunk)->base;
+
+  if (chunk >= self->step_chunk)
+    base += self->step_delta;
+
+  return base;
+}
+
+static inline Token *
+pos_get (IdeBufferStructure *self,
+         const TokenPos     *pos)
+{
+  return &g_array_index (get_chunk (self, pos->chunk)->tokens, Token, pos->index);
+}
+
+static inline guint
+pos_begin (IdeBufferStructure *self,
+           const TokenPos     *pos)
+{
+  return chunk_base (self, pos->chunk) + pos_get (self, pos)->begin;
+}
+
+static inline guint
+pos_end (IdeBufferStructure *self,
+         const TokenPos     *pos)
+{
+  const Token *token = pos_get (self, pos);
+
+  if (token->end == SPAN_TO_END)
+    return SPAN_TO_END;
+
+  return chunk_base (self, pos->chunk) + token->end;
+}
+
+static inline void
+pos_set_end (IdeBufferStructure *self,
+             const TokenPos     *pos,
+             guint               end)
+{
+  Token *token = pos_get (self, pos);
+
+  if (end == SPAN_TO_END)
+    token->end = SPAN_TO_END;
+  else
+    token->end = end - chunk_base (self, pos->chunk);
+}
+
+static inline gboolean
+pos_is_end (IdeBufferStructure *self,
+            const TokenPos     *pos)
+{
+  return pos->chunk >= self->chunks->len;
+}
+
+static inline gboolean
+pos_equal (const TokenPos *a,
+           const TokenPos *b)
+{
+  return a->chunk == b->chunk && a->index == b->index;
+}
+
+static inline void
+pos_next (IdeBufferStructure *self,
+          TokenPos           *pos)
+{
+  if (++pos->index >= get_chunk (self, pos->chunk)->tokens->len)
+    {
+      pos->chunk++;
+      pos->index = 0;
+    }
+}
+
+static inline gboolean
+pos_prev (IdeBufferStructure *self,
+          TokenPos           *pos)
+{
+  if (pos->index > 0)
+    {
+      pos->index--;
+      return TRUE;
+    }
+
+  if (pos->chunk == 0)
+    return FALSE;
+
+  pos->chunk--;
+  pos->index = get_chunk (self, pos->chunk)->tokens->len - 1;
+
+  return TRUE;
+}
+
+/* Locates the first token with begin >= offset */
+static TokenPos
+lower_bound (IdeBufferStructure *self,
+             guint               offset)
+{
+  TokenPos pos = { 0, 0 };
+  const Chunk *chunk;
+  guint base;
+  guint lo = 0;
+  guint hi = self->chunks->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (chunk_base (self, mid) < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  /* The first token of chunk lo is past offset, so look in the one before */
+  if (lo == 0)
+    return pos;
+
+  pos.chunk = lo - 1;
+  chunk = get_chunk (self, pos.chunk);
+  base = chunk_base (self, pos.chunk);
+
+  lo = 0;
+  hi = chunk->tokens->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (base + g_array_index (chunk->tokens, Token, mid).begin < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == chunk->tokens->len)
+    pos.chunk++;
+  else
+    pos.index = lo;
+
+  return pos;
+}
+
+/* Applies the pending step to the chunks before @chunk */
+static void
+ide_buffer_structure_settle (IdeBufferStructure *self,
+                             guint               chunk)
+{
+  if (self->step_delta == 0)
+    {
+      self->step_chunk = MAX (self->step_chunk, chunk);
+      return;
+    }
+
+  for (; self->step_chunk < chunk; self->step_chunk++)
+    get_chunk (self, self->step_chunk)->base += self->step_delta;
+}
+
+static void
+ide_buffer_structure_shift_chunks (IdeBufferStructure *self,
+                                   guint               chunk,
+                                   gint                delta)
+{
+  guint i;
+
+  if (delta == 0 || chunk >= self->chunks->len)
+    return;
+
+  if (self->step_delta == 0)
+    {
+      self->step_chunk = chunk;
+      self->step_delta = delta;
+    }
+  else if (chunk >= self->step_chunk)
+    {
+      ide_buffer_structure_settle (self, chunk);
+      self->step_delta += delta;
+    }
+  else
+    {
+      for (i = chunk; i < self->step_chunk; i++)
+        get_chunk (self, i)->base += delta;
+      self->step_delta += delta;
+    }
+}
+
+/* Marks the summaries from @chunk up to the last @n_after chunks as stale */
+static inline void
+ide_buffer_structure_touch (IdeBufferStructure *self,
+                            guint               chunk,
+                            guint               n_after)
+{
+  self->summary_begin = MIN (self->summary_begin, chunk);
+  self->summary_tail = MIN (self->summary_tail, n_after);
+}
+
+static void
+ide_buffer_structure_update_chunk (IdeBufferStructure *self,
+                                   guint               chunk)
+{
+  chunk_update_summary (get_chunk (self, chunk));
+  ide_buffer_structure_touch (self, chunk, self->chunks->len - chunk - 1);
+}
+
+static void
+ide_buffer_structure_update_summaries (IdeBufferStructure *self)
+{
+  guint len = self->chunks->len;
+  guint begin;
+  guint end;
+  guint lo;
+  guint hi;
+  guint i;
+
+  if (self->summary_begin == G_MAXUINT)
+    return;
+
+  if (len != self->summary_len)
+    {
+      guint size = 1;
+
+      while (size < len)
+        size <<= 1;
+
+      /* Clears the nodes past the last chunk, they must stay empty */
+      g_array_set_size (self->summaries, 0);
+      g_array_set_size (self->summaries, size * 2);
+
+      self->summary_size = size;
+      self->summary_len = len;
+
+      begin = 0;
+      end = len;
+    }
+  else
+    {
+      begin = self->summary_begin;
+      end = len - MIN (self->summary_tail, len);
+    }
+
+  self->summary_begin = G_MAXUINT;
+  self->summary_tail = G_MAXUINT;
+
+  if (begin >= end)
+    return;
+
+  for (i = begin; i < end; i++)
+    g_array_index (self->summaries, Summary, self->summary_size + i) = get_chunk (self, i)->summary;
+
+  lo = self->summary_size + begin;
+  hi = self->summary_size + end - 1;
+
+  while (lo > 1)
+    {
+      lo /= 2;
+      hi /= 2;
+
+      for (i = lo; i <= hi; i++)
+        summary_concat (&g_array_index (self->summaries, Summary, i),
+                        &g_array_index (self->summaries, Summary, i * 2),
+                        &g_array_index (self->summaries, Summary, i * 2 + 1));
+    }
+}
+
+/*
+ * Finds the first chunk, from @chunk on, that cannot be skipped by a search
+ * moving forward. @node covers the chunks from @node_begin up to @node_end.
+ */
+static guint
+summary_find_next (IdeBufferStructure *self,
+                   guint               node,
+                   guint               node_begin,
+                   guint               node_end,
+                   guint               chunk,
+                   guint               what,
+                   guint              *depth)
+{
+  guint mid;
+  guint found;
+
+  if (node_end <= chunk || node_begin >= self->chunks->len)
+    return G_MAXUINT;
+
+  if (node_begin >= chunk &&
+      summary_skip_forward (&g_array_index (self->summaries, Summary, node), what, depth))
+    return G_MAXUINT;
+
+  if (node_end - node_begin == 1)
+    return node_begin;
+
+  mid = node_begin + (node_end - node_begin) / 2;
+  found = summary_find_next (self, node * 2, node_begin, mid, chunk, what, depth);
+
+  if (found == G_MAXUINT)
+    found = summary_find_next (self, node * 2 + 1, mid, node_end, chunk, what, depth);
+
+  return found;
+}
+
+/* Finds the last chunk, before @chunk, that cannot be skipped by a search moving backward */
+static guint
+summary_find_prev (IdeBufferStructure *self,
+                   guint               node,
+                   guint               node_begin,
+                   guint               node_end,
+                   guint               chunk,
+                   guint               what,
+                   guint              *depth)
+{
+  guint mid;
+  guint found;
+
+  if (node_begin >= chunk)
+    return G_MAXUINT;
+
+  if (node_end <= chunk &&
+      summary_skip_backward (&g_array_index (self->summaries, Summary, node), what, depth))
+    return G_MAXUINT;
+
+  if (node_end - node_begin == 1)
+    return node_begin;
+
+  mid = node_begin + (node_end - node_begin) / 2;
+  found = summary_find_prev (self, node * 2 + 1, mid, node_end, chunk, what, depth);
+
+  if (found == G_MAXUINT)
+    found = summary_find_prev (self, node * 2, node_begin, mid, chunk, what, depth);
+
+  return found;
+}
+
+static inline guint
+ide_buffer_structure_next_chunk (IdeBufferStructure *self,
+                                 guint               chunk,
+                                 guint               what,
+                                 guint              *depth)
+{
+  if (chunk >= self->chunks->len)
+    return G_MAXUINT;
+
+  return summary_find_next (self, 1, 0, self->summary_size, chunk, what, depth);
+}
+
+static inline guint
+ide_buffer_structure_prev_chunk (IdeBufferStructure *self,
+                                 guint               chunk,
+                                 guint               what,
+                                 guint              *depth)
+{
+  if (chunk == 0)
+    return G_MAXUINT;
+
+  return summary_find_prev (self, 1, 0, self->summary_size, chunk, what, depth);
+}
+
+static void
+ide_buffer_structure_remove_chunks (IdeBufferStructure *self,
+                                    guint               chunk,
+                                    guint               n_chunks)
+{
+  if (n_chunks == 0)
+    return;
+
+  ide_buffer_structure_touch (self, chunk, self->chunks->len - chunk - n_chunks);
+  ide_buffer_structure_settle (self, chunk);
+
+  if (self->step_chunk >= chunk + n_chunks)
+    self->step_chunk -= n_chunks;
+  else
+    self->step_chunk = chunk;
+
+  g_ptr_array_remove_range (self->chunks, chunk, n_chunks);
+}
+
+/* @new_chunk must have been created with absolute offsets */
+static void
+ide_buffer_structure_insert_chunk (IdeBufferStructure *self,
+                                   guint               chunk,
+                                   Chunk              *new_chunk)
+{
+  ide_buffer_structure_touch (self, chunk, self->chunks->len - chunk);
+  ide_buffer_structure_settle (self, chunk);
+  g_ptr_array_insert (self->chunks, chunk, new_chunk);
+  self->step_chunk++;
+}
+
+/* Moves the tokens from @pos onwards by @delta characters */
+static void
+ide_buffer_structure_shift_tokens (IdeBufferStructure *self,
+                                   TokenPos            pos,
+                                   gint                delta)
+{
+  if (pos_is_end (self, &pos))
+    return;
+
+  if (pos.index > 0)
+    {
+      Chunk *chunk = get_chunk (self, pos.chunk);
+
+      for (; pos.index < chunk->tokens->len; pos.index++)
+        {
+          Token *token = &g_array_index (chunk->tokens, Token, pos.index);
+
+          token->begin += delta;
+          if (token->end != SPAN_TO_END)
+            token->end += delta;
+        }
+
+      pos.chunk++;
+    }
+
+  ide_buffer_structure_shift_chunks (self, pos.chunk, delta);
+}
+
+/*
+ * Removes the tokens from @first up to, but not including, @last.
+ *
+ * Returns: the position of the token that was at @last.
+ */
+static TokenPos
+ide_buffer_structure_remove_tokens (IdeBufferStructure *self,
+                                    TokenPos            first,
+                                    TokenPos            last)
+{
+  Chunk *chunk;
+  guint remove_begin;
+
+  if (pos_equal (&first, &last))
+    return first;
+
+  if (first.chunk == last.chunk)
+    {
+      chunk = get_chunk (self, first.chunk);
+      g_array_remove_range (chunk->tokens, first.index, last.index - first.index);
+      if (first.index == 0)
+        chunk_rebase (chunk);
+      ide_buffer_structure_update_chunk (self, first.chunk);
+      return first;
+    }
+
+  remove_begin = first.chunk;
+
+  if (first.index > 0)
+    {
+      chunk = get_chunk (self, first.chunk);
+      g_array_set_size (chunk->tokens, first.index);
+      ide_buffer_structure_update_chunk (self, first.chunk);
+      remove_begin++;
+    }
+
+  if (!pos_is_end (self, &last) && last.index > 0)
+    {
+      chunk = get_chunk (self, last.chunk);
+      g_array_remove_range (chunk->tokens, 0, last.index);
+      chunk_rebase (chunk);
+      ide_buffer_structure_update_chunk (self, last.chunk);
+    }
+
+  ide_buffer_structure_remove_chunks (self, remove_begin, last.chunk - remove_begin);
+
+  first.chunk = remove_begin;
+  first.index = 0;
+
+  return first;
+}
+
+static void
+ide_buffer_structure_append_tokens (IdeBufferStructure *self,
+                                    GArray             *tokens,
+                                    guint               chunk,
+                                    guint               begin,
+                                    guint               end)
+{
+  const Chunk *c = get_chunk (self, chunk);
+  guint base = chunk_base (self, chunk);
+
+  for (; begin < end; begin++)
+    {
+      Token token = g_array_index (c->tokens, Token, begin);
+
+      token.begin += base;
+      if (token.end != SPAN_TO_END)
+        token.end += base;
+
+      g_array_append_val (tokens, token);
+    }
+}
+
+/*
+ * Replaces the tokens from @first up to @last with @fresh, which has
+ * absolute offsets. Only the chunks holding @first and @last are rebuilt.
+ */
+static void
+ide_buffer_structure_splice (IdeBufferStructure *self,
+                             TokenPos            first,
+                             TokenPos            last,
+                             GArray             *fresh)
+{
+  g_autoptr(GArray) merged = NULL;
+  guint remove_begin = first.chunk;
+  guint remove_end;
+  guint n_chunks;
+  guint i;
+
+  merged = g_array_new (FALSE, FALSE, sizeof (Token));
+
+  if (!pos_is_end (self, &first) && first.index > 0)
+    ide_buffer_structure_append_tokens (self, merged, first.chunk, 0, first.index);
+
+  g_array_append_vals (merged, fresh->data, fresh->len);
+
+  if (pos_is_end (self, &last))
+    remove_end = self->chunks->len;
+  else if (last.index == 0)
+    remove_end = last.chunk;
+  else
+    {
+      ide_buffer_structure_append_tokens (self, merged, last.chunk, last.index,
+                                          get_chunk (self, last.chunk)->tokens->len);
+      remove_end = last.chunk + 1;
+    }
+
+  /* Fold small leftovers into the previous chunk so chunks stay reasonably full */
+  if (remove_begin > 0 &&
+      merged->len < CHUNK_TOKENS / 2 &&
+      get_chunk (self, remove_begin - 1)->tokens->len + merged->len <= CHUNK_TOKENS)
+    {
+      g_autoptr(GArray) before = g_array_new (FALSE, FALSE, sizeof (Token));
+
+      remove_begin--;
+      ide_buffer_structure_append_tokens (self, before, remove_begin, 0,
+                                          get_chunk (self, remove_begin)->tokens->len);
+      g_array_prepend_vals (merged, before->data, before->len);
+    }
+
+  ide_buffer_structure_remove_chunks (self, remove_begin, remove_end - remove_begin);
+
+  n_chunks = (merged->len + CHUNK_TOKENS - 1) / CHUNK_TOKENS;
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      guint begin = merged->len * i / n_chunks;
+      guint end = merged->len * (i + 1) / n_chunks;
+
+      ide_buffer_structure_insert_chunk (self,
+                                         remove_begin + i,
+                                         chunk_new (&g_array_index (merged, Token, begin), end - begin));
+    }
+}
+
+static inline guint
+map_delete (guint offset,
+            guint begin,
+            guint n_chars)
+{
+  if (offset == SPAN_TO_END || offset <= begin)
+    return offset;
+  else if (offset < begin + n_chars)
+    return begin;
+  else
+    return offset - n_chars;
+}
+
+static void
+ide_buffer_structure_add_dirty (IdeBufferStructure *self,
+                                guint               begin,
+                                guint               end)
+{
+  if (!self->dirty)
+    {
+      self->dirty_begin = begin;
+      self->dirty_end = end;
+      self->dirty = TRUE;
+    }
+  else
+    {
+      self->dirty_begin = MIN (self->dirty_begin, begin);
+      self->dirty_end = MAX (self->dirty_end, end);
+    }
+}
+
+static void
+ide_buffer_structure_relex (IdeBufferStructure *self)
+{
+  g_autoptr(GArray) fresh = NULL;
+  GtkTextIter iter;
+  GtkTextIter chunk_end;
+  TokenPos first;
+  TokenPos last;
+  TokenPos prev;
+  Lexer lexer = { 0 };
+  guint relex_begin;
+  gint line;
+
+  IDE_ENTRY;
+
+  g_assert (self->dirty);
+  g_assert (self->buffer != NULL);
+
+  if (self->invalid)
+    {
+      g_ptr_array_set_size (self->chunks, 0);
+      ide_buffer_structure_touch (self, 0, 0);
+      self->step_chunk = 0;
+      self->step_delta = 0;
+      self->dirty_begin = 0;
+      self->dirty_end = SPAN_TO_END;
+      self->invalid = FALSE;
+    }
+
+  /*
+   * Start from the beginning of the first dirty line, backing up further if
+   * a token we are keeping would span into the region we re-lex.
+   */
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &iter, self->dirty_begin);
+  gtk_text_iter_set_line_offset (&iter, 0);
+  relex_begin = gtk_text_iter_get_offset (&iter);
+  first = lower_bound (self, relex_begin);
+
+  for (prev = first; pos_prev (self, &prev); prev = first)
+    {
+      guint prev_end = pos_end (self, &prev);
+
+      if (prev_end <= relex_begin && prev_end < self->dirty_begin)
+        break;
+
+      gtk_text_buffer_get_iter_at_offset (self->buffer, &iter, pos_begin (self, &prev));
+      gtk_text_iter_set_line_offset (&iter, 0);
+      relex_begin = gtk_text_iter_get_offset (&iter);
+      first = lower_bound (self, relex_begin);
+    }
+
+  fresh = g_array_new (FALSE, FALSE, sizeof (Token));
+
+  lexer.tokens = fresh;
+  lexer.offset = relex_begin;
+  lexer.line_start = TRUE;
+  lexer.preprocessor = self->preprocessor;
+
+  last.chunk = self->chunks->len;
+  last.index = 0;
+  line = gtk_text_iter_get_line (&iter);
+
+  for (;;)
+    {
+      g_autofree gchar *text = NULL;
+      const gchar *c;
+
+      gtk_text_buffer_get_iter_at_line (self->buffer, &chunk_end, line + CHUNK_LINES);
+      if (gtk_text_iter_get_line (&chunk_end) != line + CHUNK_LINES)
+        gtk_text_buffer_get_end_iter (self->buffer, &chunk_end);
+
+      text = gtk_text_iter_get_slice (&iter, &chunk_end);
+
+      for (c = text; *c; c = g_utf8_next_char (c))
+        {
+          gunichar ch = g_utf8_get_char (c);
+
+          lexer_push (&lexer, ch);
+
+          /*
+           * Once we are at the start of a line past the dirty range (so the
+           * newline itself was not edited) and no old token spans it, the
+           * previous lexing was in the same state and the rest of the old
+           * tokens are still valid.
+           */
+          if (ch == '\n' &&
+              lexer.state == LEX_NORMAL &&
+              lexer.offset > self->dirty_end)
+            {
+              TokenPos next = lower_bound (self, lexer.offset);
+
+              prev = next;
+
+              if (!pos_prev (self, &prev) || pos_end (self, &prev) <= lexer.offset)
+                {
+                  last = next;
+                  IDE_GOTO (splice);
+                }
+            }
+        }
+
+      if (gtk_text_iter_is_end (&chunk_end))
+        break;
+
+      iter = chunk_end;
+      line += CHUNK_LINES;
+    }
+
+  lexer_finish (&lexer);
+
+splice:
+  IDE_TRACE_MSG ("Re-lexed %u..%u into %u tokens", relex_begin, lexer.offset, fresh->len);
+
+  ide_buffer_structure_splice (self, first, last, fresh);
+
+  self->dirty = FALSE;
+
+  IDE_EXIT;
+}
+
+static gboolean
+ide_buffer_structure_ensure (IdeBufferStructure *self)
+{
+  g_assert (IDE_IS_BUFFER_STRUCTURE (self));
+
+  if (self->buffer == NULL || !self->enabled)
+    return FALSE;
+
+  if (self->dirty)
+    ide_buffer_structure_relex (self);
+
+  ide_buffer_structure_update_summaries (self);
+
+  return TRUE;
+}
+
+/*
+ * Walks forward from the token after @pos to the close bracket of kind
+ * @bracket that leaves @depth levels of nesting, skipping chunks which
+ * cannot contain it.
+ */
+static gboolean
+ide_buffer_structure_forward_close (IdeBufferStructure *self,
+                                    TokenPos           *pos,
+                                    guint               bracket,
+                                    guint               depth)
+{
+  guint chunk = pos->chunk;
+  guint index = pos->index + 1;
+
+  for (;;)
+    {
+      const Chunk *c = get_chunk (self, chunk);
+
+      for (; index < c->tokens->len; index++)
+        {
+          const Token *token = &g_array_index (c->tokens, Token, index);
+
+          if (token->kind == TOKEN_OPEN && token->sub == bracket)
+            depth++;
+          else if (token->kind == TOKEN_CLOSE && token->sub == bracket && --depth == 0)
+            {
+              pos->chunk = chunk;
+              pos->index = index;
+              return TRUE;
+            }
+        }
+
+      chunk = ide_buffer_structure_next_chunk (self, chunk + 1, bracket, &depth);
+      index = 0;
+
+      if (chunk == G_MAXUINT)
+        return FALSE;
+    }
+}
+
+/*
+ * Walks backward from the token before @pos to the open bracket of kind
+ * @bracket that is @depth levels out, skipping chunks which cannot
+ * contain it.
+ */
+static gboolean
+ide_buffer_structure_backward_open (IdeBufferStructure *self,
+                                    TokenPos           *pos,
+                                    guint               bracket,
+                                    guint               depth)
+{
+  guint chunk = pos->chunk;
+  guint index = pos->index;
+
+  for (;;)
+    {
+      if (index > 0)
+        {
+          const Chunk *c = get_chunk (self, chunk);
+
+          while (index > 0)
+            {
+              const Token *token = &g_array_index (c->tokens, Token, --index);
+
+              if (token->kind == TOKEN_CLOSE && token->sub == bracket)
+                depth++;
+              else if (token->kind == TOKEN_OPEN && token->sub == bracket && --depth == 0)
+                {
+                  pos->chunk = chunk;
+                  pos->index = index;
+                  return TRUE;
+                }
+            }
+        }
+
+      chunk = ide_buffer_structure_prev_chunk (self, chunk, bracket, &depth);
+
+      if (chunk == G_MAXUINT)
+        return FALSE;
+
+      index = get_chunk (self, chunk)->tokens->len;
+    }
+}
+
+/* Walks forward from the token after @pos to the next directive of its #if chain */
+static gboolean
+ide_buffer_structure_forward_directive (IdeBufferStructure *self,
+                                        TokenPos           *pos)
+{
+  guint chunk = pos->chunk;
+  guint index = pos->index + 1;
+  guint depth = 0;
+
+  for (;;)
+    {
+      const Chunk *c = get_chunk (self, chunk);
+
+      for (; index < c->tokens->len; index++)
+        {
+          const Token *token = &g_array_index (c->tokens, Token, index);
+
+          if (token->kind != TOKEN_DIRECTIVE)
+            continue;
+
+          if (token->sub == DIRECTIVE_IF)
+            depth++;
+          else if (depth == 0)
+            {
+              pos->chunk = chunk;
+              pos->index = index;
+              return TRUE;
+            }
+          else if (token->sub == DIRECTIVE_ENDIF)
+            depth--;
+        }
+
+      chunk = ide_buffer_structure_next_chunk (self, chunk + 1, SUMMARY_DIRECTIVES, &depth);
+      index = 0;
+
+      if (chunk == G_MAXUINT)
+        return FALSE;
+    }
+}
+
+/* Walks backward from the token before @pos to the #if of the enclosing chain */
+static gboolean
+ide_buffer_structure_backward_if (IdeBufferStructure *self,
+                                  TokenPos           *pos)
+{
+  guint chunk = pos->chunk;
+  guint index = pos->index;
+  guint depth = 0;
+
+  for (;;)
+    {
+      if (index > 0)
+        {
+          const Chunk *c = get_chunk (self, chunk);
+
+          while (index > 0)
+            {
+              const Token *token = &g_array_index (c->tokens, Token, --index);
+
+              if (token->kind != TOKEN_DIRECTIVE)
+                continue;
+
+              if (token->sub == DIRECTIVE_ENDIF)
+                depth++;
+              else if (token->sub == DIRECTIVE_IF && depth-- == 0)
+                {
+                  pos->chunk = chunk;
+                  pos->index = index;
+                  return TRUE;
+                }
+            }
+        }
+
+      chunk = ide_buffer_structure_prev_chunk (self, chunk, SUMMARY_DIRECTIVES, &depth);
+
+      if (chunk == G_MAXUINT)
+        return FALSE;
+
+      index = get_chunk (self, chunk)->tokens->len;
+    }
+}
+
+static void
+ide_buffer_structure_finalize (GObject *object)
+{
+  IdeBufferStructure *self = (IdeBufferStructure *)object;
+
+  ide_clear_weak_pointer (&self->buffer);
+  g_clear_pointer (&self->chunks, g_ptr_array_unref);
+  g_clear_pointer (&self->summaries, g_array_unref);
+
+  G_OBJECT_CLASS (ide_buffer_structure_parent_class)->finalize (object);
+}
+
+static void
+ide_buffer_structure_class_init (IdeBufferStructureClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_buffer_structure_finalize;
+}
+
+static void
+ide_buffer_structure_init (IdeBufferStructure *self)
+{
+  self->chunks = g_ptr_array_new_with_free_func (chunk_free);
+  self->summaries = g_array_new (FALSE, TRUE, sizeof (Summary));
+  self->dirty = TRUE;
+  self->invalid = TRUE;
+}
+IdeBufferStructure *
+_ide_buffer_structure_new (GtkTextBuffer *buffer)
+{
+  IdeBufferStructure *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  self = g_object_new (IDE_TYPE_BUFFER_STRUCTURE, NULL);
+  ide_set_weak_pointer (&self->buffer, buffer);
+
+  return self;
+}
+
+gboolean
+_ide_buffer_structure_get_enabled (IdeBufferStructure *self)
+{
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), FALSE);
+
+  return self->enabled;
+}
+
+void
+_ide_buffer_structure_set_language_id (IdeBufferStructure *self,
+                                       const gchar        *language_id)
+{
+  gboolean enabled = FALSE;
+  gboolean preprocessor = FALSE;
+  guint i;
+
+  g_return_if_fail (IDE_IS_BUFFER_STRUCTURE (self));
+
+  for (i = 0; language_id != NULL && i < G_N_ELEMENTS (c_like_languages); i++)
+    {
+      if (g_str_equal (language_id, c_like_languages [i].id))
+        {
+          enabled = TRUE;
+          preprocessor = c_like_languages [i].preprocessor;
+          break;
+        }
+    }
+
+  if (enabled != self->enabled || preprocessor != self->preprocessor)
+    {
+      self->enabled = enabled;
+      self->preprocessor = preprocessor;
+      _ide_buffer_structure_reset (self);
+    }
+}
+
+gsize
+_ide_buffer_structure_get_memory_usage (IdeBufferStructure *self)
+{
+  gsize size;
+  guint i;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), 0);
+
+  size = sizeof *self + (gsize)self->chunks->len * (sizeof (gpointer) + sizeof (Chunk));
+  size += (gsize)self->summaries->len * sizeof (Summary);
+
+  for (i = 0; i < self->chunks->len; i++)
+    size += (gsize)get_chunk (self, i)->tokens->len * sizeof (Token);
+
+  return size;
+}
+
+/*
+ * Drops all tokens. They are recreated on the next query.
+ */
+void
+_ide_buffer_structure_reset (IdeBufferStructure *self)
+{
+  g_return_if_fail (IDE_IS_BUFFER_STRUCTURE (self));
+
+  g_ptr_array_set_size (self->chunks, 0);
+  ide_buffer_structure_touch (self, 0, 0);
+  self->step_chunk = 0;
+  self->step_delta = 0;
+  self->dirty = TRUE;
+  self->invalid = TRUE;
+}
+
+void
+_ide_buffer_structure_insert (IdeBufferStructure *self,
+                              guint               offset,
+                              guint               n_chars)
+{
+  TokenPos pos;
+  TokenPos prev;
+
+  g_return_if_fail (IDE_IS_BUFFER_STRUCTURE (self));
+
+  if (self->invalid || n_chars == 0)
+    return;
+
+  pos = lower_bound (self, offset);
+
+  /* A span containing the insertion point grows with it */
+  prev = pos;
+  if (pos_prev (self, &prev))
+    {
+      Token *token = pos_get (self, &prev);
+
+      if (token->end != SPAN_TO_END && pos_end (self, &prev) > offset)
+        token->end += n_chars;
+    }
+
+  ide_buffer_structure_shift_tokens (self, pos, n_chars);
+
+  if (self->dirty)
+    {
+      if (self->dirty_begin > offset)
+        self->dirty_begin += n_chars;
+      if (self->dirty_end >= offset && self->dirty_end != SPAN_TO_END)
+        self->dirty_end += n_chars;
+    }
+
+  ide_buffer_structure_add_dirty (self, offset, offset + n_chars);
+}
+
+void
+_ide_buffer_structure_delete (IdeBufferStructure *self,
+                              guint               offset,
+                              guint               n_chars)
+{
+  guint dirty_end = offset;
+  TokenPos first;
+  TokenPos last;
+  TokenPos pos;
+
+  g_return_if_fail (IDE_IS_BUFFER_STRUCTURE (self));
+
+  if (self->invalid || n_chars == 0)
+    return;
+
+  first = lower_bound (self, offset);
+  last = lower_bound (self, offset + n_chars);
+
+  pos = first;
+  if (pos_prev (self, &pos))
+    pos_set_end (self, &pos, map_delete (pos_end (self, &pos), offset, n_chars));
+
+  /*
+   * Tokens starting within the deleted text are dropped, but whatever they
+   * covered past the deletion needs to be lexed again.
+   */
+  for (pos = first; !pos_equal (&pos, &last); pos_next (self, &pos))
+    dirty_end = MAX (dirty_end, map_delete (pos_end (self, &pos), offset, n_chars));
+
+  /* Everything after the deletion simply moves back */
+  pos = ide_buffer_structure_remove_tokens (self, first, last);
+  ide_buffer_structure_shift_tokens (self, pos, -(gint)n_chars);
+
+  if (self->dirty)
+    {
+      self->dirty_begin = map_delete (self->dirty_begin, offset, n_chars);
+      self->dirty_end = map_delete (self->dirty_end, offset, n_chars);
+    }
+
+  ide_buffer_structure_add_dirty (self, offset, dirty_end);
+}
+
+/**
+ * ide_buffer_structure_get_span:
+ * @self: An #IdeBufferStructure
+ * @iter: A #GtkTextIter
+ * @begin: (out) (optional): A location for the beginning of the span
+ * @end: (out) (optional): A location for the end of the span
+ *
+ * Checks if the character at @iter is part of a comment or string literal,
+ * and if so, returns the bounds of it. A C89 style comment ends after its
+ * closing delimiter while a C99 style comment ends before the newline.
+ *
+ * Returns: The kind of span containing @iter, or %IDE_BUFFER_SPAN_NONE.
+ */
+IdeBufferSpanKind
+ide_buffer_structure_get_span (IdeBufferStructure *self,
+                               const GtkTextIter  *iter,
+                               GtkTextIter        *begin,
+                               GtkTextIter        *end)
+{
+  IdeBufferSpanKind kind;
+  const Token *token;
+  TokenPos pos;
+  guint offset;
+  guint token_end;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), IDE_BUFFER_SPAN_NONE);
+  g_return_val_if_fail (iter != NULL, IDE_BUFFER_SPAN_NONE);
+
+  if (!ide_buffer_structure_ensure (self))
+    return IDE_BUFFER_SPAN_NONE;
+
+  offset = gtk_text_iter_get_offset (iter);
+  pos = lower_bound (self, offset + 1);
+
+  if (!pos_prev (self, &pos))
+    return IDE_BUFFER_SPAN_NONE;
+
+  token = pos_get (self, &pos);
+  token_end = pos_end (self, &pos);
+
+  if (token_end == SPAN_TO_END)
+    token_end = gtk_text_buffer_get_char_count (self->buffer);
+
+  if (offset >= token_end)
+    return IDE_BUFFER_SPAN_NONE;
+
+  switch (token->kind)
+    {
+    case TOKEN_COMMENT:
+      kind = IDE_BUFFER_SPAN_COMMENT;
+      break;
+
+    case TOKEN_LINE_COMMENT:
+      kind = IDE_BUFFER_SPAN_LINE_COMMENT;
+      break;
+
+    case TOKEN_STRING:
+      kind = IDE_BUFFER_SPAN_STRING;
+      break;
+
+    default:
+      return IDE_BUFFER_SPAN_NONE;
+    }
+
+  if (begin != NULL)
+    gtk_text_buffer_get_iter_at_offset (self->buffer, begin, pos_begin (self, &pos));
+
+  if (end != NULL)
+    gtk_text_buffer_get_iter_at_offset (self->buffer, end, token_end);
+
+  return kind;
+}
+
+/**
+ * ide_buffer_structure_find_matching_bracket:
+ * @self: An #IdeBufferStructure
+ * @iter: A #GtkTextIter at a bracket
+ * @match: (out): A location for the matching bracket
+ *
+ * Locates the bracket matching the one at @iter. Brackets within comments
+ * and strings are ignored.
+ *
+ * Returns: %TRUE if @iter is at a bracket and it has a match.
+ */
+gboolean
+ide_buffer_structure_find_matching_bracket (IdeBufferStructure *self,
+                                            const GtkTextIter  *iter,
+                                            GtkTextIter        *match)
+{
+  const Token *token;
+  TokenPos pos;
+  guint offset;
+  gboolean found;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (match != NULL, FALSE);
+
+  if (!ide_buffer_structure_ensure (self))
+    return FALSE;
+
+  offset = gtk_text_iter_get_offset (iter);
+  pos = lower_bound (self, offset);
+
+  if (pos_is_end (self, &pos) || pos_begin (self, &pos) != offset)
+    return FALSE;
+
+  token = pos_get (self, &pos);
+
+  if (token->kind == TOKEN_OPEN)
+    found = ide_buffer_structure_forward_close (self, &pos, token->sub, 1);
+  else if (token->kind == TOKEN_CLOSE)
+    found = ide_buffer_structure_backward_open (self, &pos, token->sub, 1);
+  else
+    return FALSE;
+
+  if (found)
+    gtk_text_buffer_get_iter_at_offset (self->buffer, match, pos_begin (self, &pos));
+
+  return found;
+}
+
+/**
+ * ide_buffer_structure_find_enclosing_bracket:
+ * @self: An #IdeBufferStructure
+ * @iter: A #GtkTextIter
+ * @open_char: one of '(', '[', or '{'
+ * @depth: the number of levels to walk out, starting at 1
+ * @match: (out): A location for the bracket
+ *
+ * Locates the opening bracket that is still unmatched before @iter, walking
+ * out @depth levels of nesting. Only brackets of the same kind as
+ * @open_char are considered.
+ *
+ * Returns: %TRUE if an enclosing bracket was found.
+ */
+gboolean
+ide_buffer_structure_find_enclosing_bracket (IdeBufferStructure *self,
+                                             const GtkTextIter  *iter,
+                                             gunichar            open_char,
+                                             guint               depth,
+                                             GtkTextIter        *match)
+{
+  gboolean is_open = FALSE;
+  TokenPos pos;
+  gint kind;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (match != NULL, FALSE);
+  g_return_val_if_fail (depth > 0, FALSE);
+
+  kind = bracket_kind (open_char, &is_open);
+  g_return_val_if_fail (kind != -1 && is_open, FALSE);
+
+  if (!ide_buffer_structure_ensure (self))
+    return FALSE;
+
+  pos = lower_bound (self, gtk_text_iter_get_offset (iter));
+
+  if (!ide_buffer_structure_backward_open (self, &pos, kind, depth))
+    return FALSE;
+
+  gtk_text_buffer_get_iter_at_offset (self->buffer, match, pos_begin (self, &pos));
+
+  return TRUE;
+}
+
+/**
+ * ide_buffer_structure_find_matching_conditional:
+ * @self: An #IdeBufferStructure
+ * @iter: A #GtkTextIter within a preprocessor conditional directive
+ * @match: (out): A location for the matching directive
+ *
+ * Locates the directive following the one at @iter in the same
+ * #if/#elif/#else/#endif chain, or for #endif, the opening #if.
+ *
+ * Returns: %TRUE if a matching directive was found.
+ */
+gboolean
+ide_buffer_structure_find_matching_conditional (IdeBufferStructure *self,
+                                                const GtkTextIter  *iter,
+                                                GtkTextIter        *match)
+{
+  const Token *token;
+  TokenPos pos;
+  TokenPos head;
+  guint offset;
+  gboolean found;
+
+  g_return_val_if_fail (IDE_IS_BUFFER_STRUCTURE (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (match != NULL, FALSE);
+
+  if (!ide_buffer_structure_ensure (self))
+    return FALSE;
+
+  offset = gtk_text_iter_get_offset (iter);
+  pos = lower_bound (self, offset + 1);
+
+  if (!pos_prev (self, &pos))
+    return FALSE;
+
+  token = pos_get (self, &pos);
+
+  if (token->kind != TOKEN_DIRECTIVE || offset > pos_end (self, &pos))
+    return FALSE;
+
+  head = pos;
+
+  /* #elif and #else only belong to a chain if there is an #if to start it */
+  if (token->sub == DIRECTIVE_ENDIF)
+    found = ide_buffer_structure_backward_if (self, &pos);
+  else if (token->sub != DIRECTIVE_IF && !ide_buffer_structure_backward_if (self, &head))
+    found = FALSE;
+  else
+    found = ide_buffer_structure_forward_directive (self, &pos);
+
+  if (found)
+    gtk_text_buffer_get_iter_at_offset (self->buffer, match, pos_begin (self, &pos));
+
+  return found;
+}
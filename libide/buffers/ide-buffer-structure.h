@@ -0,0 +1,58 @@
+/* ide-buffer-structure.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUFFER_STRUCTURE_H
+#define IDE_BUFFER_STRUCTURE_H
+
+#include <gtk/gtk.h>
+
+#include "ide-types.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUFFER_STRUCTURE (ide_buffer_structure_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBufferStructure, ide_buffer_structure, IDE, BUFFER_STRUCTURE, GObject)
+
+typedef enum
+{
+  IDE_BUFFER_SPAN_NONE,
+  IDE_BUFFER_SPAN_COMMENT,
+  IDE_BUFFER_SPAN_LINE_COMMENT,
+  IDE_BUFFER_SPAN_STRING,
+} IdeBufferSpanKind;
+
+IdeBufferSpanKind ide_buffer_structure_get_span                  (IdeBufferStructure *self,
+                                                                  const GtkTextIter  *iter,
+                                                                  GtkTextIter        *begin,
+                                                                  GtkTextIter        *end);
+gboolean          ide_buffer_structure_find_matching_bracket     (IdeBufferStructure *self,
+                                                                  const GtkTextIter  *iter,
+                                                                  GtkTextIter        *match);
+gboolean          ide_buffer_structure_find_enclosing_bracket    (IdeBufferStructure *self,
+                                                                  const GtkTextIter  *iter,
+                                                                  gunichar            open_char,
+                                                                  guint               depth,
+                                                                  GtkTextIter        *match);
+gboolean          ide_buffer_structure_find_matching_conditional (IdeBufferStructure *self,
+                                                                  const GtkTextIter  *iter,
+                                                                  GtkTextIter        *match);
+
+G_END_DECLS
+
+#endif /* IDE_BUFFER_STRUCTURE_H */
@@ -27,6 +27,7 @@
 #include "ide-internal.h"
 
 #include "buffers/ide-buffer-change-monitor.h"
+#include "buffers/ide-buffer-structure.h"
 #include "buffers/ide-buffer.h"
 #include "buffers/ide-unsaved-files.h"
 #include "diagnostics/ide-diagnostic.h"
@@ -53,6 +54,17 @@
 #define RECLAIMATION_TIMEOUT_SECS              1
 #define MODIFICATION_TIMEOUT_SECS              1
 
+/*
+ * Rough per-line costs used by ide_buffer_get_memory_usage(). They do not
+ * need to be exact, only good enough to rank buffers against each other and
+ * against the buffer manager's memory budget.
+ */
+#define TEXT_LINE_OVERHEAD_BYTES               64
+#define HIGHLIGHT_LINE_OVERHEAD_BYTES          96
+#define CHANGE_MONITOR_LINE_OVERHEAD_BYTES     16
+#define DIAGNOSTIC_OVERHEAD_BYTES              256
+#define UNDO_CHAR_OVERHEAD_BYTES               2
+
 #define TAG_ERROR            "diagnostician::error"
 #define TAG_WARNING          "diagnostician::warning"
 #define TAG_DEPRECATED       "diagnostician::deprecated"
@@ -69,11 +81,15 @@ typedef struct
 {
   IdeContext             *context;
   IdeDiagnostics         *diagnostics;
+  GHashTable             *applied_diagnostics;
+  GtkTextMark            *edited_begin;
+  GtkTextMark            *edited_end;
   GHashTable             *diagnostics_line_cache;
   EggSignalGroup         *diagnostics_manager_signals;
   IdeFile                *file;
   GBytes                 *content;
   IdeBufferChangeMonitor *change_monitor;
+  IdeBufferStructure     *structure;
   IdeHighlightEngine     *highlight_engine;
   IdeExtensionAdapter    *rename_provider_adapter;
   IdeExtensionAdapter    *symbol_resolver_adapter;
@@ -88,6 +104,7 @@ typedef struct
   guint                   check_modified_timeout;
 
   guint                   diagnostics_sequence;
+  guint                   changes_frozen;
 
   GTimeVal                mtime;
 
@@ -96,11 +113,17 @@ typedef struct
 
   gsize                   change_count;
 
+  /* Used by the buffer manager to reclaim memory from idle buffers */
+  gint64                  last_viewed;
+  guint                   n_mapped;
+  gsize                   undo_chars;
+
   guint                   changed_on_volume : 1;
   guint                   highlight_diagnostics : 1;
   guint                   loading : 1;
   guint                   mtime_set : 1;
   guint                   read_only : 1;
+  guint                   trimmed : 1;
 } IdeBufferPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (IdeBuffer, ide_buffer, GTK_SOURCE_TYPE_BUFFER)
@@ -111,6 +134,7 @@ enum {
   PROP_0,
   PROP_BUSY,
   PROP_CHANGED_ON_VOLUME,
+  PROP_CHANGES_FROZEN,
   PROP_CONTEXT,
   PROP_FILE,
   PROP_HAS_DIAGNOSTICS,
@@ -133,6 +157,8 @@ enum {
 static GParamSpec *properties [LAST_PROP];
 static guint signals [LAST_SIGNAL];
 
+static void ide_buffer_untrim (IdeBuffer *self);
+
 /**
  * ide_buffer_get_has_diagnostics:
  * @self: A #IdeBuffer.
@@ -263,36 +289,60 @@ ide_buffer_sync_to_unsaved_files (IdeBuffer *self)
     g_bytes_unref (content);
 }
 
+/*
+ * Tracks the span of the buffer that was tagged for a diagnostic. The marks
+ * follow edits to the buffer so that we can untag the span where it ended
+ * up, rather than where the diagnostic was reported.
+ */
+typedef struct
+{
+  IdeDiagnostic *diagnostic;
+  GtkTextMark   *begin;
+  GtkTextMark   *end;
+} AppliedDiagnostic;
+
+typedef struct
+{
+  guint begin;
+  guint end;
+} LineRange;
+
+static void
+applied_diagnostic_free (gpointer data)
+{
+  AppliedDiagnostic *applied = data;
+
+  /* Marks are owned by the buffer, which may be finalizing */
+  g_clear_pointer (&applied->diagnostic, ide_diagnostic_unref);
+  g_slice_free (AppliedDiagnostic, applied);
+}
+
 static void
-ide_buffer_clear_diagnostics (IdeBuffer *self)
+ide_buffer_remove_diagnostic_tags (IdeBuffer         *self,
+                                   const GtkTextIter *begin,
+                                   const GtkTextIter *end)
 {
-  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   GtkTextBuffer *buffer = (GtkTextBuffer *)self;
   GtkTextTagTable *table;
   GtkTextTag *tag;
-  GtkTextIter begin;
-  GtkTextIter end;
 
   g_assert (IDE_IS_BUFFER (self));
-
-  if (priv->diagnostics_line_cache != NULL)
-    g_hash_table_remove_all (priv->diagnostics_line_cache);
-
-  gtk_text_buffer_get_bounds (buffer, &begin, &end);
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
 
   table = gtk_text_buffer_get_tag_table (buffer);
 
   if (NULL != (tag = gtk_text_tag_table_lookup (table, TAG_NOTE)))
-    ide_gtk_text_buffer_remove_tag (buffer, tag, &begin, &end, TRUE);
+    ide_gtk_text_buffer_remove_tag (buffer, tag, begin, end, TRUE);
 
   if (NULL != (tag = gtk_text_tag_table_lookup (table, TAG_WARNING)))
-    ide_gtk_text_buffer_remove_tag (buffer, tag, &begin, &end, TRUE);
+    ide_gtk_text_buffer_remove_tag (buffer, tag, begin, end, TRUE);
 
   if (NULL != (tag = gtk_text_tag_table_lookup (table, TAG_DEPRECATED)))
-    ide_gtk_text_buffer_remove_tag (buffer, tag, &begin, &end, TRUE);
+    ide_gtk_text_buffer_remove_tag (buffer, tag, begin, end, TRUE);
 
   if (NULL != (tag = gtk_text_tag_table_lookup (table, TAG_ERROR)))
-    ide_gtk_text_buffer_remove_tag (buffer, tag, &begin, &end, TRUE);
+    ide_gtk_text_buffer_remove_tag (buffer, tag, begin, end, TRUE);
 }
 
 static void
@@ -332,18 +382,84 @@ ide_buffer_cache_diagnostic_line (IdeBuffer             *self,
 }
 
 static void
+ide_buffer_cache_diagnostic (IdeBuffer     *self,
+                             IdeDiagnostic *diagnostic)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  IdeDiagnosticSeverity severity;
+  IdeSourceLocation *location;
+  gsize num_ranges;
+  gsize i;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (diagnostic);
+
+  severity = ide_diagnostic_get_severity (diagnostic);
+
+  if (severity == IDE_DIAGNOSTIC_IGNORED)
+    return;
+
+  if (NULL != (location = ide_diagnostic_get_location (diagnostic)))
+    {
+      IdeFile *file = ide_source_location_get_file (location);
+
+      if (file && priv->file && !ide_file_equal (file, priv->file))
+        return;
+
+      ide_buffer_cache_diagnostic_line (self, location, location, severity);
+    }
+
+  num_ranges = ide_diagnostic_get_num_ranges (diagnostic);
+
+  for (i = 0; i < num_ranges; i++)
+    {
+      IdeSourceRange *range = ide_diagnostic_get_range (diagnostic, i);
+
+      ide_buffer_cache_diagnostic_line (self,
+                                        ide_source_range_get_begin (range),
+                                        ide_source_range_get_end (range),
+                                        severity);
+    }
+}
+
+static void
+extend_span (GtkTextIter       *span_begin,
+             GtkTextIter       *span_end,
+             gboolean           first,
+             const GtkTextIter *begin,
+             const GtkTextIter *end)
+{
+  if (first || gtk_text_iter_compare (begin, span_begin) < 0)
+    *span_begin = *begin;
+
+  if (first || gtk_text_iter_compare (end, span_end) > 0)
+    *span_end = *end;
+}
+
+/*
+ * Applies the tags for @diagnostic and stores the region of the buffer
+ * that was tagged in @span_begin and @span_end.
+ *
+ * Returns: %TRUE if any tags were applied.
+ */
+static gboolean
 ide_buffer_update_diagnostic (IdeBuffer     *self,
-                              IdeDiagnostic *diagnostic)
+                              IdeDiagnostic *diagnostic,
+                              GtkTextIter   *span_begin,
+                              GtkTextIter   *span_end)
 {
   IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   IdeDiagnosticSeverity severity;
   const gchar *tag_name = NULL;
   IdeSourceLocation *location;
+  gboolean tagged = FALSE;
   gsize num_ranges;
   gsize i;
 
   g_assert (IDE_IS_BUFFER (self));
   g_assert (diagnostic);
+  g_assert (span_begin != NULL);
+  g_assert (span_end != NULL);
 
   severity = ide_diagnostic_get_severity (diagnostic);
 
@@ -368,7 +484,7 @@ ide_buffer_update_diagnostic (IdeBuffer     *self,
 
     case IDE_DIAGNOSTIC_IGNORED:
     default:
-      return;
+      return FALSE;
     }
 
   if (NULL != (location = ide_diagnostic_get_location (diagnostic)))
@@ -380,9 +496,7 @@ ide_buffer_update_diagnostic (IdeBuffer     *self,
       file = ide_source_location_get_file (location);
 
       if (file && priv->file && !ide_file_equal (file, priv->file))
-        return;
-
-      ide_buffer_cache_diagnostic_line (self, location, location, severity);
+        return FALSE;
 
       ide_buffer_get_iter_at_location (self, &iter1, location);
       gtk_text_iter_assign (&iter2, &iter1);
@@ -392,6 +506,9 @@ ide_buffer_update_diagnostic (IdeBuffer     *self,
         gtk_text_iter_backward_char (&iter1);
 
       gtk_text_buffer_apply_tag_by_name (GTK_TEXT_BUFFER (self), tag_name, &iter1, &iter2);
+
+      extend_span (span_begin, span_end, !tagged, &iter1, &iter2);
+      tagged = TRUE;
     }
 
   num_ranges = ide_diagnostic_get_num_ranges (diagnostic);
@@ -419,8 +536,6 @@ ide_buffer_update_diagnostic (IdeBuffer     *self,
       ide_buffer_get_iter_at_location (self, &iter1, begin);
       ide_buffer_get_iter_at_location (self, &iter2, end);
 
-      ide_buffer_cache_diagnostic_line (self, begin, end, severity);
-
       if (gtk_text_iter_equal (&iter1, &iter2))
         {
           if (!gtk_text_iter_ends_line (&iter2))
@@ -430,58 +545,293 @@ ide_buffer_update_diagnostic (IdeBuffer     *self,
         }
 
       gtk_text_buffer_apply_tag_by_name (GTK_TEXT_BUFFER (self), tag_name, &iter1, &iter2);
+
+      extend_span (span_begin, span_end, !tagged, &iter1, &iter2);
+      tagged = TRUE;
     }
+
+  return tagged;
 }
 
 static void
-ide_buffer_update_diagnostics (IdeBuffer      *self,
-                               IdeDiagnostics *diagnostics)
+ide_buffer_apply_diagnostic (IdeBuffer         *self,
+                             AppliedDiagnostic *applied)
 {
-  gsize size;
-  gsize i;
+  GtkTextBuffer *buffer = (GtkTextBuffer *)self;
+  GtkTextIter begin;
+  GtkTextIter end;
 
   g_assert (IDE_IS_BUFFER (self));
-  g_assert (diagnostics);
+  g_assert (applied != NULL);
 
-  size = ide_diagnostics_get_size (diagnostics);
+  if (!ide_buffer_update_diagnostic (self, applied->diagnostic, &begin, &end))
+    return;
 
-  for (i = 0; i < size; i++)
+  /* Track whole lines so neighbouring edits remain inside of the span */
+  gtk_text_iter_set_line_offset (&begin, 0);
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+
+  if (applied->begin == NULL)
     {
-      IdeDiagnostic *diagnostic;
+      applied->begin = gtk_text_buffer_create_mark (buffer, NULL, &begin, TRUE);
+      applied->end = gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE);
+    }
+  else
+    {
+      gtk_text_buffer_move_mark (buffer, applied->begin, &begin);
+      gtk_text_buffer_move_mark (buffer, applied->end, &end);
+    }
+}
 
-      diagnostic = ide_diagnostics_index (diagnostics, i);
-      if (diagnostic != NULL)
-        ide_buffer_update_diagnostic (self, diagnostic);
+static void
+ide_buffer_unapply_diagnostic (IdeBuffer         *self,
+                               AppliedDiagnostic *applied,
+                               LineRange         *lines)
+{
+  GtkTextBuffer *buffer = (GtkTextBuffer *)self;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (applied != NULL);
+  g_assert (applied->begin != NULL);
+  g_assert (lines != NULL);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, applied->begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, applied->end);
+
+  ide_buffer_remove_diagnostic_tags (self, &begin, &end);
+
+  lines->begin = gtk_text_iter_get_line (&begin);
+  lines->end = gtk_text_iter_get_line (&end);
+
+  gtk_text_buffer_delete_mark (buffer, applied->begin);
+  gtk_text_buffer_delete_mark (buffer, applied->end);
+
+  applied->begin = NULL;
+  applied->end = NULL;
+}
+
+static gboolean
+ide_buffer_applied_overlaps (IdeBuffer         *self,
+                             AppliedDiagnostic *applied,
+                             GArray            *lines)
+{
+  GtkTextBuffer *buffer = (GtkTextBuffer *)self;
+  GtkTextIter begin;
+  GtkTextIter end;
+  guint begin_line;
+  guint end_line;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (applied != NULL);
+  g_assert (lines != NULL);
+
+  if (applied->begin == NULL)
+    return FALSE;
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, applied->begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, applied->end);
+
+  begin_line = gtk_text_iter_get_line (&begin);
+  end_line = gtk_text_iter_get_line (&end);
+
+  for (guint i = 0; i < lines->len; i++)
+    {
+      const LineRange *range = &g_array_index (lines, LineRange, i);
+
+      if (begin_line <= range->end && range->begin <= end_line)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Tracks the span of text edited since diagnostics were last applied. Text
+ * inserted within a tagged range does not inherit the tag, so diagnostics
+ * we keep across sets need to be retagged when they touch this span.
+ */
+static void
+ide_buffer_extend_edited (IdeBuffer         *self,
+                          const GtkTextIter *begin,
+                          const GtkTextIter *end)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  GtkTextBuffer *buffer = (GtkTextBuffer *)self;
+  GtkTextIter edited_begin;
+  GtkTextIter edited_end;
+
+  g_assert (IDE_IS_BUFFER (self));
+
+  if (priv->applied_diagnostics == NULL)
+    return;
+
+  if (priv->edited_begin == NULL)
+    {
+      priv->edited_begin = gtk_text_buffer_create_mark (buffer, NULL, begin, TRUE);
+      priv->edited_end = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
+      return;
     }
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &edited_begin, priv->edited_begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &edited_end, priv->edited_end);
+
+  if (gtk_text_iter_compare (begin, &edited_begin) < 0)
+    gtk_text_buffer_move_mark (buffer, priv->edited_begin, begin);
+
+  if (gtk_text_iter_compare (end, &edited_end) > 0)
+    gtk_text_buffer_move_mark (buffer, priv->edited_end, end);
 }
 
+/*
+ * Diagnostics are reported as a whole set each time, but usually only a few
+ * of them change between two sets. Rather than clearing and reapplying the
+ * tags for the whole buffer, we only untag diagnostics that went away, retag
+ * those that shared lines with them or with edited text, and tag the new
+ * ones.
+ */
 static void
 ide_buffer_set_diagnostics (IdeBuffer      *self,
                             IdeDiagnostics *diagnostics)
 {
   IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  g_autoptr(GHashTable) applied = NULL;
+  g_autoptr(GPtrArray) added = NULL;
+  g_autoptr(GArray) removed_lines = NULL;
+  GHashTableIter iter;
+  gpointer value;
+  gsize size;
+  gsize i;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_BUFFER (self));
   g_assert (diagnostics != NULL);
 
-  if (diagnostics != priv->diagnostics)
+  if (diagnostics == priv->diagnostics)
+    IDE_EXIT;
+
+  applied = g_hash_table_new_full ((GHashFunc)ide_diagnostic_hash,
+                                   (GEqualFunc)ide_diagnostic_equal,
+                                   NULL,
+                                   applied_diagnostic_free);
+  added = g_ptr_array_new ();
+  removed_lines = g_array_new (FALSE, FALSE, sizeof (LineRange));
+
+  size = ide_diagnostics_get_size (diagnostics);
+
+  for (i = 0; i < size; i++)
+    {
+      IdeDiagnostic *diagnostic = ide_diagnostics_index (diagnostics, i);
+      gpointer key;
+
+      if (diagnostic == NULL || g_hash_table_contains (applied, diagnostic))
+        continue;
+
+      if (priv->applied_diagnostics != NULL &&
+          g_hash_table_lookup_extended (priv->applied_diagnostics, diagnostic, &key, &value))
+        {
+          g_hash_table_steal (priv->applied_diagnostics, key);
+          g_hash_table_insert (applied, key, value);
+        }
+      else
+        {
+          g_ptr_array_add (added, diagnostic);
+        }
+    }
+
+  /* Anything left over has gone away */
+  if (priv->applied_diagnostics != NULL)
     {
-      ide_buffer_clear_diagnostics (self);
+      g_hash_table_iter_init (&iter, priv->applied_diagnostics);
 
-      g_clear_pointer (&priv->diagnostics, ide_diagnostics_unref);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          AppliedDiagnostic *item = value;
+          LineRange lines;
 
-      if (diagnostics != NULL)
+          if (item->begin != NULL)
+            {
+              ide_buffer_unapply_diagnostic (self, item, &lines);
+              g_array_append_val (removed_lines, lines);
+            }
+        }
+
+      g_clear_pointer (&priv->applied_diagnostics, g_hash_table_unref);
+    }
+
+  if (priv->edited_begin != NULL)
+    {
+      GtkTextIter begin;
+      GtkTextIter end;
+      LineRange lines;
+
+      gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (self), &begin, priv->edited_begin);
+      gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (self), &end, priv->edited_end);
+
+      lines.begin = gtk_text_iter_get_line (&begin);
+      lines.end = gtk_text_iter_get_line (&end);
+      g_array_append_val (removed_lines, lines);
+
+      gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (self), priv->edited_begin);
+      gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (self), priv->edited_end);
+
+      priv->edited_begin = NULL;
+      priv->edited_end = NULL;
+    }
+
+  /* Untagging and edits may have removed tags of diagnostics we kept */
+  if (removed_lines->len > 0)
+    {
+      g_hash_table_iter_init (&iter, applied);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
         {
-          priv->diagnostics = ide_diagnostics_ref (diagnostics);
-          ide_buffer_update_diagnostics (self, diagnostics);
+          AppliedDiagnostic *item = value;
+
+          if (ide_buffer_applied_overlaps (self, item, removed_lines))
+            ide_buffer_apply_diagnostic (self, item);
         }
+    }
+
+  for (i = 0; i < added->len; i++)
+    {
+      IdeDiagnostic *diagnostic = g_ptr_array_index (added, i);
+      AppliedDiagnostic *item;
+
+      if (g_hash_table_contains (applied, diagnostic))
+        continue;
 
-      g_signal_emit (self, signals [LINE_FLAGS_CHANGED], 0);
-      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_HAS_DIAGNOSTICS]);
+      item = g_slice_new0 (AppliedDiagnostic);
+      item->diagnostic = ide_diagnostic_ref (diagnostic);
+      ide_buffer_apply_diagnostic (self, item);
+      g_hash_table_insert (applied, item->diagnostic, item);
     }
 
+  priv->applied_diagnostics = g_steal_pointer (&applied);
+
+  /* Line flags are cheap to compute, so rebuild them from scratch */
+  if (priv->diagnostics_line_cache != NULL)
+    {
+      g_hash_table_remove_all (priv->diagnostics_line_cache);
+
+      for (i = 0; i < size; i++)
+        {
+          IdeDiagnostic *diagnostic = ide_diagnostics_index (diagnostics, i);
+
+          if (diagnostic != NULL)
+            ide_buffer_cache_diagnostic (self, diagnostic);
+        }
+    }
+
+  g_clear_pointer (&priv->diagnostics, ide_diagnostics_unref);
+  priv->diagnostics = ide_diagnostics_ref (diagnostics);
+
+  g_signal_emit (self, signals [LINE_FLAGS_CHANGED], 0);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_HAS_DIAGNOSTICS]);
+
   IDE_EXIT;
 }
 
@@ -646,6 +996,11 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
                          GtkTextIter   *start,
                          GtkTextIter   *end)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  guint begin_offset;
+  guint end_offset;
+
   IDE_ENTRY;
 
 #ifdef IDE_ENABLE_TRACE
@@ -664,8 +1019,17 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
   }
 #endif
 
+  begin_offset = gtk_text_iter_get_offset (start);
+  end_offset = gtk_text_iter_get_offset (end);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->delete_range (buffer, start, end);
 
+  _ide_buffer_structure_delete (priv->structure, begin_offset, end_offset - begin_offset);
+
+  priv->undo_chars += end_offset - begin_offset;
+
+  ide_buffer_extend_edited (self, start, start);
+
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
 
   IDE_EXIT;
@@ -677,7 +1041,12 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
                         const gchar   *text,
                         gint           len)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  GtkTextIter begin;
   gboolean check_modeline = FALSE;
+  guint offset;
+  guint n_chars;
 
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (location);
@@ -693,8 +1062,20 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
       ((text [0] == '\n') || ((len > 1) && (strchr (text, '\n') != NULL))))
     check_modeline = TRUE;
 
+  offset = gtk_text_iter_get_offset (location);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->insert_text (buffer, location, text, len);
 
+  n_chars = g_utf8_strlen (text, len);
+
+  _ide_buffer_structure_insert (priv->structure, offset, n_chars);
+
+  priv->undo_chars += n_chars;
+
+  begin = *location;
+  gtk_text_iter_backward_chars (&begin, n_chars);
+  ide_buffer_extend_edited (self, &begin, location);
+
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
 
   if (check_modeline)
@@ -871,6 +1252,8 @@ ide_buffer_notify_language (IdeBuffer  *self,
 
   if (priv->symbol_resolver_adapter != NULL)
     ide_extension_adapter_set_value (priv->symbol_resolver_adapter, lang_id);
+
+  _ide_buffer_structure_set_language_id (priv->structure, lang_id);
 }
 
 static void
@@ -1220,6 +1603,7 @@ ide_buffer_dispose (GObject *object)
   egg_signal_group_set_target (priv->diagnostics_manager_signals, NULL);
 
   g_clear_pointer (&priv->diagnostics_line_cache, g_hash_table_unref);
+  g_clear_pointer (&priv->applied_diagnostics, g_hash_table_unref);
   g_clear_pointer (&priv->diagnostics, ide_diagnostics_unref);
   g_clear_pointer (&priv->content, g_bytes_unref);
   g_clear_pointer (&priv->title, g_free);
@@ -1256,6 +1640,7 @@ ide_buffer_finalize (GObject *object)
     }
 
   ide_clear_weak_pointer (&priv->context);
+  g_clear_object (&priv->structure);
 
   G_OBJECT_CLASS (ide_buffer_parent_class)->finalize (object);
 
@@ -1282,6 +1667,10 @@ ide_buffer_get_property (GObject    *object,
       g_value_set_boolean (value, ide_buffer_get_changed_on_volume (self));
       break;
 
+    case PROP_CHANGES_FROZEN:
+      g_value_set_boolean (value, ide_buffer_get_changes_frozen (self));
+      break;
+
     case PROP_CONTEXT:
       g_value_set_object (value, ide_buffer_get_context (self));
       break;
@@ -1377,6 +1766,20 @@ ide_buffer_class_init (IdeBufferClass *klass)
                           FALSE,
                           (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * IdeBuffer:changes-frozen:
+   *
+   * If listeners should defer expensive work in response to buffer changes,
+   * such as highlighting, diffing, or diagnosing, until the property is
+   * %FALSE again. See ide_buffer_freeze_changes().
+   */
+  properties [PROP_CHANGES_FROZEN] =
+    g_param_spec_boolean ("changes-frozen",
+                          "Changes Frozen",
+                          "If change listeners should defer their work.",
+                          FALSE,
+                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   properties [PROP_CONTEXT] =
     g_param_spec_object ("context",
                          "Context",
@@ -1527,6 +1930,8 @@ ide_buffer_init (IdeBuffer *self)
                                    G_CONNECT_SWAPPED);
 
   priv->diagnostics_line_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->last_viewed = g_get_monotonic_time ();
+  priv->structure = _ide_buffer_structure_new (GTK_TEXT_BUFFER (self));
 
   priv->diagnostics_manager_signals = egg_signal_group_new (IDE_TYPE_DIAGNOSTICS_MANAGER);
   egg_signal_group_connect_object (priv->diagnostics_manager_signals,
@@ -2111,8 +2516,12 @@ _ide_buffer_set_loading (IdeBuffer *self,
     {
       priv->loading = loading;
 
+      /* Loading the file is not undoable, so it is not in the undo history */
       if (!priv->loading)
-        g_signal_emit (self, signals [LOADED], 0);
+        {
+          priv->undo_chars = 0;
+          g_signal_emit (self, signals [LOADED], 0);
+        }
     }
 
   IDE_EXIT;
@@ -2714,3 +3123,301 @@ ide_buffer_get_insert_location (IdeBuffer *self)
 
   return ide_buffer_get_iter_location (self, &iter);
 }
+
+/**
+ * ide_buffer_get_memory_usage:
+ * @self: An #IdeBuffer
+ *
+ * Gets an estimate of the number of bytes of memory used by @self. This
+ * includes the text, any cached content snapshot, highlighting tags,
+ * diagnostics, undo history, and change-monitor state for the buffer.
+ *
+ * The value is an approximation suitable for comparing buffers and for
+ * budgeting, not an exact accounting.
+ *
+ * Returns: The approximate memory usage in bytes.
+ */
+gsize
+ide_buffer_get_memory_usage (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  gsize n_lines;
+  gsize total;
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+
+  n_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self));
+
+  total = gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (self));
+  total += n_lines * TEXT_LINE_OVERHEAD_BYTES;
+
+  /* The unsaved files entry shares this GBytes, so count it once */
+  if (priv->content != NULL)
+    total += g_bytes_get_size (priv->content);
+
+  if (priv->highlight_engine != NULL && !priv->trimmed)
+    total += n_lines * HIGHLIGHT_LINE_OVERHEAD_BYTES;
+
+  if (priv->change_monitor != NULL)
+    total += n_lines * CHANGE_MONITOR_LINE_OVERHEAD_BYTES;
+
+  if (priv->diagnostics != NULL)
+    total += ide_diagnostics_get_size (priv->diagnostics) * DIAGNOSTIC_OVERHEAD_BYTES;
+
+  total += _ide_buffer_get_undo_size (self);
+
+  total += _ide_buffer_structure_get_memory_usage (priv->structure);
+
+  return total;
+}
+
+/**
+ * ide_buffer_get_structure:
+ * @self: An #IdeBuffer
+ *
+ * Gets the structural index for the buffer, which tracks brackets, comments,
+ * strings, and preprocessor conditionals as the buffer is edited. Indenters
+ * and movements can use it to avoid scanning the buffer character by
+ * character.
+ *
+ * The index is only available for C-like languages.
+ *
+ * Returns: (transfer none) (nullable): An #IdeBufferStructure or %NULL.
+ */
+IdeBufferStructure *
+ide_buffer_get_structure (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
+
+  if (priv->structure == NULL || !_ide_buffer_structure_get_enabled (priv->structure))
+    return NULL;
+
+  return priv->structure;
+}
+
+gboolean
+_ide_buffer_get_mapped (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+
+  return priv->n_mapped > 0;
+}
+
+gint64
+_ide_buffer_get_last_viewed (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+
+  return priv->last_viewed;
+}
+
+gboolean
+_ide_buffer_get_trimmed (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+
+  return priv->trimmed;
+}
+
+gsize
+_ide_buffer_get_undo_size (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+
+  if (!gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (self)) &&
+      !gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER (self)))
+    return 0;
+
+  return priv->undo_chars * UNDO_CHAR_OVERHEAD_BYTES;
+}
+
+static void
+ide_buffer_untrim (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_assert (IDE_IS_BUFFER (self));
+
+  if (!priv->trimmed)
+    return;
+
+  IDE_TRACE_MSG ("Restoring derived state for %s", priv->title);
+
+  priv->trimmed = FALSE;
+
+  if (priv->highlight_engine != NULL)
+    ide_highlight_engine_rebuild (priv->highlight_engine);
+
+  ide_buffer_reload_change_monitor (self);
+}
+
+/*
+ * Called by IdeSourceView as it is mapped and unmapped so that the buffer
+ * manager knows which buffers are currently visible. When a buffer becomes
+ * visible again, any state dropped by the buffer manager is restored.
+ */
+void
+_ide_buffer_set_mapped (IdeBuffer *self,
+                        gboolean   mapped)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (mapped || priv->n_mapped > 0);
+
+  priv->last_viewed = g_get_monotonic_time ();
+
+  if (!mapped)
+    {
+      priv->n_mapped--;
+      return;
+    }
+
+  if (priv->n_mapped++ > 0)
+    return;
+
+  ide_buffer_untrim (self);
+}
+
+/*
+ * Drops state derived from the buffer contents that can be recreated when
+ * the buffer is viewed again: the content snapshot (and unsaved file copy
+ * when the buffer matches what is on disk), highlighting tags, the
+ * structural index, and the change monitor.
+ */
+void
+_ide_buffer_trim (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+
+  if (priv->trimmed)
+    IDE_EXIT;
+
+  IDE_TRACE_MSG ("Trimming derived state for %s", priv->title);
+
+  priv->trimmed = TRUE;
+
+  if (!gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (self)) &&
+      (priv->context != NULL) &&
+      (priv->file != NULL))
+    {
+      IdeUnsavedFiles *unsaved_files = ide_context_get_unsaved_files (priv->context);
+
+      ide_unsaved_files_remove (unsaved_files, ide_file_get_file (priv->file));
+    }
+
+  g_clear_pointer (&priv->content, g_bytes_unref);
+
+  if (priv->highlight_engine != NULL)
+    ide_highlight_engine_clear (priv->highlight_engine);
+
+  _ide_buffer_structure_reset (priv->structure);
+
+  if (priv->change_monitor != NULL)
+    {
+      ide_clear_signal_handler (priv->change_monitor, &priv->change_monitor_changed_handler);
+      g_clear_object (&priv->change_monitor);
+    }
+
+  IDE_EXIT;
+}
+
+/*
+ * Drops the undo history of a buffer that has not been viewed in a while,
+ * in addition to the state dropped by _ide_buffer_trim(). The undo history
+ * keeps a copy of every edit made to the buffer, so for long sessions it
+ * can be larger than the text itself. The text is left untouched so that
+ * language servers, the symbol tree, and completion keep seeing the file.
+ */
+void
+_ide_buffer_compact (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (priv->n_mapped == 0);
+
+  if (priv->loading)
+    IDE_EXIT;
+
+  IDE_TRACE_MSG ("Compacting %s", priv->title);
+
+  _ide_buffer_trim (self);
+
+  /* Ending a not undoable action clears the undo and redo stacks */
+  gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (self));
+  gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (self));
+
+  priv->undo_chars = 0;
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_buffer_freeze_changes:
+ * @self: An #IdeBuffer
+ *
+ * Asks the listeners of the buffer to defer their work in response to
+ * buffer changes until ide_buffer_thaw_changes() is called. This is
+ * useful when performing a large number of small edits in a row, such
+ * as when replaying a macro, so that the highlighter, change monitor,
+ * diagnostics and language servers only process the result once.
+ *
+ * Calls may be nested, and must be paired with ide_buffer_thaw_changes().
+ */
+void
+ide_buffer_freeze_changes (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+
+  if (priv->changes_frozen++ == 0)
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CHANGES_FROZEN]);
+}
+
+/**
+ * ide_buffer_thaw_changes:
+ * @self: An #IdeBuffer
+ *
+ * Reverses a call to ide_buffer_freeze_changes(). When the last freeze is
+ * released, #IdeBuffer:changes-frozen is notified and listeners process
+ * the changes that were made in the mean time.
+ */
+void
+ide_buffer_thaw_changes (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (priv->changes_frozen > 0);
+
+  if (--priv->changes_frozen == 0)
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CHANGES_FROZEN]);
+}
+
+gboolean
+ide_buffer_get_changes_frozen (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+
+  return priv->changes_frozen > 0;
+}
@@ -63,6 +63,7 @@ struct _IdeBufferClass
 gboolean            ide_buffer_get_busy                      (IdeBuffer            *self);
 gboolean            ide_buffer_get_changed_on_volume         (IdeBuffer            *self);
 gsize               ide_buffer_get_change_count              (IdeBuffer            *self);
+gboolean            ide_buffer_get_changes_frozen            (IdeBuffer            *self);
 GBytes             *ide_buffer_get_content                   (IdeBuffer            *self);
 IdeContext         *ide_buffer_get_context                   (IdeBuffer            *self);
 IdeDiagnostic      *ide_buffer_get_diagnostic_at_iter        (IdeBuffer            *self,
@@ -70,6 +71,8 @@ IdeDiagnostic      *ide_buffer_get_diagnostic_at_iter        (IdeBuffer
 IdeFile            *ide_buffer_get_file                      (IdeBuffer            *self);
 IdeBufferLineFlags  ide_buffer_get_line_flags                (IdeBuffer            *self,
                                                               guint                 line);
+gsize               ide_buffer_get_memory_usage              (IdeBuffer            *self);
+IdeBufferStructure *ide_buffer_get_structure                 (IdeBuffer            *self);
 gboolean            ide_buffer_get_read_only                 (IdeBuffer            *self);
 gboolean            ide_buffer_get_highlight_diagnostics     (IdeBuffer            *self);
 const gchar        *ide_buffer_get_style_scheme_name         (IdeBuffer            *self);
@@ -105,6 +108,8 @@ IdeSymbol          *ide_buffer_get_symbol_at_location_finish (IdeBuffer
                                                               GError              **error);
 void                ide_buffer_hold                          (IdeBuffer            *self);
 void                ide_buffer_release                       (IdeBuffer            *self);
+void                ide_buffer_freeze_changes                (IdeBuffer            *self);
+void                ide_buffer_thaw_changes                  (IdeBuffer            *self);
 gchar              *ide_buffer_get_word_at_iter              (IdeBuffer            *self,
                                                               const GtkTextIter    *iter);
 void                ide_buffer_sync_to_unsaved_files         (IdeBuffer            *self);
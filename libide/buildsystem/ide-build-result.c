@@ -31,6 +31,7 @@
 #include "diagnostics/ide-source-location.h"
 #include "files/ide-file.h"
 #include "subprocess/ide-subprocess.h"
+#include "util/ide-line-reader.h"
 
 #define POINTER_MARK(p)   GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)|1)
 #define POINTER_UNMARK(p) GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)&~(gsize)1)
@@ -81,6 +82,7 @@ enum {
 enum {
   DIAGNOSTIC,
   LOG,
+  SPAWNED,
   LAST_SIGNAL
 };
 
@@ -312,41 +314,57 @@ ide_build_result_get_stdout_stream (IdeBuildResult *self)
 }
 
 static void
-ide_build_result_tail_cb (GObject      *object,
-                          GAsyncResult *result,
-                          gpointer      user_data)
+tail_free (gpointer data)
+{
+  Tail *tail = data;
+
+  g_object_unref (tail->self);
+  g_object_unref (tail->writer);
+  g_slice_free1 (sizeof *tail, tail);
+}
+
+static gboolean
+ide_build_result_tail_lines (IdeLineReader *reader,
+                             gpointer       user_data)
 {
-  GDataInputStream *reader = (GDataInputStream *)object;
-  g_autofree gchar *line = NULL;
-  g_autoptr(GError) error = NULL;
   Tail *tail = user_data;
-  gsize n_read;
+  gchar *line;
+  gsize len;
 
-  g_assert (G_IS_INPUT_STREAM (reader));
+  g_assert (reader != NULL);
   g_assert (tail != NULL);
   g_assert (G_IS_OUTPUT_STREAM (tail->writer));
 
-  line = g_data_input_stream_read_line_finish_utf8 (reader, result, &n_read, &error);
-
-  if (line)
+  while (NULL != (line = ide_line_reader_next (reader, &len)))
     {
+      /* Replace the newline so we can log the line in place */
+      line [len] = '\0';
+
+      /* The log is displayed in a text view, skip anything that is not UTF-8 */
+      if (!g_utf8_validate (line, len, NULL))
+        continue;
+
       if (tail->log == IDE_BUILD_RESULT_LOG_STDOUT)
         ide_build_result_log_stdout (tail->self, "%s", line);
       else
         ide_build_result_log_stderr (tail->self, "%s", line);
-
-      g_data_input_stream_read_line_async (reader,
-                                           G_PRIORITY_DEFAULT,
-                                           NULL,
-                                           ide_build_result_tail_cb,
-                                           tail);
-    }
-  else
-    {
-      g_object_unref (tail->self);
-      g_object_unref (tail->writer);
-      g_slice_free1 (sizeof *tail, tail);
     }
+
+  return TRUE;
+}
+
+static void
+ide_build_result_tail_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  GInputStream *reader = (GInputStream *)object;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_INPUT_STREAM (reader));
+
+  if (!ide_line_reader_read_stream_finish (reader, result, &error))
+    g_debug ("%s", error->message);
 }
 
 static void
@@ -355,25 +373,71 @@ ide_build_result_tail_into (IdeBuildResult    *self,
                             GInputStream      *reader,
                             GOutputStream     *writer)
 {
-  g_autoptr(GDataInputStream) data_reader = NULL;
   Tail *tail;
 
   g_return_if_fail (IDE_IS_BUILD_RESULT (self));
   g_return_if_fail (G_IS_INPUT_STREAM (reader));
   g_return_if_fail (G_IS_OUTPUT_STREAM (writer));
 
-  data_reader = g_data_input_stream_new (reader);
-
   tail = g_slice_alloc0 (sizeof *tail);
   tail->self = g_object_ref (self);
   tail->writer = g_object_ref (writer);
   tail->log = log;
 
-  g_data_input_stream_read_line_async (data_reader,
-                                       G_PRIORITY_DEFAULT,
-                                       NULL,
-                                       ide_build_result_tail_cb,
-                                       tail);
+  ide_line_reader_read_stream_async (reader,
+                                     ide_build_result_tail_lines,
+                                     tail,
+                                     tail_free,
+                                     NULL,
+                                     ide_build_result_tail_cb,
+                                     NULL);
+}
+
+static gboolean
+ide_build_result_emit_spawned_cb (gpointer data)
+{
+  struct {
+    IdeBuildResult *result;
+    gchar          *identifier;
+  } *pair = data;
+
+  g_assert (pair != NULL);
+  g_assert (IDE_IS_BUILD_RESULT (pair->result));
+  g_assert (pair->identifier != NULL);
+
+  g_signal_emit (pair->result, signals [SPAWNED], 0, pair->identifier);
+
+  g_object_unref (pair->result);
+  g_free (pair->identifier);
+  g_slice_free1 (sizeof *pair, pair);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_build_result_emit_spawned (IdeBuildResult *self,
+                               const gchar    *identifier)
+{
+  struct {
+    IdeBuildResult *result;
+    gchar          *identifier;
+  } *pair;
+
+  g_assert (IDE_IS_BUILD_RESULT (self));
+  g_assert (identifier != NULL);
+
+  /* Emit immediately if we are in the primary thread. */
+  if G_LIKELY (g_main_context_get_thread_default () == g_main_context_default ())
+    {
+      g_signal_emit (self, signals [SPAWNED], 0, identifier);
+      return;
+    }
+
+  pair = g_slice_alloc0 (sizeof *pair);
+  pair->result = g_object_ref (self);
+  pair->identifier = g_strdup (identifier);
+
+  g_timeout_add (0, ide_build_result_emit_spawned_cb, pair);
 }
 
 void
@@ -383,10 +447,14 @@ ide_build_result_log_subprocess (IdeBuildResult *self,
   IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
   GInputStream *stdout_stream;
   GInputStream *stderr_stream;
+  const gchar *identifier;
 
   g_return_if_fail (IDE_IS_BUILD_RESULT (self));
   g_return_if_fail (IDE_IS_SUBPROCESS (subprocess));
 
+  if ((identifier = ide_subprocess_get_identifier (subprocess)))
+    ide_build_result_emit_spawned (self, identifier);
+
   /* ensure lazily created streams are available */
   (void)ide_build_result_get_stderr_stream (self);
   (void)ide_build_result_get_stdout_stream (self);
@@ -662,6 +730,24 @@ ide_build_result_class_init (IdeBuildResultClass *klass)
                   2,
                   IDE_TYPE_BUILD_RESULT_LOG,
                   G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+  /**
+   * IdeBuildResult::spawned:
+   * @self: An #IdeBuildResult
+   * @identifier: the identifier of the subprocess, as returned from
+   *   ide_subprocess_get_identifier()
+   *
+   * This signal is emitted on the main thread when a subprocess is attached
+   * to the build result with ide_build_result_log_subprocess(). It allows
+   * plugins to monitor the processes spawned by a build.
+   */
+  signals [SPAWNED] =
+    g_signal_new ("spawned",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 static void
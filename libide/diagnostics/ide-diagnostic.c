@@ -24,6 +24,7 @@
 
 #include "files/ide-file.h"
 #include "diagnostics/ide-diagnostic.h"
+#include "diagnostics/ide-fixit.h"
 #include "diagnostics/ide-source-location.h"
 #include "diagnostics/ide-source-range.h"
 
@@ -61,6 +62,80 @@ ide_diagnostic_hash (IdeDiagnostic *self)
   return hash;
 }
 
+static gboolean
+source_range_equal (IdeSourceRange *a,
+                    IdeSourceRange *b)
+{
+  return ide_source_location_compare (ide_source_range_get_begin (a),
+                                      ide_source_range_get_begin (b)) == 0 &&
+         ide_source_location_compare (ide_source_range_get_end (a),
+                                      ide_source_range_get_end (b)) == 0;
+}
+
+/**
+ * ide_diagnostic_equal:
+ * @a: an #IdeDiagnostic
+ * @b: an #IdeDiagnostic
+ *
+ * Checks if @a and @b describe the same diagnostic, including severity,
+ * text, location, ranges and fixits. This is suitable to be used with
+ * ide_diagnostic_hash() as a #GEqualFunc.
+ *
+ * Returns: %TRUE if @a and @b are equal.
+ */
+gboolean
+ide_diagnostic_equal (IdeDiagnostic *a,
+                      IdeDiagnostic *b)
+{
+  guint n_ranges;
+  guint n_fixits;
+
+  g_return_val_if_fail (a != NULL, FALSE);
+  g_return_val_if_fail (b != NULL, FALSE);
+
+  if (a == b)
+    return TRUE;
+
+  if ((a->location == NULL) != (b->location == NULL))
+    return FALSE;
+
+  if (ide_diagnostic_compare (a, b) != 0)
+    return FALSE;
+
+  n_ranges = a->ranges ? a->ranges->len : 0;
+
+  if (n_ranges != (b->ranges ? b->ranges->len : 0))
+    return FALSE;
+
+  for (guint i = 0; i < n_ranges; i++)
+    {
+      if (!source_range_equal (g_ptr_array_index (a->ranges, i),
+                               g_ptr_array_index (b->ranges, i)))
+        return FALSE;
+    }
+
+  /*
+   * Fixits are part of the hash, and a diagnostic whose fixits changed
+   * needs to be treated as new so that the new fixits are offered.
+   */
+  n_fixits = a->fixits ? a->fixits->len : 0;
+
+  if (n_fixits != (b->fixits ? b->fixits->len : 0))
+    return FALSE;
+
+  for (guint i = 0; i < n_fixits; i++)
+    {
+      IdeFixit *fa = g_ptr_array_index (a->fixits, i);
+      IdeFixit *fb = g_ptr_array_index (b->fixits, i);
+
+      if (g_strcmp0 (ide_fixit_get_text (fa), ide_fixit_get_text (fb)) != 0 ||
+          !source_range_equal (ide_fixit_get_range (fa), ide_fixit_get_range (fb)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 IdeDiagnostic *
 ide_diagnostic_ref (IdeDiagnostic *self)
 {
@@ -64,6 +64,8 @@ void                   ide_diagnostic_take_range           (IdeDiagnostic
 gint                   ide_diagnostic_compare              (const IdeDiagnostic   *a,
                                                             const IdeDiagnostic   *b);
 guint                  ide_diagnostic_hash                 (IdeDiagnostic         *self);
+gboolean               ide_diagnostic_equal                (IdeDiagnostic         *a,
+                                                            IdeDiagnostic         *b);
 
 
 const gchar           *ide_diagnostic_severity_to_string   (IdeDiagnosticSeverity severity);
@@ -26,11 +26,63 @@
 
 #include "buffers/ide-buffer.h"
 #include "buffers/ide-buffer-manager.h"
+#include "buildsystem/ide-build-system.h"
 #include "diagnostics/ide-diagnostic.h"
 #include "diagnostics/ide-diagnostic-provider.h"
 #include "diagnostics/ide-diagnostics.h"
 #include "diagnostics/ide-diagnostics-manager.h"
+#include "diagnostics/ide-source-location.h"
+#include "files/ide-file.h"
 #include "plugins/ide-extension-set-adapter.h"
+#include "threading/ide-thread-pool.h"
+#include "vcs/ide-vcs.h"
+
+/*
+ * Diagnoses are delayed after a change so that typing does not cause a
+ * diagnosis per keystroke. The delay for each provider is its average
+ * diagnosis time, within these bounds, so that expensive providers wait
+ * longer for typing to settle while cheap ones report quickly.
+ */
+#define DEBOUNCE_MIN_USEC (G_USEC_PER_SEC / 20)
+#define DEBOUNCE_MAX_USEC (G_USEC_PER_SEC * 2)
+
+/*
+ * The workspace scan resolves languages on the main loop, so we limit how
+ * many files without diagnostic providers are skipped per idle callback.
+ */
+#define WORKSPACE_MAX_SKIP_PER_DISPATCH 100
+
+typedef struct
+{
+  /*
+   * The monotonic time at which the provider should be asked to diagnose
+   * again, or zero if no diagnosis is needed. Every change pushes this
+   * forward, which is what debounces the provider.
+   */
+  gint64 ready_time;
+
+  /*
+   * When the current diagnosis began, and the moving average of how long
+   * a diagnosis takes for this provider.
+   */
+  gint64 begin_time;
+  gint64 cost;
+
+  /*
+   * The value of the group's change counter when the running (or last)
+   * diagnosis began, and when the last result was published. If they
+   * differ, the buffer has been edited since the published diagnostics
+   * were tagged, so the next result is published even if it is equal.
+   */
+  guint diagnosed_changes;
+  guint published_changes;
+
+  /*
+   * Set while a diagnosis is running. If ready_time is set upon completion
+   * the next diagnosis is scheduled then.
+   */
+  guint in_diagnose : 1;
+} IdeDiagnosticsProviderState;
 
 typedef struct
 {
@@ -82,15 +134,19 @@ typedef struct
   guint sequence;
 
   /*
-   * If we are currently diagnosing, then this will be set to a
-   * number greater than zero.
+   * The number of providers currently diagnosing this group.
    */
   guint in_diagnose;
 
   /*
-   * If we need a diagnose this bit will be set. If we complete a
-   * diagnosis and this bit is set, then we will automatically queue
-   * another diagnose upon completion.
+   * Incremented for every change to the buffer. Providers note it when
+   * they begin a diagnosis, see IdeDiagnosticsProviderState.
+   */
+  guint n_changes;
+
+  /*
+   * If the buffer changed while changes were frozen, this bit will be
+   * set so that we queue a diagnose once the buffer is thawed.
    */
   guint needs_diagnose : 1;
 
@@ -111,6 +167,57 @@ typedef struct
 
 } IdeDiagnosticsGroup;
 
+typedef struct
+{
+  /*
+   * The checksum of the file contents and the build flags used for the
+   * diagnosis. If both are unchanged on the next workspace scan, the
+   * providers do not need to be run again.
+   */
+  gchar *key;
+
+  /*
+   * The diagnostics the providers reported for the file.
+   */
+  IdeDiagnostics *diagnostics;
+} WorkspaceEntry;
+
+typedef struct
+{
+  /*
+   * The files left to be scanned, which are popped from the end. This is
+   * %NULL until the project tree has been enumerated.
+   */
+  GPtrArray *files;
+
+  /*
+   * The diagnostic providers for each language discovered, keyed by the
+   * language id. These are separate from the providers of open buffers
+   * so that the scan does not interfere with their diagnostics.
+   */
+  GHashTable *adapters;
+
+  /*
+   * The number of files being diagnosed and how many we allow at once.
+   * The limit is a fraction of the compiler thread pool so that the scan
+   * leaves room for diagnosing the buffers the user is editing.
+   */
+  guint in_flight;
+  guint max_in_flight;
+} WorkspaceScan;
+
+typedef struct
+{
+  IdeDiagnosticsManager  *self;
+  GTask                  *task;
+  IdeFile                *file;
+  IdeExtensionSetAdapter *adapter;
+  gchar                  *content_hash;
+  gchar                  *key;
+  IdeDiagnostics         *diagnostics;
+  guint                   n_pending;
+} FileScan;
+
 struct _IdeDiagnosticsManager
 {
   IdeObject parent_instance;
@@ -124,10 +231,33 @@ struct _IdeDiagnosticsManager
   GHashTable *groups_by_file;
 
   /*
-   * If any group has a queued diagnose in process, this will be set so
-   * we can coalesce the dispatch of everything at the same time.
+   * A single timeout dispatches every provider that is ready. It is set
+   * for the earliest ready time and reschedules itself for the next.
    */
   guint queued_diagnose_source;
+  gint64 queued_diagnose_time;
+
+  /*
+   * Results of the workspace scan, a mapping of GFile to WorkspaceEntry.
+   * Files with open buffers are diagnosed as part of their group instead.
+   */
+  GHashTable *workspace_cache;
+
+  /*
+   * The project-wide model of diagnostics, created on demand, and the
+   * rows of each file within it as a GArray of GtkTreeIter. The iters of
+   * a GtkListStore persist, so the rows of a file can be replaced without
+   * touching the rest of the model.
+   */
+  GtkListStore *workspace_model;
+  GHashTable *workspace_rows;
+
+  /*
+   * The workspace scan in progress, if any, and the idle used to dispatch
+   * more files to the providers.
+   */
+  GTask *workspace_task;
+  guint workspace_dispatch_source;
 };
 
 enum {
@@ -145,11 +275,12 @@ enum {
 static void     initable_iface_init                       (GInitableIface        *iface);
 static gboolean ide_diagnostics_manager_clear_by_provider (IdeDiagnosticsManager *self,
                                                            IdeDiagnosticProvider *provider);
-static void     ide_diagnostics_manager_add_diagnostic    (IdeDiagnosticsManager *self,
-                                                           IdeDiagnosticProvider *provider,
-                                                           IdeDiagnostic         *diagnostic);
 static void     ide_diagnostics_group_queue_diagnose      (IdeDiagnosticsGroup   *group,
                                                            IdeDiagnosticsManager *self);
+static void     ide_diagnostics_manager_schedule          (IdeDiagnosticsManager *self,
+                                                           gint64                 ready_time);
+static void     ide_diagnostics_manager_update_model      (IdeDiagnosticsManager *self,
+                                                           GFile                 *file);
 
 
 static GParamSpec *properties [N_PROPS];
@@ -169,6 +300,45 @@ free_diagnostics (gpointer data)
     ide_diagnostics_unref (diagnostics);
 }
 
+static void
+provider_state_free (gpointer data)
+{
+  g_slice_free (IdeDiagnosticsProviderState, data);
+}
+
+static void
+workspace_entry_free (gpointer data)
+{
+  WorkspaceEntry *entry = data;
+
+  g_free (entry->key);
+  g_clear_pointer (&entry->diagnostics, ide_diagnostics_unref);
+  g_slice_free (WorkspaceEntry, entry);
+}
+
+static void
+workspace_scan_free (gpointer data)
+{
+  WorkspaceScan *scan = data;
+
+  g_clear_pointer (&scan->files, g_ptr_array_unref);
+  g_clear_pointer (&scan->adapters, g_hash_table_unref);
+  g_slice_free (WorkspaceScan, scan);
+}
+
+static void
+file_scan_free (FileScan *fs)
+{
+  g_clear_object (&fs->self);
+  g_clear_object (&fs->task);
+  g_clear_object (&fs->file);
+  g_clear_object (&fs->adapter);
+  g_clear_pointer (&fs->content_hash, g_free);
+  g_clear_pointer (&fs->key, g_free);
+  g_clear_pointer (&fs->diagnostics, ide_diagnostics_unref);
+  g_slice_free (FileScan, fs);
+}
+
 static void
 ide_diagnostics_group_free (gpointer data)
 {
@@ -267,32 +437,104 @@ ide_diagnostics_group_can_dispose (IdeDiagnosticsGroup *group)
          (group->has_diagnostics == FALSE);
 }
 
-static void
-ide_diagnostics_group_add (IdeDiagnosticsGroup   *group,
-                           IdeDiagnosticProvider *provider,
-                           IdeDiagnostic         *diagnostic)
+static gboolean
+diagnostics_equal (IdeDiagnostics *a,
+                   IdeDiagnostics *b)
 {
-  IdeDiagnostics *diagnostics;
+  g_autoptr(GHashTable) counts = NULL;
+  guint a_size = a ? ide_diagnostics_get_size (a) : 0;
+  guint b_size = b ? ide_diagnostics_get_size (b) : 0;
+
+  if (a_size != b_size)
+    return FALSE;
+
+  if (a_size == 0)
+    return TRUE;
+
+  /* Compare as multisets, providers do not sort their results */
+  counts = g_hash_table_new ((GHashFunc)ide_diagnostic_hash,
+                             (GEqualFunc)ide_diagnostic_equal);
+
+  for (guint i = 0; i < a_size; i++)
+    {
+      IdeDiagnostic *diagnostic = ide_diagnostics_index (a, i);
+      guint count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, diagnostic));
+
+      g_hash_table_insert (counts, diagnostic, GUINT_TO_POINTER (count + 1));
+    }
+
+  for (guint i = 0; i < b_size; i++)
+    {
+      IdeDiagnostic *diagnostic = ide_diagnostics_index (b, i);
+      gpointer key;
+      gpointer value;
+
+      if (!g_hash_table_lookup_extended (counts, diagnostic, &key, &value) ||
+          GPOINTER_TO_UINT (value) == 0)
+        return FALSE;
+
+      g_hash_table_insert (counts, key, GUINT_TO_POINTER (GPOINTER_TO_UINT (value) - 1));
+    }
+
+  return TRUE;
+}
+
+/*
+ * Replaces the diagnostics @provider reported for @group with @diagnostics,
+ * unless they are the same as what was previously reported and @force is
+ * not set. Equal diagnostics are forced when the buffer was edited since
+ * they were last published, as the edits may have removed the tags for
+ * them and the buffer only retags when the sequence changes.
+ *
+ * Returns: %TRUE if the diagnostics for the group changed.
+ */
+static gboolean
+ide_diagnostics_group_replace (IdeDiagnosticsGroup   *group,
+                               IdeDiagnosticProvider *provider,
+                               IdeDiagnostics        *diagnostics,
+                               gboolean               force)
+{
+  IdeDiagnostics *old = NULL;
+  gboolean is_owner;
 
   g_assert (group != NULL);
   g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
-  g_assert (diagnostic != NULL);
 
-  if (group->diagnostics_by_provider == NULL)
-    group->diagnostics_by_provider = g_hash_table_new_full (NULL, NULL, NULL, free_diagnostics);
+  if (group->diagnostics_by_provider != NULL)
+    old = g_hash_table_lookup (group->diagnostics_by_provider, provider);
+
+  if (!force && diagnostics_equal (old, diagnostics))
+    return FALSE;
 
-  diagnostics = g_hash_table_lookup (group->diagnostics_by_provider, provider);
+  is_owner = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP") == group;
 
-  if (diagnostics == NULL)
+  if (diagnostics != NULL && ide_diagnostics_get_size (diagnostics) > 0)
     {
-      diagnostics = ide_diagnostics_new (NULL);
-      g_hash_table_insert (group->diagnostics_by_provider, provider, diagnostics);
+      if (group->diagnostics_by_provider == NULL)
+        group->diagnostics_by_provider = g_hash_table_new_full (NULL, NULL, NULL, free_diagnostics);
+
+      g_hash_table_insert (group->diagnostics_by_provider,
+                           provider,
+                           ide_diagnostics_ref (diagnostics));
+    }
+  else if (is_owner)
+    {
+      /* Keep the placeholder entry for providers loaded for this group */
+      if (group->diagnostics_by_provider != NULL)
+        g_hash_table_insert (group->diagnostics_by_provider, provider, NULL);
     }
+  else if (group->diagnostics_by_provider != NULL)
+    {
+      g_hash_table_remove (group->diagnostics_by_provider, provider);
 
-  ide_diagnostics_add (diagnostics, diagnostic);
+      if (g_hash_table_size (group->diagnostics_by_provider) == 0)
+        g_clear_pointer (&group->diagnostics_by_provider, g_hash_table_unref);
+    }
 
-  group->has_diagnostics = TRUE;
+  group->has_diagnostics = ide_diagnostics_group_has_diagnostics (group);
   group->sequence++;
+
+  return TRUE;
 }
 
 static void
@@ -303,9 +545,16 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)object;
   g_autoptr(IdeDiagnosticsManager) self = user_data;
   g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  g_autoptr(GHashTable) by_file = NULL;
   g_autoptr(GError) error = NULL;
+  IdeDiagnosticsProviderState *state;
   IdeDiagnosticsGroup *group;
-  gboolean changed;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  gboolean changed = FALSE;
+  gboolean force;
+  gint64 cost;
 
   IDE_ENTRY;
 
@@ -328,17 +577,28 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   group = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP");
   g_assert (group != NULL);
 
-  /*
-   * Clear all of our old diagnostics no matter where they ended up.
-   */
-  changed = ide_diagnostics_manager_clear_by_provider (self, provider);
+  state = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_STATE");
+  g_assert (state != NULL);
+
+  cost = g_get_monotonic_time () - state->begin_time;
+  state->cost = state->cost ? (state->cost * 3 + cost) / 4 : cost;
+  state->in_diagnose = FALSE;
+
+  group->in_diagnose--;
+
+  force = state->diagnosed_changes != state->published_changes;
+  state->published_changes = state->diagnosed_changes;
 
   /*
-   * The following adds diagnostics to the appropriate group, but tries the
-   * group we belong to first as our fast path. That will almost always be
-   * the case, except when a diagnostic came up for a header or something
-   * while parsing a given file.
+   * Split the diagnostics by file. Most will be for the file of our group,
+   * except when a diagnostic came up for a header or something while
+   * parsing a given file.
    */
+  by_file = g_hash_table_new_full (g_file_hash,
+                                   (GEqualFunc)g_file_equal,
+                                   NULL,
+                                   free_diagnostics);
+
   if (diagnostics != NULL)
     {
       guint length = ide_diagnostics_get_size (diagnostics);
@@ -347,29 +607,58 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
         {
           IdeDiagnostic *diagnostic = ide_diagnostics_index (diagnostics, i);
           GFile *file = ide_diagnostic_get_file (diagnostic);
+          IdeDiagnostics *file_diagnostics;
+
+          if G_UNLIKELY (file == NULL)
+            continue;
 
-          if G_LIKELY (file != NULL)
+          if (NULL == (file_diagnostics = g_hash_table_lookup (by_file, file)))
             {
-              if G_LIKELY (g_file_equal (file, group->file))
-                ide_diagnostics_group_add (group, provider, diagnostic);
-              else
-                ide_diagnostics_manager_add_diagnostic (self, provider, diagnostic);
+              file_diagnostics = ide_diagnostics_new (NULL);
+              g_hash_table_insert (by_file, file, file_diagnostics);
             }
-        }
 
-      if (length > 0)
-        changed = TRUE;
+          ide_diagnostics_add (file_diagnostics, diagnostic);
+        }
     }
 
-  group->in_diagnose--;
-
   /*
-   * Ensure we increment our sequence number even when no diagnostics were
-   * reported. This ensures that the gutter gets cleared and line-flags
-   * cache updated.
+   * Only replace what actually changed since the last diagnosis. That keeps
+   * the sequence numbers stable for unchanged files so that buffers do not
+   * need to update their diagnostics.
    */
-  if (group->in_diagnose == 0)
-    group->sequence++;
+  g_hash_table_iter_init (&iter, self->groups_by_file);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      IdeDiagnosticsGroup *other = value;
+
+      if (ide_diagnostics_group_replace (other,
+                                         provider,
+                                         g_hash_table_lookup (by_file, other->file),
+                                         force && other == group))
+        {
+          ide_diagnostics_manager_update_model (self, other->file);
+          changed = TRUE;
+        }
+
+      g_hash_table_remove (by_file, other->file);
+    }
+
+  /* Anything left is for a file we are not tracking yet */
+  g_hash_table_iter_init (&iter, by_file);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      IdeDiagnosticsGroup *other;
+
+      other = ide_diagnostics_group_new (key);
+      g_hash_table_insert (self->groups_by_file, other->file, other);
+
+      ide_diagnostics_group_replace (other, provider, value, FALSE);
+      ide_diagnostics_manager_update_model (self, other->file);
+      changed = TRUE;
+    }
 
   /*
    * Since the individual groups have sequence numbers associated with changes,
@@ -381,16 +670,16 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
     g_signal_emit (self, signals [CHANGED], 0);
 
   /*
-   * If there are no more diagnostics providers active and the group needs
-   * another diagnosis, then we can start the next one now.
+   * If the buffer changed while we were diagnosing, schedule the next
+   * diagnosis for this provider now.
    *
    * If we are completing this diagnosis and the buffer was already released
    * (and other diagnose providers have unloaded), we might be able to clean
    * up the group and be done with things.
    */
-  if (group->was_removed == FALSE && group->in_diagnose == 0 && group->needs_diagnose)
+  if (group->was_removed == FALSE && group->adapter != NULL && state->ready_time != 0)
     {
-      ide_diagnostics_group_queue_diagnose (group, self);
+      ide_diagnostics_manager_schedule (self, state->ready_time);
     }
   else if (ide_diagnostics_group_can_dispose (group))
     {
@@ -403,27 +692,42 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
 }
 
 static void
-ide_diagnostics_group_diagnose_foreach (IdeExtensionSetAdapter *adapter,
-                                        PeasPluginInfo         *plugin_info,
-                                        PeasExtension          *exten,
-                                        gpointer                user_data)
+ide_diagnostics_group_diagnose (IdeDiagnosticsGroup   *group,
+                                IdeDiagnosticProvider *provider,
+                                IdeDiagnosticsManager *self)
 {
-  IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)exten;
-  IdeDiagnosticsManager *self = user_data;
-  IdeDiagnosticsGroup *group;
-  IdeContext *context;
+  IdeDiagnosticsProviderState *state;
+  g_autoptr(IdeBuffer) buffer = NULL;
   g_autoptr(IdeFile) file = NULL;
+  IdeContext *context;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
-  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
-  g_assert (plugin_info != NULL);
   g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (group != NULL);
+
+  state = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_STATE");
+
+  g_assert (state != NULL);
+  g_assert (state->in_diagnose == FALSE);
+
+  state->ready_time = 0;
+  state->in_diagnose = TRUE;
+  state->begin_time = g_get_monotonic_time ();
+  state->diagnosed_changes = group->n_changes;
 
-  group = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP");
   group->in_diagnose++;
 
+  /*
+   * We need to ensure that all the diagnostic providers have access to the
+   * proper data within the unsaved files. The content is cached by the
+   * buffer until it changes, so this is cheap for all but the first
+   * provider to be dispatched.
+   */
+  if (NULL != (buffer = g_weak_ref_get (&group->buffer_wr)))
+    ide_buffer_sync_to_unsaved_files (buffer);
+
   context = ide_object_get_context (IDE_OBJECT (self));
 
   file = g_object_new (IDE_TYPE_FILE,
@@ -444,39 +748,49 @@ ide_diagnostics_group_diagnose_foreach (IdeExtensionSetAdapter *adapter,
                                           NULL,
                                           ide_diagnostics_group_diagnose_cb,
                                           g_object_ref (self));
+
+  IDE_EXIT;
 }
 
-static void
-ide_diagnostics_group_diagnose (IdeDiagnosticsGroup   *group,
-                                IdeDiagnosticsManager *self)
+typedef struct
 {
-  g_autoptr(IdeBuffer) buffer = NULL;
-
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
-  g_assert (group != NULL);
-  g_assert (group->in_diagnose == FALSE);
-  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (group->adapter));
+  IdeDiagnosticsManager *self;
+  IdeDiagnosticsGroup   *group;
+  gint64                 now;
+  gint64                 next;
+  guint                  n_dispatched;
+} Dispatch;
 
-  group->needs_diagnose = FALSE;
-  group->has_diagnostics = FALSE;
+static void
+ide_diagnostics_group_dispatch_foreach (IdeExtensionSetAdapter *adapter,
+                                        PeasPluginInfo         *plugin_info,
+                                        PeasExtension          *exten,
+                                        gpointer                user_data)
+{
+  IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)exten;
+  IdeDiagnosticsProviderState *state;
+  Dispatch *dispatch = user_data;
 
-  /*
-   * We need to ensure that all the diagnostic providers have access to the
-   * proper data within the unsaved files. So sync the content once to avoid
-   * all providers from having to do this manually.
-   */
-  if (NULL != (buffer = g_weak_ref_get (&group->buffer_wr)))
-    ide_buffer_sync_to_unsaved_files (buffer);
+  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
+  g_assert (plugin_info != NULL);
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (dispatch != NULL);
 
-  ide_extension_set_adapter_foreach (group->adapter,
-                                     ide_diagnostics_group_diagnose_foreach,
-                                     self);
+  state = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_STATE");
 
-  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUSY]);
+  /* Running providers reschedule themselves upon completion */
+  if (state == NULL || state->ready_time == 0 || state->in_diagnose)
+    return;
 
-  IDE_EXIT;
+  if (state->ready_time <= dispatch->now)
+    {
+      ide_diagnostics_group_diagnose (dispatch->group, provider, dispatch->self);
+      dispatch->n_dispatched++;
+    }
+  else if (dispatch->next == 0 || state->ready_time < dispatch->next)
+    {
+      dispatch->next = state->ready_time;
+    }
 }
 
 static gboolean
@@ -485,6 +799,7 @@ ide_diagnostics_manager_begin_diagnose (gpointer data)
   IdeDiagnosticsManager *self = data;
   GHashTableIter iter;
   gpointer value;
+  Dispatch dispatch = { 0 };
 
   IDE_ENTRY;
 
@@ -492,40 +807,107 @@ ide_diagnostics_manager_begin_diagnose (gpointer data)
 
   self->queued_diagnose_source = 0;
 
+  dispatch.self = self;
+  dispatch.now = g_get_monotonic_time ();
+
   g_hash_table_iter_init (&iter, self->groups_by_file);
 
   while (g_hash_table_iter_next (&iter, NULL, &value))
     {
       IdeDiagnosticsGroup *group = value;
 
-      if (group->needs_diagnose && group->adapter != NULL)
-        ide_diagnostics_group_diagnose (group, self);
+      if (group->adapter != NULL)
+        {
+          dispatch.group = group;
+          ide_extension_set_adapter_foreach (group->adapter,
+                                             ide_diagnostics_group_dispatch_foreach,
+                                             &dispatch);
+        }
     }
 
+  if (dispatch.next != 0)
+    ide_diagnostics_manager_schedule (self, dispatch.next);
+
+  if (dispatch.n_dispatched > 0)
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUSY]);
+
   IDE_RETURN (G_SOURCE_REMOVE);
 }
 
 static void
-ide_diagnostics_group_queue_diagnose (IdeDiagnosticsGroup   *group,
-                                      IdeDiagnosticsManager *self)
+ide_diagnostics_manager_schedule (IdeDiagnosticsManager *self,
+                                  gint64                 ready_time)
 {
-  g_assert (group != NULL);
+  gint64 delay;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (ready_time > 0);
+
+  /* The pending timeout fires first and will reschedule for us */
+  if (self->queued_diagnose_source != 0 && self->queued_diagnose_time <= ready_time)
+    return;
+
+  ide_clear_source (&self->queued_diagnose_source);
+
+  delay = MAX (0, ready_time - g_get_monotonic_time ());
+
+  self->queued_diagnose_time = ready_time;
+  self->queued_diagnose_source =
+    gdk_threads_add_timeout_full (G_PRIORITY_DEFAULT,
+                                  (delay + 999) / 1000,
+                                  ide_diagnostics_manager_begin_diagnose,
+                                  g_object_ref (self),
+                                  g_object_unref);
+}
+
+static void
+ide_diagnostics_manager_queue_provider (IdeDiagnosticsManager *self,
+                                        IdeDiagnosticProvider *provider)
+{
+  IdeDiagnosticsProviderState *state;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+
+  state = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_STATE");
+
+  if (state == NULL)
+    return;
+
+  state->ready_time = g_get_monotonic_time () +
+                      CLAMP (state->cost, DEBOUNCE_MIN_USEC, DEBOUNCE_MAX_USEC);
 
   /*
-   * This checks to see if we are diagnosing and if not queues a diagnose.
    * If a diagnosis is already running, we don't need to do anything now
-   * because the completion of the diagnose will tick off the next diagnose
-   * upon seening group->needs_diagnose==TRUE.
+   * because the completion of the diagnose will schedule the next one
+   * upon seeing ready_time set.
    */
+  if (!state->in_diagnose)
+    ide_diagnostics_manager_schedule (self, state->ready_time);
+}
+
+static void
+ide_diagnostics_group_queue_foreach (IdeExtensionSetAdapter *adapter,
+                                     PeasPluginInfo         *plugin_info,
+                                     PeasExtension          *exten,
+                                     gpointer                user_data)
+{
+  ide_diagnostics_manager_queue_provider (user_data, (IdeDiagnosticProvider *)exten);
+}
+
+static void
+ide_diagnostics_group_queue_diagnose (IdeDiagnosticsGroup   *group,
+                                      IdeDiagnosticsManager *self)
+{
+  g_assert (group != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
 
-  group->needs_diagnose = TRUE;
+  group->needs_diagnose = FALSE;
 
-  if (group->in_diagnose == 0 && self->queued_diagnose_source == 0)
-    self->queued_diagnose_source =
-      gdk_threads_add_idle_full (G_PRIORITY_DEFAULT,
-                                 ide_diagnostics_manager_begin_diagnose,
-                                 g_object_ref (self),
-                                 g_object_unref);
+  if (group->adapter != NULL)
+    ide_extension_set_adapter_foreach (group->adapter,
+                                       ide_diagnostics_group_queue_foreach,
+                                       self);
 }
 
 static void
@@ -534,7 +916,11 @@ ide_diagnostics_manager_finalize (GObject *object)
   IdeDiagnosticsManager *self = (IdeDiagnosticsManager *)object;
 
   ide_clear_source (&self->queued_diagnose_source);
+  ide_clear_source (&self->workspace_dispatch_source);
   g_clear_pointer (&self->groups_by_file, g_hash_table_unref);
+  g_clear_pointer (&self->workspace_cache, g_hash_table_unref);
+  g_clear_pointer (&self->workspace_rows, g_hash_table_unref);
+  g_clear_object (&self->workspace_model);
 
   G_OBJECT_CLASS (ide_diagnostics_manager_parent_class)->finalize (object);
 }
@@ -596,58 +982,34 @@ ide_diagnostics_manager_init (IdeDiagnosticsManager *self)
                                                 (GEqualFunc)g_file_equal,
                                                 NULL,
                                                 (GDestroyNotify)ide_diagnostics_group_unref);
+  self->workspace_cache = g_hash_table_new_full (g_file_hash,
+                                                 (GEqualFunc)g_file_equal,
+                                                 g_object_unref,
+                                                 workspace_entry_free);
+  self->workspace_rows = g_hash_table_new_full (g_file_hash,
+                                                (GEqualFunc)g_file_equal,
+                                                g_object_unref,
+                                                (GDestroyNotify)g_array_unref);
 }
 
-static void
-ide_diagnostics_manager_add_diagnostic (IdeDiagnosticsManager *self,
-                                        IdeDiagnosticProvider *provider,
-                                        IdeDiagnostic         *diagnostic)
+static IdeDiagnosticsGroup *
+ide_diagnostics_manager_find_group_from_buffer (IdeDiagnosticsManager *self,
+                                                IdeBuffer             *buffer)
 {
   IdeDiagnosticsGroup *group;
-  GFile *file;
+  IdeFile *ifile;
+  GFile *gfile;
 
   g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
-  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
-  g_assert (diagnostic != NULL);
-
-  /*
-   * This is our slow path for adding a diagnostic to the system. We have
-   * to locate the proper group for the diagnostic and then insert it
-   * into that group.
-   */
-
-  if (NULL == (file = ide_diagnostic_get_file (diagnostic)))
-    return;
+  g_assert (IDE_IS_BUFFER (buffer));
 
-  group = g_hash_table_lookup (self->groups_by_file, file);
+  ifile = ide_buffer_get_file (buffer);
+  gfile = ide_file_get_file (ifile);
+  group = g_hash_table_lookup (self->groups_by_file, gfile);
 
   if (group == NULL)
     {
-      group = ide_diagnostics_group_new (file);
-      g_hash_table_insert (self->groups_by_file, group->file, group);
-    }
-
-  ide_diagnostics_group_add (group, provider, diagnostic);
-}
-
-static IdeDiagnosticsGroup *
-ide_diagnostics_manager_find_group_from_buffer (IdeDiagnosticsManager *self,
-                                                IdeBuffer             *buffer)
-{
-  IdeDiagnosticsGroup *group;
-  IdeFile *ifile;
-  GFile *gfile;
-
-  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
-  g_assert (IDE_IS_BUFFER (buffer));
-
-  ifile = ide_buffer_get_file (buffer);
-  gfile = ide_file_get_file (ifile);
-  group = g_hash_table_lookup (self->groups_by_file, gfile);
-
-  if (group == NULL)
-    {
-      group = ide_diagnostics_group_new (gfile);
+      group = ide_diagnostics_group_new (gfile);
       g_hash_table_insert (self->groups_by_file, group->file, group);
     }
 
@@ -692,9 +1054,7 @@ ide_diagnostics_manager_provider_invalidated (IdeDiagnosticsManager *self,
   g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
   g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
 
-  group = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP");
-
-  ide_diagnostics_group_queue_diagnose (group, self);
+  ide_diagnostics_manager_queue_provider (self, provider);
 
   IDE_EXIT;
 }
@@ -728,6 +1088,11 @@ ide_diagnostics_manager_extension_added (IdeExtensionSetAdapter *adapter,
                           ide_diagnostics_group_ref (group),
                           (GDestroyNotify)ide_diagnostics_group_unref);
 
+  g_object_set_data_full (G_OBJECT (provider),
+                          "IDE_DIAGNOSTICS_STATE",
+                          g_slice_new0 (IdeDiagnosticsProviderState),
+                          provider_state_free);
+
   /*
    * We insert a dummy entry into the hashtable upon creation so
    * that when an async diagnosis completes we can use the presence
@@ -747,7 +1112,7 @@ ide_diagnostics_manager_extension_added (IdeExtensionSetAdapter *adapter,
 
   ide_diagnostic_provider_load (provider);
 
-  ide_diagnostics_group_queue_diagnose (group, self);
+  ide_diagnostics_manager_queue_provider (self, provider);
 
   IDE_EXIT;
 }
@@ -836,7 +1201,39 @@ ide_diagnostics_manager_buffer_changed (IdeDiagnosticsManager *self,
   g_assert (IDE_IS_BUFFER (buffer));
 
   group = ide_diagnostics_manager_find_group_from_buffer (self, buffer);
-  ide_diagnostics_group_queue_diagnose (group, self);
+  group->n_changes++;
+
+  /*
+   * If the buffer is frozen, just note that we need to diagnose and wait
+   * for the buffer to be thawed before queuing it.
+   */
+  if (ide_buffer_get_changes_frozen (buffer))
+    group->needs_diagnose = TRUE;
+  else
+    ide_diagnostics_group_queue_diagnose (group, self);
+
+  IDE_EXIT;
+}
+
+static void
+ide_diagnostics_manager_buffer_notify_changes_frozen (IdeDiagnosticsManager *self,
+                                                      GParamSpec            *pspec,
+                                                      IdeBuffer             *buffer)
+{
+  IdeDiagnosticsGroup *group;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (ide_buffer_get_changes_frozen (buffer))
+    IDE_EXIT;
+
+  group = ide_diagnostics_manager_find_group_from_buffer (self, buffer);
+
+  if (group->needs_diagnose)
+    ide_diagnostics_group_queue_diagnose (group, self);
 
   IDE_EXIT;
 }
@@ -974,6 +1371,12 @@ ide_diagnostics_manager_buffer_loaded (IdeDiagnosticsManager *self,
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (buffer,
+                           "notify::changes-frozen",
+                           G_CALLBACK (ide_diagnostics_manager_buffer_notify_changes_frozen),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   g_signal_connect_object (buffer,
                            "notify::file",
                            G_CALLBACK (ide_diagnostics_manager_buffer_notify_file),
@@ -999,6 +1402,12 @@ ide_diagnostics_manager_buffer_loaded (IdeDiagnosticsManager *self,
 
   g_weak_ref_init (&group->buffer_wr, buffer);
 
+  /*
+   * The buffer is diagnosed from now on, and may be modified, so the
+   * result of a previous workspace scan no longer applies.
+   */
+  g_hash_table_remove (self->workspace_cache, gfile);
+
   language = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (buffer));
 
   if (language != NULL)
@@ -1089,6 +1498,10 @@ ide_diagnostics_manager_buffer_unloaded (IdeDiagnosticsManager *self,
                                         G_CALLBACK (ide_diagnostics_manager_buffer_changed),
                                         self);
 
+  g_signal_handlers_disconnect_by_func (buffer,
+                                        G_CALLBACK (ide_diagnostics_manager_buffer_notify_changes_frozen),
+                                        self);
+
   g_signal_handlers_disconnect_by_func (buffer,
                                         G_CALLBACK (ide_diagnostics_manager_buffer_notify_file),
                                         self);
@@ -1101,6 +1514,8 @@ ide_diagnostics_manager_buffer_unloaded (IdeDiagnosticsManager *self,
 
   group->has_diagnostics = has_diagnostics;
 
+  ide_diagnostics_manager_update_model (self, group->file);
+
   IDE_EXIT;
 }
 
@@ -1253,3 +1668,758 @@ ide_diagnostics_manager_get_sequence_for_file (IdeDiagnosticsManager *self,
 
   return 0;
 }
+
+static gboolean
+ide_diagnostics_group_has_buffer (IdeDiagnosticsGroup *group)
+{
+  g_autoptr(IdeBuffer) buffer = NULL;
+
+  g_assert (group != NULL);
+
+  buffer = g_weak_ref_get (&group->buffer_wr);
+
+  return buffer != NULL;
+}
+
+static void
+ide_diagnostics_manager_update_model (IdeDiagnosticsManager *self,
+                                      GFile                 *file)
+{
+  g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  IdeDiagnosticsGroup *group;
+  WorkspaceEntry *entry;
+  GArray *rows;
+  guint length;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (G_IS_FILE (file));
+
+  if (self->workspace_model == NULL)
+    return;
+
+  group = g_hash_table_lookup (self->groups_by_file, file);
+  entry = g_hash_table_lookup (self->workspace_cache, file);
+
+  /*
+   * Diagnostics of open buffers are more recent than those of the
+   * workspace scan, so prefer them whenever we have them.
+   */
+  if (entry == NULL ||
+      (group != NULL &&
+       (group->has_diagnostics || ide_diagnostics_group_has_buffer (group))))
+    diagnostics = ide_diagnostics_manager_get_diagnostics_for_file (self, file);
+  else
+    diagnostics = ide_diagnostics_ref (entry->diagnostics);
+
+  if (NULL != (rows = g_hash_table_lookup (self->workspace_rows, file)))
+    {
+      for (guint i = 0; i < rows->len; i++)
+        gtk_list_store_remove (self->workspace_model,
+                               &g_array_index (rows, GtkTreeIter, i));
+      g_hash_table_remove (self->workspace_rows, file);
+    }
+
+  length = ide_diagnostics_get_size (diagnostics);
+
+  if (length == 0)
+    return;
+
+  rows = g_array_sized_new (FALSE, FALSE, sizeof (GtkTreeIter), length);
+
+  for (guint i = 0; i < length; i++)
+    {
+      IdeDiagnostic *diagnostic = ide_diagnostics_index (diagnostics, i);
+      IdeSourceLocation *location = ide_diagnostic_get_location (diagnostic);
+      GtkTreeIter iter;
+
+      gtk_list_store_insert_with_values (self->workspace_model, &iter, -1,
+                                         IDE_DIAGNOSTICS_MANAGER_COLUMN_DIAGNOSTIC, diagnostic,
+                                         IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, file,
+                                         IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY, ide_diagnostic_get_severity (diagnostic),
+                                         IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, location ? ide_source_location_get_line (location) : 0,
+                                         IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT, ide_diagnostic_get_text (diagnostic),
+                                         -1);
+      g_array_append_val (rows, iter);
+    }
+
+  g_hash_table_insert (self->workspace_rows, g_object_ref (file), rows);
+}
+
+/**
+ * ide_diagnostics_manager_get_workspace_model:
+ * @self: An #IdeDiagnosticsManager
+ *
+ * Gets a model containing the diagnostics of every file in the project,
+ * one row per diagnostic, with the columns described by
+ * #IdeDiagnosticsManagerColumn. It contains the diagnostics of open
+ * buffers and the results of ide_diagnostics_manager_diagnose_workspace_async(),
+ * and is updated as either changes.
+ *
+ * The model implements #GtkTreeSortable, and may be wrapped in a
+ * #GtkTreeModelFilter to filter by severity or file.
+ *
+ * Returns: (transfer none): A #GtkTreeModel.
+ */
+GtkTreeModel *
+ide_diagnostics_manager_get_workspace_model (IdeDiagnosticsManager *self)
+{
+  g_return_val_if_fail (IDE_IS_DIAGNOSTICS_MANAGER (self), NULL);
+
+  if (self->workspace_model == NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+
+      self->workspace_model = gtk_list_store_new (IDE_DIAGNOSTICS_MANAGER_N_COLUMNS,
+                                                  IDE_TYPE_DIAGNOSTIC,
+                                                  G_TYPE_FILE,
+                                                  G_TYPE_INT,
+                                                  G_TYPE_UINT,
+                                                  G_TYPE_STRING);
+
+      g_hash_table_iter_init (&iter, self->groups_by_file);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        ide_diagnostics_manager_update_model (self, key);
+
+      g_hash_table_iter_init (&iter, self->workspace_cache);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          if (!g_hash_table_contains (self->groups_by_file, key))
+            ide_diagnostics_manager_update_model (self, key);
+        }
+    }
+
+  return GTK_TREE_MODEL (self->workspace_model);
+}
+
+static void
+ide_diagnostics_manager_workspace_complete (IdeDiagnosticsManager *self,
+                                            GTask                 *task,
+                                            GError                *error)
+{
+  g_autoptr(GTask) owned = NULL;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (G_IS_TASK (task));
+
+  /* Already completed, such as due to cancellation */
+  if (self->workspace_task != task)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
+  owned = g_steal_pointer (&self->workspace_task);
+  ide_clear_source (&self->workspace_dispatch_source);
+
+  if (error != NULL)
+    g_task_return_error (owned, error);
+  else
+    g_task_return_boolean (owned, TRUE);
+}
+
+static gboolean ide_diagnostics_manager_workspace_dispatch (gpointer data);
+
+static void
+ide_diagnostics_manager_workspace_queue_dispatch (IdeDiagnosticsManager *self)
+{
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  if (self->workspace_task == NULL || self->workspace_dispatch_source != 0)
+    return;
+
+  self->workspace_dispatch_source =
+    g_idle_add_full (G_PRIORITY_LOW,
+                     ide_diagnostics_manager_workspace_dispatch,
+                     g_object_ref (self),
+                     g_object_unref);
+}
+
+static void
+ide_diagnostics_manager_workspace_file_done (FileScan *fs)
+{
+  IdeDiagnosticsManager *self = fs->self;
+  WorkspaceScan *scan;
+
+  g_assert (fs != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  scan = g_task_get_task_data (fs->task);
+  scan->in_flight--;
+
+  if (self->workspace_task == fs->task)
+    {
+      GError *error = NULL;
+
+      if (g_cancellable_set_error_if_cancelled (g_task_get_cancellable (fs->task), &error))
+        ide_diagnostics_manager_workspace_complete (self, fs->task, error);
+      else
+        ide_diagnostics_manager_workspace_queue_dispatch (self);
+    }
+
+  file_scan_free (fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_provider_done (FileScan *fs)
+{
+  IdeDiagnosticsManager *self = fs->self;
+  WorkspaceEntry *entry;
+  WorkspaceEntry *old;
+  gboolean changed;
+  GFile *file;
+
+  g_assert (fs != NULL);
+  g_assert (fs->n_pending > 0);
+
+  if (--fs->n_pending > 0)
+    return;
+
+  /*
+   * Even if the scan was cancelled in the mean time, the result is valid
+   * for the contents we hashed and saves work for the next scan.
+   */
+  file = ide_file_get_file (fs->file);
+
+  entry = g_slice_new0 (WorkspaceEntry);
+  entry->key = g_steal_pointer (&fs->key);
+  entry->diagnostics = g_steal_pointer (&fs->diagnostics);
+
+  old = g_hash_table_lookup (self->workspace_cache, file);
+  changed = !diagnostics_equal (old ? old->diagnostics : NULL, entry->diagnostics);
+
+  g_hash_table_insert (self->workspace_cache, g_object_ref (file), entry);
+
+  if (changed)
+    {
+      ide_diagnostics_manager_update_model (self, file);
+      g_signal_emit (self, signals [CHANGED], 0);
+    }
+
+  ide_diagnostics_manager_workspace_file_done (fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_diagnose_cb (GObject      *object,
+                                               GAsyncResult *result,
+                                               gpointer      user_data)
+{
+  IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)object;
+  g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  g_autoptr(GError) error = NULL;
+  FileScan *fs = user_data;
+
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (fs != NULL);
+
+  diagnostics = ide_diagnostic_provider_diagnose_finish (provider, result, &error);
+
+  if (error != NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("%s", error->message);
+
+  /*
+   * Diagnostics for other files, such as headers, are dropped. Those
+   * files are scanned on their own.
+   */
+  if (diagnostics != NULL)
+    {
+      GFile *file = ide_file_get_file (fs->file);
+      guint length = ide_diagnostics_get_size (diagnostics);
+
+      for (guint i = 0; i < length; i++)
+        {
+          IdeDiagnostic *diagnostic = ide_diagnostics_index (diagnostics, i);
+          GFile *diagnostic_file = ide_diagnostic_get_file (diagnostic);
+
+          if (diagnostic_file != NULL && g_file_equal (diagnostic_file, file))
+            ide_diagnostics_add (fs->diagnostics, diagnostic);
+        }
+    }
+
+  ide_diagnostics_manager_workspace_provider_done (fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_diagnose_foreach (IdeExtensionSetAdapter *adapter,
+                                                    PeasPluginInfo         *plugin_info,
+                                                    PeasExtension          *exten,
+                                                    gpointer                user_data)
+{
+  IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)exten;
+  FileScan *fs = user_data;
+
+  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (fs != NULL);
+
+  fs->n_pending++;
+
+  ide_diagnostic_provider_diagnose_async (provider,
+                                          fs->file,
+                                          g_task_get_cancellable (fs->task),
+                                          ide_diagnostics_manager_workspace_diagnose_cb,
+                                          fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_get_build_flags_cb (GObject      *object,
+                                                      GAsyncResult *result,
+                                                      gpointer      user_data)
+{
+  IdeBuildSystem *build_system = (IdeBuildSystem *)object;
+  g_autoptr(GChecksum) checksum = NULL;
+  g_auto(GStrv) flags = NULL;
+  WorkspaceEntry *entry;
+  FileScan *fs = user_data;
+
+  g_assert (IDE_IS_BUILD_SYSTEM (build_system));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (fs != NULL);
+
+  /* Not every build system provides flags, which is fine for the key */
+  flags = ide_build_system_get_build_flags_finish (build_system, result, NULL);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guchar *)fs->content_hash, -1);
+
+  for (guint i = 0; flags != NULL && flags [i] != NULL; i++)
+    {
+      /* Include the terminator so that flags cannot run together */
+      g_checksum_update (checksum, (const guchar *)flags [i], strlen (flags [i]) + 1);
+    }
+
+  fs->key = g_strdup (g_checksum_get_string (checksum));
+
+  entry = g_hash_table_lookup (fs->self->workspace_cache, ide_file_get_file (fs->file));
+
+  if (entry != NULL && g_strcmp0 (entry->key, fs->key) == 0)
+    {
+      IDE_TRACE_MSG ("Reusing diagnostics for unchanged file");
+      ide_diagnostics_manager_workspace_file_done (fs);
+      return;
+    }
+
+  fs->diagnostics = ide_diagnostics_new (NULL);
+
+  /* Hold a pending operation so providers completing early do not finish us */
+  fs->n_pending = 1;
+  ide_extension_set_adapter_foreach (fs->adapter,
+                                     ide_diagnostics_manager_workspace_diagnose_foreach,
+                                     fs);
+  ide_diagnostics_manager_workspace_provider_done (fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_hash_worker (GTask        *task,
+                                               gpointer      source_object,
+                                               gpointer      task_data,
+                                               GCancellable *cancellable)
+{
+  GFile *file = task_data;
+  g_autofree gchar *contents = NULL;
+  GError *error = NULL;
+  gsize len = 0;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (G_IS_FILE (file));
+
+  if (!g_file_load_contents (file, cancellable, &contents, &len, NULL, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task,
+                           g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *)contents, len),
+                           g_free);
+}
+
+static void
+ide_diagnostics_manager_workspace_hash_cb (GObject      *object,
+                                           GAsyncResult *result,
+                                           gpointer      user_data)
+{
+  IdeDiagnosticsManager *self = (IdeDiagnosticsManager *)object;
+  IdeBuildSystem *build_system;
+  IdeContext *context;
+  FileScan *fs = user_data;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (fs != NULL);
+
+  fs->content_hash = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  /* The file may have been removed since we enumerated it */
+  if (fs->content_hash == NULL)
+    {
+      ide_diagnostics_manager_workspace_file_done (fs);
+      return;
+    }
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+
+  ide_build_system_get_build_flags_async (build_system,
+                                          fs->file,
+                                          g_task_get_cancellable (fs->task),
+                                          ide_diagnostics_manager_workspace_get_build_flags_cb,
+                                          fs);
+}
+
+static void
+ide_diagnostics_manager_workspace_extension_added (IdeExtensionSetAdapter *adapter,
+                                                   PeasPluginInfo         *plugin_info,
+                                                   PeasExtension          *exten,
+                                                   gpointer                user_data)
+{
+  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (exten));
+
+  ide_diagnostic_provider_load (IDE_DIAGNOSTIC_PROVIDER (exten));
+}
+
+static gboolean
+ide_diagnostics_manager_workspace_dispatch (gpointer data)
+{
+  IdeDiagnosticsManager *self = data;
+  WorkspaceScan *scan;
+  IdeContext *context;
+  GError *error = NULL;
+  GTask *task;
+  guint n_skipped = 0;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  self->workspace_dispatch_source = 0;
+
+  if (NULL == (task = self->workspace_task))
+    IDE_RETURN (G_SOURCE_REMOVE);
+
+  if (g_cancellable_set_error_if_cancelled (g_task_get_cancellable (task), &error))
+    {
+      ide_diagnostics_manager_workspace_complete (self, task, error);
+      IDE_RETURN (G_SOURCE_REMOVE);
+    }
+
+  scan = g_task_get_task_data (task);
+  context = ide_object_get_context (IDE_OBJECT (self));
+
+  while (scan->files->len > 0 &&
+         scan->in_flight < scan->max_in_flight &&
+         n_skipped < WORKSPACE_MAX_SKIP_PER_DISPATCH)
+    {
+      GFile *file = g_ptr_array_index (scan->files, scan->files->len - 1);
+      g_autoptr(IdeFile) ifile = NULL;
+      IdeExtensionSetAdapter *adapter;
+      IdeDiagnosticsGroup *group;
+      GtkSourceLanguage *language;
+      const gchar *language_id;
+      FileScan *fs;
+      GTask *hash_task;
+
+      /* Open buffers are diagnosed as they change */
+      group = g_hash_table_lookup (self->groups_by_file, file);
+
+      if (group != NULL && ide_diagnostics_group_has_buffer (group))
+        {
+          g_ptr_array_remove_index (scan->files, scan->files->len - 1);
+          n_skipped++;
+          continue;
+        }
+
+      ifile = ide_file_new (context, file);
+      language = ide_file_get_language (ifile);
+
+      if (language == NULL)
+        {
+          g_ptr_array_remove_index (scan->files, scan->files->len - 1);
+          n_skipped++;
+          continue;
+        }
+
+      language_id = gtk_source_language_get_id (language);
+      adapter = g_hash_table_lookup (scan->adapters, language_id);
+
+      if (adapter == NULL)
+        {
+          /*
+           * The adapter loads its extensions from the main loop, so leave
+           * the file in place and come back once that has happened.
+           */
+          adapter = ide_extension_set_adapter_new (context,
+                                                   peas_engine_get_default (),
+                                                   IDE_TYPE_DIAGNOSTIC_PROVIDER,
+                                                   "Diagnostic-Provider-Languages",
+                                                   language_id);
+          g_signal_connect (adapter,
+                            "extension-added",
+                            G_CALLBACK (ide_diagnostics_manager_workspace_extension_added),
+                            NULL);
+          g_hash_table_insert (scan->adapters, g_strdup (language_id), adapter);
+          break;
+        }
+
+      g_ptr_array_remove_index (scan->files, scan->files->len - 1);
+
+      if (ide_extension_set_adapter_get_n_extensions (adapter) == 0)
+        {
+          n_skipped++;
+          continue;
+        }
+
+      fs = g_slice_new0 (FileScan);
+      fs->self = g_object_ref (self);
+      fs->task = g_object_ref (task);
+      fs->file = g_steal_pointer (&ifile);
+      fs->adapter = g_object_ref (adapter);
+
+      scan->in_flight++;
+
+      hash_task = g_task_new (self,
+                              g_task_get_cancellable (task),
+                              ide_diagnostics_manager_workspace_hash_cb,
+                              fs);
+      g_task_set_priority (hash_task, G_PRIORITY_LOW);
+      g_task_set_task_data (hash_task,
+                            g_object_ref (ide_file_get_file (fs->file)),
+                            g_object_unref);
+      ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER,
+                                 hash_task,
+                                 ide_diagnostics_manager_workspace_hash_worker);
+      g_object_unref (hash_task);
+    }
+
+  if (scan->files->len == 0 && scan->in_flight == 0)
+    ide_diagnostics_manager_workspace_complete (self, task, NULL);
+  else if (scan->files->len > 0 && scan->in_flight < scan->max_in_flight)
+    ide_diagnostics_manager_workspace_queue_dispatch (self);
+
+  IDE_RETURN (G_SOURCE_REMOVE);
+}
+
+static void
+ide_diagnostics_manager_workspace_collect (IdeVcs       *vcs,
+                                           GFile        *directory,
+                                           GPtrArray    *found,
+                                           GCancellable *cancellable)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  g_autofree gboolean *ignored = NULL;
+  gpointer file_info_ptr;
+
+  g_assert (IDE_IS_VCS (vcs));
+  g_assert (G_IS_FILE (directory));
+  g_assert (found != NULL);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return;
+
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+  children = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) file_info = file_info_ptr;
+      const gchar *name = g_file_info_get_name (file_info);
+
+      /* Skip .git, .flatpak-builder and friends */
+      if (name [0] == '.')
+        continue;
+
+      switch (g_file_info_get_file_type (file_info))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+          g_ptr_array_add (children, g_file_get_child (directory, name));
+          break;
+
+        case G_FILE_TYPE_REGULAR:
+          g_ptr_array_add (files, g_file_get_child (directory, name));
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  ignored = g_new0 (gboolean, files->len);
+
+  if (ide_vcs_is_ignored_many (vcs, (GFile **)files->pdata, files->len, ignored, NULL))
+    {
+      for (guint i = 0; i < files->len; i++)
+        {
+          if (!ignored [i])
+            g_ptr_array_add (found, g_object_ref (g_ptr_array_index (files, i)));
+        }
+    }
+
+  for (guint i = 0; i < children->len; i++)
+    {
+      GFile *child = g_ptr_array_index (children, i);
+
+      if (!ide_vcs_is_ignored (vcs, child, NULL))
+        ide_diagnostics_manager_workspace_collect (vcs, child, found, cancellable);
+    }
+}
+
+static void
+ide_diagnostics_manager_workspace_enumerate_worker (GTask        *task,
+                                                    gpointer      source_object,
+                                                    gpointer      task_data,
+                                                    GCancellable *cancellable)
+{
+  IdeVcs *vcs = task_data;
+  g_autoptr(GPtrArray) found = NULL;
+  GFile *workdir;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_VCS (vcs));
+
+  workdir = ide_vcs_get_working_directory (vcs);
+  found = g_ptr_array_new_with_free_func (g_object_unref);
+
+  ide_diagnostics_manager_workspace_collect (vcs, workdir, found, cancellable);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  g_task_return_pointer (task, g_steal_pointer (&found), (GDestroyNotify)g_ptr_array_unref);
+}
+
+static void
+ide_diagnostics_manager_workspace_enumerate_cb (GObject      *object,
+                                                GAsyncResult *result,
+                                                gpointer      user_data)
+{
+  IdeDiagnosticsManager *self = (IdeDiagnosticsManager *)object;
+  g_autoptr(GTask) task = user_data;
+  WorkspaceScan *scan;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  scan = g_task_get_task_data (task);
+  scan->files = g_task_propagate_pointer (G_TASK (result), &error);
+
+  if (scan->files == NULL)
+    {
+      ide_diagnostics_manager_workspace_complete (self, task, error);
+      IDE_EXIT;
+    }
+
+  IDE_TRACE_MSG ("Scanning %u files for diagnostics", scan->files->len);
+
+  ide_diagnostics_manager_workspace_queue_dispatch (self);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_diagnostics_manager_diagnose_workspace_async:
+ * @self: An #IdeDiagnosticsManager
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Runs the diagnostic providers over every file of the project that is
+ * not ignored by the version control system, at low priority. Only a
+ * few files are diagnosed at a time so that the diagnostics of open
+ * buffers remain responsive.
+ *
+ * Results are cached by the contents of the file and its build flags, so
+ * that scanning again only diagnoses the files that changed. The results
+ * are available from ide_diagnostics_manager_get_workspace_model() as
+ * they arrive.
+ *
+ * Only one scan may run at a time, a second request fails with
+ * %G_IO_ERROR_PENDING.
+ */
+void
+ide_diagnostics_manager_diagnose_workspace_async (IdeDiagnosticsManager *self,
+                                                  GCancellable          *cancellable,
+                                                  GAsyncReadyCallback    callback,
+                                                  gpointer               user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) enumerate_task = NULL;
+  WorkspaceScan *scan;
+  IdeContext *context;
+  IdeVcs *vcs;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (self->workspace_task != NULL)
+    {
+      g_task_report_new_error (self, callback, user_data,
+                               ide_diagnostics_manager_diagnose_workspace_async,
+                               G_IO_ERROR,
+                               G_IO_ERROR_PENDING,
+                               "A workspace diagnosis is already in progress");
+      IDE_EXIT;
+    }
+
+  scan = g_slice_new0 (WorkspaceScan);
+  scan->adapters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  scan->max_in_flight = MAX (1, ide_thread_pool_get_max_threads (IDE_THREAD_POOL_COMPILER) / 2);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_diagnostics_manager_diagnose_workspace_async);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_set_task_data (task, scan, workspace_scan_free);
+
+  self->workspace_task = g_object_ref (task);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  vcs = ide_context_get_vcs (context);
+
+  enumerate_task = g_task_new (self,
+                               cancellable,
+                               ide_diagnostics_manager_workspace_enumerate_cb,
+                               g_object_ref (task));
+  g_task_set_priority (enumerate_task, G_PRIORITY_LOW);
+  g_task_set_task_data (enumerate_task, g_object_ref (vcs), g_object_unref);
+  g_task_run_in_thread (enumerate_task, ide_diagnostics_manager_workspace_enumerate_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_diagnostics_manager_diagnose_workspace_finish:
+ * @self: An #IdeDiagnosticsManager
+ * @result: A #GAsyncResult provided to the callback
+ * @error: A location for a #GError, or %NULL
+ *
+ * Completes an asynchronous request to
+ * ide_diagnostics_manager_diagnose_workspace_async().
+ *
+ * Returns: %TRUE if every file was scanned; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_diagnostics_manager_diagnose_workspace_finish (IdeDiagnosticsManager  *self,
+                                                   GAsyncResult           *result,
+                                                   GError                **error)
+{
+  g_return_val_if_fail (IDE_IS_DIAGNOSTICS_MANAGER (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
@@ -19,7 +19,7 @@
 #ifndef IDE_DIAGNOSTICS_MANAGER_H
 #define IDE_DIAGNOSTICS_MANAGER_H
 
-#include <gio/gio.h>
+#include <gtk/gtk.h>
 
 #include "ide-object.h"
 
@@ -29,6 +29,26 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (IdeDiagnosticsManager, ide_diagnostics_manager, IDE, DIAGNOSTICS_MANAGER, IdeObject)
 
+/**
+ * IdeDiagnosticsManagerColumn:
+ * @IDE_DIAGNOSTICS_MANAGER_COLUMN_DIAGNOSTIC: the #IdeDiagnostic
+ * @IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE: the #GFile of the diagnostic
+ * @IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY: the #IdeDiagnosticSeverity, as an int
+ * @IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE: the zero-based line of the diagnostic
+ * @IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT: the message of the diagnostic
+ *
+ * The columns of ide_diagnostics_manager_get_workspace_model().
+ */
+typedef enum
+{
+  IDE_DIAGNOSTICS_MANAGER_COLUMN_DIAGNOSTIC,
+  IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE,
+  IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY,
+  IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE,
+  IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT,
+  IDE_DIAGNOSTICS_MANAGER_N_COLUMNS
+} IdeDiagnosticsManagerColumn;
+
 gboolean        ide_diagnostics_manager_get_busy                 (IdeDiagnosticsManager *self);
 IdeDiagnostics *ide_diagnostics_manager_get_diagnostics_for_file (IdeDiagnosticsManager *self,
                                                                   GFile                 *file);
@@ -37,6 +57,14 @@ guint           ide_diagnostics_manager_get_sequence_for_file    (IdeDiagnostics
 void            ide_diagnostics_manager_update_group_by_file     (IdeDiagnosticsManager *self,
                                                                   IdeBuffer             *buffer,
                                                                   GFile                 *new_file);
+void            ide_diagnostics_manager_diagnose_workspace_async (IdeDiagnosticsManager *self,
+                                                                  GCancellable          *cancellable,
+                                                                  GAsyncReadyCallback    callback,
+                                                                  gpointer               user_data);
+gboolean        ide_diagnostics_manager_diagnose_workspace_finish (IdeDiagnosticsManager *self,
+                                                                   GAsyncResult          *result,
+                                                                   GError               **error);
+GtkTreeModel   *ide_diagnostics_manager_get_workspace_model      (IdeDiagnosticsManager *self);
 
 G_END_DECLS
 
@@ -385,6 +385,10 @@ ide_highlight_engine_queue_work (IdeHighlightEngine *self)
   if ((self->highlighter == NULL) || (self->buffer == NULL) || (self->work_timeout != 0))
     return;
 
+  /* Picked up when the buffer is thawed. */
+  if (ide_buffer_get_changes_frozen (self->buffer))
+    return;
+
   self->work_timeout =  gdk_threads_add_idle_full (G_PRIORITY_LOW,
                                                    ide_highlight_engine_work_timeout_handler,
                                                    self,
@@ -586,6 +590,18 @@ ide_highlight_engine__notify_language_cb (IdeHighlightEngine *self,
   ide_extension_adapter_set_value (self->extension, lang_id);
 }
 
+static void
+ide_highlight_engine__notify_changes_frozen_cb (IdeHighlightEngine *self,
+                                               GParamSpec         *pspec,
+                                               IdeBuffer          *buffer)
+{
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (!ide_buffer_get_changes_frozen (buffer))
+    ide_highlight_engine_queue_work (self);
+}
+
 static void
 ide_highlight_engine__notify_style_scheme_cb (IdeHighlightEngine *self,
                                               GParamSpec         *pspec,
@@ -902,6 +918,12 @@ ide_highlight_engine_init (IdeHighlightEngine *self)
                                    self,
                                    G_CONNECT_SWAPPED);
 
+  egg_signal_group_connect_object (self->signal_group,
+                                   "notify::changes-frozen",
+                                   G_CALLBACK (ide_highlight_engine__notify_changes_frozen_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED);
+
   g_signal_connect_object (self->signal_group,
                            "bind",
                            G_CALLBACK (ide_highlight_engine__bind_buffer_cb),
@@ -41,6 +41,9 @@ struct _IdeHighlightIndex
 
   GStringChunk  *strings;
   GHashTable    *index;
+
+  /* Indexes we borrow keys from, see ide_highlight_index_merge() */
+  GPtrArray     *merged;
 };
 
 IdeHighlightIndex *
@@ -101,6 +104,44 @@ ide_highlight_index_lookup (IdeHighlightIndex *self,
   return g_hash_table_lookup (self->index, word);
 }
 
+/**
+ * ide_highlight_index_merge:
+ * @self: An #IdeHighlightIndex.
+ * @other: An #IdeHighlightIndex that will no longer be modified.
+ *
+ * Adds the words of @other to @self, keeping the tag of words that are
+ * already in @self. The strings are borrowed from @other rather than copied,
+ * which makes it cheap to share a large index, such as the declarations
+ * of a common header, between many indexes. Lookups still only probe @self.
+ */
+void
+ide_highlight_index_merge (IdeHighlightIndex *self,
+                           IdeHighlightIndex *other)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  g_assert (self);
+  g_assert (other);
+  g_assert (self != other);
+
+  if (self->merged == NULL)
+    self->merged = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_highlight_index_unref);
+  g_ptr_array_add (self->merged, ide_highlight_index_ref (other));
+
+  g_hash_table_iter_init (&iter, other->index);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!g_hash_table_contains (self->index, key))
+        {
+          g_hash_table_insert (self->index, key, value);
+          self->count++;
+        }
+    }
+}
+
 IdeHighlightIndex *
 ide_highlight_index_ref (IdeHighlightIndex *self)
 {
@@ -119,6 +160,7 @@ ide_highlight_index_finalize (IdeHighlightIndex *self)
 
   g_string_chunk_free (self->strings);
   g_hash_table_unref (self->index);
+  g_clear_pointer (&self->merged, g_ptr_array_unref);
   g_free (self);
 
   EGG_COUNTER_DEC (instances);
@@ -36,6 +36,8 @@ void               ide_highlight_index_insert   (IdeHighlightIndex *self,
                                                  gpointer           tag);
 gpointer           ide_highlight_index_lookup   (IdeHighlightIndex *self,
                                                  const gchar       *word);
+void               ide_highlight_index_merge    (IdeHighlightIndex *self,
+                                                 IdeHighlightIndex *other);
 void               ide_highlight_index_dump     (IdeHighlightIndex *self);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeHighlightIndex, ide_highlight_index_unref)
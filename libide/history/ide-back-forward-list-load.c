@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ide-context.h"
 #include "ide-debug.h"
@@ -27,64 +28,138 @@
 #include "history/ide-back-forward-item.h"
 #include "history/ide-back-forward-list.h"
 #include "history/ide-back-forward-list-private.h"
+#include "threading/ide-thread-pool.h"
+
+/*
+ * Only the most recent records are parsed, the list would prune the rest
+ * anyway. Older records are dropped when the log is compacted.
+ */
+#define MAX_LOAD_RECORDS 200
+
+typedef struct
+{
+  GFile     *file;
+  GPtrArray *uris;
+  guint      n_records;
+  guint      needs_compact : 1;
+} IdeBackForwardListLoad;
 
 static void
-ide_back_forward_list_load_cb (GObject      *object,
-                               GAsyncResult *result,
-                               gpointer      user_data)
+ide_back_forward_list_load_free (gpointer data)
 {
-  g_autoptr(GTask) task = user_data;
-  g_autofree gchar *contents = NULL;
-  g_auto(GStrv) lines = NULL;
-  IdeBackForwardList *self;
-  IdeContext *context;
-  GError *error = NULL;
-  GFile *file = (GFile *)object;
-  gsize length = 0;
-  gsize n_lines;
-  gint i;
+  IdeBackForwardListLoad *state = data;
 
-  g_assert (G_IS_FILE (file));
-  g_assert (G_IS_TASK (task));
+  if (state != NULL)
+    {
+      g_clear_object (&state->file);
+      g_clear_pointer (&state->uris, g_ptr_array_unref);
 
-  self = g_task_get_source_object (task);
-  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+      g_slice_free (IdeBackForwardListLoad, state);
+    }
+}
 
-  context = ide_object_get_context (IDE_OBJECT (self));
-  g_assert (IDE_IS_CONTEXT (context));
+static void
+ide_back_forward_list_load_add (IdeBackForwardListLoad *state,
+                                const gchar            *str)
+{
+  IdeUri *uri;
+
+  g_assert (state != NULL);
+  g_assert (str != NULL);
+
+  if (NULL != (uri = ide_uri_new (str, 0, NULL)))
+    g_ptr_array_add (state->uris, uri);
+  else
+    state->needs_compact = TRUE;
+}
+
+static void
+ide_back_forward_list_load_log (IdeBackForwardListLoad *state,
+                                const gchar            *contents,
+                                gsize                   length)
+{
+  g_autoptr(GArray) offsets = NULL;
+  gsize pos = IDE_BACK_FORWARD_LIST_MAGIC_LEN;
+  guint first;
 
-  if (!g_file_load_contents_finish (file, result, &contents, &length, NULL, &error))
+  g_assert (state != NULL);
+  g_assert (contents != NULL);
+
+  offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  /*
+   * Find where each record starts first, so that we only need to parse
+   * the most recent ones. A truncated record at the end, such as from
+   * a crash while appending, is ignored and dropped upon compaction.
+   */
+  while (pos + sizeof (guint32) <= length)
     {
-      g_task_return_error (task, error);
-      return;
+      guint32 len;
+
+      memcpy (&len, contents + pos, sizeof len);
+      len = GUINT32_FROM_LE (len);
+
+      if (len > IDE_BACK_FORWARD_LIST_MAX_URI || len > length - pos - sizeof len)
+        {
+          state->needs_compact = TRUE;
+          break;
+        }
+
+      g_array_append_val (offsets, pos);
+      pos += sizeof len + len;
     }
 
-  if (length > (10 * 1024 * 1024))
+  if (pos != length)
+    state->needs_compact = TRUE;
+
+  state->n_records = offsets->len;
+  first = offsets->len > MAX_LOAD_RECORDS ? offsets->len - MAX_LOAD_RECORDS : 0;
+
+  for (guint i = first; i < offsets->len; i++)
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVALID_DATA,
-                               "Implausible file size discovered");
-      return;
+      gsize offset = g_array_index (offsets, gsize, i);
+      g_autofree gchar *str = NULL;
+      guint32 len;
+
+      memcpy (&len, contents + offset, sizeof len);
+      len = GUINT32_FROM_LE (len);
+
+      str = g_strndup (contents + offset + sizeof len, len);
+      ide_back_forward_list_load_add (state, str);
     }
+}
+
+static gboolean
+ide_back_forward_list_load_legacy (IdeBackForwardListLoad  *state,
+                                   const gchar             *contents,
+                                   gsize                    length,
+                                   GError                 **error)
+{
+  g_auto(GStrv) lines = NULL;
+  gsize n_lines;
+
+  g_assert (state != NULL);
+  g_assert (contents != NULL);
 
   if (!g_utf8_validate (contents, length, NULL))
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVALID_DATA,
-                               "The content was not UTF-8 formatted");
-      return;
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "The content was not UTF-8 formatted");
+      return FALSE;
     }
 
+  /* Always convert the text format to a log upon the next save */
+  state->needs_compact = TRUE;
+
   lines = g_strsplit (contents, "\n", 0);
   n_lines = g_strv_length (lines);
 
-  for (i = n_lines; i > 0; i--)
+  /* The text format is stored most recent first */
+  for (gsize i = n_lines; i > 0; i--)
     {
       const gchar *line = lines [i - 1];
-      g_autoptr(IdeUri) uri = NULL;
-      g_autoptr(IdeBackForwardItem) item = NULL;
       g_autofree gchar *new_style_uri = NULL;
       char *old_style_uri = NULL;
       guint lineno = 0;
@@ -100,21 +175,111 @@ ide_back_forward_list_load_cb (GObject      *object,
           free (old_style_uri);
         }
 
-      uri = ide_uri_new (line, 0, &error);
+      ide_back_forward_list_load_add (state, line);
+      state->n_records++;
+    }
 
-      if (uri == NULL)
-        {
-          g_task_return_error (task, error);
-          return;
-        }
+  return TRUE;
+}
+
+static void
+ide_back_forward_list_load_worker (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  IdeBackForwardListLoad *state = task_data;
+  g_autofree gchar *contents = NULL;
+  GError *error = NULL;
+  gsize length = 0;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_BACK_FORWARD_LIST (source_object));
+  g_assert (state != NULL);
+  g_assert (G_IS_FILE (state->file));
+
+  if (!g_file_load_contents (state->file, cancellable, &contents, &length, NULL, &error))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  if (length > (10 * 1024 * 1024))
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_DATA,
+                               "Implausible file size discovered");
+      IDE_EXIT;
+    }
+
+  if (length >= IDE_BACK_FORWARD_LIST_MAGIC_LEN &&
+      memcmp (contents, IDE_BACK_FORWARD_LIST_MAGIC, IDE_BACK_FORWARD_LIST_MAGIC_LEN) == 0)
+    ide_back_forward_list_load_log (state, contents, length);
+  else if (!ide_back_forward_list_load_legacy (state, contents, length, &error))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
 
-      item = ide_back_forward_item_new (context, uri);
-      ide_back_forward_list_push (self, item);
+static void
+ide_back_forward_list_load_cb (GObject      *object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+  IdeBackForwardList *self = (IdeBackForwardList *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GPtrArray) items = NULL;
+  IdeBackForwardListLoad *state;
+  IdeContext *context;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (G_TASK (result));
+  items = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      /*
+       * A missing history is an empty one, and an unreadable one will be
+       * replaced upon the next save. For other errors we do not mark the
+       * history as loaded, so that we only append to it.
+       */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        _ide_back_forward_list_restore (self, items, 0, FALSE);
+      else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        _ide_back_forward_list_restore (self, items, 0, TRUE);
+
+      g_task_return_error (task, error);
+      return;
     }
 
+  context = ide_object_get_context (IDE_OBJECT (self));
+  g_assert (IDE_IS_CONTEXT (context));
+
+  for (guint i = 0; i < state->uris->len; i++)
+    g_ptr_array_add (items, ide_back_forward_item_new (context, g_ptr_array_index (state->uris, i)));
+
+  _ide_back_forward_list_restore (self, items, state->n_records, state->needs_compact);
+
   g_task_return_boolean (task, TRUE);
 }
 
+/*
+ * Loads the history from @file on a worker thread. Items that have been
+ * pushed in the mean time are kept as the most recent history, so callers
+ * do not need to wait for this to complete before using the list.
+ */
 void
 _ide_back_forward_list_load_async (IdeBackForwardList  *self,
                                    GFile               *file,
@@ -122,7 +287,9 @@ _ide_back_forward_list_load_async (IdeBackForwardList  *self,
                                    GAsyncReadyCallback  callback,
                                    gpointer             user_data)
 {
+  IdeBackForwardListLoad *state;
   g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) worker = NULL;
 
   g_assert (IDE_IS_BACK_FORWARD_LIST (self));
   g_assert (G_IS_FILE (file));
@@ -139,10 +306,16 @@ _ide_back_forward_list_load_async (IdeBackForwardList  *self,
 
   task = g_task_new (self, cancellable, callback, user_data);
 
-  g_file_load_contents_async (file,
-                              cancellable,
-                              ide_back_forward_list_load_cb,
-                              g_object_ref (task));
+  state = g_slice_new0 (IdeBackForwardListLoad);
+  state->file = g_object_ref (file);
+  state->uris = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_uri_unref);
+
+  worker = g_task_new (self, cancellable, ide_back_forward_list_load_cb, g_object_ref (task));
+  g_task_set_priority (worker, G_PRIORITY_LOW);
+  g_task_set_task_data (worker, state, ide_back_forward_list_load_free);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER,
+                             worker,
+                             ide_back_forward_list_load_worker);
 }
 
 gboolean
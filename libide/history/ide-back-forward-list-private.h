@@ -25,6 +25,16 @@
 
 G_BEGIN_DECLS
 
+/*
+ * The history is stored as a log of records, each of which is the URI of
+ * a jump prefixed by its length as a little-endian 32-bit integer. Records
+ * are appended as the user navigates, oldest first, and the log is
+ * rewritten from the list when it has grown too large.
+ */
+#define IDE_BACK_FORWARD_LIST_MAGIC     "IDEHIST1"
+#define IDE_BACK_FORWARD_LIST_MAGIC_LEN 8
+#define IDE_BACK_FORWARD_LIST_MAX_URI   (64 * 1024)
+
 void                _ide_back_forward_list_foreach     (IdeBackForwardList    *self,
                                                         GFunc                  callback,
                                                         gpointer               user_data);
@@ -46,6 +56,16 @@ gboolean            _ide_back_forward_list_save_finish (IdeBackForwardList    *s
                                                         GError               **error);
 IdeBackForwardItem *_ide_back_forward_list_find        (IdeBackForwardList    *self,
                                                         IdeFile               *file);
+GPtrArray          *_ide_back_forward_list_steal_unsaved     (IdeBackForwardList *self);
+gboolean            _ide_back_forward_list_get_needs_compact (IdeBackForwardList *self);
+guint               _ide_back_forward_list_get_n_records     (IdeBackForwardList *self);
+void                _ide_back_forward_list_set_n_records     (IdeBackForwardList *self,
+                                                              guint               n_records,
+                                                              gboolean            compacted);
+void                _ide_back_forward_list_restore           (IdeBackForwardList *self,
+                                                              GPtrArray          *items,
+                                                              guint               n_records,
+                                                              gboolean            needs_compact);
 
 G_END_DECLS
 
@@ -18,6 +18,8 @@
 
 #define G_LOG_DOMAIN "ide-back-forward-list"
 
+#include <string.h>
+
 #include "ide-debug.h"
 
 #include "history/ide-back-forward-item.h"
@@ -29,8 +31,10 @@
 typedef struct
 {
   GHashTable *counter;
-  GString    *content;
+  GPtrArray  *uris;
+  GByteArray *records;
   GFile      *file;
+  guint       compact : 1;
 } IdeBackForwardListSave;
 
 static void
@@ -41,30 +45,48 @@ ide_back_forward_list_save_free (gpointer data)
   if (state != NULL)
     {
       g_clear_object (&state->file);
-
-      g_string_free (state->content, TRUE);
-      state->content = NULL;
-
+      g_clear_pointer (&state->records, g_byte_array_unref);
+      g_clear_pointer (&state->uris, g_ptr_array_unref);
       g_clear_pointer (&state->counter, g_hash_table_unref);
 
       g_slice_free (IdeBackForwardListSave, state);
     }
 }
 
+static void
+ide_back_forward_list_save_append_record (GByteArray *records,
+                                          IdeUri     *uri)
+{
+  g_autofree gchar *str = NULL;
+  guint32 len;
+
+  g_assert (records != NULL);
+  g_assert (uri != NULL);
+
+  str = ide_uri_to_string (uri, 0);
+
+  if (str == NULL || strlen (str) > IDE_BACK_FORWARD_LIST_MAX_URI)
+    return;
+
+  len = GUINT32_TO_LE (strlen (str));
+
+  g_byte_array_append (records, (const guint8 *)&len, sizeof len);
+  g_byte_array_append (records, (const guint8 *)str, strlen (str));
+}
+
 static void
 ide_back_forward_list_save_collect (gpointer data,
                                     gpointer user_data)
 {
   IdeBackForwardListSave *state = user_data;
   IdeBackForwardItem *item = data;
-  g_autofree gchar *str = NULL;
   gchar *hash_key = NULL;
   IdeUri *uri;
   gsize count;
 
   g_assert (IDE_IS_BACK_FORWARD_ITEM (item));
   g_assert (state != NULL);
-  g_assert (state->content != NULL);
+  g_assert (state->uris != NULL);
   g_assert (state->counter != NULL);
 
   uri = ide_back_forward_item_get_uri (item);
@@ -84,9 +106,96 @@ ide_back_forward_list_save_collect (gpointer data,
 
   g_hash_table_insert (state->counter, hash_key, GSIZE_TO_POINTER (count + 1));
 
-  str = ide_uri_to_string (uri, 0);
-  if (str != NULL)
-    g_string_append_printf (state->content, "%s\n", str);
+  g_ptr_array_add (state->uris, uri);
+}
+
+static gboolean
+ide_back_forward_list_save_has_magic (GFile         *file,
+                                      GCancellable  *cancellable,
+                                      GError       **error)
+{
+  g_autoptr(GFileInputStream) stream = NULL;
+  gchar magic [IDE_BACK_FORWARD_LIST_MAGIC_LEN];
+  gsize n_read = 0;
+
+  g_assert (G_IS_FILE (file));
+
+  if (NULL == (stream = g_file_read (file, cancellable, error)))
+    return FALSE;
+
+  if (!g_input_stream_read_all (G_INPUT_STREAM (stream), magic, sizeof magic, &n_read, cancellable, error))
+    return FALSE;
+
+  return n_read == sizeof magic &&
+         memcmp (magic, IDE_BACK_FORWARD_LIST_MAGIC, sizeof magic) == 0;
+}
+
+static gboolean
+ide_back_forward_list_save_replace (IdeBackForwardListSave  *state,
+                                    GCancellable            *cancellable,
+                                    GError                 **error)
+{
+  g_autoptr(GByteArray) content = NULL;
+
+  g_assert (state != NULL);
+
+  content = g_byte_array_sized_new (IDE_BACK_FORWARD_LIST_MAGIC_LEN + state->records->len);
+  g_byte_array_append (content,
+                       (const guint8 *)IDE_BACK_FORWARD_LIST_MAGIC,
+                       IDE_BACK_FORWARD_LIST_MAGIC_LEN);
+  g_byte_array_append (content, state->records->data, state->records->len);
+
+  return g_file_replace_contents (state->file,
+                                  (const gchar *)content->data,
+                                  content->len,
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_NONE,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
+
+static gboolean
+ide_back_forward_list_save_append (IdeBackForwardListSave  *state,
+                                   GCancellable            *cancellable,
+                                   GError                 **error)
+{
+  g_autoptr(GFileOutputStream) stream = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  g_assert (state != NULL);
+
+  /*
+   * If the log does not exist yet, or is still in the old text format,
+   * we need to write it from scratch with our header.
+   */
+  if (!ide_back_forward_list_save_has_magic (state->file, cancellable, &local_error))
+    {
+      if (local_error != NULL &&
+          !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+
+      return ide_back_forward_list_save_replace (state, cancellable, error);
+    }
+
+  stream = g_file_append_to (state->file, G_FILE_CREATE_NONE, cancellable, error);
+
+  if (stream == NULL)
+    return FALSE;
+
+  if (!g_output_stream_write_all (G_OUTPUT_STREAM (stream),
+                                  state->records->data,
+                                  state->records->len,
+                                  NULL,
+                                  cancellable,
+                                  error))
+    return FALSE;
+
+  return g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, error);
 }
 
 static void
@@ -106,7 +215,7 @@ ide_back_forward_list_save_worker (GTask        *task,
   g_assert (G_IS_TASK (task));
   g_assert (state != NULL);
   g_assert (G_IS_FILE (state->file));
-  g_assert (state->content != NULL);
+  g_assert (state->records != NULL);
 
   parent = g_file_get_parent (state->file);
 
@@ -119,15 +228,10 @@ ide_back_forward_list_save_worker (GTask        *task,
         }
     }
 
-  ret = g_file_replace_contents (state->file,
-                                 state->content->str,
-                                 state->content->len,
-                                 NULL,
-                                 FALSE,
-                                 G_FILE_CREATE_NONE,
-                                 NULL,
-                                 cancellable,
-                                 &error);
+  if (state->compact)
+    ret = ide_back_forward_list_save_replace (state, cancellable, &error);
+  else
+    ret = ide_back_forward_list_save_append (state, cancellable, &error);
 
   if (ret == FALSE)
     g_task_return_error (task, error);
@@ -145,6 +249,7 @@ _ide_back_forward_list_save_async (IdeBackForwardList  *self,
                                    gpointer             user_data)
 {
   IdeBackForwardListSave *state;
+  g_autoptr(GPtrArray) unsaved = NULL;
   g_autoptr(GTask) task = NULL;
 
   IDE_ENTRY;
@@ -163,15 +268,49 @@ _ide_back_forward_list_save_async (IdeBackForwardList  *self,
 #endif
 
   state = g_slice_new0 (IdeBackForwardListSave);
-  state->content = g_string_new (NULL);
-  state->counter = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  state->records = g_byte_array_new ();
   state->file = g_object_ref (file);
-  _ide_back_forward_list_foreach (self, ide_back_forward_list_save_collect, state);
+  state->compact = _ide_back_forward_list_get_needs_compact (self);
+
+  /*
+   * Usually we only append the jumps made since the last save. Once the
+   * log has grown too large, we rewrite it with the items in the list,
+   * keeping only the most recent few for each file.
+   */
+  unsaved = _ide_back_forward_list_steal_unsaved (self);
+
+  if (state->compact)
+    {
+      state->uris = g_ptr_array_new ();
+      state->counter = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      _ide_back_forward_list_foreach (self, ide_back_forward_list_save_collect, state);
+
+      /* Collected newest first, but the log is oldest first */
+      for (guint i = state->uris->len; i > 0; i--)
+        ide_back_forward_list_save_append_record (state->records,
+                                                  g_ptr_array_index (state->uris, i - 1));
+
+      _ide_back_forward_list_set_n_records (self, state->uris->len, TRUE);
+    }
+  else
+    {
+      for (guint i = 0; i < unsaved->len; i++)
+        {
+          IdeBackForwardItem *item = g_ptr_array_index (unsaved, i);
+
+          ide_back_forward_list_save_append_record (state->records,
+                                                    ide_back_forward_item_get_uri (item));
+        }
+
+      _ide_back_forward_list_set_n_records (self,
+                                            _ide_back_forward_list_get_n_records (self) + unsaved->len,
+                                            FALSE);
+    }
 
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_task_data (task, state, ide_back_forward_list_save_free);
 
-  if (state->content->len == 0)
+  if (state->records->len == 0 && !state->compact)
     g_task_return_boolean (task, TRUE);
   else
     g_task_run_in_thread (task, ide_back_forward_list_save_worker);
@@ -32,10 +32,24 @@
 #include "files/ide-file.h"
 #include "history/ide-back-forward-item.h"
 #include "history/ide-back-forward-list.h"
+#include "history/ide-back-forward-list-private.h"
 #include "projects/ide-project.h"
 
 #define MAX_ITEMS_TOTAL 100
 
+/*
+ * The history log is compacted once it contains this many times more
+ * records than the list itself, but never while it is small.
+ */
+#define COMPACT_MIN_RECORDS 500
+#define COMPACT_RATIO       4
+
+/*
+ * If this many items are pushed without a save, we stop tracking them
+ * individually and rewrite the log from the list upon the next save.
+ */
+#define MAX_UNSAVED_ITEMS 1000
+
 struct _IdeBackForwardList
 {
   IdeObject           parent_instance;
@@ -43,6 +57,25 @@ struct _IdeBackForwardList
   GQueue             *backward;
   IdeBackForwardItem *current_item;
   GQueue             *forward;
+
+  /*
+   * Items pushed since the history was last saved, in the order they
+   * were pushed. These are appended to the history log upon saving.
+   */
+  GPtrArray          *unsaved;
+
+  /*
+   * The number of records in the history log, which is used to decide
+   * when the log should be compacted.
+   */
+  guint               n_records;
+
+  /*
+   * Set once the history log has been loaded, as the log can only be
+   * compacted once we know its contents.
+   */
+  guint               loaded : 1;
+  guint               needs_compact : 1;
 };
 
 
@@ -168,12 +201,12 @@ ide_back_forward_list_prune (IdeBackForwardList *self)
     }
 }
 
-void
-ide_back_forward_list_push (IdeBackForwardList *self,
-                            IdeBackForwardItem *item)
+static void
+ide_back_forward_list_push_internal (IdeBackForwardList *self,
+                                     IdeBackForwardItem *item)
 {
-  g_return_if_fail (IDE_IS_BACK_FORWARD_LIST (self));
-  g_return_if_fail (IDE_IS_BACK_FORWARD_ITEM (item));
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+  g_assert (IDE_IS_BACK_FORWARD_ITEM (item));
 
   /*
    * The following algorithm tries to loosely copy the design of jump lists
@@ -216,6 +249,21 @@ ide_back_forward_list_push (IdeBackForwardList *self,
   g_return_if_fail (self->forward->length == 0);
 }
 
+void
+ide_back_forward_list_push (IdeBackForwardList *self,
+                            IdeBackForwardItem *item)
+{
+  g_return_if_fail (IDE_IS_BACK_FORWARD_LIST (self));
+  g_return_if_fail (IDE_IS_BACK_FORWARD_ITEM (item));
+
+  ide_back_forward_list_push_internal (self, item);
+
+  if (self->unsaved->len < MAX_UNSAVED_ITEMS)
+    g_ptr_array_add (self->unsaved, g_object_ref (item));
+  else
+    self->needs_compact = TRUE;
+}
+
 /**
  * ide_back_forward_list_branch:
  *
@@ -383,6 +431,9 @@ ide_back_forward_list_dispose (GObject *object)
       g_clear_pointer (&self->forward, g_queue_free);
     }
 
+  g_clear_object (&self->current_item);
+  g_clear_pointer (&self->unsaved, g_ptr_array_unref);
+
   G_OBJECT_CLASS (ide_back_forward_list_parent_class)->dispose (object);
 }
 
@@ -460,6 +511,7 @@ ide_back_forward_list_init (IdeBackForwardList *self)
 {
   self->backward = g_queue_new ();
   self->forward = g_queue_new ();
+  self->unsaved = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
 void
@@ -540,3 +592,127 @@ _ide_back_forward_list_find (IdeBackForwardList *self,
 
   return lookup.result;
 }
+
+/**
+ * _ide_back_forward_list_steal_unsaved:
+ * @self: A #IdeBackForwardList
+ *
+ * Takes the items pushed since the last call, in the order they were pushed,
+ * so that they can be appended to the history log.
+ *
+ * Returns: (transfer full) (element-type Ide.BackForwardItem): A #GPtrArray.
+ */
+GPtrArray *
+_ide_back_forward_list_steal_unsaved (IdeBackForwardList *self)
+{
+  GPtrArray *ret;
+
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+
+  ret = self->unsaved;
+  self->unsaved = g_ptr_array_new_with_free_func (g_object_unref);
+
+  return ret;
+}
+
+/**
+ * _ide_back_forward_list_get_needs_compact:
+ * @self: A #IdeBackForwardList
+ *
+ * Checks if the history log has grown enough, compared to the contents of
+ * @self, that it should be rewritten rather than appended to.
+ *
+ * Returns: %TRUE if the history log should be compacted.
+ */
+gboolean
+_ide_back_forward_list_get_needs_compact (IdeBackForwardList *self)
+{
+  guint length;
+
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+
+  /* We would lose the records we have not loaded yet */
+  if (!self->loaded)
+    return FALSE;
+
+  if (self->needs_compact)
+    return TRUE;
+
+  length = self->backward->length + self->forward->length + (self->current_item ? 1 : 0);
+
+  return (self->n_records + self->unsaved->len) > MAX (COMPACT_MIN_RECORDS, length * COMPACT_RATIO);
+}
+
+guint
+_ide_back_forward_list_get_n_records (IdeBackForwardList *self)
+{
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+
+  return self->n_records;
+}
+
+/**
+ * _ide_back_forward_list_set_n_records:
+ * @self: A #IdeBackForwardList
+ * @n_records: the number of records in the history log
+ * @compacted: if the log was just rewritten
+ *
+ * Updates the number of records known to be in the history log after saving.
+ */
+void
+_ide_back_forward_list_set_n_records (IdeBackForwardList *self,
+                                      guint               n_records,
+                                      gboolean            compacted)
+{
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+
+  self->n_records = n_records;
+
+  if (compacted)
+    self->needs_compact = FALSE;
+}
+
+/**
+ * _ide_back_forward_list_restore:
+ * @self: A #IdeBackForwardList
+ * @items: (element-type Ide.BackForwardItem): the loaded items, oldest first
+ * @n_records: the number of records in the history log
+ * @needs_compact: if the history log should be rewritten on the next save
+ *
+ * Restores the history loaded from the history log. Since the history is
+ * loaded in the background, items may have been pushed already. Those are
+ * more recent than the loaded history, so they are pushed again after it.
+ */
+void
+_ide_back_forward_list_restore (IdeBackForwardList *self,
+                                GPtrArray          *items,
+                                guint               n_records,
+                                gboolean            needs_compact)
+{
+  g_autoptr(GPtrArray) existing = NULL;
+
+  g_assert (IDE_IS_BACK_FORWARD_LIST (self));
+  g_assert (items != NULL);
+
+  existing = ide_back_forward_list_to_array (self);
+  g_ptr_array_set_free_func (existing, g_object_unref);
+
+  /* The array takes over the references held by the list */
+  g_queue_clear (self->backward);
+  g_queue_clear (self->forward);
+  self->current_item = NULL;
+
+  for (guint i = 0; i < items->len; i++)
+    ide_back_forward_list_push_internal (self, g_ptr_array_index (items, i));
+
+  for (guint i = 0; i < existing->len; i++)
+    ide_back_forward_list_push_internal (self, g_ptr_array_index (existing, i));
+
+  self->n_records = n_records;
+  self->loaded = TRUE;
+  self->needs_compact |= !!needs_compact;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CAN_GO_BACKWARD]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CAN_GO_FORWARD]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CURRENT_ITEM]);
+}
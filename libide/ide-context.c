@@ -1208,11 +1208,11 @@ ide_context__back_forward_list_load_cb (GObject      *object,
                                         gpointer      user_data)
 {
   IdeBackForwardList *back_forward_list = (IdeBackForwardList *)object;
-  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeContext) self = user_data;
   GError *error = NULL;
 
   g_assert (IDE_IS_BACK_FORWARD_LIST (back_forward_list));
-  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CONTEXT (self));
 
   /*
    * Failing to load the back-forward list is non-fatal. We'll fix it during
@@ -1224,8 +1224,6 @@ ide_context__back_forward_list_load_cb (GObject      *object,
         g_warning ("%s", error->message);
       g_clear_error (&error);
     }
-
-  g_task_return_boolean (task, TRUE);
 }
 
 static void
@@ -1244,12 +1242,19 @@ ide_context_init_back_forward_list (gpointer             source_object,
 
   task = g_task_new (self, cancellable, callback, user_data);
 
+  /*
+   * The history is only needed once the user starts navigating, and the
+   * list merges it with any jumps made in the mean time, so we do not
+   * hold up loading the context for it.
+   */
   file = get_back_forward_list_file (self);
   _ide_back_forward_list_load_async (self->back_forward_list,
                                      file,
-                                     cancellable,
+                                     NULL,
                                      ide_context__back_forward_list_load_cb,
-                                     g_object_ref (task));
+                                     g_object_ref (self));
+
+  g_task_return_boolean (task, TRUE);
 
   IDE_EXIT;
 }
@@ -40,10 +40,30 @@ void                _ide_buffer_set_changed_on_volume       (IdeBuffer
 gboolean            _ide_buffer_get_loading                 (IdeBuffer             *self);
 void                _ide_buffer_set_loading                 (IdeBuffer             *self,
                                                              gboolean               loading);
+gint64              _ide_buffer_get_last_viewed             (IdeBuffer             *self);
+gboolean            _ide_buffer_get_mapped                  (IdeBuffer             *self);
+void                _ide_buffer_set_mapped                  (IdeBuffer             *self,
+                                                             gboolean               mapped);
+gboolean            _ide_buffer_get_trimmed                 (IdeBuffer             *self);
+gsize               _ide_buffer_get_undo_size               (IdeBuffer             *self);
+void                _ide_buffer_trim                        (IdeBuffer             *self);
+void                _ide_buffer_compact                     (IdeBuffer             *self);
 void                _ide_buffer_set_mtime                   (IdeBuffer             *self,
                                                              const GTimeVal        *mtime);
 void                _ide_buffer_set_read_only               (IdeBuffer             *buffer,
                                                              gboolean               read_only);
+IdeBufferStructure *_ide_buffer_structure_new               (GtkTextBuffer         *buffer);
+void                _ide_buffer_structure_delete            (IdeBufferStructure    *self,
+                                                             guint                  offset,
+                                                             guint                  n_chars);
+gboolean            _ide_buffer_structure_get_enabled       (IdeBufferStructure    *self);
+gsize               _ide_buffer_structure_get_memory_usage  (IdeBufferStructure    *self);
+void                _ide_buffer_structure_insert            (IdeBufferStructure    *self,
+                                                             guint                  offset,
+                                                             guint                  n_chars);
+void                _ide_buffer_structure_reset             (IdeBufferStructure    *self);
+void                _ide_buffer_structure_set_language_id   (IdeBufferStructure    *self,
+                                                             const gchar           *language_id);
 void                _ide_buffer_manager_reclaim             (IdeBufferManager      *self,
                                                              IdeBuffer             *buffer);
 void                _ide_build_system_set_project_file      (IdeBuildSystem        *self,
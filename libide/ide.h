@@ -32,6 +32,7 @@ G_BEGIN_DECLS
 #include "application/ide-application.h"
 #include "buffers/ide-buffer-change-monitor.h"
 #include "buffers/ide-buffer-manager.h"
+#include "buffers/ide-buffer-structure.h"
 #include "buffers/ide-buffer.h"
 #include "buffers/ide-unsaved-file.h"
 #include "buffers/ide-unsaved-files.h"
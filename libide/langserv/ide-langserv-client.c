@@ -43,6 +43,7 @@ typedef struct
   JsonrpcClient  *rpc_client;
   GIOStream      *io_stream;
   GHashTable     *diagnostics_by_file;
+  GHashTable     *frozen_buffers;
   GPtrArray      *languages;
 } IdeLangservClientPrivate;
 
@@ -154,6 +155,74 @@ ide_langserv_client_buffer_saved (IdeLangservClient *self,
  *       events into a single dispatch.
  */
 
+static gboolean
+ide_langserv_client_defer_buffer_change (IdeLangservClient *self,
+                                         IdeBuffer         *buffer)
+{
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  /*
+   * While the buffer is frozen, we drop the incremental changes and send
+   * the whole document in a single notification once it is thawed.
+   */
+  if (ide_buffer_get_changes_frozen (buffer))
+    {
+      g_hash_table_add (priv->frozen_buffers, buffer);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+ide_langserv_client_buffer_notify_changes_frozen (IdeLangservClient *self,
+                                                  GParamSpec        *pspec,
+                                                  IdeBuffer         *buffer)
+{
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+  g_autoptr(JsonNode) params = NULL;
+  g_autofree gchar *uri = NULL;
+  g_autofree gchar *text = NULL;
+  GtkTextIter begin;
+  GtkTextIter end;
+  gint version;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (ide_buffer_get_changes_frozen (buffer) ||
+      !g_hash_table_remove (priv->frozen_buffers, buffer))
+    IDE_EXIT;
+
+  uri = ide_buffer_get_uri (buffer);
+  version = (gint)ide_buffer_get_change_count (buffer);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &begin, &end);
+  text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &begin, &end, TRUE);
+
+  params = JCON_NEW (
+    "textDocument", "{",
+      "uri", JCON_STRING (uri),
+      "version", JCON_INT (version),
+    "}",
+    "contentChanges", "[",
+      "{",
+        "text", JCON_STRING (text),
+      "}",
+    "]");
+
+  ide_langserv_client_send_notification_async (self, "textDocument/didChange",
+                                               g_steal_pointer (&params),
+                                               NULL, NULL, NULL);
+
+  IDE_EXIT;
+}
+
 static void
 ide_langserv_client_buffer_insert_text (IdeLangservClient *self,
                                         GtkTextIter       *location,
@@ -174,6 +243,9 @@ ide_langserv_client_buffer_insert_text (IdeLangservClient *self,
   g_assert (location != NULL);
   g_assert (IDE_IS_BUFFER (buffer));
 
+  if (ide_langserv_client_defer_buffer_change (self, buffer))
+    IDE_EXIT;
+
   copy = g_strndup (new_text, len);
 
   uri = ide_buffer_get_uri (buffer);
@@ -234,6 +306,9 @@ ide_langserv_client_buffer_delete_range (IdeLangservClient *self,
   g_assert (end_iter != NULL);
   g_assert (IDE_IS_BUFFER (buffer));
 
+  if (ide_langserv_client_defer_buffer_change (self, buffer))
+    IDE_EXIT;
+
   uri = ide_buffer_get_uri (buffer);
   version = (gint)ide_buffer_get_change_count (buffer);
 
@@ -303,6 +378,12 @@ ide_langserv_client_buffer_loaded (IdeLangservClient *self,
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (buffer,
+                           "notify::changes-frozen",
+                           G_CALLBACK (ide_langserv_client_buffer_notify_changes_frozen),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   uri = ide_buffer_get_uri (buffer);
 
   params = JCON_NEW (
@@ -324,6 +405,7 @@ ide_langserv_client_buffer_unloaded (IdeLangservClient *self,
                                      IdeBuffer         *buffer,
                                      IdeBufferManager  *buffer_manager)
 {
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
   g_autoptr(JsonNode) params = NULL;
   g_autofree gchar *uri = NULL;
 
@@ -333,6 +415,8 @@ ide_langserv_client_buffer_unloaded (IdeLangservClient *self,
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
 
+  g_hash_table_remove (priv->frozen_buffers, buffer);
+
   if (!ide_langserv_client_supports_buffer (self, buffer))
     IDE_EXIT;
 
@@ -655,6 +739,7 @@ ide_langserv_client_finalize (GObject *object)
   IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
 
   g_clear_pointer (&priv->diagnostics_by_file, g_hash_table_unref);
+  g_clear_pointer (&priv->frozen_buffers, g_hash_table_unref);
   g_clear_pointer (&priv->languages, g_ptr_array_unref);
   g_clear_object (&priv->rpc_client);
   g_clear_object (&priv->buffer_manager_signals);
@@ -791,6 +876,8 @@ ide_langserv_client_init (IdeLangservClient *self)
                                                      g_object_unref,
                                                      (GDestroyNotify)ide_diagnostics_unref);
 
+  priv->frozen_buffers = g_hash_table_new (NULL, NULL);
+
   priv->buffer_manager_signals = egg_signal_group_new (IDE_TYPE_BUFFER_MANAGER);
 
   egg_signal_group_connect_object (priv->buffer_manager_signals,
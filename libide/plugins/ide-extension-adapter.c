@@ -61,15 +61,9 @@ static GSettings *
 ide_extension_adapter_get_settings (IdeExtensionAdapter *self,
                                     PeasPluginInfo      *plugin_info)
 {
-  g_autofree gchar *path = NULL;
-
   g_assert (IDE_IS_EXTENSION_ADAPTER (self));
 
-  path = g_strdup_printf ("/org/gnome/builder/extension-types/%s/%s/",
-                          peas_plugin_info_get_module_name (plugin_info),
-                          g_type_name (self->interface_type));
-
-  return g_settings_new_with_path ("org.gnome.builder.extension-type", path);
+  return g_object_ref (ide_extension_util_get_settings (plugin_info, self->interface_type));
 }
 
 static void
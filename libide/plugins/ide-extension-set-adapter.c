@@ -110,16 +110,12 @@ watch_extension (IdeExtensionSetAdapter *self,
                  GType                   interface_type)
 {
   GSettings *settings;
-  gchar *path;
 
   g_assert (IDE_IS_EXTENSION_SET_ADAPTER (self));
   g_assert (plugin_info != NULL);
   g_assert (G_TYPE_IS_INTERFACE (interface_type));
 
-  path = g_strdup_printf ("/org/gnome/builder/extension-types/%s/%s/",
-                          peas_plugin_info_get_module_name (plugin_info),
-                          g_type_name (interface_type));
-  settings = g_settings_new_with_path ("org.gnome.builder.extension-type", path);
+  settings = ide_extension_util_get_settings (plugin_info, interface_type);
 
   g_ptr_array_add (self->settings, g_object_ref (settings));
 
@@ -128,9 +124,6 @@ watch_extension (IdeExtensionSetAdapter *self,
                            G_CALLBACK (ide_extension_set_adapter_enabled_changed),
                            self,
                            G_CONNECT_SWAPPED);
-
-  g_object_unref (settings);
-  g_free (path);
 }
 
 static void
@@ -18,10 +18,270 @@
 
 #define G_LOG_DOMAIN "ide-extension-util"
 
+#include <egg-counter.h>
 #include <stdlib.h>
 
+#include "ide-debug.h"
+
 #include "ide-extension-util.h"
 
+typedef struct
+{
+  PeasPluginInfo *plugin_info;
+  gint            priority;
+} PluginMatch;
+
+EGG_DEFINE_COUNTER (OnDemandLoads, "Plugins", "On-Demand Loads", "Number of plugins loaded upon first use.")
+EGG_DEFINE_COUNTER (OnDemandUsec, "Plugins", "On-Demand Load Time", "Microseconds spent loading plugins upon first use.")
+
+/*
+ * Adapters are reloaded for every buffer and every language change, and
+ * checking the match keys of every plugin each time meant splitting the
+ * same strings over and over. Instead, the first use of a key parses it
+ * for every plugin into a table of value to matching plugins, such as
+ * "python3" to the completion providers for Python. The tables are
+ * dropped when the engine rescans plugins.
+ *
+ * Everything here is only accessed from the main thread.
+ */
+static PeasEngine *indexed_engine;
+static GHashTable *match_tables;
+static GHashTable *settings_cache;
+static GHashTable *on_demand;
+
+static void
+ide_extension_util_clear_index (void)
+{
+  g_clear_pointer (&match_tables, g_hash_table_unref);
+}
+
+static void
+ide_extension_util_ensure_index (PeasEngine *engine)
+{
+  g_assert (PEAS_IS_ENGINE (engine));
+
+  if (indexed_engine != engine)
+    {
+      if (indexed_engine != NULL)
+        {
+          g_signal_handlers_disconnect_by_func (indexed_engine,
+                                                G_CALLBACK (ide_extension_util_clear_index),
+                                                NULL);
+          g_object_remove_weak_pointer (G_OBJECT (indexed_engine), (gpointer *)&indexed_engine);
+        }
+
+      ide_extension_util_clear_index ();
+
+      /* Weak so the engine can still be finalized, such as in tests */
+      indexed_engine = engine;
+      g_object_add_weak_pointer (G_OBJECT (engine), (gpointer *)&indexed_engine);
+
+      g_signal_connect_swapped (engine,
+                                "notify::plugin-list",
+                                G_CALLBACK (ide_extension_util_clear_index),
+                                NULL);
+    }
+
+  if (match_tables == NULL)
+    match_tables = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify)g_hash_table_unref);
+}
+
+static GHashTable *
+ide_extension_util_get_match_table (PeasEngine  *engine,
+                                    const gchar *key)
+{
+  g_autofree gchar *priority_name = NULL;
+  GHashTable *table;
+  const GList *plugins;
+
+  g_assert (PEAS_IS_ENGINE (engine));
+  g_assert (key != NULL);
+
+  ide_extension_util_ensure_index (engine);
+
+  if (NULL != (table = g_hash_table_lookup (match_tables, key)))
+    return table;
+
+  table = g_hash_table_new_full (g_str_hash,
+                                 g_str_equal,
+                                 g_free,
+                                 (GDestroyNotify)g_array_unref);
+
+  priority_name = g_strdup_printf ("%s-Priority", key);
+  plugins = peas_engine_get_plugin_list (engine);
+
+  for (; plugins != NULL; plugins = plugins->next)
+    {
+      PeasPluginInfo *plugin_info = plugins->data;
+      g_auto(GStrv) values_array = NULL;
+      const gchar *priority_value;
+      const gchar *values;
+      PluginMatch match = { plugin_info, 0 };
+
+      if (NULL == (values = peas_plugin_info_get_external_data (plugin_info, key)))
+        continue;
+
+      priority_value = peas_plugin_info_get_external_data (plugin_info, priority_name);
+      if (priority_value != NULL)
+        match.priority = atoi (priority_value);
+
+      values_array = g_strsplit (values, ",", 0);
+
+      for (guint i = 0; values_array [i] != NULL; i++)
+        {
+          const gchar *value = values_array [i];
+          GArray *matches;
+
+          if (*value == '\0')
+            continue;
+
+          if (NULL == (matches = g_hash_table_lookup (table, value)))
+            {
+              matches = g_array_new (FALSE, FALSE, sizeof (PluginMatch));
+              g_hash_table_insert (table, g_strdup (value), matches);
+            }
+
+          /* Ignore values listed twice by the same plugin */
+          if (matches->len == 0 ||
+              g_array_index (matches, PluginMatch, matches->len - 1).plugin_info != plugin_info)
+            g_array_append_val (matches, match);
+        }
+    }
+
+  g_hash_table_insert (match_tables, g_strdup (key), table);
+
+  return table;
+}
+
+static gboolean
+ide_extension_util_find_match (PeasEngine     *engine,
+                               PeasPluginInfo *plugin_info,
+                               const gchar    *key,
+                               const gchar    *value,
+                               gint           *priority)
+{
+  GHashTable *table;
+  GArray *matches;
+
+  g_assert (PEAS_IS_ENGINE (engine));
+  g_assert (plugin_info != NULL);
+  g_assert (key != NULL);
+  g_assert (value != NULL);
+  g_assert (priority != NULL);
+
+  table = ide_extension_util_get_match_table (engine, key);
+
+  if (NULL == (matches = g_hash_table_lookup (table, value)))
+    return FALSE;
+
+  for (guint i = 0; i < matches->len; i++)
+    {
+      const PluginMatch *match = &g_array_index (matches, PluginMatch, i);
+
+      if (match->plugin_info == plugin_info)
+        {
+          *priority = match->priority;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/**
+ * ide_extension_util_get_settings:
+ * @plugin_info: a #PeasPluginInfo
+ * @interface_type: the interface implemented by the plugin
+ *
+ * Gets the settings which control if the extension of @interface_type
+ * provided by @plugin_info is enabled. The settings are shared, so that
+ * checking them does not require creating a new #GSettings each time.
+ *
+ * Returns: (transfer none): A #GSettings
+ */
+GSettings *
+ide_extension_util_get_settings (PeasPluginInfo *plugin_info,
+                                 GType           interface_type)
+{
+  g_autofree gchar *path = NULL;
+  GSettings *settings;
+
+  g_return_val_if_fail (plugin_info != NULL, NULL);
+  g_return_val_if_fail (G_TYPE_IS_INTERFACE (interface_type), NULL);
+
+  if (settings_cache == NULL)
+    settings_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+  path = g_strdup_printf ("/org/gnome/builder/extension-types/%s/%s/",
+                          peas_plugin_info_get_module_name (plugin_info),
+                          g_type_name (interface_type));
+
+  if (NULL == (settings = g_hash_table_lookup (settings_cache, path)))
+    {
+      settings = g_settings_new_with_path ("org.gnome.builder.extension-type", path);
+      g_hash_table_insert (settings_cache, g_steal_pointer (&path), settings);
+    }
+
+  return settings;
+}
+
+/**
+ * ide_extension_util_set_load_on_demand:
+ * @plugin_info: a #PeasPluginInfo
+ * @load_on_demand: if the plugin should be loaded upon first use
+ *
+ * Marks @plugin_info as loaded on demand. Such plugins are not loaded at
+ * startup, but the first time an adapter matches them by key and value,
+ * such as when a buffer of one of their languages is opened. This is
+ * meant for plugins that are expensive to load and only useful for some
+ * projects.
+ */
+void
+ide_extension_util_set_load_on_demand (PeasPluginInfo *plugin_info,
+                                       gboolean        load_on_demand)
+{
+  g_return_if_fail (plugin_info != NULL);
+
+  if (on_demand == NULL)
+    on_demand = g_hash_table_new (NULL, NULL);
+
+  if (load_on_demand)
+    g_hash_table_add (on_demand, plugin_info);
+  else
+    g_hash_table_remove (on_demand, plugin_info);
+}
+
+static gboolean
+ide_extension_util_load_on_demand (PeasEngine     *engine,
+                                   PeasPluginInfo *plugin_info)
+{
+  gint64 begin;
+  gboolean ret;
+
+  g_assert (PEAS_IS_ENGINE (engine));
+  g_assert (plugin_info != NULL);
+
+  if (on_demand == NULL || !g_hash_table_remove (on_demand, plugin_info))
+    return FALSE;
+
+  begin = g_get_monotonic_time ();
+
+  /* This only happens once, we do not retry if loading fails */
+  ret = peas_engine_load_plugin (engine, plugin_info);
+
+  EGG_COUNTER_INC (OnDemandLoads);
+  EGG_COUNTER_ADD (OnDemandUsec, g_get_monotonic_time () - begin);
+
+  g_debug ("Loaded plugin \"%s\" on demand in %.3lf msec",
+           peas_plugin_info_get_module_name (plugin_info),
+           (g_get_monotonic_time () - begin) / 1000.0);
+
+  return ret;
+}
+
 gboolean
 ide_extension_util_can_use_plugin (PeasEngine     *engine,
                                    PeasPluginInfo *plugin_info,
@@ -30,8 +290,7 @@ ide_extension_util_can_use_plugin (PeasEngine     *engine,
                                    const gchar    *value,
                                    gint           *priority)
 {
-  g_autofree gchar *path = NULL;
-  g_autoptr(GSettings) settings = NULL;
+  GSettings *settings;
 
   g_return_val_if_fail (plugin_info != NULL, FALSE);
   g_return_val_if_fail (g_type_is_a (interface_type, G_TYPE_INTERFACE), FALSE);
@@ -47,48 +306,41 @@ ide_extension_util_can_use_plugin (PeasEngine     *engine,
     return FALSE;
 
   /*
-   * If the plugin isn't loaded, then we shouldn't use it.
+   * Check that the plugin provides the match value we are looking for.
+   * If key is NULL, then we aren't restricting by matching. This only
+   * needs the plugin metadata, so we do it before loading plugins that
+   * are loaded on demand.
    */
-  if (!peas_plugin_info_is_loaded (plugin_info))
-    return FALSE;
+  if (key != NULL)
+    {
+      if (!ide_extension_util_find_match (engine, plugin_info, key, value, priority))
+        return FALSE;
+    }
 
   /*
-   * If this plugin doesn't provide this type, we can't use it either.
+   * Ensure the plugin type isn't disabled by checking our GSettings
+   * for the plugin type. There is an implicit plugin issue here, in that
+   * two modules using different plugin loaders could have the same module
+   * name. But we can enforce this issue socially. This is checked before
+   * loading plugins on demand, so that disabled plugins are never loaded.
    */
-  if (!peas_engine_provides_extension (engine, plugin_info, interface_type))
+  settings = ide_extension_util_get_settings (plugin_info, interface_type);
+
+  if (!g_settings_get_boolean (settings, "enabled"))
     return FALSE;
 
   /*
-   * Check that the plugin provides the match value we are looking for.
-   * If key is NULL, then we aren't restricting by matching.
+   * If the plugin isn't loaded, then we shouldn't use it, unless this is
+   * the first matching use of a plugin that is loaded on demand.
    */
-  if (key != NULL)
+  if (!peas_plugin_info_is_loaded (plugin_info))
     {
-      g_autofree gchar *priority_name = NULL;
-      g_auto(GStrv) values_array = NULL;
-      const gchar *values;
-      const gchar *priority_value;
-
-      values = peas_plugin_info_get_external_data (plugin_info, key);
-      values_array = g_strsplit (values ? values : "", ",", 0);
-      if (!g_strv_contains ((const gchar * const *)values_array, value))
+      if (key == NULL || !ide_extension_util_load_on_demand (engine, plugin_info))
         return FALSE;
-
-      priority_name = g_strdup_printf ("%s-Priority", key);
-      priority_value = peas_plugin_info_get_external_data (plugin_info, priority_name);
-      if (priority_value != NULL)
-        *priority = atoi (priority_value);
     }
 
   /*
-   * Ensure the plugin type isn't disabled by checking our GSettings
-   * for the plugin type. There is an implicit plugin issue here, in that
-   * two modules using different plugin loaders could have the same module
-   * name. But we can enforce this issue socially.
+   * If this plugin doesn't provide this type, we can't use it either.
    */
-  path = g_strdup_printf ("/org/gnome/builder/extension-types/%s/%s/",
-                          peas_plugin_info_get_module_name (plugin_info),
-                          g_type_name (interface_type));
-  settings = g_settings_new_with_path ("org.gnome.builder.extension-type", path);
-  return g_settings_get_boolean (settings, "enabled");
+  return peas_engine_provides_extension (engine, plugin_info, interface_type);
 }
@@ -19,16 +19,21 @@
 #ifndef IDE_EXTENSION_UTIL_H
 #define IDE_EXTENSION_UTIL_H
 
+#include <gio/gio.h>
 #include <libpeas/peas.h>
 
 G_BEGIN_DECLS
 
-gboolean ide_extension_util_can_use_plugin (PeasEngine     *engine,
-                                            PeasPluginInfo *plugin_info,
-                                            GType           interface_type,
-                                            const gchar    *key,
-                                            const gchar    *value,
-                                            gint           *priority);
+gboolean   ide_extension_util_can_use_plugin     (PeasEngine     *engine,
+                                                  PeasPluginInfo *plugin_info,
+                                                  GType           interface_type,
+                                                  const gchar    *key,
+                                                  const gchar    *value,
+                                                  gint           *priority);
+GSettings *ide_extension_util_get_settings       (PeasPluginInfo *plugin_info,
+                                                  GType           interface_type);
+void       ide_extension_util_set_load_on_demand (PeasPluginInfo *plugin_info,
+                                                  gboolean        load_on_demand);
 
 G_END_DECLS
 
@@ -196,6 +196,7 @@ ide_preferences_builtin_register_code_insight (IdePreferences *preferences)
   ide_preferences_add_switch (preferences, "code-insight", "completion", "org.gnome.builder.code-insight", "clang-autocompletion", NULL, NULL, _("Suggest completions using Clang (Experimental)"), _("Use Clang to suggest completions for C and C++ languages"), NULL, 20);
 
   ide_preferences_add_list_group (preferences, "code-insight", "diagnostics", _("Diagnostics"), GTK_SELECTION_NONE, 200);
+  ide_preferences_add_switch (preferences, "code-insight", "diagnostics", "org.gnome.builder.code-insight", "diagnose-workspace", NULL, NULL, _("Diagnose the whole project"), _("Check every file of the project for problems when it is opened"), NULL, 0);
 }
 
 static void
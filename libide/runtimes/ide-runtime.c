@@ -30,8 +30,26 @@ typedef struct
 {
   gchar *id;
   gchar *display_name;
+
+  /*
+   * Results of probing the runtime for programs, as probing may require
+   * spawning a process within the runtime. Runtime providers create new
+   * runtime instances when the runtime changes, which drops the cache.
+   * Programs that were not found are probed again after a while, as some
+   * runtimes (such as the host) live for the whole session.
+   */
+  GMutex      probe_mutex;
+  GHashTable *probes;
 } IdeRuntimePrivate;
 
+#define PROBE_MISSING_TTL_USEC (30 * G_USEC_PER_SEC)
+
+/*
+ * The result of a probe is stored in the hashtable as the time at which it
+ * expires, negated if the program was not found.
+ */
+#define PROBE_FOUND G_MAXINT64
+
 G_DEFINE_TYPE_WITH_PRIVATE (IdeRuntime, ide_runtime, IDE_TYPE_OBJECT)
 
 enum {
@@ -171,16 +189,181 @@ ide_runtime_real_contains_program_in_path (IdeRuntime   *self,
   return ret;
 }
 
+static gboolean
+ide_runtime_real_probe_programs (IdeRuntime          *self,
+                                 const gchar * const *programs,
+                                 gboolean            *found,
+                                 GCancellable        *cancellable)
+{
+  guint i;
+
+  g_assert (IDE_IS_RUNTIME (self));
+  g_assert (programs != NULL);
+  g_assert (found != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  for (i = 0; programs[i] != NULL; i++)
+    found[i] = IDE_RUNTIME_GET_CLASS (self)->contains_program_in_path (self, programs[i], cancellable);
+
+  return TRUE;
+}
+
+static void
+ide_runtime_cache_probe_locked (IdeRuntime  *self,
+                                const gchar *program,
+                                gboolean     found)
+{
+  IdeRuntimePrivate *priv = ide_runtime_get_instance_private (self);
+  gint64 *expire_at;
+
+  g_assert (IDE_IS_RUNTIME (self));
+  g_assert (program != NULL);
+
+  expire_at = g_new (gint64, 1);
+  *expire_at = found ? PROBE_FOUND : -(g_get_monotonic_time () + PROBE_MISSING_TTL_USEC);
+
+  g_hash_table_insert (priv->probes, g_strdup (program), expire_at);
+}
+
+/*
+ * Looks up a previous probe for @program, dropping it if it has expired.
+ *
+ * Returns: %TRUE if a result was found and @found is set.
+ */
+static gboolean
+ide_runtime_lookup_probe_locked (IdeRuntime  *self,
+                                 const gchar *program,
+                                 gboolean    *found)
+{
+  IdeRuntimePrivate *priv = ide_runtime_get_instance_private (self);
+  const gint64 *expire_at;
+
+  g_assert (IDE_IS_RUNTIME (self));
+  g_assert (program != NULL);
+
+  if (NULL == (expire_at = g_hash_table_lookup (priv->probes, program)))
+    return FALSE;
+
+  if (*expire_at > 0)
+    {
+      if (found != NULL)
+        *found = TRUE;
+      return TRUE;
+    }
+
+  if (-*expire_at < g_get_monotonic_time ())
+    {
+      g_hash_table_remove (priv->probes, program);
+      return FALSE;
+    }
+
+  if (found != NULL)
+    *found = FALSE;
+
+  return TRUE;
+}
+
+/**
+ * ide_runtime_contains_program_in_path:
+ *
+ * Checks if @program can be found in the PATH of the runtime. The result
+ * is cached, so that only the first call for a given program may need to
+ * spawn a process within the runtime. Programs that are not found are
+ * looked for again once the cached result expires.
+ *
+ * This function may be called from any thread.
+ */
 gboolean
 ide_runtime_contains_program_in_path (IdeRuntime   *self,
                                       const gchar  *program,
                                       GCancellable *cancellable)
 {
+  IdeRuntimePrivate *priv = ide_runtime_get_instance_private (self);
+  gboolean found = FALSE;
+  gboolean cached;
+
   g_return_val_if_fail (IDE_IS_RUNTIME (self), FALSE);
   g_return_val_if_fail (program != NULL, FALSE);
   g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
 
-  return IDE_RUNTIME_GET_CLASS (self)->contains_program_in_path (self, program, cancellable);
+  g_mutex_lock (&priv->probe_mutex);
+  cached = ide_runtime_lookup_probe_locked (self, program, &found);
+  g_mutex_unlock (&priv->probe_mutex);
+
+  if (cached)
+    return found;
+
+  found = IDE_RUNTIME_GET_CLASS (self)->contains_program_in_path (self, program, cancellable);
+
+  /* A cancelled probe tells us nothing */
+  if (!g_cancellable_is_cancelled (cancellable))
+    {
+      g_mutex_lock (&priv->probe_mutex);
+      ide_runtime_cache_probe_locked (self, program, found);
+      g_mutex_unlock (&priv->probe_mutex);
+    }
+
+  return found;
+}
+
+/**
+ * ide_runtime_probe_programs:
+ * @self: An #IdeRuntime
+ * @programs: (array zero-terminated=1): the programs to look for
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ *
+ * Probes the runtime for all of @programs at once, so that following
+ * calls to ide_runtime_contains_program_in_path() for them return
+ * immediately. Runtimes that need to spawn a process to probe will
+ * only spawn one for the whole set.
+ *
+ * This function may be called from any thread.
+ */
+void
+ide_runtime_probe_programs (IdeRuntime          *self,
+                            const gchar * const *programs,
+                            GCancellable        *cancellable)
+{
+  IdeRuntimePrivate *priv = ide_runtime_get_instance_private (self);
+  g_autoptr(GPtrArray) missing = NULL;
+  g_autofree gboolean *found = NULL;
+  guint i;
+
+  g_return_if_fail (IDE_IS_RUNTIME (self));
+  g_return_if_fail (programs != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  missing = g_ptr_array_new ();
+
+  g_mutex_lock (&priv->probe_mutex);
+  for (i = 0; programs[i] != NULL; i++)
+    {
+      if (!ide_runtime_lookup_probe_locked (self, programs[i], NULL))
+        g_ptr_array_add (missing, (gchar *)programs[i]);
+    }
+  g_mutex_unlock (&priv->probe_mutex);
+
+  if (missing->len == 0)
+    return;
+
+  g_ptr_array_add (missing, NULL);
+  found = g_new0 (gboolean, missing->len);
+
+  /*
+   * If the probe could not be completed (or was cancelled) we know nothing
+   * about the programs, so leave them to be looked up individually.
+   */
+  if (!IDE_RUNTIME_GET_CLASS (self)->probe_programs (self,
+                                                     (const gchar * const *)missing->pdata,
+                                                     found,
+                                                     cancellable) ||
+      g_cancellable_is_cancelled (cancellable))
+    return;
+
+  g_mutex_lock (&priv->probe_mutex);
+  for (i = 0; i < missing->len - 1; i++)
+    ide_runtime_cache_probe_locked (self, g_ptr_array_index (missing, i), found[i]);
+  g_mutex_unlock (&priv->probe_mutex);
 }
 
 static void
@@ -278,6 +461,9 @@ ide_runtime_finalize (GObject *object)
 
   g_clear_pointer (&priv->id, g_free);
   g_clear_pointer (&priv->display_name, g_free);
+  g_clear_pointer (&priv->probes, g_hash_table_unref);
+
+  g_mutex_clear (&priv->probe_mutex);
 
   G_OBJECT_CLASS (ide_runtime_parent_class)->finalize (object);
 }
@@ -346,6 +532,7 @@ ide_runtime_class_init (IdeRuntimeClass *klass)
   klass->create_launcher = ide_runtime_real_create_launcher;
   klass->create_runner = ide_runtime_real_create_runner;
   klass->contains_program_in_path = ide_runtime_real_contains_program_in_path;
+  klass->probe_programs = ide_runtime_real_probe_programs;
   klass->prepare_configuration = ide_runtime_real_prepare_configuration;
 
   properties [PROP_ID] =
@@ -368,6 +555,10 @@ ide_runtime_class_init (IdeRuntimeClass *klass)
 static void
 ide_runtime_init (IdeRuntime *self)
 {
+  IdeRuntimePrivate *priv = ide_runtime_get_instance_private (self);
+
+  g_mutex_init (&priv->probe_mutex);
+  priv->probes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 const gchar *
@@ -78,8 +78,11 @@ struct _IdeRuntimeClass
                                                       GError              **error);
   GFile                 *(*translate_file)           (IdeRuntime           *self,
                                                       GFile                *file);
+  gboolean               (*probe_programs)           (IdeRuntime           *self,
+                                                      const gchar * const  *programs,
+                                                      gboolean             *found,
+                                                      GCancellable         *cancellable);
 
-  gpointer _reserved4;
   gpointer _reserved5;
   gpointer _reserved6;
   gpointer _reserved7;
@@ -122,6 +125,9 @@ gboolean               ide_runtime_postinstall_finish       (IdeRuntime
 gboolean               ide_runtime_contains_program_in_path (IdeRuntime           *self,
                                                              const gchar          *program,
                                                              GCancellable         *cancellable);
+void                   ide_runtime_probe_programs           (IdeRuntime           *self,
+                                                             const gchar * const  *programs,
+                                                             GCancellable         *cancellable);
 IdeSubprocessLauncher *ide_runtime_create_launcher          (IdeRuntime           *self,
                                                              GError              **error);
 IdeRunner             *ide_runtime_create_runner            (IdeRuntime           *self,
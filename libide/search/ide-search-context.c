@@ -19,12 +19,21 @@
 #define G_LOG_DOMAIN "ide-search-context"
 
 #include "ide-debug.h"
+#include "ide-macros.h"
 
 #include "application/ide-application.h"
 #include "search/ide-search-context.h"
 #include "search/ide-search-provider.h"
 #include "search/ide-search-result.h"
 
+/*
+ * Providers run asynchronously and stream their results as they come. If
+ * they have not all completed by the deadline, the search is cancelled
+ * and completed with whatever results arrived, so that a slow provider
+ * cannot hold up the results of the others.
+ */
+#define DEADLINE_MSEC 500
+
 struct _IdeSearchContext
 {
   IdeObject     parent_instance;
@@ -33,6 +42,7 @@ struct _IdeSearchContext
   GList        *providers;
   gsize         max_results;
   guint         in_progress;
+  guint         deadline_source;
   guint         executed : 1;
 };
 
@@ -65,8 +75,18 @@ ide_search_context_provider_completed (IdeSearchContext  *self,
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
   g_return_if_fail (g_list_find (self->providers, provider));
 
+  /* Already completed by the deadline */
+  if (self->in_progress == 0)
+    return;
+
   if (--self->in_progress == 0)
-    g_signal_emit (self, signals [COMPLETED], 0);
+    {
+      ide_clear_source (&self->deadline_source);
+
+      /* Nobody is interested in the results of a cancelled search anymore */
+      if (!g_cancellable_is_cancelled (self->cancellable))
+        g_signal_emit (self, signals [COMPLETED], 0);
+    }
 }
 
 /**
@@ -96,6 +116,9 @@ ide_search_context_add_result (IdeSearchContext  *self,
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
   g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
 
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return;
+
   g_signal_emit (self, signals [RESULT_ADDED], 0, provider, result);
 }
 
@@ -109,6 +132,9 @@ ide_search_context_remove_result (IdeSearchContext  *self,
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
   g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
 
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return;
+
   g_signal_emit (self, signals [RESULT_REMOVED], 0, provider, result);
 }
 
@@ -124,6 +150,27 @@ ide_search_context_set_provider_count (IdeSearchContext  *self,
   g_signal_emit (self, signals [COUNT_SET], 0, provider, count);
 }
 
+static gboolean
+ide_search_context_deadline_cb (gpointer user_data)
+{
+  IdeSearchContext *self = user_data;
+
+  g_assert (IDE_IS_SEARCH_CONTEXT (self));
+
+  self->deadline_source = 0;
+
+  if (self->in_progress > 0)
+    {
+      g_debug ("%u search providers missed the deadline", self->in_progress);
+
+      self->in_progress = 0;
+      g_cancellable_cancel (self->cancellable);
+      g_signal_emit (self, signals [COMPLETED], 0);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
 void
 ide_search_context_execute (IdeSearchContext *self,
                             const gchar      *search_terms,
@@ -157,6 +204,11 @@ ide_search_context_execute (IdeSearchContext *self,
                                     self->cancellable);
     }
 
+  if (self->in_progress > 0)
+    self->deadline_source = g_timeout_add (DEADLINE_MSEC,
+                                           ide_search_context_deadline_cb,
+                                           self);
+
   IDE_EXIT;
 }
 
@@ -166,6 +218,8 @@ ide_search_context_cancel (IdeSearchContext *self)
   g_return_if_fail (IDE_IS_MAIN_THREAD ());
   g_return_if_fail (IDE_IS_SEARCH_CONTEXT (self));
 
+  ide_clear_source (&self->deadline_source);
+
   if (!g_cancellable_is_cancelled (self->cancellable))
     g_cancellable_cancel (self->cancellable);
 }
@@ -189,6 +243,8 @@ ide_search_context_finalize (GObject *object)
   IdeSearchContext *self = (IdeSearchContext *)object;
   GList *copy;
 
+  ide_clear_source (&self->deadline_source);
+
   copy = self->providers, self->providers = NULL;
   g_list_foreach (copy, (GFunc)g_object_unref, NULL);
   g_list_free (copy);
@@ -131,6 +131,12 @@ ide_source_snippets_foreach (IdeSourceSnippets *snippets,
   if (!prefix)
     prefix = "";
 
+  /*
+   * Snippets are added while loading and then looked up on every
+   * keystroke, compact them on first use. Adding more thaws them back.
+   */
+  trie_freeze (snippets->snippets);
+
   trie_traverse (snippets->snippets,
                  prefix,
                  G_PRE_ORDER,
@@ -18,9 +18,13 @@
 
 #define G_LOG_DOMAIN "ide-indenter"
 
+#include <string.h>
+
 #include "ide-context.h"
 #include "ide-indenter.h"
 
+#include "util/ide-gdk.h"
+
 G_DEFINE_INTERFACE (IdeIndenter, ide_indenter, G_TYPE_OBJECT)
 
 static gchar *
@@ -41,11 +45,93 @@ ide_indenter_default_is_trigger (IdeIndenter *self,
   return FALSE;
 }
 
+/*
+ * Reindents each line as if Return had been pressed right before its first
+ * non-blank character, in a single pass from the first line to the last.
+ * Indenters look back at the lines above, so every line is computed from
+ * the already reindented lines before it. Only the leading whitespace of
+ * each line is replaced, the rest of the text is never moved.
+ */
+static void
+ide_indenter_real_reindent (IdeIndenter *self,
+                            GtkTextView *text_view,
+                            GtkTextIter *begin,
+                            GtkTextIter *end)
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark *end_mark;
+  GdkEventKey *event;
+  GdkWindow *window;
+  guint line;
+
+  g_assert (IDE_IS_INDENTER (self));
+  g_assert (GTK_IS_TEXT_VIEW (text_view));
+
+  buffer = gtk_text_view_get_buffer (text_view);
+  window = gtk_text_view_get_window (text_view, GTK_TEXT_WINDOW_TEXT);
+  event = ide_gdk_synthesize_event_key (window, '\n');
+  end_mark = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
+
+  for (line = gtk_text_iter_get_line (begin); ; line++)
+    {
+      g_autofree gchar *indent = NULL;
+      const gchar *text;
+      GtkTextIter line_begin;
+      GtkTextIter text_begin;
+      GtkTextIter limit;
+      gint cursor_offset = 0;
+
+      gtk_text_buffer_get_iter_at_line (buffer, &line_begin, line);
+      gtk_text_buffer_get_iter_at_mark (buffer, &limit, end_mark);
+
+      if (gtk_text_iter_get_line (&line_begin) != (gint)line ||
+          gtk_text_iter_compare (&line_begin, &limit) > 0)
+        break;
+
+      text_begin = line_begin;
+      while (!gtk_text_iter_ends_line (&text_begin) &&
+             g_unichar_isspace (gtk_text_iter_get_char (&text_begin)))
+        gtk_text_iter_forward_char (&text_begin);
+
+      if (!gtk_text_iter_equal (&line_begin, &text_begin))
+        gtk_text_buffer_delete (buffer, &line_begin, &text_begin);
+
+      /* Nothing precedes the first line to be indented against */
+      if (line == 0)
+        continue;
+
+      text_begin = line_begin;
+      indent = ide_indenter_format (self, text_view, &line_begin, &text_begin, &cursor_offset, event);
+
+      if (indent == NULL)
+        continue;
+
+      /*
+       * Pressing Return before a closing brace or tag may split the pair
+       * onto two lines, in which case the indentation of our text is the
+       * part after the newline.
+       */
+      if (NULL != (text = strrchr (indent, '\n')))
+        text++;
+      else
+        text = indent;
+
+      if (!gtk_text_iter_equal (&line_begin, &text_begin))
+        gtk_text_buffer_delete (buffer, &line_begin, &text_begin);
+
+      gtk_text_buffer_insert (buffer, &line_begin, text, -1);
+    }
+
+  gtk_text_buffer_delete_mark (buffer, end_mark);
+  gdk_event_free ((GdkEvent *)event);
+}
+
 static void
 ide_indenter_default_init (IdeIndenterInterface *iface)
 {
   iface->format = ide_indenter_default_format;
   iface->is_trigger = ide_indenter_default_is_trigger;
+  iface->reindent = ide_indenter_real_reindent;
 
   g_object_interface_install_property (iface,
                                        g_param_spec_object ("context",
@@ -111,3 +197,47 @@ ide_indenter_is_trigger (IdeIndenter *self,
 
   return IDE_INDENTER_GET_IFACE (self)->is_trigger (self, event);
 }
+
+/**
+ * ide_indenter_reindent:
+ * @self: an #IdeIndenter
+ * @text_view: A #GtkTextView
+ * @begin: A #GtkTextIter within the first line to reindent.
+ * @end: A #GtkTextIter within the last line to reindent.
+ *
+ * Reindents all of the lines between @begin and @end. Implementations may
+ * override this to compute the indentation of the whole range at once, the
+ * default applies the rules of ide_indenter_format() for Return to each
+ * line in turn.
+ *
+ * Callers should group the call in a user action so that it is undone as
+ * a single edit. Upon return, @begin and @end are revalidated to span the
+ * reindented lines.
+ */
+void
+ide_indenter_reindent (IdeIndenter *self,
+                       GtkTextView *text_view,
+                       GtkTextIter *begin,
+                       GtkTextIter *end)
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark *end_mark;
+  guint line;
+
+  g_return_if_fail (IDE_IS_INDENTER (self));
+  g_return_if_fail (GTK_IS_TEXT_VIEW (text_view));
+  g_return_if_fail (begin != NULL);
+  g_return_if_fail (end != NULL);
+
+  gtk_text_iter_order (begin, end);
+
+  buffer = gtk_text_view_get_buffer (text_view);
+  line = gtk_text_iter_get_line (begin);
+  end_mark = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
+
+  IDE_INDENTER_GET_IFACE (self)->reindent (self, text_view, begin, end);
+
+  gtk_text_buffer_get_iter_at_line (buffer, begin, line);
+  gtk_text_buffer_get_iter_at_mark (buffer, end, end_mark);
+  gtk_text_buffer_delete_mark (buffer, end_mark);
+}
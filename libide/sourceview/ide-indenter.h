@@ -43,6 +43,10 @@ struct _IdeIndenterInterface
                             GdkEventKey   *event);
   void      (*set_context) (IdeIndenter   *self,
                             IdeContext    *context);
+  void      (*reindent)    (IdeIndenter   *self,
+                            GtkTextView   *text_view,
+                            GtkTextIter   *begin,
+                            GtkTextIter   *end);
 };
 
 gboolean  ide_indenter_is_trigger (IdeIndenter *self,
@@ -53,6 +57,10 @@ gchar    *ide_indenter_format     (IdeIndenter *self,
                                    GtkTextIter *end,
                                    gint        *cursor_offset,
                                    GdkEventKey *event);
+void      ide_indenter_reindent   (IdeIndenter *self,
+                                   GtkTextView *text_view,
+                                   GtkTextIter *begin,
+                                   GtkTextIter *end);
 
 G_END_DECLS
 
@@ -24,6 +24,8 @@
 #include "ide-debug.h"
 #include "ide-internal.h"
 
+#include "buffers/ide-buffer-structure.h"
+#include "buffers/ide-buffer.h"
 #include "sourceview/ide-source-iter.h"
 #include "sourceview/ide-source-view-movements.h"
 #include "sourceview/ide-text-iter.h"
@@ -919,6 +921,17 @@ ide_source_view_movements_move_page (Movement *mv)
     }
 }
 
+static IdeBufferStructure *
+get_structure (const GtkTextIter *iter)
+{
+  GtkTextBuffer *buffer = gtk_text_iter_get_buffer (iter);
+
+  if (IDE_IS_BUFFER (buffer))
+    return ide_buffer_get_structure (IDE_BUFFER (buffer));
+
+  return NULL;
+}
+
 static gboolean
 bracket_predicate (GtkTextIter *iter,
                    gunichar     ch,
@@ -962,6 +975,7 @@ match_char_with_depth (GtkTextIter      *iter,
                        gboolean          is_exclusive,
                        gboolean          string_mode)
 {
+  IdeBufferStructure *structure;
   MatchingBracketState state;
   GtkTextIter limit;
   gboolean ret;
@@ -970,6 +984,41 @@ match_char_with_depth (GtkTextIter      *iter,
   g_return_val_if_fail ((left_char == right_char && string_mode) ||
                         (left_char != right_char && !string_mode), FALSE);
 
+  /*
+   * If the buffer has a structural index, use it to jump straight to the
+   * enclosing bracket. Brackets within comments and strings are skipped, so
+   * we only do this when not starting from within one of those.
+   */
+  if (!string_mode &&
+      NULL != (structure = get_structure (iter)) &&
+      IDE_BUFFER_SPAN_NONE == ide_buffer_structure_get_span (structure, iter, NULL, NULL))
+    {
+      GtkTextIter open;
+
+      limit = *iter;
+
+      if (direction == GTK_DIR_LEFT)
+        {
+          if (!gtk_text_iter_ends_line (&limit) && gtk_text_iter_get_char (&limit) != right_char)
+            gtk_text_iter_forward_char (&limit);
+
+          if ((ret = ide_buffer_structure_find_enclosing_bracket (structure, &limit, left_char, depth, &open)))
+            *iter = open;
+        }
+      else
+        {
+          gtk_text_iter_forward_char (&limit);
+
+          ret = ide_buffer_structure_find_enclosing_bracket (structure, &limit, left_char, depth, &open) &&
+                ide_buffer_structure_find_matching_bracket (structure, &open, iter);
+        }
+
+      if (ret && !is_exclusive)
+        gtk_text_iter_forward_char (iter);
+
+      return ret;
+    }
+
   state.jump_from = left_char;
   state.jump_to = right_char;
   state.direction = direction;
@@ -1186,12 +1235,21 @@ macro_conditionals_skip_block_forward (GtkTextIter *insert)
 static gboolean
 match_macro_conditionals (GtkTextIter *insert)
 {
+  IdeBufferStructure *structure;
   GtkTextIter cursor;
   GtkTextIter cond_start;
   GtkTextIter cond_end;
   MacroCond next_cond;
   MacroCond cond;
 
+  if (NULL != (structure = get_structure (insert)) &&
+      ide_buffer_structure_find_matching_conditional (structure, insert, &cursor))
+    {
+      *insert = cursor;
+
+      return TRUE;
+    }
+
   cond = macro_conditionals_qualify_iter (insert, &cond_start, &cond_end, TRUE);
   if (cond == MACRO_COND_NONE)
     return FALSE;
@@ -1228,6 +1286,7 @@ static gboolean
 match_comments (GtkTextIter *insert,
                 gunichar     ch)
 {
+  IdeBufferStructure *structure;
   GtkTextIter cursor;
   GtkTextIter cursor_before;
   GtkTextIter cursor_after;
@@ -1239,6 +1298,45 @@ match_comments (GtkTextIter *insert,
   if (gtk_text_iter_forward_char (&cursor_after))
     ch_after = gtk_text_iter_get_char (&cursor_after);
 
+  if (NULL != (structure = get_structure (insert)))
+    {
+      GtkTextIter begin;
+      GtkTextIter end;
+
+      if (IDE_BUFFER_SPAN_COMMENT == ide_buffer_structure_get_span (structure, insert, &begin, &end))
+        {
+          gint offset = gtk_text_iter_get_offset (insert);
+          gint begin_offset = gtk_text_iter_get_offset (&begin);
+          gint end_offset = gtk_text_iter_get_offset (&end);
+          gboolean terminated;
+
+          cursor = end;
+          terminated = (end_offset - begin_offset >= 4 &&
+                        gtk_text_iter_backward_char (&cursor) &&
+                        gtk_text_iter_get_char (&cursor) == '/' &&
+                        gtk_text_iter_backward_char (&cursor) &&
+                        gtk_text_iter_get_char (&cursor) == '*');
+
+          if (terminated && offset - begin_offset < 2)
+            {
+              *insert = end;
+              gtk_text_iter_backward_char (insert);
+
+              return TRUE;
+            }
+          else if (terminated && end_offset - offset <= 2)
+            {
+              *insert = begin;
+
+              return TRUE;
+            }
+        }
+
+      *insert = cursor_after;
+
+      return FALSE;
+    }
+
   cursor_before = *insert;
   if (gtk_text_iter_backward_char (&cursor_before))
     ch_before = gtk_text_iter_get_char (&cursor_before);
@@ -82,6 +82,7 @@
 #define FIXIT_LABEL_LEN_MAX 30
 #define SCROLL_REPLAY_DELAY 1000
 #define DEFAULT_OVERSCROLL_NUM_LINES 1
+#define TAG_AFFECTS_LAYOUT_KEY "IDE_SOURCE_VIEW_TAG_AFFECTS_LAYOUT"
 #define TAG_DEFINITION "action::hover-definition"
 #define DEFINITION_HIGHLIGHT_MODIFIER GDK_CONTROL_MASK
 
@@ -165,6 +166,21 @@ typedef struct
 
   GRegex                      *include_regex;
 
+  /*
+   * Search bubble rectangles for the lines between search_bubbles_begin_line
+   * and search_bubbles_end_line. They are relative to the top of their line,
+   * so lines elsewhere changing height do not move them. They are valid as
+   * long as the buffer, search settings, text width, and the layout of the
+   * cached lines themselves are unchanged.
+   */
+  GArray                      *search_bubbles;
+  guint                        search_bubbles_change_sequence;
+  guint                        search_bubbles_settings_generation;
+  gint                         search_bubbles_width;
+  gint                         search_bubbles_begin_line;
+  gint                         search_bubbles_end_line;
+  guint                        search_settings_generation;
+
   guint                        auto_indent : 1;
   guint                        completion_blocked : 1;
   guint                        completion_visible : 1;
@@ -198,6 +214,13 @@ typedef struct
   guint             exclusive : 1;
 } SearchMovement;
 
+typedef struct
+{
+  /* y is relative to the top of @line */
+  GdkRectangle      area;
+  gint              line;
+} SearchBubble;
+
 typedef struct
 {
   IdeSourceView    *self;
@@ -1049,6 +1072,116 @@ ide_source_view__buffer_changed_cb (IdeSourceView *self,
   priv->change_sequence++;
 }
 
+static void
+ide_source_view_invalidate_search_bubbles (IdeSourceView *self)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  priv->search_settings_generation++;
+}
+
+/*
+ * Checks if @tag sets anything that changes the size or position of the
+ * text it covers. The answer is cached on the tag until the tag table
+ * reports that the tag changed.
+ */
+static gboolean
+ide_source_view_tag_affects_layout (GtkTextTag *tag)
+{
+  static const gchar *layout_properties[] = {
+    "family-set", "style-set", "variant-set", "weight-set", "stretch-set",
+    "size-set", "scale-set", "rise-set", "letter-spacing-set",
+    "pixels-above-lines-set", "pixels-below-lines-set",
+    "pixels-inside-wrap-set", "indent-set", "left-margin-set",
+    "right-margin-set", "tabs-set", "wrap-mode-set", "invisible-set",
+  };
+  gpointer cached;
+  gboolean affects = FALSE;
+  guint i;
+
+  g_assert (GTK_IS_TEXT_TAG (tag));
+
+  if (NULL != (cached = g_object_get_data (G_OBJECT (tag), TAG_AFFECTS_LAYOUT_KEY)))
+    return GPOINTER_TO_INT (cached) == 2;
+
+  for (i = 0; !affects && i < G_N_ELEMENTS (layout_properties); i++)
+    g_object_get (tag, layout_properties [i], &affects, NULL);
+
+  g_object_set_data (G_OBJECT (tag), TAG_AFFECTS_LAYOUT_KEY, GINT_TO_POINTER (affects ? 2 : 1));
+
+  return affects;
+}
+
+static void
+ide_source_view_forget_tag_layout (GtkTextTag *tag,
+                                   gpointer    user_data)
+{
+  g_object_set_data (G_OBJECT (tag), TAG_AFFECTS_LAYOUT_KEY, NULL);
+}
+
+static void
+ide_source_view__tag_table_tag_changed_cb (IdeSourceView   *self,
+                                           GtkTextTag      *tag,
+                                           gboolean         size_changed,
+                                           GtkTextTagTable *tag_table)
+{
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (GTK_IS_TEXT_TAG (tag));
+  g_assert (GTK_IS_TEXT_TAG_TABLE (tag_table));
+
+  ide_source_view_forget_tag_layout (tag, NULL);
+
+  if (size_changed)
+    ide_source_view_invalidate_search_bubbles (self);
+}
+
+/*
+ * Tags can change fonts or spacing, which moves matches within their line.
+ * Highlighters tag text as it is scrolled into view, but their tags rarely
+ * change the layout, so only drop the cached bubbles for tags that do and
+ * whose range overlaps them.
+ */
+static void
+ide_source_view__buffer_tag_changed_cb (IdeSourceView     *self,
+                                        GtkTextTag        *tag,
+                                        const GtkTextIter *begin,
+                                        const GtkTextIter *end,
+                                        IdeBuffer         *buffer)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (GTK_IS_TEXT_TAG (tag));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (priv->search_bubbles_begin_line < 0 ||
+      !ide_source_view_tag_affects_layout (tag) ||
+      gtk_text_iter_get_line (end) < priv->search_bubbles_begin_line ||
+      gtk_text_iter_get_line (begin) > priv->search_bubbles_end_line)
+    return;
+
+  ide_source_view_invalidate_search_bubbles (self);
+}
+
+static void
+ide_source_view_notify_layout_cb (IdeSourceView *self,
+                                  GParamSpec    *pspec,
+                                  gpointer       user_data)
+{
+  static const gchar *layout_properties[] = {
+    "indent", "left-margin", "right-margin", "pixels-above-lines",
+    "pixels-below-lines", "pixels-inside-wrap", "tabs", "tab-width",
+    "wrap-mode", NULL
+  };
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  if (g_strv_contains (layout_properties, pspec->name))
+    ide_source_view_invalidate_search_bubbles (self);
+}
+
 static void
 ide_source_view__search_settings_notify_search_text (IdeSourceView           *self,
                                                      GParamSpec              *pspec,
@@ -1588,6 +1721,9 @@ ide_source_view_bind_buffer (IdeSourceView  *self,
 
   ide_buffer_hold (buffer);
 
+  if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    _ide_buffer_set_mapped (buffer, TRUE);
+
   if (_ide_buffer_get_loading (buffer))
     {
       GtkSourceCompletion *completion;
@@ -1635,8 +1771,26 @@ ide_source_view_bind_buffer (IdeSourceView  *self,
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (search_settings,
+                           "notify",
+                           G_CALLBACK (ide_source_view_invalidate_search_bubbles),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  ide_source_view_invalidate_search_bubbles (self);
+
   g_clear_object (&search_settings);
 
+  /* Tags may have changed while no view was watching them */
+  gtk_text_tag_table_foreach (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (buffer)),
+                              ide_source_view_forget_tag_layout,
+                              NULL);
+  g_signal_connect_object (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (buffer)),
+                           "tag-changed",
+                           G_CALLBACK (ide_source_view__tag_table_tag_changed_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   /* Create scroll mark used by movements and our scrolling helper */
   gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &iter);
   priv->scroll_mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (buffer), NULL, &iter, TRUE);
@@ -1704,10 +1858,19 @@ ide_source_view_unbind_buffer (IdeSourceView  *self,
 
   g_clear_object (&priv->search_context);
   g_clear_object (&priv->indenter_adapter);
+
+  g_signal_handlers_disconnect_by_func (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (priv->buffer)),
+                                        G_CALLBACK (ide_source_view__tag_table_tag_changed_cb),
+                                        self);
+
+  ide_source_view_invalidate_search_bubbles (self);
   g_clear_object (&priv->completion_providers);
   g_clear_object (&priv->definition_highlight_start_mark);
   g_clear_object (&priv->definition_highlight_end_mark);
 
+  if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    _ide_buffer_set_mapped (priv->buffer, FALSE);
+
   ide_buffer_release (priv->buffer);
 
   IDE_EXIT;
@@ -2945,6 +3108,9 @@ ide_source_view_real_style_updated (GtkWidget *widget)
   pango_layout_set_text (layout, "X", 1);
   pango_layout_get_pixel_size (layout, &priv->cached_char_width, &priv->cached_char_height);
   g_object_unref (layout);
+
+  /* Font changes move every match rectangle */
+  ide_source_view_invalidate_search_bubbles (self);
 }
 
 static void
@@ -4292,10 +4458,6 @@ ide_source_view_real_reindent (IdeSourceView *self)
   GtkTextIter begin;
   GtkTextIter end;
   GdkWindow *window;
-  GtkTextIter iter;
-  guint i;
-  guint first_line;
-  g_autoptr(GPtrArray) lines = NULL;
 
   g_assert (IDE_IS_SOURCE_VIEW (self));
 
@@ -4311,9 +4473,6 @@ ide_source_view_real_reindent (IdeSourceView *self)
   gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
   gtk_text_iter_order (&begin, &end);
 
-  gtk_text_iter_set_line_offset (&begin, 0);
-  first_line = gtk_text_iter_get_line (&begin);
-
   /* if the end position is at index 0 of the next line (common with
    * line mode in vim), then move it back to the end of the previous
    * line, since we don't really care about that next line.
@@ -4322,63 +4481,25 @@ ide_source_view_real_reindent (IdeSourceView *self)
       gtk_text_iter_get_line (&begin) != gtk_text_iter_get_line (&end))
     gtk_text_iter_backward_char (&end);
 
-  if (!gtk_text_iter_ends_line (&end))
-    gtk_text_iter_forward_to_line_end (&end);
-
-  lines = g_ptr_array_new_with_free_func (g_free);
-
-  if (gtk_text_iter_compare (&begin, &end) == 0)
-    g_ptr_array_add (lines, g_strdup (""));
-  else
-    for (iter = begin;
-         gtk_text_iter_compare (&iter, &end) < 0;
-         gtk_text_iter_forward_line (&iter))
-      {
-        GtkTextIter line_end = iter;
-        gchar *line;
-
-        if (!gtk_text_iter_ends_line (&line_end))
-          gtk_text_iter_forward_to_line_end (&line_end);
-
-        line = gtk_text_iter_get_slice (&iter, &line_end);
-        g_ptr_array_add (lines, g_strstrip (line));
-      }
-
+  /*
+   * The indenter updates the buffer line by line, as each line is indented
+   * against the lines above it. Hold back the buffer listeners (highlighting,
+   * diagnostics, change monitors, and language servers) so they only process
+   * the result once, and undo it as a single edit.
+   */
+  if (window != NULL)
+    gdk_window_freeze_updates (window);
+  ide_buffer_freeze_changes (priv->buffer);
   gtk_text_buffer_begin_user_action (buffer);
 
-  gtk_text_buffer_delete (buffer, &begin, &end);
-
-  for (i = 0; i < lines->len; i++)
-    {
-      g_autofree gchar *indent = NULL;
-      const gchar *line;
-      GdkEventKey *event;
-      gint cursor_offset;
-
-      line = g_ptr_array_index (lines, i);
-      event = ide_gdk_synthesize_event_key (window, '\n');
-      indent = ide_indenter_format (indenter, GTK_TEXT_VIEW (self), &begin, &end, &cursor_offset, event);
-      gdk_event_free ((GdkEvent *)event);
-
-      if (indent != NULL)
-        {
-          if (!gtk_text_iter_equal (&begin, &end))
-            gtk_text_buffer_delete (buffer, &begin, &end);
-
-          gtk_text_buffer_insert (buffer, &begin, indent, -1);
-          gtk_text_buffer_insert (buffer, &begin, line, -1);
-
-          if (i != lines->len - 1)
-            gtk_text_buffer_insert (buffer, &begin, "\n", -1);
-        }
-
-      end = begin;
-    }
+  ide_indenter_reindent (indenter, GTK_TEXT_VIEW (self), &begin, &end);
 
   gtk_text_buffer_end_user_action (buffer);
+  ide_buffer_thaw_changes (priv->buffer);
+  if (window != NULL)
+    gdk_window_thaw_updates (window);
 
   /* Advance to first non-whitespace */
-  gtk_text_iter_set_line (&begin, first_line);
   while (!gtk_text_iter_ends_line (&begin) &&
          g_unichar_isspace (gtk_text_iter_get_char (&begin)))
     gtk_text_iter_forward_char (&begin);
@@ -4622,16 +4743,16 @@ draw_bezel (cairo_t                     *cr,
 
 static void
 add_match (GtkTextView       *text_view,
-           cairo_region_t    *region,
+           GArray            *bubbles,
            const GtkTextIter *begin,
            const GtkTextIter *end)
 {
   GdkRectangle begin_rect;
   GdkRectangle end_rect;
-  cairo_rectangle_int_t rect;
+  SearchBubble bubble;
 
   g_assert (GTK_IS_TEXT_VIEW (text_view));
-  g_assert (region);
+  g_assert (bubbles);
   g_assert (begin);
   g_assert (end);
 
@@ -4641,33 +4762,36 @@ add_match (GtkTextView       *text_view,
 
   if (gtk_text_iter_get_line (begin) == gtk_text_iter_get_line (end))
     {
+      gint line_y;
+
+      /*
+       * Keep the rectangle relative to its line so that it remains valid
+       * while scrolling, or when lines above it are validated or wrapped.
+       * It is translated to window coordinates at draw time.
+       */
       gtk_text_view_get_iter_location (text_view, begin, &begin_rect);
-      gtk_text_view_buffer_to_window_coords (text_view, GTK_TEXT_WINDOW_TEXT,
-                                             begin_rect.x, begin_rect.y,
-                                             &begin_rect.x, &begin_rect.y);
       gtk_text_view_get_iter_location (text_view, end, &end_rect);
-      gtk_text_view_buffer_to_window_coords (text_view, GTK_TEXT_WINDOW_TEXT,
-                                             end_rect.x, end_rect.y,
-                                             &end_rect.x, &end_rect.y);
-      rect.x = begin_rect.x;
-      rect.y = begin_rect.y;
-      rect.width = end_rect.x - begin_rect.x;
-      rect.height = MAX (begin_rect.height, end_rect.height);
-      cairo_region_union_rectangle (region, &rect);
+      gtk_text_view_get_line_yrange (text_view, begin, &line_y, NULL);
+      bubble.line = gtk_text_iter_get_line (begin);
+      bubble.area.x = begin_rect.x;
+      bubble.area.y = begin_rect.y - line_y;
+      bubble.area.width = end_rect.x - begin_rect.x;
+      bubble.area.height = MAX (begin_rect.height, end_rect.height);
+      g_array_append_val (bubbles, bubble);
       return;
     }
 
   /*
    * TODO: Add support for multi-line matches. When @begin and @end are not
-   *       on the same line, we need to add the match region to @region so
+   *       on the same line, we need to add the match region to @bubbles so
    *       ide_source_view_draw_search_bubbles() can draw search bubbles
    *       around it.
    */
 }
 
-static guint
+static void
 add_matches (GtkTextView            *text_view,
-             cairo_region_t         *region,
+             GArray                 *bubbles,
              GtkSourceSearchContext *search_context,
              const GtkTextIter      *begin,
              const GtkTextIter      *end)
@@ -4677,10 +4801,9 @@ add_matches (GtkTextView            *text_view,
   GtkTextIter match_begin;
   GtkTextIter match_end;
   gboolean has_wrapped;
-  guint count = 1;
 
   g_assert (GTK_IS_TEXT_VIEW (text_view));
-  g_assert (region);
+  g_assert (bubbles);
   g_assert (GTK_SOURCE_IS_SEARCH_CONTEXT (search_context));
   g_assert (begin);
   g_assert (end);
@@ -4689,10 +4812,12 @@ add_matches (GtkTextView            *text_view,
                                            begin,
                                            &first_begin,
                                            &match_end,
-                                           &has_wrapped))
-    return 0;
+                                           &has_wrapped) ||
+      has_wrapped ||
+      (gtk_text_iter_compare (&first_begin, end) >= 0))
+    return;
 
-  add_match (text_view, region, &first_begin, &match_end);
+  add_match (text_view, bubbles, &first_begin, &match_end);
 
   for (;; )
     {
@@ -4703,18 +4828,101 @@ add_matches (GtkTextView            *text_view,
                                               &match_begin,
                                               &match_end,
                                               &has_wrapped) &&
+          !has_wrapped &&
           (gtk_text_iter_compare (&match_begin, end) < 0) &&
           (gtk_text_iter_compare (&first_begin, &match_begin) != 0))
         {
-          add_match (text_view, region, &match_begin, &match_end);
-          count++;
+          add_match (text_view, bubbles, &match_begin, &match_end);
           continue;
         }
 
       break;
     }
+}
 
-  return count;
+static void
+add_matches_for_lines (IdeSourceView *self,
+                       gint           begin_line,
+                       gint           end_line)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+  GtkTextBuffer *buffer;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (begin_line <= end_line);
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self));
+
+  gtk_text_buffer_get_iter_at_line (buffer, &begin, begin_line);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, end_line);
+  if (!gtk_text_iter_forward_line (&end))
+    gtk_text_buffer_get_end_iter (buffer, &end);
+
+  add_matches (GTK_TEXT_VIEW (self), priv->search_bubbles, priv->search_context, &begin, &end);
+}
+
+/*
+ * Ensures priv->search_bubbles contains the matches for every line between
+ * @begin_line and @end_line (inclusive). Only lines that were not part of
+ * the previous frame are searched, so scrolling with a common search term
+ * does not requery the search context for the whole visible area.
+ */
+static void
+ide_source_view_update_search_bubbles (IdeSourceView *self,
+                                       gint           begin_line,
+                                       gint           end_line)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+  GdkWindow *window;
+  gint width;
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (begin_line <= end_line);
+
+  window = gtk_text_view_get_window (GTK_TEXT_VIEW (self), GTK_TEXT_WINDOW_TEXT);
+  width = gdk_window_get_width (window);
+
+  if ((priv->search_bubbles_change_sequence != priv->change_sequence) ||
+      (priv->search_bubbles_settings_generation != priv->search_settings_generation) ||
+      (priv->search_bubbles_width != width))
+    {
+      priv->search_bubbles_change_sequence = priv->change_sequence;
+      priv->search_bubbles_settings_generation = priv->search_settings_generation;
+      priv->search_bubbles_width = width;
+      priv->search_bubbles_begin_line = -1;
+      priv->search_bubbles_end_line = -1;
+    }
+
+  /*
+   * If the cached range is not adjacent to the requested range, or it has
+   * grown well beyond what we are drawing, start over with just the lines
+   * that are exposed.
+   */
+  if ((priv->search_bubbles_begin_line < 0) ||
+      (end_line + 1 < priv->search_bubbles_begin_line) ||
+      (begin_line > priv->search_bubbles_end_line + 1) ||
+      ((priv->search_bubbles_end_line - priv->search_bubbles_begin_line) > 4 * (end_line - begin_line + 1)))
+    {
+      g_array_set_size (priv->search_bubbles, 0);
+      add_matches_for_lines (self, begin_line, end_line);
+      priv->search_bubbles_begin_line = begin_line;
+      priv->search_bubbles_end_line = end_line;
+      return;
+    }
+
+  if (begin_line < priv->search_bubbles_begin_line)
+    {
+      add_matches_for_lines (self, begin_line, priv->search_bubbles_begin_line - 1);
+      priv->search_bubbles_begin_line = begin_line;
+    }
+
+  if (end_line > priv->search_bubbles_end_line)
+    {
+      add_matches_for_lines (self, priv->search_bubbles_end_line + 1, end_line);
+      priv->search_bubbles_end_line = end_line;
+    }
 }
 
 void
@@ -4729,9 +4937,15 @@ ide_source_view_draw_search_bubbles (IdeSourceView *self,
   GtkTextIter begin;
   GtkTextIter end;
   cairo_rectangle_int_t r;
-  guint count;
+  guint count = 0;
   gint buffer_x = 0;
   gint buffer_y = 0;
+  gint window_x = 0;
+  gint window_y = 0;
+  gint begin_line;
+  gint end_line;
+  gint line = -1;
+  gint line_y = 0;
   gint n;
   gint i;
 
@@ -4752,9 +4966,40 @@ ide_source_view_draw_search_bubbles (IdeSourceView *self,
                                       buffer_x + area.width,
                                       buffer_y + area.height);
 
+  begin_line = gtk_text_iter_get_line (&begin);
+  end_line = gtk_text_iter_get_line (&end);
+
+  ide_source_view_update_search_bubbles (self, begin_line, end_line);
+
+  gtk_text_view_buffer_to_window_coords (text_view, GTK_TEXT_WINDOW_TEXT,
+                                         0, 0, &window_x, &window_y);
+
   clip_region = cairo_region_create_rectangle (&area);
   match_region = cairo_region_create ();
-  count = add_matches (text_view, match_region, priv->search_context, &begin, &end);
+
+  for (guint j = 0; j < priv->search_bubbles->len; j++)
+    {
+      const SearchBubble *bubble = &g_array_index (priv->search_bubbles, SearchBubble, j);
+
+      if (bubble->line < begin_line || bubble->line > end_line)
+        continue;
+
+      /* Matches on the same line are adjacent, so look up each line once */
+      if (bubble->line != line)
+        {
+          GtkTextIter iter;
+
+          line = bubble->line;
+          gtk_text_buffer_get_iter_at_line (gtk_text_view_get_buffer (text_view), &iter, line);
+          gtk_text_view_get_line_yrange (text_view, &iter, &line_y, NULL);
+        }
+
+      r = bubble->area;
+      r.x += window_x;
+      r.y += window_y + line_y;
+      cairo_region_union_rectangle (match_region, &r);
+      count++;
+    }
 
   cairo_region_subtract (clip_region, match_region);
 
@@ -5084,6 +5329,8 @@ ide_source_view_real_replay_macro (IdeSourceView *self,
 {
   IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
   IdeSourceViewCapture *capture;
+  GtkTextMark *insert;
+  GdkWindow *window;
   gint count = 1;
   gsize i;
 
@@ -5103,14 +5350,27 @@ ide_source_view_real_replay_macro (IdeSourceView *self,
       IDE_EXIT;
     }
 
-  if (priv->capture == NULL)
-    return;
+  if (priv->capture == NULL || priv->buffer == NULL)
+    IDE_EXIT;
 
   if (use_count)
     count = MAX (1, priv->count);
 
   IDE_TRACE_MSG ("Replaying capture %d times.", count);
 
+  /*
+   * Replaying synthesizes every recorded event, which can be thousands of
+   * small edits with a large count. Group them into a single user action,
+   * ask the buffer listeners (highlighting, change monitor, diagnostics,
+   * language servers) to defer their work until we are done, and avoid
+   * painting the intermediate states.
+   */
+  window = gtk_widget_get_window (GTK_WIDGET (self));
+  if (window != NULL)
+    gdk_window_freeze_updates (window);
+  ide_buffer_freeze_changes (priv->buffer);
+  gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (priv->buffer));
+
   priv->in_replay_macro = TRUE;
   capture = priv->capture, priv->capture = NULL;
   for (i = 0; i < count; i++)
@@ -5119,6 +5379,14 @@ ide_source_view_real_replay_macro (IdeSourceView *self,
   priv->capture = capture, capture = NULL;
   priv->in_replay_macro = FALSE;
 
+  gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (priv->buffer));
+  ide_buffer_thaw_changes (priv->buffer);
+  if (window != NULL)
+    gdk_window_thaw_updates (window);
+
+  insert = gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (priv->buffer));
+  ide_source_view_scroll_mark_onscreen (self, insert, FALSE, 0, 0);
+
   IDE_EXIT;
 }
 
@@ -5496,6 +5764,40 @@ ide_source_view_do_size_allocate_hack (IdeSourceView *self,
   return TRUE;
 }
 
+static void
+ide_source_view_map (GtkWidget *widget)
+{
+  IdeSourceView *self = (IdeSourceView *)widget;
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  GTK_WIDGET_CLASS (ide_source_view_parent_class)->map (widget);
+
+  /*
+   * Let the buffer manager know this buffer is visible. priv->buffer is not
+   * cleared when unbinding, so make sure it is still our buffer.
+   */
+  if (priv->buffer != NULL &&
+      priv->buffer == (IdeBuffer *)gtk_text_view_get_buffer (GTK_TEXT_VIEW (self)))
+    _ide_buffer_set_mapped (priv->buffer, TRUE);
+}
+
+static void
+ide_source_view_unmap (GtkWidget *widget)
+{
+  IdeSourceView *self = (IdeSourceView *)widget;
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  if (priv->buffer != NULL &&
+      priv->buffer == (IdeBuffer *)gtk_text_view_get_buffer (GTK_TEXT_VIEW (self)))
+    _ide_buffer_set_mapped (priv->buffer, FALSE);
+
+  GTK_WIDGET_CLASS (ide_source_view_parent_class)->unmap (widget);
+}
+
 static void
 ide_source_view_size_allocate (GtkWidget     *widget,
                                GtkAllocation *allocation)
@@ -5845,6 +6147,7 @@ ide_source_view_finalize (GObject *object)
   g_clear_pointer (&priv->snippets, g_queue_free);
   g_clear_pointer (&priv->include_regex, g_regex_unref);
   g_clear_pointer (&priv->saved_search_text, g_free);
+  g_clear_pointer (&priv->search_bubbles, g_array_unref);
 
   EGG_COUNTER_DEC (instances);
 
@@ -6084,7 +6387,9 @@ ide_source_view_class_init (IdeSourceViewClass *klass)
   widget_class->key_release_event = ide_source_view_key_release_event;
   widget_class->query_tooltip = ide_source_view_query_tooltip;
   widget_class->scroll_event = ide_source_view_scroll_event;
+  widget_class->map = ide_source_view_map;
   widget_class->size_allocate = ide_source_view_size_allocate;
+  widget_class->unmap = ide_source_view_unmap;
   widget_class->style_updated = ide_source_view_real_style_updated;
 
   text_view_class->delete_from_cursor = ide_source_view_real_delete_from_cursor;
@@ -6950,6 +7255,14 @@ ide_source_view_init (IdeSourceView *self)
   priv->search_direction = GTK_DIR_DOWN;
   priv->command_str = g_string_sized_new (32);
   priv->overscroll_num_lines = DEFAULT_OVERSCROLL_NUM_LINES;
+  priv->search_bubbles = g_array_new (FALSE, FALSE, sizeof (SearchBubble));
+  priv->search_bubbles_begin_line = -1;
+  priv->search_bubbles_end_line = -1;
+
+  g_signal_connect (self,
+                    "notify",
+                    G_CALLBACK (ide_source_view_notify_layout_cb),
+                    NULL);
 
   priv->completion_providers_signals = egg_signal_group_new (IDE_TYPE_EXTENSION_SET_ADAPTER);
 
@@ -7056,6 +7369,16 @@ ide_source_view_init (IdeSourceView *self)
                                    G_CALLBACK (ide_source_view__buffer_notify_has_selection_cb),
                                    self,
                                    G_CONNECT_SWAPPED);
+  egg_signal_group_connect_object (priv->buffer_signals,
+                                   "apply-tag",
+                                   G_CALLBACK (ide_source_view__buffer_tag_changed_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+  egg_signal_group_connect_object (priv->buffer_signals,
+                                   "remove-tag",
+                                   G_CALLBACK (ide_source_view__buffer_tag_changed_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
   g_signal_connect_object (priv->buffer_signals,
                            "bind",
                            G_CALLBACK (ide_source_view_bind_buffer),
@@ -23,7 +23,6 @@
 #include <fcntl.h>
 #include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
-#include <gio/gunixfdlist.h>
 #include <glib-unix.h>
 #include <stdio.h>
 #include <string.h>
@@ -36,19 +35,14 @@
 
 #include "application/ide-application.h"
 #include "subprocess/ide-breakout-subprocess.h"
+#include "subprocess/ide-host-spawner.h"
 #include "util/ide-glib.h"
 
-#ifndef FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV
-# define FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV (1 << 0)
-#endif
-
 /*
- * One very non-ideal thing about this implementation is that we use a new
- * GDBusConnection for every instance. This is due to some difficulty in
- * dealing with our connection being closed out from underneath us. If we
- * can determine what was/is causing that, we should be able to move back
- * to a shared connection (although we might want a dedicated connection
- * for all subprocesses so that we can have exit-on-close => false).
+ * The host processes are spawned through IdeHostSpawner, which shares a
+ * single private connection (with exit-on-close => false) between all
+ * instances. If that connection is closed out from underneath us, the
+ * spawner synthesizes the completion of our command.
  */
 
 EGG_DEFINE_COUNTER (instances, "Subprocess", "HostCommand Instances", "Number of IdeBreakoutSubprocess instances")
@@ -57,8 +51,7 @@ struct _IdeBreakoutSubprocess
 {
   GObject parent_instance;
 
-  GDBusConnection *connection;
-  gulong connection_closed_handler;
+  IdeHostSpawner *spawner;
 
   GPid client_pid;
   gint status;
@@ -86,7 +79,6 @@ struct _IdeBreakoutSubprocess
 
   guint sigint_id;
   guint sigterm_id;
-  guint exited_subscription;
 
   /* GList of GTasks for wait_async() */
   GList *waiting;
@@ -542,20 +534,10 @@ ide_breakout_subprocess_send_signal (IdeSubprocess *subprocess,
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
 
   /* Signal delivery is not guaranteed, so we can drop this on the floor. */
-  if (self->client_has_exited || self->connection == NULL)
+  if (self->client_has_exited || self->client_pid == 0)
     IDE_EXIT;
 
-  IDE_TRACE_MSG ("Sending signal %d to pid %u", signal_num, (guint)self->client_pid);
-
-  g_dbus_connection_call_sync (self->connection,
-                               "org.freedesktop.Flatpak",
-                               "/org/freedesktop/Flatpak/Development",
-                               "org.freedesktop.Flatpak.Development",
-                               "HostCommandSignal",
-                               g_variant_new ("(uub)", self->client_pid, signal_num, TRUE),
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE, -1,
-                               NULL, NULL);
+  ide_host_spawner_send_signal (self->spawner, self->client_pid, signal_num);
 
   IDE_EXIT;
 }
@@ -928,19 +910,10 @@ static gboolean
 sigterm_handler (gpointer user_data)
 {
   IdeBreakoutSubprocess *self = user_data;
-  g_autoptr(GDBusConnection) bus = NULL;
 
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
 
-  g_dbus_connection_call_sync (self->connection,
-                               "org.freedesktop.Flatpak",
-                               "/org/freedesktop/Flatpak/Development",
-                               "org.freedesktop.Flatpak.Development",
-                               "HostCommandSignal",
-                               g_variant_new ("(uub)", self->client_pid, SIGTERM, TRUE),
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE, -1,
-                               NULL, NULL);
+  ide_host_spawner_send_signal (self->spawner, self->client_pid, SIGTERM);
 
   kill (getpid (), SIGTERM);
 
@@ -951,19 +924,10 @@ static gboolean
 sigint_handler (gpointer user_data)
 {
   IdeBreakoutSubprocess *self = user_data;
-  g_autoptr(GDBusConnection) bus = NULL;
 
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
 
-  g_dbus_connection_call_sync (self->connection,
-                               "org.freedesktop.Flatpak",
-                               "/org/freedesktop/Flatpak/Development",
-                               "org.freedesktop.Flatpak.Development",
-                               "HostCommandSignal",
-                               g_variant_new ("(uub)", self->client_pid, SIGINT, TRUE),
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE, -1,
-                               NULL, NULL);
+  ide_host_spawner_send_signal (self->spawner, self->client_pid, SIGINT);
 
   kill (getpid (), SIGINT);
 
@@ -1043,7 +1007,6 @@ ide_breakout_subprocess_complete_command_locked (IdeBreakoutSubprocess *self,
   IDE_ENTRY;
 
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
-  g_assert (G_IS_DBUS_CONNECTION (self->connection));
 
   self->client_has_exited = TRUE;
   self->status = exit_status;
@@ -1075,11 +1038,6 @@ ide_breakout_subprocess_complete_command_locked (IdeBreakoutSubprocess *self,
   /* Notify synchronous waiters */
   g_cond_broadcast (&self->waiter_cond);
 
-  g_signal_handler_disconnect (self->connection, self->connection_closed_handler);
-  self->connection_closed_handler = 0;
-
-  g_clear_object (&self->connection);
-
   if (self->main_context != NULL)
     g_main_context_wakeup (self->main_context);
 
@@ -1087,47 +1045,28 @@ ide_breakout_subprocess_complete_command_locked (IdeBreakoutSubprocess *self,
 }
 
 static void
-host_command_exited_cb (GDBusConnection *connection,
-                        const gchar     *sender_name,
-                        const gchar     *object_path,
-                        const gchar     *interface_name,
-                        const gchar     *signal_name,
-                        GVariant        *parameters,
-                        gpointer         user_data)
+ide_breakout_subprocess_host_exited (IdeHostSpawner *spawner,
+                                     GPid            client_pid,
+                                     gint            exit_status,
+                                     gpointer        user_data)
 {
   g_autoptr(IdeBreakoutSubprocess) finalize_protect = NULL;
   IdeBreakoutSubprocess *self = user_data;
   g_autoptr(GMutexLocker) locker = NULL;
-  guint32 client_pid = 0;
-  guint32 exit_status = 0;
 
   IDE_ENTRY;
 
-  g_assert (G_IS_DBUS_CONNECTION (connection));
+  g_assert (IDE_IS_HOST_SPAWNER (spawner));
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
 
   finalize_protect = g_object_ref (self);
 
-  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(uu)")))
-    IDE_EXIT;
-
-  g_variant_get (parameters, "(uu)", &client_pid, &exit_status);
-  if (client_pid != self->client_pid)
-    IDE_EXIT;
-
   locker = g_mutex_locker_new (&self->waiter_mutex);
 
-  IDE_TRACE_MSG ("Host process %u exited with %u",
-                 (guint)self->client_pid,
-                 (guint)exit_status);
-
-  /* We can release our dbus signal handler now */
-  if (self->exited_subscription != 0)
-    {
-      IDE_TRACE_MSG ("Unsubscribing from DBus subscription %d", self->exited_subscription);
-      g_dbus_connection_signal_unsubscribe (self->connection, self->exited_subscription);
-      self->exited_subscription = 0;
-    }
+  /* An exit status of -1 means the spawner lost its connection */
+  IDE_TRACE_MSG ("Host process %u exited with %d",
+                 (guint)client_pid,
+                 exit_status);
 
   ide_breakout_subprocess_complete_command_locked (self, exit_status);
 
@@ -1160,47 +1099,16 @@ maybe_close (gint *fd)
   *fd = -1;
 }
 
-static void
-ide_breakout_subprocess_connection_closed (IdeBreakoutSubprocess *self,
-                                           gboolean               remote_peer_vanished,
-                                           const GError          *error,
-                                           GDBusConnection       *connection)
-{
-  g_autoptr(GMutexLocker) locker = NULL;
-
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
-  g_assert (G_IS_DBUS_CONNECTION (connection));
-
-  locker = g_mutex_locker_new (&self->waiter_mutex);
-
-  IDE_TRACE_MSG ("Synthesizing failure for client pid %u", (guint)self->client_pid);
-
-  self->exited_subscription = 0;
-  ide_breakout_subprocess_complete_command_locked (self, -1);
-
-  IDE_EXIT;
-}
-
 static gboolean
 ide_breakout_subprocess_initable_init (GInitable     *initable,
                                        GCancellable  *cancellable,
                                        GError       **error)
 {
   IdeBreakoutSubprocess *self = (IdeBreakoutSubprocess *)initable;
-  g_autoptr(GVariantBuilder) fd_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{uh}"));
-  g_autoptr(GVariantBuilder) env_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{ss}"));
-  g_autoptr(GUnixFDList) fd_list = g_unix_fd_list_new ();
-  g_autoptr(GVariant) reply = NULL;
-  g_autoptr(GVariant) params = NULL;
-  guint32 client_pid = 0;
+  GPid client_pid;
   gint stdout_pair[2] = { -1, -1 };
   gint stderr_pair[2] = { -1, -1 };
   gint stdin_pair[2] = { -1, -1 };
-  gint stdin_handle = -1;
-  gint stdout_handle = -1;
-  gint stderr_handle = -1;
   gboolean ret = FALSE;
 
   IDE_ENTRY;
@@ -1208,37 +1116,7 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  /*
-   * FIXME:
-   *
-   * Because we are seeing a rather difficult to track down bug where we lose
-   * the connection upon submission of the HostCommand() after a timeout period
-   * (the dbus-daemon is closing our connection) we are using a private
-   * GDBusConnection for the command.
-   *
-   * This means we need to ensure we close the connection as soon as we can
-   * so that we don't hold things open for too long. Additionally, if we do
-   * get disconnected from the daemon, we don't want to crash but instead will
-   * synthesize the completion of the command. However, this should be much
-   * more unlikely since we haven't seen this failure case.
-   *
-   * One thing we could look into for recovery is to send a SIGKILL to a new
-   * connection (of our client pid) during recovery to ensure that it dies and
-   * force our operation to fail. Callers could handle this during wait_async()
-   * wait_finish() pairs. Again, not ideal.
-   */
-  self->connection =
-    g_dbus_connection_new_for_address_sync (g_getenv ("DBUS_SESSION_BUS_ADDRESS"),
-                                            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
-                                            NULL,
-                                            cancellable,
-                                            error);
-
-  if (self->connection == NULL)
-    IDE_RETURN (FALSE);
-
-  g_dbus_connection_set_exit_on_close (self->connection, FALSE);
-
+  self->spawner = g_object_ref (ide_host_spawner_get_default ());
 
   /*
    * Handle STDIN for the process.
@@ -1272,12 +1150,6 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
 
   g_assert (stdin_pair[0] != -1);
 
-  stdin_handle = g_unix_fd_list_append (fd_list, stdin_pair[0], error);
-  if (stdin_handle == -1)
-    IDE_GOTO (cleanup_fds);
-  else
-    maybe_close (&stdin_pair[0]);
-
 
   /*
    * Setup STDOUT for the process.
@@ -1312,12 +1184,6 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
 
   g_assert (stdout_pair[1] != -1);
 
-  stdout_handle = g_unix_fd_list_append (fd_list, stdout_pair[1], error);
-  if (stdout_handle == -1)
-    IDE_GOTO (cleanup_fds);
-  else
-    maybe_close (&stdout_pair[1]);
-
 
   /*
    * Handle STDERR for the process.
@@ -1352,20 +1218,6 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
 
   g_assert (stderr_pair[1] != -1);
 
-  stderr_handle = g_unix_fd_list_append (fd_list, stderr_pair[1], error);
-  if (stderr_handle == -1)
-    IDE_GOTO (cleanup_fds);
-  else
-    maybe_close (&stderr_pair[1]);
-
-
-  /*
-   * Build our FDs for the message.
-   */
-  g_variant_builder_add (fd_builder, "{uh}", 0, stdin_handle);
-  g_variant_builder_add (fd_builder, "{uh}", 1, stdout_handle);
-  g_variant_builder_add (fd_builder, "{uh}", 2, stderr_handle);
-
 
   /*
    * Build streams for our application to use.
@@ -1375,23 +1227,6 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
   maybe_create_input_stream (&self->stderr_pipe, &stderr_pair[0], !!(self->flags & G_SUBPROCESS_FLAGS_STDERR_PIPE));
 
 
-  /*
-   * Build our environment variables message.
-   */
-  if (self->env != NULL)
-    {
-      for (guint i = 0; self->env[i]; i++)
-        {
-          const gchar *pair = self->env[i];
-          const gchar *eq = strchr (pair, '=');
-          const gchar *val = eq ? eq + 1 : "";
-          g_autofree gchar *key = eq ? g_strndup (pair, eq - pair) : g_strdup (pair);
-
-          g_variant_builder_add (env_builder, "{ss}", key, val);
-        }
-    }
-
-
   /*
    * Register signal handlers for SIGTERM/SIGINT so that we can terminate
    * the host process with us (which won't be guaranteed since its outside
@@ -1403,88 +1238,41 @@ ide_breakout_subprocess_initable_init (GInitable     *initable,
 
   /*
    * Make sure we've closed or stolen all of the FDs that are in play
-   * before calling the DBus service.
+   * before spawning, other than those handed to the child.
    */
-  g_assert_cmpint (-1, ==, stdin_pair[0]);
   g_assert_cmpint (-1, ==, stdin_pair[1]);
   g_assert_cmpint (-1, ==, stdout_pair[0]);
-  g_assert_cmpint (-1, ==, stdout_pair[1]);
   g_assert_cmpint (-1, ==, stderr_pair[0]);
-  g_assert_cmpint (-1, ==, stderr_pair[1]);
 
 
   /*
-   * Connect to the HostCommandExited signal so that we can make progress
-   * on all tasks waiting on ide_subprocess_wait() and its async variants.
-   * We need to do this before spawning the process to avoid the race.
+   * Now ask the host to execute the process. Our exit callback will make
+   * progress on all tasks waiting on ide_subprocess_wait() and its async
+   * variants. The spawner duplicates the child FDs, so we close ours below.
    */
-  self->exited_subscription = g_dbus_connection_signal_subscribe (self->connection,
-                                                                  NULL,
-                                                                  "org.freedesktop.Flatpak.Development",
-                                                                  "HostCommandExited",
-                                                                  "/org/freedesktop/Flatpak/Development",
-                                                                  NULL,
-                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                  host_command_exited_cb,
-                                                                  self,
-                                                                  NULL);
-
-
-  /*
-   * We wait to connect to closed until here so that we don't lose our
-   * connection potentially during setup.
-   */
-  self->connection_closed_handler =
-    g_signal_connect_object (self->connection,
-                             "closed",
-                             G_CALLBACK (ide_breakout_subprocess_connection_closed),
-                             self,
-                             G_CONNECT_SWAPPED);
-
-
-  /*
-   * Now call the HostCommand service to execute the process within the host
-   * system. We need to ensure our fd_list is sent across for redirecting
-   * various standard streams.
-   */
-  g_assert_cmpint (3, ==, g_unix_fd_list_get_length (fd_list));
-  params = g_variant_new ("(^ay^aay@a{uh}@a{ss}u)",
-                          self->cwd ?: g_get_home_dir (),
-                          self->argv,
-                          g_variant_builder_end (g_steal_pointer (&fd_builder)),
-                          g_variant_builder_end (g_steal_pointer (&env_builder)),
-                          self->clear_env ? FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV : 0);
-  g_variant_ref_sink (params);
-
-#ifdef IDE_ENABLE_TRACE
-  {
-    g_autofree gchar *str = g_variant_print (params, TRUE);
-    IDE_TRACE_MSG ("Calling HostCommand with %s", str);
-  }
-#endif
-
-  reply = g_dbus_connection_call_with_unix_fd_list_sync (self->connection,
-                                                         "org.freedesktop.Flatpak",
-                                                         "/org/freedesktop/Flatpak/Development",
-                                                         "org.freedesktop.Flatpak.Development",
-                                                         "HostCommand",
-                                                         params,
-                                                         G_VARIANT_TYPE ("(u)"),
-                                                         G_DBUS_CALL_FLAGS_NONE,
-                                                         -1,
-                                                         fd_list,
-                                                         NULL,
-                                                         cancellable,
-                                                         error);
-  if (reply == NULL)
+  client_pid = ide_host_spawner_spawn (self->spawner,
+                                       self->cwd,
+                                       (const gchar * const *)self->argv,
+                                       (const gchar * const *)self->env,
+                                       self->clear_env,
+                                       stdin_pair[0],
+                                       stdout_pair[1],
+                                       stderr_pair[1],
+                                       ide_breakout_subprocess_host_exited,
+                                       self,
+                                       cancellable,
+                                       error);
+
+  if (client_pid == 0)
     IDE_GOTO (cleanup_fds);
 
-  g_variant_get (reply, "(u)", &client_pid);
-
-  self->client_pid = (GPid)client_pid;
-  self->identifier = g_strdup_printf ("%u", client_pid);
-
-  IDE_TRACE_MSG ("HostCommand() spawned client_pid %u", (guint)client_pid);
+  g_mutex_lock (&self->waiter_mutex);
+  if (!self->client_has_exited)
+    {
+      self->client_pid = client_pid;
+      self->identifier = g_strdup_printf ("%u", (guint)client_pid);
+    }
+  g_mutex_unlock (&self->waiter_mutex);
 
   if (cancellable != NULL)
     {
@@ -1531,15 +1319,10 @@ ide_breakout_subprocess_dispose (GObject *object)
 
   g_assert (IDE_IS_BREAKOUT_SUBPROCESS (self));
 
-  if (self->exited_subscription != 0)
+  if (self->spawner != NULL && self->client_pid != 0 && !self->client_has_exited)
     {
-      if (self->connection != NULL && !g_dbus_connection_is_closed (self->connection))
-        {
-          IDE_TRACE_MSG ("Unsubscribing from DBus subscription %d", self->exited_subscription);
-          g_dbus_connection_signal_unsubscribe (self->connection, self->exited_subscription);
-        }
-
-      self->exited_subscription = 0;
+      IDE_TRACE_MSG ("Forgetting host process %u", (guint)self->client_pid);
+      ide_host_spawner_forget (self->spawner, self->client_pid);
     }
 
   if (self->waiting != NULL)
@@ -1561,7 +1344,6 @@ ide_breakout_subprocess_finalize (GObject *object)
   g_assert (self->waiting == NULL);
   g_assert_cmpint (self->sigint_id, ==, 0);
   g_assert_cmpint (self->sigterm_id, ==, 0);
-  g_assert_cmpint (self->exited_subscription, ==, 0);
 
   g_clear_pointer (&self->identifier, g_free);
   g_clear_pointer (&self->cwd, g_free);
@@ -1572,7 +1354,7 @@ ide_breakout_subprocess_finalize (GObject *object)
   g_clear_object (&self->stdin_pipe);
   g_clear_object (&self->stdout_pipe);
   g_clear_object (&self->stderr_pipe);
-  g_clear_object (&self->connection);
+  g_clear_object (&self->spawner);
 
   g_mutex_clear (&self->waiter_mutex);
   g_cond_clear (&self->waiter_cond);
@@ -0,0 +1,710 @@
+/* ide-host-spawner.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-host-spawner"
+
+#include <egg-counter.h>
+#include <gio/gunixfdlist.h>
+#include <string.h>
+
+#include "ide-debug.h"
+#include "ide-macros.h"
+
+#include "subprocess/ide-host-spawner.h"
+
+#ifndef FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV
+# define FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV (1 << 0)
+#endif
+
+#define DEVELOPMENT_NAME      "org.freedesktop.Flatpak"
+#define DEVELOPMENT_PATH      "/org/freedesktop/Flatpak/Development"
+#define DEVELOPMENT_INTERFACE "org.freedesktop.Flatpak.Development"
+
+/*
+ * IdeHostSpawner keeps a single, persistent connection to the service that
+ * spawns processes on the host (the flatpak session helper). Opening a
+ * private bus connection for every process costs an authentication
+ * handshake, which adds up when hundreds of processes are spawned while
+ * loading a project. The connection can be opened ahead of time with
+ * ide_host_spawner_prewarm(), and spawns from multiple threads are
+ * pipelined over it.
+ *
+ * There is a single subscription to HostCommandExited, and exit statuses
+ * are routed to the spawner's clients by process identifier.
+ *
+ * If the connection is lost, processes that were already started can no
+ * longer be tracked and are reported as failed. A HostCommand() call that
+ * had not been answered yet is retried once on a new connection.
+ */
+
+EGG_DEFINE_COUNTER (spawned, "Subprocess", "Host Spawns", "Number of processes spawned through IdeHostSpawner")
+
+typedef struct
+{
+  IdeHostSpawnerExitFunc func;
+  gpointer               user_data;
+  GPid                   client_pid;
+  gint                   exit_status;
+  guint                  exited : 1;
+} Waiter;
+
+struct _IdeHostSpawner
+{
+  GObject          parent_instance;
+
+  /* Guards all of the fields below */
+  GMutex           mutex;
+
+  GDBusConnection *connection;
+  guint            exited_subscription;
+  gulong           closed_handler;
+
+  /* GPid => Waiter */
+  GHashTable      *waiters;
+
+  /* GPid => exit status, for processes that exited before we saw the reply */
+  GHashTable      *early_exits;
+
+  /* GPid set, for processes whose exit we no longer care about */
+  GHashTable      *forgotten;
+
+  /* The number of HostCommand() calls awaiting their reply */
+  guint            n_in_flight;
+
+  guint            flush_source;
+};
+
+G_DEFINE_TYPE (IdeHostSpawner, ide_host_spawner, G_TYPE_OBJECT)
+
+static void
+waiter_free (gpointer data)
+{
+  g_slice_free (Waiter, data);
+}
+
+static void
+ide_host_spawner_dispatch (IdeHostSpawner *self,
+                           GPtrArray      *waiters)
+{
+  guint i;
+
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+  g_assert (waiters != NULL);
+
+  for (i = 0; i < waiters->len; i++)
+    {
+      Waiter *waiter = g_ptr_array_index (waiters, i);
+
+      IDE_TRACE_MSG ("Host process %u exited with %d",
+                     (guint)waiter->client_pid, waiter->exit_status);
+
+      waiter->func (self, waiter->client_pid, waiter->exit_status, waiter->user_data);
+    }
+}
+
+static gboolean
+ide_host_spawner_flush (gpointer data)
+{
+  IdeHostSpawner *self = data;
+  g_autoptr(GPtrArray) exited = NULL;
+  GHashTableIter iter;
+  Waiter *waiter;
+
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  exited = g_ptr_array_new_with_free_func (waiter_free);
+
+  g_mutex_lock (&self->mutex);
+
+  self->flush_source = 0;
+
+  g_hash_table_iter_init (&iter, self->waiters);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&waiter))
+    {
+      if (waiter->exited)
+        {
+          g_hash_table_iter_steal (&iter);
+          g_ptr_array_add (exited, waiter);
+        }
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  ide_host_spawner_dispatch (self, exited);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_host_spawner_queue_flush_locked (IdeHostSpawner *self)
+{
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  if (self->flush_source == 0)
+    self->flush_source = g_idle_add_full (G_PRIORITY_DEFAULT,
+                                          ide_host_spawner_flush,
+                                          g_object_ref (self),
+                                          g_object_unref);
+}
+
+static void
+ide_host_spawner_host_command_exited (GDBusConnection *connection,
+                                      const gchar     *sender_name,
+                                      const gchar     *object_path,
+                                      const gchar     *interface_name,
+                                      const gchar     *signal_name,
+                                      GVariant        *parameters,
+                                      gpointer         user_data)
+{
+  IdeHostSpawner *self = user_data;
+  g_autoptr(GPtrArray) exited = NULL;
+  guint32 client_pid = 0;
+  guint32 exit_status = 0;
+  Waiter *waiter;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_DBUS_CONNECTION (connection));
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(uu)")))
+    IDE_EXIT;
+
+  g_variant_get (parameters, "(uu)", &client_pid, &exit_status);
+
+  exited = g_ptr_array_new_with_free_func (waiter_free);
+
+  g_mutex_lock (&self->mutex);
+
+  if (NULL != (waiter = g_hash_table_lookup (self->waiters, GUINT_TO_POINTER (client_pid))))
+    {
+      g_hash_table_steal (self->waiters, GUINT_TO_POINTER (client_pid));
+      waiter->exit_status = exit_status;
+      waiter->exited = TRUE;
+      g_ptr_array_add (exited, waiter);
+    }
+  else if (g_hash_table_remove (self->forgotten, GUINT_TO_POINTER (client_pid)))
+    {
+      /* Nobody is waiting for this one anymore */
+    }
+  else if (self->n_in_flight > 0)
+    {
+      /*
+       * A spawning thread may not have seen the reply yet. If none is
+       * waiting, this is not one of ours and there is nothing to record.
+       */
+      g_hash_table_insert (self->early_exits,
+                           GUINT_TO_POINTER (client_pid),
+                           GINT_TO_POINTER (exit_status));
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  ide_host_spawner_dispatch (self, exited);
+
+  IDE_EXIT;
+}
+
+/*
+ * Forgets the current connection. We can no longer know when the processes
+ * started over it exit, so synthesize a failure for all of them. The next
+ * spawn will reconnect.
+ */
+static void
+ide_host_spawner_drop_connection_locked (IdeHostSpawner *self)
+{
+  g_autoptr(GString) pids = NULL;
+  GHashTableIter iter;
+  Waiter *waiter;
+  guint n_failed = 0;
+
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+  g_assert (self->connection != NULL);
+
+  g_dbus_connection_signal_unsubscribe (self->connection, self->exited_subscription);
+  g_signal_handler_disconnect (self->connection, self->closed_handler);
+  self->exited_subscription = 0;
+  self->closed_handler = 0;
+  g_clear_object (&self->connection);
+
+  pids = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, self->waiters);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&waiter))
+    {
+      if (waiter->exited)
+        continue;
+
+      waiter->exit_status = -1;
+      waiter->exited = TRUE;
+
+      g_string_append_printf (pids, "%s%u", n_failed++ ? ", " : "", (guint)waiter->client_pid);
+    }
+
+  g_hash_table_remove_all (self->early_exits);
+  g_hash_table_remove_all (self->forgotten);
+
+  if (n_failed > 0)
+    {
+      g_warning ("Lost connection to host, reporting %u processes as failed: %s",
+                 n_failed, pids->str);
+      ide_host_spawner_queue_flush_locked (self);
+    }
+}
+
+static void
+ide_host_spawner_connection_closed (GDBusConnection *connection,
+                                    gboolean         remote_peer_vanished,
+                                    const GError    *error,
+                                    gpointer         user_data)
+{
+  IdeHostSpawner *self = user_data;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_DBUS_CONNECTION (connection));
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  IDE_TRACE_MSG ("Host connection closed: %s", error ? error->message : "no error");
+
+  g_mutex_lock (&self->mutex);
+  if (self->connection == connection)
+    ide_host_spawner_drop_connection_locked (self);
+  g_mutex_unlock (&self->mutex);
+
+  IDE_EXIT;
+}
+
+static GDBusConnection *
+ide_host_spawner_get_connection_locked (IdeHostSpawner  *self,
+                                        GCancellable    *cancellable,
+                                        GError         **error)
+{
+  g_autoptr(GDBusConnection) connection = NULL;
+
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  /* ::closed is emitted from the main context, so it may not have run yet */
+  if (self->connection != NULL && g_dbus_connection_is_closed (self->connection))
+    ide_host_spawner_drop_connection_locked (self);
+
+  if (self->connection != NULL)
+    return g_object_ref (self->connection);
+
+  /*
+   * We use a private connection (rather than the shared session bus) so
+   * that we can disable exit-on-close and recover if the daemon drops us.
+   */
+  connection = g_dbus_connection_new_for_address_sync (g_getenv ("DBUS_SESSION_BUS_ADDRESS"),
+                                                       (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                       NULL,
+                                                       cancellable,
+                                                       error);
+
+  if (connection == NULL)
+    return NULL;
+
+  g_dbus_connection_set_exit_on_close (connection, FALSE);
+
+  /* Exit notifications are dispatched from the main context */
+  self->exited_subscription =
+    g_dbus_connection_signal_subscribe (connection,
+                                        NULL,
+                                        DEVELOPMENT_INTERFACE,
+                                        "HostCommandExited",
+                                        DEVELOPMENT_PATH,
+                                        NULL,
+                                        G_DBUS_SIGNAL_FLAGS_NONE,
+                                        ide_host_spawner_host_command_exited,
+                                        self,
+                                        NULL);
+
+  self->closed_handler =
+    g_signal_connect (connection,
+                      "closed",
+                      G_CALLBACK (ide_host_spawner_connection_closed),
+                      self);
+
+  self->connection = g_object_ref (connection);
+
+  return g_steal_pointer (&connection);
+}
+
+static void
+ide_host_spawner_prewarm_worker (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+  IdeHostSpawner *self = source_object;
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+
+  g_mutex_lock (&self->mutex);
+  connection = ide_host_spawner_get_connection_locked (self, cancellable, &error);
+  g_mutex_unlock (&self->mutex);
+
+  if (connection == NULL)
+    g_debug ("Failed to connect to host: %s", error->message);
+
+  g_task_return_boolean (task, connection != NULL);
+}
+
+/**
+ * ide_host_spawner_prewarm:
+ *
+ * Opens the connection to the host in a thread, so that the first call to
+ * ide_host_spawner_spawn() does not need to wait for it.
+ */
+void
+ide_host_spawner_prewarm (IdeHostSpawner *self)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_HOST_SPAWNER (self));
+
+  task = g_task_new (self, NULL, NULL, NULL);
+  g_task_set_source_tag (task, ide_host_spawner_prewarm);
+  g_task_run_in_thread (task, ide_host_spawner_prewarm_worker);
+}
+
+/*
+ * Called once a spawning thread has handled the reply to HostCommand().
+ * Exits that arrived early are only interesting to spawns still awaiting
+ * their reply, so once there are none left, anything remaining belongs to
+ * processes we did not spawn and must not match a future pid.
+ */
+static void
+ide_host_spawner_end_in_flight_locked (IdeHostSpawner *self)
+{
+  g_assert (IDE_IS_HOST_SPAWNER (self));
+  g_assert (self->n_in_flight > 0);
+
+  if (--self->n_in_flight == 0)
+    g_hash_table_remove_all (self->early_exits);
+}
+
+/**
+ * ide_host_spawner_spawn:
+ * @self: An #IdeHostSpawner
+ * @cwd: (nullable): the working directory, or %NULL for the home directory
+ * @argv: the arguments for the process
+ * @env: (nullable): "KEY=VALUE" pairs to set in the environment
+ * @clear_env: if the host environment should be cleared first
+ * @stdin_fd: the fd to use as stdin for the process
+ * @stdout_fd: the fd to use as stdout for the process
+ * @stderr_fd: the fd to use as stderr for the process
+ * @exit_func: called when the process exits
+ * @user_data: closure data for @exit_func
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: a location for a #GError, or %NULL
+ *
+ * Spawns a process on the host. The file-descriptors are duplicated and
+ * may be closed by the caller once this function returns.
+ *
+ * @exit_func is called exactly once, unless ide_host_spawner_forget() is
+ * called first.
+ *
+ * This function may be called from any thread.
+ *
+ * Returns: the host process identifier, or 0 and @error is set.
+ */
+GPid
+ide_host_spawner_spawn (IdeHostSpawner          *self,
+                        const gchar             *cwd,
+                        const gchar * const     *argv,
+                        const gchar * const     *env,
+                        gboolean                 clear_env,
+                        gint                     stdin_fd,
+                        gint                     stdout_fd,
+                        gint                     stderr_fd,
+                        IdeHostSpawnerExitFunc   exit_func,
+                        gpointer                 user_data,
+                        GCancellable            *cancellable,
+                        GError                 **error)
+{
+  g_autoptr(GVariantBuilder) fd_builder = NULL;
+  g_autoptr(GVariantBuilder) env_builder = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(GVariant) params = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  const gint fds[] = { stdin_fd, stdout_fd, stderr_fd };
+  gpointer exit_status = NULL;
+  guint32 client_pid = 0;
+  Waiter *waiter;
+  guint attempt;
+  guint i;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_HOST_SPAWNER (self), 0);
+  g_return_val_if_fail (argv != NULL, 0);
+  g_return_val_if_fail (argv[0] != NULL, 0);
+  g_return_val_if_fail (exit_func != NULL, 0);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), 0);
+
+  fd_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{uh}"));
+  env_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{ss}"));
+  fd_list = g_unix_fd_list_new ();
+
+  for (i = 0; i < G_N_ELEMENTS (fds); i++)
+    {
+      gint handle;
+
+      if (-1 == (handle = g_unix_fd_list_append (fd_list, fds[i], error)))
+        IDE_RETURN (0);
+
+      g_variant_builder_add (fd_builder, "{uh}", i, handle);
+    }
+
+  if (env != NULL)
+    {
+      for (i = 0; env[i]; i++)
+        {
+          const gchar *pair = env[i];
+          const gchar *eq = strchr (pair, '=');
+          const gchar *val = eq ? eq + 1 : "";
+          g_autofree gchar *key = eq ? g_strndup (pair, eq - pair) : g_strdup (pair);
+
+          g_variant_builder_add (env_builder, "{ss}", key, val);
+        }
+    }
+
+  params = g_variant_ref_sink (g_variant_new ("(^ay^aay@a{uh}@a{ss}u)",
+                                               cwd ?: g_get_home_dir (),
+                                               argv,
+                                               g_variant_builder_end (fd_builder),
+                                               g_variant_builder_end (env_builder),
+                                               clear_env ? FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV : 0));
+
+  for (attempt = 0; ; attempt++)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      g_clear_object (&connection);
+
+      g_mutex_lock (&self->mutex);
+      if (NULL != (connection = ide_host_spawner_get_connection_locked (self, cancellable, error)))
+        self->n_in_flight++;
+      g_mutex_unlock (&self->mutex);
+
+      if (connection == NULL)
+        IDE_RETURN (0);
+
+      reply = g_dbus_connection_call_with_unix_fd_list_sync (connection,
+                                                             DEVELOPMENT_NAME,
+                                                             DEVELOPMENT_PATH,
+                                                             DEVELOPMENT_INTERFACE,
+                                                             "HostCommand",
+                                                             params,
+                                                             G_VARIANT_TYPE ("(u)"),
+                                                             G_DBUS_CALL_FLAGS_NONE,
+                                                             -1,
+                                                             fd_list,
+                                                             NULL,
+                                                             cancellable,
+                                                             &local_error);
+
+      if (reply != NULL)
+        break;
+
+      g_mutex_lock (&self->mutex);
+      ide_host_spawner_end_in_flight_locked (self);
+      g_mutex_unlock (&self->mutex);
+
+      /*
+       * The connection was lost before the host replied. Retry once on a
+       * new connection rather than failing a process the host most likely
+       * never saw.
+       */
+      if (attempt > 0 ||
+          !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CLOSED) ||
+          g_cancellable_is_cancelled (cancellable))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          IDE_RETURN (0);
+        }
+
+      g_debug ("Lost connection to host before HostCommand() replied, retrying %s", argv[0]);
+    }
+
+  g_variant_get (reply, "(u)", &client_pid);
+
+  IDE_TRACE_MSG ("HostCommand() spawned client_pid %u", (guint)client_pid);
+
+  EGG_COUNTER_INC (spawned);
+
+  waiter = g_slice_new0 (Waiter);
+  waiter->func = exit_func;
+  waiter->user_data = user_data;
+  waiter->client_pid = (GPid)client_pid;
+
+  g_mutex_lock (&self->mutex);
+
+  if (g_hash_table_lookup_extended (self->early_exits,
+                                    GUINT_TO_POINTER (client_pid),
+                                    NULL,
+                                    &exit_status))
+    {
+      g_hash_table_remove (self->early_exits, GUINT_TO_POINTER (client_pid));
+      waiter->exit_status = GPOINTER_TO_INT (exit_status);
+      waiter->exited = TRUE;
+    }
+  else if (self->connection != connection)
+    {
+      /* We lost the connection after the host started the process */
+      g_warning ("Lost connection to host, reporting process %u as failed",
+                 (guint)client_pid);
+      waiter->exit_status = -1;
+      waiter->exited = TRUE;
+    }
+
+  g_hash_table_insert (self->waiters, GUINT_TO_POINTER (client_pid), waiter);
+
+  ide_host_spawner_end_in_flight_locked (self);
+
+  /* Never call exit_func before the caller knows the pid */
+  if (waiter->exited)
+    ide_host_spawner_queue_flush_locked (self);
+
+  g_mutex_unlock (&self->mutex);
+
+  IDE_RETURN ((GPid)client_pid);
+}
+
+/**
+ * ide_host_spawner_forget:
+ *
+ * Removes the exit function registered for @client_pid, so that it will
+ * not be called.
+ */
+void
+ide_host_spawner_forget (IdeHostSpawner *self,
+                         GPid            client_pid)
+{
+  g_return_if_fail (IDE_IS_HOST_SPAWNER (self));
+
+  g_mutex_lock (&self->mutex);
+  if (g_hash_table_remove (self->waiters, GUINT_TO_POINTER (client_pid)))
+    g_hash_table_add (self->forgotten, GUINT_TO_POINTER (client_pid));
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * ide_host_spawner_send_signal:
+ *
+ * Sends @signum to the process group of @client_pid on the host. Delivery
+ * is not guaranteed.
+ */
+void
+ide_host_spawner_send_signal (IdeHostSpawner *self,
+                              GPid            client_pid,
+                              gint            signum)
+{
+  g_autoptr(GDBusConnection) connection = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_HOST_SPAWNER (self));
+
+  g_mutex_lock (&self->mutex);
+  if (self->connection != NULL)
+    connection = g_object_ref (self->connection);
+  g_mutex_unlock (&self->mutex);
+
+  if (connection == NULL || client_pid == 0)
+    IDE_EXIT;
+
+  IDE_TRACE_MSG ("Sending signal %d to pid %u", signum, (guint)client_pid);
+
+  g_dbus_connection_call_sync (connection,
+                               DEVELOPMENT_NAME,
+                               DEVELOPMENT_PATH,
+                               DEVELOPMENT_INTERFACE,
+                               "HostCommandSignal",
+                               g_variant_new ("(uub)", (guint32)client_pid, (guint32)signum, TRUE),
+                               NULL,
+                               G_DBUS_CALL_FLAGS_NONE, -1,
+                               NULL, NULL);
+
+  IDE_EXIT;
+}
+
+static void
+ide_host_spawner_finalize (GObject *object)
+{
+  IdeHostSpawner *self = (IdeHostSpawner *)object;
+
+  g_assert (self->flush_source == 0);
+
+  if (self->connection != NULL)
+    {
+      g_dbus_connection_signal_unsubscribe (self->connection, self->exited_subscription);
+      g_signal_handler_disconnect (self->connection, self->closed_handler);
+      g_dbus_connection_close (self->connection, NULL, NULL, NULL);
+      g_clear_object (&self->connection);
+    }
+
+  g_clear_pointer (&self->waiters, g_hash_table_unref);
+  g_clear_pointer (&self->early_exits, g_hash_table_unref);
+  g_clear_pointer (&self->forgotten, g_hash_table_unref);
+
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (ide_host_spawner_parent_class)->finalize (object);
+}
+
+static void
+ide_host_spawner_class_init (IdeHostSpawnerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_host_spawner_finalize;
+}
+
+static void
+ide_host_spawner_init (IdeHostSpawner *self)
+{
+  g_mutex_init (&self->mutex);
+  self->waiters = g_hash_table_new_full (NULL, NULL, NULL, waiter_free);
+  self->early_exits = g_hash_table_new (NULL, NULL);
+  self->forgotten = g_hash_table_new (NULL, NULL);
+}
+
+/**
+ * ide_host_spawner_get_default:
+ *
+ * Returns: (transfer none): The shared #IdeHostSpawner.
+ */
+IdeHostSpawner *
+ide_host_spawner_get_default (void)
+{
+  static IdeHostSpawner *instance;
+
+  if (g_once_init_enter (&instance))
+    g_once_init_leave (&instance, g_object_new (IDE_TYPE_HOST_SPAWNER, NULL));
+
+  return instance;
+}
@@ -0,0 +1,67 @@
+/* ide-host-spawner.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_HOST_SPAWNER_H
+#define IDE_HOST_SPAWNER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_HOST_SPAWNER (ide_host_spawner_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeHostSpawner, ide_host_spawner, IDE, HOST_SPAWNER, GObject)
+
+/**
+ * IdeHostSpawnerExitFunc:
+ * @self: an #IdeHostSpawner
+ * @client_pid: the host process identifier
+ * @exit_status: the wait status of the process, or -1 if it was lost
+ * @user_data: closure data
+ *
+ * Called from the main context when a process spawned with
+ * ide_host_spawner_spawn() exits.
+ */
+typedef void (*IdeHostSpawnerExitFunc) (IdeHostSpawner *self,
+                                        GPid            client_pid,
+                                        gint            exit_status,
+                                        gpointer        user_data);
+
+IdeHostSpawner *ide_host_spawner_get_default (void) G_GNUC_INTERNAL;
+void            ide_host_spawner_prewarm     (IdeHostSpawner          *self) G_GNUC_INTERNAL;
+GPid            ide_host_spawner_spawn       (IdeHostSpawner          *self,
+                                              const gchar             *cwd,
+                                              const gchar * const     *argv,
+                                              const gchar * const     *env,
+                                              gboolean                 clear_env,
+                                              gint                     stdin_fd,
+                                              gint                     stdout_fd,
+                                              gint                     stderr_fd,
+                                              IdeHostSpawnerExitFunc   exit_func,
+                                              gpointer                 user_data,
+                                              GCancellable            *cancellable,
+                                              GError                 **error) G_GNUC_INTERNAL;
+void            ide_host_spawner_forget      (IdeHostSpawner          *self,
+                                              GPid                     client_pid) G_GNUC_INTERNAL;
+void            ide_host_spawner_send_signal (IdeHostSpawner          *self,
+                                              GPid                     client_pid,
+                                              gint                     signum) G_GNUC_INTERNAL;
+
+G_END_DECLS
+
+#endif /* IDE_HOST_SPAWNER_H */
@@ -336,3 +336,127 @@ ide_subprocess_check_exit_status (IdeSubprocess  *self,
 
   return g_spawn_check_exit_status (exit_status, error);
 }
+
+/**
+ * ide_subprocess_read_lines:
+ * @self: an #IdeSubprocess
+ * @func: (scope call): a callback to receive lines
+ * @func_data: closure data for @func
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @error: a location for a #GError or %NULL
+ *
+ * Streams the standard output of @self to @func in batches of complete
+ * lines without buffering the whole output like
+ * ide_subprocess_communicate_utf8() does. See ide_line_reader_read_stream()
+ * for details.
+ *
+ * The subprocess must have been spawned with %G_SUBPROCESS_FLAGS_STDOUT_PIPE.
+ * This does not wait for the subprocess to exit.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_subprocess_read_lines (IdeSubprocess      *self,
+                           IdeLineReaderFunc   func,
+                           gpointer            func_data,
+                           GCancellable       *cancellable,
+                           GError            **error)
+{
+  GInputStream *stream;
+
+  g_return_val_if_fail (IDE_IS_SUBPROCESS (self), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  if (NULL == (stream = ide_subprocess_get_stdout_pipe (self)))
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_SUPPORTED,
+                           "Subprocess stdout is not a pipe");
+      return FALSE;
+    }
+
+  return ide_line_reader_read_stream (stream, func, func_data, cancellable, error);
+}
+
+static void
+ide_subprocess_read_lines_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  GInputStream *stream = (GInputStream *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+  g_assert (G_IS_TASK (task));
+
+  if (!ide_line_reader_read_stream_finish (stream, result, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * ide_subprocess_read_lines_async:
+ * @self: an #IdeSubprocess
+ * @func: (scope notified): a callback to receive lines
+ * @func_data: closure data for @func
+ * @func_data_destroy: (nullable): a #GDestroyNotify for @func_data
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Asynchronous version of ide_subprocess_read_lines().
+ */
+void
+ide_subprocess_read_lines_async (IdeSubprocess       *self,
+                                 IdeLineReaderFunc    func,
+                                 gpointer             func_data,
+                                 GDestroyNotify       func_data_destroy,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  GInputStream *stream;
+
+  g_return_if_fail (IDE_IS_SUBPROCESS (self));
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_subprocess_read_lines_async);
+
+  if (NULL == (stream = ide_subprocess_get_stdout_pipe (self)))
+    {
+      if (func_data_destroy != NULL)
+        func_data_destroy (func_data);
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Subprocess stdout is not a pipe");
+      return;
+    }
+
+  ide_line_reader_read_stream_async (stream,
+                                     func,
+                                     func_data,
+                                     func_data_destroy,
+                                     cancellable,
+                                     ide_subprocess_read_lines_cb,
+                                     g_steal_pointer (&task));
+}
+
+gboolean
+ide_subprocess_read_lines_finish (IdeSubprocess  *self,
+                                  GAsyncResult   *result,
+                                  GError        **error)
+{
+  g_return_val_if_fail (IDE_IS_SUBPROCESS (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+  g_return_val_if_fail (g_task_is_valid (G_TASK (result), self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
@@ -21,6 +21,8 @@
 
 #include <gio/gio.h>
 
+#include "util/ide-line-reader.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_SUBPROCESS (ide_subprocess_get_type())
@@ -135,6 +137,21 @@ gboolean       ide_subprocess_communicate_finish (IdeSubprocess        *self,
                                                   GBytes              **stdout_buf,
                                                   GBytes              **stderr_buf,
                                                   GError              **error);
+gboolean       ide_subprocess_read_lines         (IdeSubprocess        *self,
+                                                  IdeLineReaderFunc     func,
+                                                  gpointer              func_data,
+                                                  GCancellable         *cancellable,
+                                                  GError              **error);
+void           ide_subprocess_read_lines_async   (IdeSubprocess        *self,
+                                                  IdeLineReaderFunc     func,
+                                                  gpointer              func_data,
+                                                  GDestroyNotify        func_data_destroy,
+                                                  GCancellable         *cancellable,
+                                                  GAsyncReadyCallback   callback,
+                                                  gpointer              user_data);
+gboolean       ide_subprocess_read_lines_finish  (IdeSubprocess        *self,
+                                                  GAsyncResult         *result,
+                                                  GError              **error);
 
 G_END_DECLS
 
@@ -152,6 +152,33 @@ ide_thread_pool_push (IdeThreadPoolKind kind,
   IDE_EXIT;
 }
 
+/**
+ * ide_thread_pool_get_max_threads:
+ * @kind: the threadpool kind
+ *
+ * Gets the number of threads that may execute work items of @kind at the
+ * same time. Bulk operations can use this to avoid queuing more work than
+ * the pool can execute, which would delay interactive requests.
+ *
+ * Returns: the maximum number of threads, or 1 if the pool is not created.
+ */
+guint
+ide_thread_pool_get_max_threads (IdeThreadPoolKind kind)
+{
+  GThreadPool *pool;
+  gint max_threads;
+
+  g_return_val_if_fail (kind >= 0, 1);
+  g_return_val_if_fail (kind < IDE_THREAD_POOL_LAST, 1);
+
+  if (NULL == (pool = ide_thread_pool_get_pool (kind)))
+    return 1;
+
+  max_threads = g_thread_pool_get_max_threads (pool);
+
+  return max_threads > 0 ? max_threads : 1;
+}
+
 static void
 ide_thread_pool_worker (gpointer data,
                         gpointer user_data)
@@ -45,6 +45,7 @@ void     ide_thread_pool_push      (IdeThreadPoolKind     kind,
 void     ide_thread_pool_push_task (IdeThreadPoolKind     kind,
                                     GTask                *task,
                                     GTaskThreadFunc       func);
+guint    ide_thread_pool_get_max_threads (IdeThreadPoolKind kind);
 
 G_END_DECLS
 
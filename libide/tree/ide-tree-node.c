@@ -151,6 +151,34 @@ ide_tree_node_insert_sorted (IdeTreeNode            *node,
   _ide_tree_insert_sorted (node->tree, node, child, compare_func, user_data);
 }
 
+/**
+ * ide_tree_node_insert_sorted_many:
+ * @node: A #IdeTreeNode.
+ * @children: (element-type Ide.TreeNode): An array of #IdeTreeNode.
+ * @compare_func: (scope call): A compare func to compare nodes.
+ * @user_data: user data for @compare_func.
+ *
+ * Like ide_tree_node_insert_sorted(), but inserts all of @children at once.
+ * The children are sorted and then merged with the existing children in a
+ * single pass, which is much faster than inserting them one at a time when
+ * there are many of them.
+ *
+ * Children with #IdeTreeNode:children-possible set will get their dummy
+ * child added as they are inserted.
+ */
+void
+ide_tree_node_insert_sorted_many (IdeTreeNode            *node,
+                                  GPtrArray              *children,
+                                  IdeTreeNodeCompareFunc  compare_func,
+                                  gpointer                user_data)
+{
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_return_if_fail (children != NULL);
+  g_return_if_fail (compare_func != NULL);
+
+  _ide_tree_insert_sorted_many (node->tree, node, children, compare_func, user_data);
+}
+
 /**
  * ide_tree_node_append:
  * @node: A #IdeTreeNode.
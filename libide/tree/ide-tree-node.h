@@ -30,6 +30,10 @@ void            ide_tree_node_insert_sorted         (IdeTreeNode            *nod
                                                      IdeTreeNode            *child,
                                                      IdeTreeNodeCompareFunc  compare_func,
                                                      gpointer                user_data);
+void            ide_tree_node_insert_sorted_many    (IdeTreeNode            *node,
+                                                     GPtrArray              *children,
+                                                     IdeTreeNodeCompareFunc  compare_func,
+                                                     gpointer                user_data);
 gboolean        ide_tree_node_is_root               (IdeTreeNode            *node);
 const gchar    *ide_tree_node_get_icon_name         (IdeTreeNode            *node);
 GObject        *ide_tree_node_get_item              (IdeTreeNode            *node);
@@ -537,6 +537,112 @@ inserted:
   g_object_unref (child);
 }
 
+typedef struct
+{
+  IdeTreeNodeCompareFunc compare_func;
+  gpointer               user_data;
+} SortClosure;
+
+static gint
+ide_tree_sort_nodes (gconstpointer a,
+                     gconstpointer b,
+                     gpointer      user_data)
+{
+  IdeTreeNode *node_a = *(IdeTreeNode **)a;
+  IdeTreeNode *node_b = *(IdeTreeNode **)b;
+  SortClosure *closure = user_data;
+
+  return closure->compare_func (node_a, node_b, closure->user_data);
+}
+
+void
+_ide_tree_insert_sorted_many (IdeTree                *self,
+                              IdeTreeNode            *node,
+                              GPtrArray              *children,
+                              IdeTreeNodeCompareFunc  compare_func,
+                              gpointer                user_data)
+{
+  IdeTreePrivate *priv = ide_tree_get_instance_private (self);
+  g_autoptr(GPtrArray) sorted = NULL;
+  SortClosure closure = { compare_func, user_data };
+  GtkTreeModel *model;
+  GtkTreeIter *parent = NULL;
+  GtkTreeIter node_iter;
+  GtkTreeIter sibling;
+  gboolean has_sibling;
+  guint i;
+
+  g_return_if_fail (IDE_IS_TREE (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_return_if_fail (children != NULL);
+  g_return_if_fail (compare_func != NULL);
+
+  if (children->len == 0)
+    return;
+
+  model = GTK_TREE_MODEL (priv->store);
+
+  sorted = g_ptr_array_sized_new (children->len);
+  for (i = 0; i < children->len; i++)
+    g_ptr_array_add (sorted, g_ptr_array_index (children, i));
+  g_ptr_array_sort_with_data (sorted, ide_tree_sort_nodes, &closure);
+
+  if (ide_tree_node_get_iter (node, &node_iter))
+    parent = &node_iter;
+
+  /*
+   * The existing children are already sorted, so merge the new ones in with
+   * a single pass over the siblings rather than one scan per insertion.
+   * Tree store iters persist, so @sibling stays valid as rows are added.
+   */
+  has_sibling = gtk_tree_model_iter_children (model, &sibling, parent);
+
+  for (i = 0; i < sorted->len; i++)
+    {
+      IdeTreeNode *child = g_ptr_array_index (sorted, i);
+      GtkTreeIter iter;
+
+      g_assert (IDE_IS_TREE_NODE (child));
+
+      _ide_tree_node_set_tree (child, self);
+      _ide_tree_node_set_parent (child, node);
+
+      g_object_ref_sink (child);
+
+      while (has_sibling)
+        {
+          g_autoptr(IdeTreeNode) item = NULL;
+
+          gtk_tree_model_get (model, &sibling, 0, &item, -1);
+
+          if (compare_func (item, child, user_data) > 0)
+            break;
+
+          has_sibling = gtk_tree_model_iter_next (model, &sibling);
+        }
+
+      gtk_tree_store_insert_before (priv->store, &iter, parent, has_sibling ? &sibling : NULL);
+      gtk_tree_store_set (priv->store, &iter, 0, child, -1);
+
+      /* We already have the iter, avoid looking it up again for the dummy */
+      if (ide_tree_node_get_children_possible (child))
+        {
+          IdeTreeNode *dummy;
+
+          dummy = g_object_ref_sink (ide_tree_node_new ());
+          gtk_tree_store_insert_with_values (priv->store, NULL, &iter, -1,
+                                             0, dummy,
+                                             -1);
+          g_object_unref (dummy);
+        }
+
+      if (node == priv->root)
+        _ide_tree_build_node (self, child);
+
+      g_object_unref (child);
+    }
+}
+
 static void
 ide_tree_row_activated (GtkTreeView       *tree_view,
                         GtkTreePath       *path,
@@ -89,3 +89,305 @@ ide_line_reader_next (IdeLineReader *reader,
 
   return ret;
 }
+
+/*
+ * Streams are read into a single buffer that is reused for every read. Only
+ * the bytes following the last newline are kept between reads, and the
+ * buffer only grows when a single line does not fit. One extra byte is
+ * always allocated so the final unterminated line can be NUL terminated.
+ */
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+typedef struct
+{
+  GInputStream      *stream;
+  IdeLineReaderFunc  func;
+  gpointer           func_data;
+  GDestroyNotify     func_data_destroy;
+  gchar             *buffer;
+  gsize              allocated;
+  gsize              len;
+} StreamState;
+
+static StreamState *
+stream_state_new (GInputStream      *stream,
+                  IdeLineReaderFunc  func,
+                  gpointer           func_data,
+                  GDestroyNotify     func_data_destroy)
+{
+  StreamState *state;
+
+  state = g_slice_new0 (StreamState);
+  state->stream = g_object_ref (stream);
+  state->func = func;
+  state->func_data = func_data;
+  state->func_data_destroy = func_data_destroy;
+  state->allocated = STREAM_BUFFER_SIZE;
+  state->buffer = g_malloc (state->allocated + 1);
+  state->len = 0;
+
+  return state;
+}
+
+static void
+stream_state_free (gpointer data)
+{
+  StreamState *state = data;
+
+  if (state->func_data_destroy != NULL)
+    state->func_data_destroy (state->func_data);
+
+  g_clear_object (&state->stream);
+  g_clear_pointer (&state->buffer, g_free);
+  g_slice_free (StreamState, state);
+}
+
+static void
+stream_state_prepare (StreamState  *state,
+                      gchar       **buffer,
+                      gsize        *count)
+{
+  g_assert (state != NULL);
+  g_assert (buffer != NULL);
+  g_assert (count != NULL);
+
+  /* Only possible if a single line is larger than our buffer */
+  if G_UNLIKELY (state->len == state->allocated)
+    {
+      state->allocated *= 2;
+      state->buffer = g_realloc (state->buffer, state->allocated + 1);
+    }
+
+  *buffer = &state->buffer [state->len];
+  *count = state->allocated - state->len;
+}
+
+/*
+ * Hands all complete lines to the consumer after @n_read bytes have been
+ * read into the region returned from stream_state_prepare(). A read of
+ * zero bytes means end of stream, flushing any unterminated line.
+ *
+ * Returns: %TRUE if more data should be read.
+ */
+static gboolean
+stream_state_dispatch (StreamState *state,
+                       gsize        n_read)
+{
+  IdeLineReader reader;
+  gsize begin;
+  gsize end;
+
+  g_assert (state != NULL);
+  g_assert (state->len + n_read <= state->allocated);
+
+  if (n_read == 0)
+    {
+      if (state->len > 0)
+        {
+          state->buffer [state->len] = '\0';
+          ide_line_reader_init (&reader, state->buffer, state->len);
+          state->func (&reader, state->func_data);
+          state->len = 0;
+        }
+
+      return FALSE;
+    }
+
+  begin = state->len;
+  state->len += n_read;
+
+  /* Bytes kept from the previous read never contain a newline */
+  for (end = state->len; end > begin; end--)
+    {
+      if (state->buffer [end - 1] == '\n')
+        break;
+    }
+
+  if (end == begin)
+    return TRUE;
+
+  ide_line_reader_init (&reader, state->buffer, end);
+
+  if (!state->func (&reader, state->func_data))
+    return FALSE;
+
+  state->len -= end;
+
+  if (state->len > 0)
+    memmove (state->buffer, &state->buffer [end], state->len);
+
+  return TRUE;
+}
+
+/**
+ * ide_line_reader_read_stream:
+ * @stream: a #GInputStream
+ * @func: (scope call): a callback to receive lines
+ * @func_data: closure data for @func
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @error: a location for a #GError or %NULL
+ *
+ * Reads @stream until end of stream, calling @func with batches of complete
+ * lines. No allocations are made per line, and @stream is not read again
+ * until @func returns, so a slow consumer applies backpressure to the writer.
+ *
+ * If @func returns %FALSE, reading stops and the rest of @stream is left
+ * unread.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_line_reader_read_stream (GInputStream       *stream,
+                             IdeLineReaderFunc   func,
+                             gpointer            func_data,
+                             GCancellable       *cancellable,
+                             GError            **error)
+{
+  StreamState *state;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  state = stream_state_new (stream, func, func_data, NULL);
+
+  for (;;)
+    {
+      gchar *buffer;
+      gsize count;
+      gssize n_read;
+
+      stream_state_prepare (state, &buffer, &count);
+
+      n_read = g_input_stream_read (stream, buffer, count, cancellable, error);
+
+      if (n_read < 0)
+        {
+          ret = FALSE;
+          break;
+        }
+
+      if (!stream_state_dispatch (state, n_read))
+        break;
+    }
+
+  stream_state_free (state);
+
+  return ret;
+}
+
+static void ide_line_reader_read_stream_next (GTask *task);
+
+static void
+ide_line_reader_read_stream_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  GInputStream *stream = (GInputStream *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
+  StreamState *state;
+  gssize n_read;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  n_read = g_input_stream_read_finish (stream, result, &error);
+
+  if (n_read < 0)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (!stream_state_dispatch (state, n_read))
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  ide_line_reader_read_stream_next (g_steal_pointer (&task));
+}
+
+static void
+ide_line_reader_read_stream_next (GTask *task)
+{
+  StreamState *state;
+  gchar *buffer;
+  gsize count;
+
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  stream_state_prepare (state, &buffer, &count);
+
+  g_input_stream_read_async (state->stream,
+                             buffer,
+                             count,
+                             g_task_get_priority (task),
+                             g_task_get_cancellable (task),
+                             ide_line_reader_read_stream_cb,
+                             task);
+}
+
+/**
+ * ide_line_reader_read_stream_async:
+ * @stream: a #GInputStream
+ * @func: (scope notified): a callback to receive lines
+ * @func_data: closure data for @func
+ * @func_data_destroy: (nullable): a #GDestroyNotify for @func_data
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Asynchronous version of ide_line_reader_read_stream(). @func is called
+ * from the thread-default main context of the caller. The next read is not
+ * started until @func returns.
+ */
+void
+ide_line_reader_read_stream_async (GInputStream        *stream,
+                                   IdeLineReaderFunc    func,
+                                   gpointer             func_data,
+                                   GDestroyNotify       func_data_destroy,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (stream, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_line_reader_read_stream_async);
+  g_task_set_task_data (task,
+                        stream_state_new (stream, func, func_data, func_data_destroy),
+                        stream_state_free);
+
+  ide_line_reader_read_stream_next (g_steal_pointer (&task));
+}
+
+/**
+ * ide_line_reader_read_stream_finish:
+ * @stream: a #GInputStream
+ * @result: a #GAsyncResult provided to the callback
+ * @error: a location for a #GError or %NULL
+ *
+ * Completes an asynchronous request to ide_line_reader_read_stream_async().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_line_reader_read_stream_finish (GInputStream  *stream,
+                                    GAsyncResult  *result,
+                                    GError       **error)
+{
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, stream), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
@@ -19,7 +19,7 @@
 #ifndef IDE_LINE_READER_H
 #define IDE_LINE_READER_H
 
-#include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -30,11 +30,42 @@ typedef struct
   gssize  pos;
 } IdeLineReader;
 
-void   ide_line_reader_init (IdeLineReader *reader,
-                             gchar         *contents,
-                             gssize         length);
-gchar *ide_line_reader_next (IdeLineReader *reader,
-                             gsize         *length);
+/**
+ * IdeLineReaderFunc:
+ * @reader: an #IdeLineReader containing one or more complete lines
+ * @user_data: closure data for the callback
+ *
+ * Callback for ide_line_reader_read_stream() and friends. Lines returned
+ * from @reader point into a buffer owned by the caller that is reused once
+ * the callback returns, so copy anything that must outlive the callback.
+ * The byte following each line (its newline) may be overwritten, such as
+ * to terminate the line with a NUL byte.
+ *
+ * Returns: %TRUE to continue reading, %FALSE to stop.
+ */
+typedef gboolean (*IdeLineReaderFunc) (IdeLineReader *reader,
+                                       gpointer       user_data);
+
+void     ide_line_reader_init               (IdeLineReader        *reader,
+                                             gchar                *contents,
+                                             gssize                length);
+gchar   *ide_line_reader_next               (IdeLineReader        *reader,
+                                             gsize                *length);
+gboolean ide_line_reader_read_stream        (GInputStream         *stream,
+                                             IdeLineReaderFunc     func,
+                                             gpointer              func_data,
+                                             GCancellable         *cancellable,
+                                             GError              **error);
+void     ide_line_reader_read_stream_async  (GInputStream         *stream,
+                                             IdeLineReaderFunc     func,
+                                             gpointer              func_data,
+                                             GDestroyNotify        func_data_destroy,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean ide_line_reader_read_stream_finish (GInputStream         *stream,
+                                             GAsyncResult         *result,
+                                             GError              **error);
 
 G_END_DECLS
 
@@ -85,6 +85,54 @@ ide_vcs_is_ignored (IdeVcs  *self,
   return FALSE;
 }
 
+/**
+ * ide_vcs_is_ignored_many:
+ * @self: An #IdeVcs
+ * @files: (array length=n_files): An array of #GFile
+ * @n_files: the number of elements in @files
+ * @ignored: (array length=n_files) (out caller-allocates): a location for the
+ *   result of each file.
+ * @error: A location for a #GError, or %NULL
+ *
+ * Like ide_vcs_is_ignored() but checks many files at once, which allows the
+ * implementation to amortize the cost of the lookup. This is meant for
+ * crawlers checking every file of a directory, and like ide_vcs_is_ignored()
+ * it may be called from a thread.
+ *
+ * Returns: %TRUE if @ignored was filled in, otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_vcs_is_ignored_many (IdeVcs    *self,
+                         GFile    **files,
+                         guint      n_files,
+                         gboolean  *ignored,
+                         GError   **error)
+{
+  guint i;
+
+  g_return_val_if_fail (IDE_IS_VCS (self), FALSE);
+  g_return_val_if_fail (files != NULL || n_files == 0, FALSE);
+  g_return_val_if_fail (ignored != NULL || n_files == 0, FALSE);
+
+  if (IDE_VCS_GET_IFACE (self)->is_ignored_many)
+    return IDE_VCS_GET_IFACE (self)->is_ignored_many (self, files, n_files, ignored, error);
+
+  for (i = 0; i < n_files; i++)
+    {
+      GError *local_error = NULL;
+
+      ignored [i] = ide_vcs_is_ignored (self, files [i], &local_error);
+
+      if (local_error != NULL)
+        {
+          g_propagate_error (error, local_error);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 gint
 ide_vcs_get_priority (IdeVcs *self)
 {
@@ -44,6 +44,11 @@ struct _IdeVcsInterface
   void                    (*changed)                   (IdeVcs     *self);
   IdeVcsConfig           *(*get_config)                (IdeVcs     *self);
   gchar                  *(*get_branch_name)           (IdeVcs     *self);
+  gboolean                (*is_ignored_many)           (IdeVcs     *self,
+                                                        GFile     **files,
+                                                        guint       n_files,
+                                                        gboolean   *ignored,
+                                                        GError    **error);
 };
 
 IdeBufferChangeMonitor *ide_vcs_get_buffer_change_monitor (IdeVcs               *self,
@@ -59,6 +64,11 @@ IdeVcs                 *ide_vcs_new_finish                (GAsyncResult
 gboolean                ide_vcs_is_ignored                (IdeVcs               *self,
                                                            GFile                *file,
                                                            GError              **error);
+gboolean                ide_vcs_is_ignored_many           (IdeVcs               *self,
+                                                           GFile               **files,
+                                                           guint                 n_files,
+                                                           gboolean             *ignored,
+                                                           GError              **error);
 gint                    ide_vcs_get_priority              (IdeVcs               *self);
 void                    ide_vcs_emit_changed              (IdeVcs               *self);
 IdeVcsConfig           *ide_vcs_get_config                (IdeVcs               *self);
@@ -20,6 +20,7 @@
 
 #include <egg-counter.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <gio/gunixsocketaddress.h>
 #include <glib/gi18n.h>
 #include <stdlib.h>
@@ -31,12 +32,31 @@
 #include "workers/ide-worker-process.h"
 #include "workers/ide-worker-manager.h"
 
+/*
+ * Each plugin gets a pool of worker processes. Plugins that declare a worker
+ * have their first worker spawned at idle priority after startup, see
+ * ide_worker_manager_warm(). Otherwise it is spawned when the plugin first
+ * requests it. Whenever every connected worker in the pool is busy with a
+ * request, another one is spawned at idle priority (up to a limit based on
+ * the number of processors) so that the next request has a warm worker
+ * waiting for it instead of paying for process startup.
+ */
+#define MAX_WORKERS_PER_PLUGIN 4
+
+typedef struct
+{
+  IdeWorkerManager *self;
+  gchar            *plugin_name;
+  GPtrArray        *workers;
+  guint             spare_source;
+} IdeWorkerPool;
+
 struct _IdeWorkerManager
 {
   GObject      parent_instance;
 
   GDBusServer *dbus_server;
-  GHashTable  *plugin_name_to_worker;
+  GHashTable  *plugin_name_to_pool;
 };
 
 G_DEFINE_TYPE (IdeWorkerManager, ide_worker_manager, G_TYPE_OBJECT)
@@ -50,7 +70,7 @@ ide_worker_manager_new_connection_cb (IdeWorkerManager *self,
 {
   GCredentials *credentials;
   GHashTableIter iter;
-  gpointer key, value;
+  gpointer value;
 
   IDE_ENTRY;
 
@@ -64,16 +84,21 @@ ide_worker_manager_new_connection_cb (IdeWorkerManager *self,
   if ((credentials == NULL) || (-1 == g_credentials_get_unix_pid (credentials, NULL)))
     IDE_RETURN (FALSE);
 
-  g_hash_table_iter_init (&iter, self->plugin_name_to_worker);
+  g_hash_table_iter_init (&iter, self->plugin_name_to_pool);
 
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  while (g_hash_table_iter_next (&iter, NULL, &value))
     {
-      IdeWorkerProcess *process = value;
+      IdeWorkerPool *pool = value;
 
-      if (ide_worker_process_matches_credentials (process, credentials))
+      for (guint i = 0; i < pool->workers->len; i++)
         {
-          ide_worker_process_set_connection (process, connection);
-          IDE_RETURN (TRUE);
+          IdeWorkerProcess *process = g_ptr_array_index (pool->workers, i);
+
+          if (ide_worker_process_matches_credentials (process, credentials))
+            {
+              ide_worker_process_set_connection (process, connection);
+              IDE_RETURN (TRUE);
+            }
         }
     }
 
@@ -150,6 +175,33 @@ ide_worker_manager_force_exit_worker (gpointer instance)
   g_object_unref (process);
 }
 
+static void
+ide_worker_pool_free (gpointer data)
+{
+  IdeWorkerPool *pool = data;
+
+  if (pool->spare_source != 0)
+    {
+      g_source_remove (pool->spare_source);
+      pool->spare_source = 0;
+    }
+
+  g_clear_pointer (&pool->workers, g_ptr_array_unref);
+  g_clear_pointer (&pool->plugin_name, g_free);
+  g_slice_free (IdeWorkerPool, pool);
+}
+
+static guint
+ide_worker_manager_get_max_workers (void)
+{
+  static guint max_workers;
+
+  if (max_workers == 0)
+    max_workers = CLAMP (g_get_num_processors () / 2, 1, MAX_WORKERS_PER_PLUGIN);
+
+  return max_workers;
+}
+
 static void
 ide_worker_manager_finalize (GObject *object)
 {
@@ -158,7 +210,7 @@ ide_worker_manager_finalize (GObject *object)
   if (self->dbus_server != NULL)
     g_dbus_server_stop (self->dbus_server);
 
-  g_clear_pointer (&self->plugin_name_to_worker, g_hash_table_unref);
+  g_clear_pointer (&self->plugin_name_to_pool, g_hash_table_unref);
   g_clear_object (&self->dbus_server);
 
   G_OBJECT_CLASS (ide_worker_manager_parent_class)->finalize (object);
@@ -180,49 +232,180 @@ ide_worker_manager_init (IdeWorkerManager *self)
 {
   EGG_COUNTER_INC (instances);
 
-  self->plugin_name_to_worker =
+  self->plugin_name_to_pool =
     g_hash_table_new_full (g_str_hash,
                            g_str_equal,
-                           g_free,
-                           ide_worker_manager_force_exit_worker);
+                           NULL,
+                           ide_worker_pool_free);
+}
+
+static void
+ide_worker_manager_spawn_worker (IdeWorkerManager *self,
+                                 IdeWorkerPool    *pool)
+{
+  g_autofree gchar *address = NULL;
+  IdeWorkerProcess *worker_process;
+  const gchar *path = PACKAGE_LIBEXECDIR G_DIR_SEPARATOR_S "gnome-builder-worker";
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_WORKER_MANAGER (self));
+  g_assert (pool != NULL);
+
+  address = g_strdup_printf ("%s,guid=%s",
+                             g_dbus_server_get_client_address (self->dbus_server),
+                             g_dbus_server_get_guid (self->dbus_server));
+
+  /*
+   * If we are running out of tree, rely on PATH to access
+   * gnome-builder-worker from the build directory.
+   */
+  if (g_getenv ("GB_IN_TREE_PLUGINS") != NULL)
+    path = "gnome-builder-worker";
+
+  IDE_TRACE_MSG ("Spawning worker %u for %s", pool->workers->len, pool->plugin_name);
+
+  worker_process = ide_worker_process_new (path, pool->plugin_name, address, pool->workers->len);
+  g_ptr_array_add (pool->workers, worker_process);
+  ide_worker_process_run (worker_process);
+
+  IDE_EXIT;
+}
+
+static gboolean
+ide_worker_manager_spawn_spare_cb (gpointer data)
+{
+  IdeWorkerPool *pool = data;
+
+  g_assert (pool != NULL);
+  g_assert (IDE_IS_WORKER_MANAGER (pool->self));
+
+  pool->spare_source = 0;
+
+  if (pool->self->dbus_server != NULL &&
+      pool->workers->len < ide_worker_manager_get_max_workers ())
+    ide_worker_manager_spawn_worker (pool->self, pool);
+
+  return G_SOURCE_REMOVE;
 }
 
+static void
+ide_worker_manager_maybe_spawn_spare (IdeWorkerManager *self,
+                                      IdeWorkerPool    *pool)
+{
+  g_assert (IDE_IS_WORKER_MANAGER (self));
+  g_assert (pool != NULL);
+
+  if (pool->spare_source != 0 ||
+      pool->workers->len >= ide_worker_manager_get_max_workers ())
+    return;
+
+  /* Nothing to do if a connected worker is still idle */
+  for (guint i = 0; i < pool->workers->len; i++)
+    {
+      IdeWorkerProcess *worker_process = g_ptr_array_index (pool->workers, i);
+
+      if (!ide_worker_process_get_ready (worker_process) ||
+          ide_worker_process_get_in_flight (worker_process) == 0)
+        return;
+    }
+
+  pool->spare_source = g_idle_add_full (G_PRIORITY_LOW,
+                                        ide_worker_manager_spawn_spare_cb,
+                                        pool,
+                                        NULL);
+}
+
+static IdeWorkerPool *
+ide_worker_manager_ensure_pool (IdeWorkerManager *self,
+                                const gchar      *plugin_name)
+{
+  IdeWorkerPool *pool;
+
+  g_assert (IDE_IS_WORKER_MANAGER (self));
+  g_assert (plugin_name != NULL);
+
+  if (!self->plugin_name_to_pool || !self->dbus_server)
+    return NULL;
+
+  pool = g_hash_table_lookup (self->plugin_name_to_pool, plugin_name);
+
+  if (pool == NULL)
+    {
+      pool = g_slice_new0 (IdeWorkerPool);
+      pool->self = self;
+      pool->plugin_name = g_strdup (plugin_name);
+      pool->workers = g_ptr_array_new_with_free_func (ide_worker_manager_force_exit_worker);
+      g_hash_table_insert (self->plugin_name_to_pool, pool->plugin_name, pool);
+    }
+
+  return pool;
+}
+
+static IdeWorkerPool *
+ide_worker_manager_get_pool (IdeWorkerManager *self,
+                             const gchar      *plugin_name)
+{
+  IdeWorkerPool *pool;
+
+  g_assert (IDE_IS_WORKER_MANAGER (self));
+  g_assert (plugin_name != NULL);
+
+  if (NULL == (pool = ide_worker_manager_ensure_pool (self, plugin_name)))
+    return NULL;
+
+  /*
+   * A request arrived before the idle spawn of the first worker ran, so
+   * spawn it now rather than making the request wait for the main loop.
+   */
+  if (pool->workers->len == 0)
+    {
+      if (pool->spare_source != 0)
+        {
+          g_source_remove (pool->spare_source);
+          pool->spare_source = 0;
+        }
+
+      ide_worker_manager_spawn_worker (self, pool);
+    }
+
+  return pool;
+}
+
+/*
+ * Selects the connected worker with the fewest outstanding requests. If no
+ * worker has connected yet, the first one is used and the request will be
+ * queued until it connects.
+ */
 static IdeWorkerProcess *
 ide_worker_manager_get_worker_process (IdeWorkerManager *self,
                                        const gchar      *plugin_name)
 {
-  IdeWorkerProcess *worker_process;
+  IdeWorkerProcess *best = NULL;
+  IdeWorkerPool *pool;
 
   g_assert (IDE_IS_WORKER_MANAGER (self));
   g_assert (plugin_name != NULL);
 
-  if (!self->plugin_name_to_worker || !self->dbus_server)
+  if (NULL == (pool = ide_worker_manager_get_pool (self, plugin_name)))
     return NULL;
 
-  worker_process = g_hash_table_lookup (self->plugin_name_to_worker, plugin_name);
-
-  if (worker_process == NULL)
+  for (guint i = 0; i < pool->workers->len; i++)
     {
-      g_autofree gchar *address = NULL;
-      const gchar *path = PACKAGE_LIBEXECDIR G_DIR_SEPARATOR_S "gnome-builder-worker";
-
-      address = g_strdup_printf ("%s,guid=%s",
-                                 g_dbus_server_get_client_address (self->dbus_server),
-                                 g_dbus_server_get_guid (self->dbus_server));
-
-      /*
-       * If we are running out of tree, rely on PATH to access
-       * gnome-builder-worker from the build directory.
-       */
-      if (g_getenv ("GB_IN_TREE_PLUGINS") != NULL)
-        path = "gnome-builder-worker";
-
-      worker_process = ide_worker_process_new (path, plugin_name, address);
-      g_hash_table_insert (self->plugin_name_to_worker, g_strdup (plugin_name), worker_process);
-      ide_worker_process_run (worker_process);
+      IdeWorkerProcess *worker_process = g_ptr_array_index (pool->workers, i);
+
+      if (!ide_worker_process_get_ready (worker_process))
+        continue;
+
+      if (best == NULL ||
+          ide_worker_process_get_in_flight (worker_process) < ide_worker_process_get_in_flight (best))
+        best = worker_process;
     }
 
-  return worker_process;
+  if (best == NULL)
+    best = g_ptr_array_index (pool->workers, 0);
+
+  return best;
 }
 
 static void
@@ -266,6 +449,17 @@ ide_worker_manager_get_worker_async (IdeWorkerManager    *self,
 
   task = g_task_new (self, cancellable, callback, user_data);
   worker_process = ide_worker_manager_get_worker_process (self, plugin_name);
+
+  if (worker_process == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CLOSED,
+                               "The worker manager has been shutdown");
+      g_object_unref (task);
+      return;
+    }
+
   ide_worker_process_get_proxy_async (worker_process,
                                       cancellable,
                                       ide_worker_manager_get_worker_cb,
@@ -285,6 +479,151 @@ ide_worker_manager_get_worker_finish (IdeWorkerManager  *self,
   return g_task_propagate_pointer (task, error);
 }
 
+static void
+ide_worker_manager_call_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  IdeWorkerProcess *worker_process = (IdeWorkerProcess *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GUnixFDList) out_fd_list = NULL;
+  GVariant *ret;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_WORKER_PROCESS (worker_process));
+  g_assert (G_IS_TASK (task));
+
+  ret = ide_worker_process_call_finish (worker_process, result, &out_fd_list, &error);
+
+  if (ret == NULL)
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  if (out_fd_list != NULL)
+    g_task_set_task_data (task, g_steal_pointer (&out_fd_list), g_object_unref);
+
+  g_task_return_pointer (task, ret, (GDestroyNotify)g_variant_unref);
+
+  IDE_EXIT;
+}
+
+/*
+ * Calls @method_name on the least busy worker in the pool for @plugin_name.
+ * If every connected worker is busy, another is spawned at idle priority so
+ * that it is warm for the next request.
+ */
+void
+ide_worker_manager_call_async (IdeWorkerManager    *self,
+                               const gchar         *plugin_name,
+                               const gchar         *method_name,
+                               GVariant            *parameters,
+                               GUnixFDList         *fd_list,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  IdeWorkerProcess *worker_process;
+  g_autoptr(GTask) task = NULL;
+  IdeWorkerPool *pool;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_WORKER_MANAGER (self));
+  g_return_if_fail (plugin_name != NULL);
+  g_return_if_fail (method_name != NULL);
+  g_return_if_fail (!fd_list || G_IS_UNIX_FD_LIST (fd_list));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_worker_manager_call_async);
+
+  worker_process = ide_worker_manager_get_worker_process (self, plugin_name);
+
+  if (worker_process == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CLOSED,
+                               "The worker manager has been shutdown");
+      IDE_EXIT;
+    }
+
+  ide_worker_process_call_async (worker_process,
+                                 method_name,
+                                 parameters,
+                                 fd_list,
+                                 -1,
+                                 cancellable,
+                                 ide_worker_manager_call_cb,
+                                 g_object_ref (task));
+
+  pool = g_hash_table_lookup (self->plugin_name_to_pool, plugin_name);
+  ide_worker_manager_maybe_spawn_spare (self, pool);
+
+  IDE_EXIT;
+}
+
+GVariant *
+ide_worker_manager_call_finish (IdeWorkerManager  *self,
+                                GAsyncResult      *result,
+                                GUnixFDList      **out_fd_list,
+                                GError           **error)
+{
+  GTask *task = (GTask *)result;
+  GVariant *ret;
+
+  g_return_val_if_fail (IDE_IS_WORKER_MANAGER (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (task), NULL);
+
+  ret = g_task_propagate_pointer (task, error);
+
+  if (out_fd_list != NULL)
+    {
+      GUnixFDList *fd_list = g_task_get_task_data (task);
+
+      *out_fd_list = fd_list ? g_object_ref (fd_list) : NULL;
+    }
+
+  return ret;
+}
+
+/**
+ * ide_worker_manager_warm:
+ * @self: An #IdeWorkerManager
+ * @plugin_name: the name of the plugin providing the worker
+ *
+ * Spawns the first worker for @plugin_name at idle priority, so that the
+ * first request to the plugin does not have to wait for process startup.
+ * Nothing is done if the pool for @plugin_name already exists.
+ */
+void
+ide_worker_manager_warm (IdeWorkerManager *self,
+                         const gchar      *plugin_name)
+{
+  IdeWorkerPool *pool;
+
+  g_return_if_fail (IDE_IS_WORKER_MANAGER (self));
+  g_return_if_fail (plugin_name != NULL);
+
+  if (self->plugin_name_to_pool != NULL &&
+      g_hash_table_contains (self->plugin_name_to_pool, plugin_name))
+    return;
+
+  if (NULL == (pool = ide_worker_manager_ensure_pool (self, plugin_name)))
+    return;
+
+  IDE_TRACE_MSG ("Warming first worker for %s at idle", plugin_name);
+
+  pool->spare_source = g_idle_add_full (G_PRIORITY_LOW,
+                                        ide_worker_manager_spawn_spare_cb,
+                                        pool,
+                                        NULL);
+}
+
 IdeWorkerManager *
 ide_worker_manager_new (void)
 {
@@ -299,6 +638,6 @@ ide_worker_manager_shutdown (IdeWorkerManager *self)
   if (self->dbus_server != NULL)
     g_dbus_server_stop (self->dbus_server);
 
-  g_clear_pointer (&self->plugin_name_to_worker, g_hash_table_unref);
+  g_clear_pointer (&self->plugin_name_to_pool, g_hash_table_unref);
   g_clear_object (&self->dbus_server);
 }
@@ -20,6 +20,7 @@
 #define IDE_WORKER_MANAGER_H
 
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 
 G_BEGIN_DECLS
 
@@ -29,6 +30,8 @@ G_DECLARE_FINAL_TYPE (IdeWorkerManager, ide_worker_manager, IDE, WORKER_MANAGER,
 
 IdeWorkerManager *ide_worker_manager_new               (void);
 void              ide_worker_manager_shutdown          (IdeWorkerManager     *self);
+void              ide_worker_manager_warm              (IdeWorkerManager     *self,
+                                                        const gchar          *plugin_name);
 void              ide_worker_manager_get_worker_async  (IdeWorkerManager     *self,
                                                         const gchar          *plugin_name,
                                                         GCancellable         *cancellable,
@@ -37,6 +40,18 @@ void              ide_worker_manager_get_worker_async  (IdeWorkerManager     *se
 GDBusProxy       *ide_worker_manager_get_worker_finish (IdeWorkerManager     *self,
                                                         GAsyncResult         *result,
                                                         GError              **error);
+void              ide_worker_manager_call_async        (IdeWorkerManager     *self,
+                                                        const gchar          *plugin_name,
+                                                        const gchar          *method_name,
+                                                        GVariant             *parameters,
+                                                        GUnixFDList          *fd_list,
+                                                        GCancellable         *cancellable,
+                                                        GAsyncReadyCallback   callback,
+                                                        gpointer              user_data);
+GVariant         *ide_worker_manager_call_finish       (IdeWorkerManager     *self,
+                                                        GAsyncResult         *result,
+                                                        GUnixFDList         **out_fd_list,
+                                                        GError              **error);
 
 G_END_DECLS
 
@@ -19,6 +19,7 @@
 #define G_LOG_DOMAIN "ide-worker-process"
 
 #include <egg-counter.h>
+#include <gio/gunixfdlist.h>
 #include <libpeas/peas.h>
 
 #include "ide-debug.h"
@@ -36,21 +37,55 @@ struct _IdeWorkerProcess
   gchar           *plugin_name;
   GSubprocess     *subprocess;
   GDBusConnection *connection;
+  GDBusProxy      *proxy;
   GPtrArray       *tasks;
   IdeWorker       *worker;
 
+  guint            slot;
+  guint            in_flight;
+
   guint            quit : 1;
 };
 
+typedef struct
+{
+  gchar       *method_name;
+  GVariant    *parameters;
+  GUnixFDList *fd_list;
+  GUnixFDList *out_fd_list;
+  gint64       begin_time;
+  gint         timeout_msec;
+} CallState;
+
 G_DEFINE_TYPE (IdeWorkerProcess, ide_worker_process, G_TYPE_OBJECT)
 
 EGG_DEFINE_COUNTER (instances, "IdeWorkerProcess", "Instances", "Number of IdeWorkerProcess instances")
 
+/*
+ * Request counters for each slot of a plugin's pool, shared by every plugin.
+ * Pools never grow beyond four workers, see ide-worker-manager.c.
+ */
+EGG_DEFINE_COUNTER (slot0_requests, "IdeWorkerProcess", "Slot 0 Requests", "Number of completed requests to workers in slot 0")
+EGG_DEFINE_COUNTER (slot0_latency, "IdeWorkerProcess", "Slot 0 Latency", "Total request latency of workers in slot 0, in microseconds")
+EGG_DEFINE_COUNTER (slot1_requests, "IdeWorkerProcess", "Slot 1 Requests", "Number of completed requests to workers in slot 1")
+EGG_DEFINE_COUNTER (slot1_latency, "IdeWorkerProcess", "Slot 1 Latency", "Total request latency of workers in slot 1, in microseconds")
+EGG_DEFINE_COUNTER (slot2_requests, "IdeWorkerProcess", "Slot 2 Requests", "Number of completed requests to workers in slot 2")
+EGG_DEFINE_COUNTER (slot2_latency, "IdeWorkerProcess", "Slot 2 Latency", "Total request latency of workers in slot 2, in microseconds")
+EGG_DEFINE_COUNTER (slot3_requests, "IdeWorkerProcess", "Slot 3 Requests", "Number of completed requests to workers in slot 3")
+EGG_DEFINE_COUNTER (slot3_latency, "IdeWorkerProcess", "Slot 3 Latency", "Total request latency of workers in slot 3, in microseconds")
+
+#define SLOT_COUNTERS_ADD(Slot, Latency)                 \
+  G_STMT_START {                                         \
+    EGG_COUNTER_INC (slot##Slot##_requests);             \
+    EGG_COUNTER_ADD (slot##Slot##_latency, Latency);     \
+  } G_STMT_END
+
 enum {
   PROP_0,
   PROP_ARGV0,
   PROP_PLUGIN_NAME,
   PROP_DBUS_ADDRESS,
+  PROP_SLOT,
   LAST_PROP
 };
 
@@ -58,10 +93,23 @@ static GParamSpec *gParamSpecs [LAST_PROP];
 
 static void ide_worker_process_respawn (IdeWorkerProcess *self);
 
+static void
+call_state_free (gpointer data)
+{
+  CallState *state = data;
+
+  g_clear_pointer (&state->method_name, g_free);
+  g_clear_pointer (&state->parameters, g_variant_unref);
+  g_clear_object (&state->fd_list);
+  g_clear_object (&state->out_fd_list);
+  g_slice_free (CallState, state);
+}
+
 IdeWorkerProcess *
 ide_worker_process_new (const gchar *argv0,
                         const gchar *plugin_name,
-                        const gchar *dbus_address)
+                        const gchar *dbus_address,
+                        guint        slot)
 {
   IdeWorkerProcess *ret;
 
@@ -75,6 +123,7 @@ ide_worker_process_new (const gchar *argv0,
                       "argv0", argv0,
                       "plugin-name", plugin_name,
                       "dbus-address", dbus_address,
+                      "slot", slot,
                       NULL);
 
   IDE_RETURN (ret);
@@ -103,6 +152,13 @@ ide_worker_process_wait_check_cb (GObject      *object,
 
   g_clear_object (&self->subprocess);
 
+  /*
+   * The new process will connect to the server again, so drop the stale
+   * connection and proxy to ensure new requests wait for it.
+   */
+  g_clear_object (&self->proxy);
+  g_clear_object (&self->connection);
+
   if (!self->quit)
     ide_worker_process_respawn (self);
 
@@ -235,6 +291,7 @@ ide_worker_process_finalize (GObject *object)
   g_clear_pointer (&self->dbus_address, g_free);
   g_clear_pointer (&self->tasks, g_ptr_array_unref);
   g_clear_object (&self->connection);
+  g_clear_object (&self->proxy);
   g_clear_object (&self->subprocess);
   g_clear_object (&self->worker);
 
@@ -265,6 +322,10 @@ ide_worker_process_get_property (GObject    *object,
       g_value_set_string (value, self->dbus_address);
       break;
 
+    case PROP_SLOT:
+      g_value_set_uint (value, self->slot);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -292,6 +353,10 @@ ide_worker_process_set_property (GObject      *object,
       self->dbus_address = g_value_dup_string (value);
       break;
 
+    case PROP_SLOT:
+      self->slot = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -328,6 +393,15 @@ ide_worker_process_class_init (IdeWorkerProcessClass *klass)
                          NULL,
                          (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
+  gParamSpecs [PROP_SLOT] =
+    g_param_spec_uint ("slot",
+                       "Slot",
+                       "The index of the worker within its plugin's pool",
+                       0,
+                       G_MAXUINT,
+                       0,
+                       (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_properties (object_class, LAST_PROP, gParamSpecs);
 }
 
@@ -381,6 +455,12 @@ ide_worker_process_create_proxy_for_task (IdeWorkerProcess *self,
       IDE_EXIT;
     }
 
+  if (self->proxy != NULL)
+    {
+      g_task_return_pointer (task, g_object_ref (self->proxy), g_object_unref);
+      IDE_EXIT;
+    }
+
   proxy = ide_worker_create_proxy (self->worker, self->connection, &error);
 
   if (proxy == NULL)
@@ -393,6 +473,8 @@ ide_worker_process_create_proxy_for_task (IdeWorkerProcess *self,
       IDE_EXIT;
     }
 
+  self->proxy = g_object_ref (proxy);
+
   g_task_return_pointer (task, proxy, g_object_unref);
 
   IDE_EXIT;
@@ -470,3 +552,196 @@ ide_worker_process_get_proxy_finish (IdeWorkerProcess  *self,
 
   IDE_RETURN (ret);
 }
+
+gboolean
+ide_worker_process_get_ready (IdeWorkerProcess *self)
+{
+  g_return_val_if_fail (IDE_IS_WORKER_PROCESS (self), FALSE);
+
+  return self->connection != NULL;
+}
+
+guint
+ide_worker_process_get_in_flight (IdeWorkerProcess *self)
+{
+  g_return_val_if_fail (IDE_IS_WORKER_PROCESS (self), 0);
+
+  return self->in_flight;
+}
+
+static void
+ide_worker_process_complete_call (IdeWorkerProcess *self,
+                                  CallState        *state)
+{
+  gint64 latency;
+
+  g_assert (IDE_IS_WORKER_PROCESS (self));
+  g_assert (state != NULL);
+  g_assert (self->in_flight > 0);
+
+  self->in_flight--;
+
+  latency = g_get_monotonic_time () - state->begin_time;
+
+  switch (self->slot)
+    {
+    case 0:
+      SLOT_COUNTERS_ADD (0, latency);
+      break;
+
+    case 1:
+      SLOT_COUNTERS_ADD (1, latency);
+      break;
+
+    case 2:
+      SLOT_COUNTERS_ADD (2, latency);
+      break;
+
+    default:
+      SLOT_COUNTERS_ADD (3, latency);
+      break;
+    }
+}
+
+static void
+ide_worker_process_call_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  GDBusProxy *proxy = (GDBusProxy *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GVariant) ret = NULL;
+  IdeWorkerProcess *self;
+  CallState *state;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_DBUS_PROXY (proxy));
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  state = g_task_get_task_data (task);
+
+  ret = g_dbus_proxy_call_with_unix_fd_list_finish (proxy, &state->out_fd_list, result, &error);
+
+  ide_worker_process_complete_call (self, state);
+
+  if (ret == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, g_steal_pointer (&ret), (GDestroyNotify)g_variant_unref);
+
+  IDE_EXIT;
+}
+
+static void
+ide_worker_process_call_get_proxy_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  IdeWorkerProcess *self = (IdeWorkerProcess *)object;
+  g_autoptr(GDBusProxy) proxy = NULL;
+  g_autoptr(GTask) task = user_data;
+  CallState *state;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_WORKER_PROCESS (self));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  proxy = ide_worker_process_get_proxy_finish (self, result, &error);
+
+  if (proxy == NULL)
+    {
+      ide_worker_process_complete_call (self, state);
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_dbus_proxy_call_with_unix_fd_list (proxy,
+                                       state->method_name,
+                                       state->parameters,
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       state->timeout_msec,
+                                       state->fd_list,
+                                       g_task_get_cancellable (task),
+                                       ide_worker_process_call_cb,
+                                       g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+/*
+ * Calls @method_name on the worker, waiting for the process to connect if
+ * necessary. The time from this call until the reply is received is added
+ * to the latency counter for the worker's slot.
+ */
+void
+ide_worker_process_call_async (IdeWorkerProcess    *self,
+                               const gchar         *method_name,
+                               GVariant            *parameters,
+                               GUnixFDList         *fd_list,
+                               gint                 timeout_msec,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  CallState *state;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_WORKER_PROCESS (self));
+  g_return_if_fail (method_name != NULL);
+  g_return_if_fail (!fd_list || G_IS_UNIX_FD_LIST (fd_list));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  state = g_slice_new0 (CallState);
+  state->method_name = g_strdup (method_name);
+  state->parameters = parameters ? g_variant_ref_sink (parameters) : NULL;
+  state->fd_list = fd_list ? g_object_ref (fd_list) : NULL;
+  state->timeout_msec = timeout_msec;
+  state->begin_time = g_get_monotonic_time ();
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_worker_process_call_async);
+  g_task_set_task_data (task, state, call_state_free);
+
+  self->in_flight++;
+
+  ide_worker_process_get_proxy_async (self,
+                                      cancellable,
+                                      ide_worker_process_call_get_proxy_cb,
+                                      g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+GVariant *
+ide_worker_process_call_finish (IdeWorkerProcess  *self,
+                                GAsyncResult      *result,
+                                GUnixFDList      **out_fd_list,
+                                GError           **error)
+{
+  GTask *task = (GTask *)result;
+  GVariant *ret;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_WORKER_PROCESS (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (task), NULL);
+
+  ret = g_task_propagate_pointer (task, error);
+
+  if (out_fd_list != NULL)
+    {
+      CallState *state = g_task_get_task_data (task);
+
+      *out_fd_list = g_steal_pointer (&state->out_fd_list);
+    }
+
+  IDE_RETURN (ret);
+}
@@ -20,6 +20,7 @@
 #define IDE_WORKER_PROCESS_H
 
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 
 G_BEGIN_DECLS
 
@@ -29,7 +30,8 @@ G_DECLARE_FINAL_TYPE (IdeWorkerProcess, ide_worker_process, IDE, WORKER_PROCESS,
 
 IdeWorkerProcess *ide_worker_process_new                 (const gchar          *argv0,
                                                           const gchar          *type,
-                                                          const gchar          *dbus_address);
+                                                          const gchar          *dbus_address,
+                                                          guint                 slot);
 void              ide_worker_process_run                 (IdeWorkerProcess     *self);
 void              ide_worker_process_quit                (IdeWorkerProcess     *self);
 gpointer          ide_worker_process_create_proxy        (IdeWorkerProcess     *self,
@@ -45,6 +47,20 @@ void              ide_worker_process_get_proxy_async     (IdeWorkerProcess     *
 GDBusProxy       *ide_worker_process_get_proxy_finish    (IdeWorkerProcess     *self,
                                                           GAsyncResult         *result,
                                                           GError              **error);
+gboolean          ide_worker_process_get_ready           (IdeWorkerProcess     *self);
+guint             ide_worker_process_get_in_flight       (IdeWorkerProcess     *self);
+void              ide_worker_process_call_async          (IdeWorkerProcess     *self,
+                                                          const gchar          *method_name,
+                                                          GVariant             *parameters,
+                                                          GUnixFDList          *fd_list,
+                                                          gint                  timeout_msec,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
+GVariant         *ide_worker_process_call_finish         (IdeWorkerProcess     *self,
+                                                          GAsyncResult         *result,
+                                                          GUnixFDList         **out_fd_list,
+                                                          GError              **error);
 
 G_END_DECLS
 
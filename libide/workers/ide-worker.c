@@ -18,6 +18,18 @@
 
 #define G_LOG_DOMAIN "ide-worker"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
 #include "ide-worker.h"
 
 G_DEFINE_INTERFACE (IdeWorker, ide_worker, G_TYPE_OBJECT)
@@ -58,3 +70,160 @@ ide_worker_create_proxy (IdeWorker        *self,
 
   return IDE_WORKER_GET_IFACE (self)->create_proxy (self, connection, error);
 }
+
+static gint
+ide_worker_open_anonymous (GError **error)
+{
+  g_autofree gchar *name = NULL;
+  gint fd;
+
+#if defined(__linux__) && defined(__NR_memfd_create)
+  fd = syscall (__NR_memfd_create, "gnome-builder-payload", 0x0002 /* MFD_ALLOW_SEALING */);
+  if (fd != -1)
+    return fd;
+#endif
+
+  /*
+   * Fallback to an unlinked temporary file, which still allows the peer
+   * to mmap() the contents without copying them through the bus.
+   */
+  fd = g_file_open_tmp ("gnome-builder-payload-XXXXXX", &name, error);
+  if (fd != -1)
+    g_unlink (name);
+
+  return fd;
+}
+
+/**
+ * ide_worker_create_payload:
+ * @data: the data for the payload
+ * @len: the length of @data, or -1 if it is %NULL terminated.
+ * @error: a location for a #GError, or %NULL.
+ *
+ * Creates an anonymous, shared-memory file descriptor containing @data.
+ *
+ * This is useful to transfer large payloads, such as the contents of a
+ * buffer, to a worker process. Append the file descriptor to a #GUnixFDList
+ * and pass only the handle (type "h") in the D-Bus message. The worker can
+ * use ide_worker_read_payload() to map the contents.
+ *
+ * Where supported, the payload is sealed so that it cannot be modified once
+ * it has been created.
+ *
+ * Returns: A file descriptor owned by the caller, or -1 and @error is set.
+ */
+gint
+ide_worker_create_payload (const gchar  *data,
+                           gssize        len,
+                           GError      **error)
+{
+  gsize to_write;
+  gint fd;
+
+  g_return_val_if_fail (data != NULL || len == 0, -1);
+
+  if (len < 0)
+    len = strlen (data);
+
+  if (-1 == (fd = ide_worker_open_anonymous (error)))
+    return -1;
+
+  for (to_write = len; to_write > 0; )
+    {
+      gssize n_written = write (fd, data, to_write);
+
+      if (n_written < 0)
+        {
+          gint errsv = errno;
+
+          if (errsv == EINTR)
+            continue;
+
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               g_io_error_from_errno (errsv),
+                               g_strerror (errsv));
+          close (fd);
+          return -1;
+        }
+
+      data += n_written;
+      to_write -= n_written;
+    }
+
+#ifdef F_ADD_SEALS
+  fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+  return fd;
+}
+
+typedef struct
+{
+  gpointer base;
+  gsize    len;
+} PayloadMapping;
+
+static void
+payload_mapping_free (gpointer data)
+{
+  PayloadMapping *mapping = data;
+
+  munmap (mapping->base, mapping->len);
+  g_slice_free (PayloadMapping, mapping);
+}
+
+/**
+ * ide_worker_read_payload:
+ * @fd: a file descriptor created with ide_worker_create_payload()
+ * @error: a location for a #GError, or %NULL.
+ *
+ * Maps the contents of a payload created with ide_worker_create_payload().
+ * The contents are mapped read-only rather than copied. @fd is not closed
+ * and remains owned by the caller.
+ *
+ * Returns: (transfer full): A #GBytes or %NULL and @error is set.
+ */
+GBytes *
+ide_worker_read_payload (gint     fd,
+                         GError **error)
+{
+  PayloadMapping *mapping;
+  struct stat st;
+  gpointer base;
+
+  g_return_val_if_fail (fd > -1, NULL);
+
+  if (fstat (fd, &st) == -1)
+    {
+      gint errsv = errno;
+
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errsv),
+                           g_strerror (errsv));
+      return NULL;
+    }
+
+  if (st.st_size == 0)
+    return g_bytes_new (NULL, 0);
+
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  if (base == MAP_FAILED)
+    {
+      gint errsv = errno;
+
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errsv),
+                           g_strerror (errsv));
+      return NULL;
+    }
+
+  mapping = g_slice_new (PayloadMapping);
+  mapping->base = base;
+  mapping->len = st.st_size;
+
+  return g_bytes_new_with_free_func (base, st.st_size, payload_mapping_free, mapping);
+}
@@ -43,6 +43,11 @@ GDBusProxy *ide_worker_create_proxy     (IdeWorker        *self,
                                          GError          **error);
 void        ide_worker_register_service (IdeWorker        *self,
                                          GDBusConnection  *connection);
+gint        ide_worker_create_payload   (const gchar      *data,
+                                         gssize            len,
+                                         GError          **error);
+GBytes     *ide_worker_read_payload     (gint              fd,
+                                         GError          **error);
 
 G_END_DECLS
 
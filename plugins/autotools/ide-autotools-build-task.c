@@ -1165,6 +1165,7 @@ step_make_all  (GTask                 *task,
   const gchar * const *targets;
   const gchar *make = NULL;
   gchar *default_targets[] = { "all", NULL };
+  static const gchar * const make_programs[] = { "gmake", "make", NULL };
   GError *error = NULL;
   guint i;
 
@@ -1191,6 +1192,8 @@ step_make_all  (GTask                 *task,
   /*
    * Try to locate GNU make within the runtime.
    */
+  ide_runtime_probe_programs (state->runtime, make_programs, cancellable);
+
   if (ide_runtime_contains_program_in_path (state->runtime, "gmake", cancellable))
     make = "gmake";
   else if (ide_runtime_contains_program_in_path (state->runtime, "make", cancellable))
@@ -32,6 +32,7 @@
 #include <gio/gio.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <ide.h>
 
@@ -902,6 +903,64 @@ ide_makecache_parse_line (IdeMakecache *self,
   IDE_RETURN (NULL);
 }
 
+typedef struct
+{
+  IdeMakecache  *self;
+  const gchar   *relpath;
+  const gchar   *subdir;
+  GString       *continued;
+  gchar        **ret;
+} FileFlagsParse;
+
+static gboolean
+ide_makecache_get_file_flags_lines (IdeLineReader *reader,
+                                    gpointer       user_data)
+{
+  FileFlagsParse *parse = user_data;
+  gchar *line;
+  gsize len;
+
+  g_assert (reader != NULL);
+  g_assert (parse != NULL);
+  g_assert (parse->ret == NULL);
+
+  while (NULL != (line = ide_line_reader_next (reader, &len)))
+    {
+      /*
+       * Join escaped newlines with " " to simplify command parsing. Most
+       * lines are not continued and are parsed in place.
+       */
+      if (len > 0 && line [len - 1] == '\\')
+        {
+          line [len - 1] = ' ';
+          g_string_append_len (parse->continued, line, len);
+          g_string_append_c (parse->continued, ' ');
+          continue;
+        }
+
+      if (parse->continued->len > 0)
+        {
+          g_string_append_len (parse->continued, line, len);
+          line = parse->continued->str;
+          len = parse->continued->len;
+        }
+      else
+        {
+          line [len] = '\0';
+        }
+
+      if (len > 0)
+        parse->ret = ide_makecache_parse_line (parse->self, line, parse->relpath, parse->subdir);
+
+      g_string_truncate (parse->continued, 0);
+
+      if (parse->ret != NULL)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
 ide_makecache_get_file_flags_worker (GTask        *task,
                                      gpointer      source_object,
@@ -909,7 +968,6 @@ ide_makecache_get_file_flags_worker (GTask        *task,
                                      GCancellable *cancellable)
 {
   FileFlagsLookup *lookup = task_data;
-  gsize i;
   gsize j;
 
   IDE_ENTRY;
@@ -929,15 +987,12 @@ ide_makecache_get_file_flags_worker (GTask        *task,
       g_autoptr(IdeSubprocessLauncher) launcher = NULL;
       g_autoptr(IdeSubprocess) subprocess = NULL;
       g_autoptr(GPtrArray) argv = NULL;
-      g_autofree gchar *stdoutstr = NULL;
       g_autofree gchar *cwd = NULL;
+      FileFlagsParse parse = { 0 };
       const gchar *subdir;
       const gchar *targetstr;
       const gchar *relpath;
       GError *error = NULL;
-      gchar **lines;
-      gchar **ret = NULL;
-      gchar *tmp;
 
       if (g_cancellable_is_cancelled (cancellable))
         break;
@@ -1006,49 +1061,34 @@ ide_makecache_get_file_flags_worker (GTask        *task,
           IDE_EXIT;
         }
 
+      parse.self = lookup->self;
+      parse.relpath = relpath;
+      parse.subdir = subdir ?: ".";
+      parse.continued = g_string_new (NULL);
+
       /* Don't let ourselves be cancelled from this operation */
-      if (!ide_subprocess_communicate_utf8 (subprocess, NULL, NULL, &stdoutstr, NULL, &error))
+      if (!ide_subprocess_read_lines (subprocess,
+                                      ide_makecache_get_file_flags_lines,
+                                      &parse,
+                                      NULL,
+                                      &error))
         {
           g_assert (error != NULL);
+          g_string_free (parse.continued, TRUE);
           g_task_return_error (task, error);
           IDE_EXIT;
         }
 
-      /*
-       * Replace escaped newlines with " " to simplify command parsing
-       */
-      tmp = stdoutstr;
-      while (NULL != (tmp = strstr (tmp, "\\\n")))
-        {
-          tmp[0] = ' ';
-          tmp[1] = ' ';
-        }
-
-      lines = g_strsplit (stdoutstr, "\n", 0);
-
-      for (i = 0; lines [i]; i++)
-        {
-          gchar *line = lines [i];
-          gsize linelen;
-
-          if (line [0] == '\0')
-            continue;
-
-          linelen = strlen (line);
-
-          if (line [linelen - 1] == '\\')
-            line [linelen - 1] = '\0';
+      /* Trailing escaped newline at end of output */
+      if (parse.ret == NULL && parse.continued->len > 0)
+        parse.ret = ide_makecache_parse_line (lookup->self, parse.continued->str, relpath, parse.subdir);
 
-          if ((ret = ide_makecache_parse_line (lookup->self, line, relpath, subdir ?: ".")))
-            break;
-        }
-
-      g_strfreev (lines);
+      g_string_free (parse.continued, TRUE);
 
-      if (ret == NULL)
+      if (parse.ret == NULL)
         continue;
 
-      g_task_return_pointer (task, ret, (GDestroyNotify)g_strfreev);
+      g_task_return_pointer (task, parse.ret, (GDestroyNotify)g_strfreev);
 
       IDE_EXIT;
     }
@@ -1405,6 +1445,40 @@ ide_makecache_class_init (IdeMakecacheClass *klass)
   g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
+static gsize
+file_flags_cost (gconstpointer value)
+{
+  const gchar * const *flags = value;
+  gsize ret = sizeof (gchar *);
+  guint i;
+
+  for (i = 0; flags [i] != NULL; i++)
+    ret += sizeof (gchar *) + strlen (flags [i]) + 1;
+
+  return ret;
+}
+
+static gsize
+file_targets_cost (gconstpointer value)
+{
+  const GPtrArray *targets = value;
+  gsize ret = sizeof (GPtrArray) + targets->len * sizeof (gpointer);
+  guint i;
+
+  for (i = 0; i < targets->len; i++)
+    {
+      IdeMakecacheTarget *target = g_ptr_array_index (targets, i);
+      const gchar *subdir = ide_makecache_target_get_subdir (target);
+      const gchar *name = ide_makecache_target_get_target (target);
+
+      ret += 2 * sizeof (gpointer) + sizeof (gint);
+      ret += subdir ? strlen (subdir) + 1 : 0;
+      ret += name ? strlen (name) + 1 : 0;
+    }
+
+  return ret;
+}
+
 static void
 ide_makecache_init (IdeMakecache *self)
 {
@@ -1424,6 +1498,7 @@ ide_makecache_init (IdeMakecache *self)
                                                  NULL);
 
   egg_task_cache_set_name (self->file_targets_cache, "makecache: file-targets-cache");
+  egg_task_cache_set_cost_func (self->file_targets_cache, file_targets_cost);
 
   self->file_flags_cache = egg_task_cache_new ((GHashFunc)g_file_hash,
                                                (GEqualFunc)g_file_equal,
@@ -1437,6 +1512,7 @@ ide_makecache_init (IdeMakecache *self)
                                                NULL);
 
   egg_task_cache_set_name (self->file_flags_cache, "makecache: file-flags-cache");
+  egg_task_cache_set_cost_func (self->file_flags_cache, file_flags_cost);
 }
 
 GFile *
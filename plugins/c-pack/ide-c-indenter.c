@@ -202,10 +202,30 @@ line_is_whitespace_until (GtkTextIter *iter)
   return TRUE;
 }
 
+/*
+ * Gets the structural index for the buffer containing @iter, if available.
+ * It lets us skip over comments, strings, and balanced brackets without
+ * walking the buffer one character at a time.
+ */
+static IdeBufferStructure *
+get_structure (const GtkTextIter *iter)
+{
+  GtkTextBuffer *buffer = gtk_text_iter_get_buffer (iter);
+
+  if (IDE_IS_BUFFER (buffer))
+    return ide_buffer_get_structure (IDE_BUFFER (buffer));
+
+  return NULL;
+}
+
 static gboolean is_special (const GtkTextIter *iter)
 {
+  IdeBufferStructure *structure;
   GtkSourceBuffer *buffer;
 
+  if (NULL != (structure = get_structure (iter)))
+    return ide_buffer_structure_get_span (structure, iter, NULL, NULL) != IDE_BUFFER_SPAN_NONE;
+
   buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (iter));
   return (gtk_source_buffer_iter_has_context_class (buffer, iter, "string") ||
           gtk_source_buffer_iter_has_context_class (buffer, iter, "comment"));
@@ -330,6 +350,7 @@ static gboolean
 backward_find_matching_char (GtkTextIter *iter,
                              gunichar     ch)
 {
+  IdeBufferStructure *structure;
   GtkTextIter copy;
   gunichar match = 0;
   gunichar cur;
@@ -350,6 +371,17 @@ backward_find_matching_char (GtkTextIter *iter,
     break;
   }
 
+  if ((ch == ')' || ch == '}') && NULL != (structure = get_structure (iter)))
+    {
+      if (ide_buffer_structure_find_enclosing_bracket (structure, iter, match, 1, &copy))
+        {
+          gtk_text_iter_assign (iter, &copy);
+          return TRUE;
+        }
+
+      return FALSE;
+    }
+
   gtk_text_iter_assign (&copy, iter);
 
   while (gtk_text_iter_backward_char (iter))
@@ -482,6 +514,7 @@ in_comment (const GtkTextIter *location,
             gint              *comment_type)
 {
   GtkSourceBuffer *buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (location));
+  IdeBufferStructure *structure;
   GtkTextIter iter = *location;
   GtkTextIter copy;
   gint type = COMMENT_NONE;
@@ -513,6 +546,34 @@ in_comment (const GtkTextIter *location,
         IDE_RETURN (FALSE);
     }
 
+  if (NULL != (structure = get_structure (&iter)))
+    {
+      switch (ide_buffer_structure_get_span (structure, &iter, &copy, NULL))
+        {
+        case IDE_BUFFER_SPAN_COMMENT:
+          type = COMMENT_C89;
+          break;
+
+        case IDE_BUFFER_SPAN_LINE_COMMENT:
+          if (gtk_text_iter_get_line (&copy) != gtk_text_iter_get_line (location))
+            IDE_RETURN (FALSE);
+          type = COMMENT_C99;
+          break;
+
+        case IDE_BUFFER_SPAN_STRING:
+        case IDE_BUFFER_SPAN_NONE:
+        default:
+          IDE_RETURN (FALSE);
+        }
+
+      *match_begin = copy;
+
+      if (comment_type)
+        *comment_type = type;
+
+      IDE_RETURN (TRUE);
+    }
+
   if (!gtk_source_buffer_iter_has_context_class (buffer, &iter, "comment"))
     IDE_RETURN (FALSE);
 
@@ -47,6 +47,34 @@ struct _IdeClangCompletionItem
   gchar            *typed_text;
 };
 
+typedef struct
+{
+  /* Interned in IdeClangCompletionResults.strings */
+  const gchar *typed_text;
+  guint        index;
+  /* Fuzzy match priority for the current query */
+  guint        priority;
+} IdeClangCompletionEntry;
+
+/*
+ * The results of a code completion request, kept as a flat array of
+ * entries. Completion items are only created for the entries that are
+ * actually handed to the completion engine, see
+ * _ide_clang_completion_results_get_item().
+ */
+struct _IdeClangCompletionResults
+{
+  IdeRefPtr    *results;
+  GStringChunk *strings;
+  GArray       *entries;
+  GPtrArray    *items;
+};
+
+IdeClangCompletionResults *_ide_clang_completion_results_new      (IdeRefPtr                 *results);
+void                       _ide_clang_completion_results_free     (IdeClangCompletionResults *self);
+IdeClangCompletionItem    *_ide_clang_completion_results_get_item (IdeClangCompletionResults *self,
+                                                                   guint                      entry);
+
 static inline CXCompletionResult *
 ide_clang_completion_item_get_result (const IdeClangCompletionItem *self)
 {
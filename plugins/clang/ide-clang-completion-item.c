@@ -558,6 +558,106 @@ ide_clang_completion_item_get_brief_comment (IdeClangCompletionItem *self)
   return self->brief_comment;
 }
 
+static void
+clear_item (gpointer data)
+{
+  if (data != NULL)
+    g_object_unref (data);
+}
+
+/*
+ * Resolves the typed text of every result up front, which can happen on
+ * the worker thread. Many results share the same name (overloads, the same
+ * macro from several headers), so the strings are interned.
+ */
+IdeClangCompletionResults *
+_ide_clang_completion_results_new (IdeRefPtr *results)
+{
+  IdeClangCompletionResults *self;
+  CXCodeCompleteResults *native;
+  guint i;
+
+  g_assert (results != NULL);
+
+  native = ide_ref_ptr_get (results);
+
+  self = g_slice_new0 (IdeClangCompletionResults);
+  self->results = ide_ref_ptr_ref (results);
+  self->strings = g_string_chunk_new (4096);
+  self->entries = g_array_sized_new (FALSE, FALSE, sizeof (IdeClangCompletionEntry), native->NumResults);
+  self->items = g_ptr_array_new_with_free_func (clear_item);
+  g_ptr_array_set_size (self->items, native->NumResults);
+
+  for (i = 0; i < native->NumResults; i++)
+    {
+      CXCompletionString completion = native->Results [i].CompletionString;
+      IdeClangCompletionEntry entry = { "", i, 0 };
+      guint num_chunks;
+      guint j;
+
+      num_chunks = clang_getNumCompletionChunks (completion);
+
+      for (j = 0; j < num_chunks; j++)
+        {
+          if (clang_getCompletionChunkKind (completion, j) == CXCompletionChunk_TypedText)
+            {
+              CXString cxstr;
+
+              cxstr = clang_getCompletionChunkText (completion, j);
+              entry.typed_text = g_string_chunk_insert_const (self->strings,
+                                                              clang_getCString (cxstr) ?: "");
+              clang_disposeString (cxstr);
+              break;
+            }
+        }
+
+      g_array_append_val (self->entries, entry);
+    }
+
+  return self;
+}
+
+void
+_ide_clang_completion_results_free (IdeClangCompletionResults *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->items, g_ptr_array_unref);
+      g_clear_pointer (&self->entries, g_array_unref);
+      g_clear_pointer (&self->strings, g_string_chunk_free);
+      g_clear_pointer (&self->results, ide_ref_ptr_unref);
+      g_slice_free (IdeClangCompletionResults, self);
+    }
+}
+
+/**
+ * _ide_clang_completion_results_get_item:
+ *
+ * Gets the completion item for @entry, creating it the first time.
+ *
+ * Returns: (transfer none): An #IdeClangCompletionItem.
+ */
+IdeClangCompletionItem *
+_ide_clang_completion_results_get_item (IdeClangCompletionResults *self,
+                                        guint                      entry)
+{
+  IdeClangCompletionItem *item;
+
+  g_assert (self != NULL);
+  g_assert (entry < self->entries->len);
+
+  if (NULL == (item = g_ptr_array_index (self->items, entry)))
+    {
+      const IdeClangCompletionEntry *e = &g_array_index (self->entries, IdeClangCompletionEntry, entry);
+
+      item = ide_clang_completion_item_new (self->results, e->index);
+      item->typed_text = g_strdup (e->typed_text);
+      g_ptr_array_index (self->items, entry) = item;
+    }
+
+  return item;
+}
+
 IdeClangCompletionItem *
 ide_clang_completion_item_new (IdeRefPtr *results,
                                guint      index)
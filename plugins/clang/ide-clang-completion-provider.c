@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "clang-completion-provider"
 
+#include <egg-heap.h>
 #include <ide.h>
 #include <string.h>
 
@@ -33,8 +34,17 @@ struct _IdeClangCompletionProvider
 
   GSettings     *settings;
   gchar         *last_line;
-  GPtrArray     *last_results;
   gchar         *last_query;
+  /*
+   * The flat result set from clang. Completion items are only created
+   * for the entries we hand to the completion engine.
+   */
+  IdeClangCompletionResults *last_results;
+  /*
+   * Indexes of the entries in last_results matching last_query. As long
+   * as the user keeps typing, we only need to recheck these.
+   */
+  GArray        *matches;
   /*
    * As an optimization, the linked list for result nodes are
    * embedded in the IdeClangCompletionItem structures and we
@@ -69,6 +79,12 @@ typedef struct
   gchar *query;
 } IdeClangCompletionState;
 
+/*
+ * Completion requests on large translation units may return tens of
+ * thousands of results. Only the best matches are displayed.
+ */
+#define MAX_PROPOSALS 250
+
 static void ide_clang_completion_provider_iface_init (GtkSourceCompletionProviderIface *iface);
 
 G_DEFINE_TYPE_EXTENDED (IdeClangCompletionProvider,
@@ -92,30 +108,83 @@ ide_clang_completion_state_free (IdeClangCompletionState *state)
 }
 
 static gint
-sort_by_priority (gconstpointer a,
-                  gconstpointer b)
+compare_entries (gconstpointer a,
+                 gconstpointer b)
 {
-  const IdeClangCompletionItem *itema = (const IdeClangCompletionItem *)a;
-  const IdeClangCompletionItem *itemb = (const IdeClangCompletionItem *)b;
+  const IdeClangCompletionEntry *entrya = *(const IdeClangCompletionEntry **)a;
+  const IdeClangCompletionEntry *entryb = *(const IdeClangCompletionEntry **)b;
 
-  if (itema->priority < itemb->priority)
+  if (entrya->priority < entryb->priority)
     return -1;
-  else if (itema->priority > itemb->priority)
+  else if (entrya->priority > entryb->priority)
     return 1;
 
-  /* If the item is in the result set here, we should have a valid
-   * typed_text field because we already scored the completion item.
-   */
-
-  return g_strcmp0 (itema->typed_text, itemb->typed_text);
+  return strcmp (entrya->typed_text, entryb->typed_text);
 }
 
+/*
+ * Selects the MAX_PROPOSALS best matches and links their completion
+ * items together, in order, starting from self->head.
+ */
 static void
-ide_clang_completion_provider_sort_by_priority (IdeClangCompletionProvider *self)
+ide_clang_completion_provider_update_head (IdeClangCompletionProvider *self)
 {
+  const IdeClangCompletionEntry *entry;
+  EggHeap *heap;
+  guint i;
+
+  IDE_ENTRY;
+
   g_assert (IDE_IS_CLANG_COMPLETION_PROVIDER (self));
 
-  self->head = g_list_sort (self->head, sort_by_priority);
+  self->head = NULL;
+
+  if (self->last_results == NULL || self->matches->len == 0)
+    IDE_EXIT;
+
+  /*
+   * The heap is ordered so that the worst of the selected entries is on
+   * top, which we replace whenever we find a better entry.
+   */
+  heap = egg_heap_new (sizeof (gpointer), compare_entries);
+
+  for (i = 0; i < self->matches->len; i++)
+    {
+      guint index = g_array_index (self->matches, guint, i);
+
+      entry = &g_array_index (self->last_results->entries, IdeClangCompletionEntry, index);
+
+      if (heap->len < MAX_PROPOSALS)
+        {
+          egg_heap_insert_val (heap, entry);
+        }
+      else if (compare_entries (&entry, &egg_heap_peek (heap, gpointer)) < 0)
+        {
+          egg_heap_extract (heap, NULL);
+          egg_heap_insert_val (heap, entry);
+        }
+    }
+
+  /* Extracting yields the worst entry first, so prepend as we go */
+  while (egg_heap_extract (heap, &entry))
+    {
+      IdeClangCompletionItem *item;
+      guint index;
+
+      index = entry - &g_array_index (self->last_results->entries, IdeClangCompletionEntry, 0);
+      item = _ide_clang_completion_results_get_item (self->last_results, index);
+      item->priority = entry->priority;
+
+      item->link.prev = NULL;
+      item->link.next = self->head;
+      if (self->head != NULL)
+        self->head->prev = &item->link;
+      self->head = &item->link;
+    }
+
+  egg_heap_unref (heap);
+
+  IDE_EXIT;
 }
 
 static gchar *
@@ -216,84 +285,42 @@ ide_clang_completion_provider_can_replay (IdeClangCompletionProvider *self,
 }
 
 static void
-ide_clang_completion_provider_save_results (IdeClangCompletionProvider *self,
-                                            GPtrArray                  *results,
-                                            const gchar                *line,
-                                            const gchar                *query)
+ide_clang_completion_provider_reset_matches (IdeClangCompletionProvider *self)
 {
-  IDE_ENTRY;
+  guint i;
 
   g_assert (IDE_IS_CLANG_COMPLETION_PROVIDER (self));
+  g_assert (self->last_results != NULL);
 
-  g_clear_pointer (&self->last_results, g_ptr_array_unref);
-  g_clear_pointer (&self->last_line, g_free);
-  g_clear_pointer (&self->last_query, g_free);
-  self->head = NULL;
+  g_array_set_size (self->matches, self->last_results->entries->len);
 
-  if (query && !*query)
-    query = NULL;
-
-  if (results != NULL)
+  for (i = 0; i < self->matches->len; i++)
     {
-      self->last_line = g_strdup (line);
-      self->last_query = g_strdup (query);
-      self->last_results = g_ptr_array_ref (results);
-      if (results->len > 0)
-        {
-          IdeClangCompletionItem *head = g_ptr_array_index (results, 0);
-          self->head = &head->link;
-        }
+      g_array_index (self->matches, guint, i) = i;
+      g_array_index (self->last_results->entries, IdeClangCompletionEntry, i).priority = 0;
     }
-
-  IDE_EXIT;
 }
 
 static void
-ide_clang_completion_provider_update_links (IdeClangCompletionProvider *self,
-                                            GPtrArray                  *results)
+ide_clang_completion_provider_save_results (IdeClangCompletionProvider *self,
+                                            IdeClangCompletionResults  *results,
+                                            const gchar                *line)
 {
-  IdeClangCompletionItem *item;
-  IdeClangCompletionItem *next;
-  IdeClangCompletionItem *prev;
-  guint i;
-
   IDE_ENTRY;
 
   g_assert (IDE_IS_CLANG_COMPLETION_PROVIDER (self));
-  g_assert (results != NULL);
 
-  if G_UNLIKELY (results->len == 0)
-    {
-      self->head = NULL;
-      IDE_EXIT;
-    }
-
-  /* Unrolling loops for the gentoo crowd */
-
-  item = g_ptr_array_index (results, 0);
-  item->link.prev = NULL;
-  item->link.next = (results->len == 1) ? NULL : &((IdeClangCompletionItem*)g_ptr_array_index (results, 1))->link;
-
-  self->head = &item->link;
-
-  prev = item;
-
-  for (i = 1; i < (results->len - 1); i++)
-    {
-      item = g_ptr_array_index (results, i);
-      next = g_ptr_array_index (results, i + 1);
-
-      item->link.prev = &prev->link;
-      item->link.next = &next->link;
-
-      prev = item;
-    }
+  g_clear_pointer (&self->last_results, _ide_clang_completion_results_free);
+  g_clear_pointer (&self->last_line, g_free);
+  g_clear_pointer (&self->last_query, g_free);
+  g_array_set_size (self->matches, 0);
+  self->head = NULL;
 
-  if (results->len > 1)
+  if (results != NULL)
     {
-      item = g_ptr_array_index (results, results->len - 1);
-      item->link.prev = &((IdeClangCompletionItem*)g_ptr_array_index (results, results->len-2))->link;
-      item->link.next = NULL;
+      self->last_line = g_strdup (line);
+      self->last_results = results;
+      ide_clang_completion_provider_reset_matches (self);
     }
 
   IDE_EXIT;
@@ -301,30 +328,34 @@ ide_clang_completion_provider_update_links (IdeClangCompletionProvider *self,
 
 static void
 ide_clang_completion_provider_refilter (IdeClangCompletionProvider *self,
-                                        GPtrArray                  *results,
                                         const gchar                *query)
 {
   g_autofree gchar *lower = NULL;
+  GArray *entries;
+  guint i;
+  guint j;
 
   IDE_ENTRY;
 
   g_assert (IDE_IS_CLANG_COMPLETION_PROVIDER (self));
-  g_assert (results != NULL);
+  g_assert (self->last_results != NULL);
   g_assert (query != NULL);
 
-  if (results->len == 0)
-    IDE_EXIT;
-
   IDE_TRACE_MSG ("Filtering with query \"%s\"", query);
 
   /*
-   * By traversing the linked list nodes instead of the array, we allow
-   * ourselves to avoid rechecking items we already know filtered.
-   * We do need to be mindful of this in case the user backspaced
-   * and our list is no longer a continual "deep dive" of matched items.
+   * If the user continued typing, everything that failed to match the
+   * previous query will fail this one too, so only recheck the previous
+   * matches. Otherwise (such as after a backspace) start over.
    */
-  if ((self->last_query != NULL) && g_str_has_prefix (query, self->last_query))
-    ide_clang_completion_provider_update_links (self, results);
+  if ((self->last_query == NULL) || !g_str_has_prefix (query, self->last_query))
+    ide_clang_completion_provider_reset_matches (self);
+
+  g_free (self->last_query);
+  self->last_query = g_strdup (query);
+
+  if (*query == '\0')
+    IDE_EXIT;
 
   lower = g_utf8_casefold (query, -1);
 
@@ -334,33 +365,19 @@ ide_clang_completion_provider_refilter (IdeClangCompletionProvider *self,
       IDE_EXIT;
     }
 
-  for (GList *iter = self->head; iter; iter = iter->next)
-    {
-      IdeClangCompletionItem *item = iter->data;
-      const gchar *typed_text;
-      guint priority;
-
-      typed_text = ide_clang_completion_item_get_typed_text (item);
-
-      if (!ide_completion_item_fuzzy_match (typed_text, lower, &priority))
-        {
-          if (iter->prev != NULL)
-            iter->prev->next = iter->next;
-          else
-            self->head = iter->next;
-
-          if (iter->next != NULL)
-            iter->next->prev = iter->prev;
+  entries = self->last_results->entries;
 
-          continue;
-        }
+  for (i = 0, j = 0; i < self->matches->len; i++)
+    {
+      guint index = g_array_index (self->matches, guint, i);
+      IdeClangCompletionEntry *entry = &g_array_index (entries, IdeClangCompletionEntry, index);
 
       /* Save the generated priority for further sorting */
-      item->priority = priority;
+      if (ide_completion_item_fuzzy_match (entry->typed_text, lower, &entry->priority))
+        g_array_index (self->matches, guint, j++) = index;
     }
 
-  g_free (self->last_query);
-  self->last_query = g_strdup (query);
+  g_array_set_size (self->matches, j);
 
   IDE_EXIT;
 }
@@ -372,7 +389,7 @@ ide_clang_completion_provider_code_complete_cb (GObject      *object,
 {
   IdeClangTranslationUnit *unit = (IdeClangTranslationUnit *)object;
   IdeClangCompletionState *state = user_data;
-  g_autoptr(GPtrArray) results = NULL;
+  IdeClangCompletionResults *results;
   GError *error = NULL;
 
   IDE_ENTRY;
@@ -395,17 +412,15 @@ ide_clang_completion_provider_code_complete_cb (GObject      *object,
       IDE_EXIT;
     }
 
-  ide_clang_completion_provider_save_results (state->self, results, state->line, state->query);
-  ide_clang_completion_provider_update_links (state->self, results);
+  ide_clang_completion_provider_save_results (state->self, results, state->line);
 
   if (!g_cancellable_is_cancelled (state->cancellable))
     {
-      if (results->len > 0)
+      if (results->entries->len > 0)
         {
-          if (state->query && *state->query)
-            ide_clang_completion_provider_refilter (state->self, results, state->query);
-          ide_clang_completion_provider_sort_by_priority (state->self);
-          IDE_TRACE_MSG ("%d results returned from clang", results->len);
+          ide_clang_completion_provider_refilter (state->self, state->query ?: "");
+          ide_clang_completion_provider_update_head (state->self);
+          IDE_TRACE_MSG ("%d results returned from clang", results->entries->len);
           gtk_source_completion_context_add_proposals (state->context,
                                                        GTK_SOURCE_COMPLETION_PROVIDER (state->self),
                                                        state->self->head, TRUE);
@@ -572,8 +587,8 @@ ide_clang_completion_provider_populate (GtkSourceCompletionProvider *provider,
        * passes of this operation by traversing the already filtered
        * linked list instead of all items.
        */
-      ide_clang_completion_provider_refilter (self, self->last_results, prefix);
-      ide_clang_completion_provider_sort_by_priority (self);
+      ide_clang_completion_provider_refilter (self, prefix);
+      ide_clang_completion_provider_update_head (self);
       gtk_source_completion_context_add_proposals (context, provider, self->head, TRUE);
 
       IDE_EXIT;
@@ -732,7 +747,8 @@ ide_clang_completion_provider_finalize (GObject *object)
 {
   IdeClangCompletionProvider *self = (IdeClangCompletionProvider *)object;
 
-  g_clear_pointer (&self->last_results, g_ptr_array_unref);
+  g_clear_pointer (&self->last_results, _ide_clang_completion_results_free);
+  g_clear_pointer (&self->matches, g_array_unref);
   g_clear_pointer (&self->last_line, g_free);
   g_clear_pointer (&self->last_query, g_free);
   g_clear_object (&self->settings);
@@ -764,5 +780,6 @@ ide_clang_completion_provider_init (IdeClangCompletionProvider *self)
 {
   IDE_ENTRY;
   self->settings = g_settings_new ("org.gnome.builder.code-insight");
+  self->matches = g_array_new (FALSE, FALSE, sizeof (guint));
   IDE_EXIT;
 }
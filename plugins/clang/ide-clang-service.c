@@ -23,12 +23,14 @@
 #include <egg-task-cache.h>
 #include <glib/gi18n.h>
 #include <ide.h>
+#include <string.h>
 
 #include "ide-clang-highlighter.h"
 #include "ide-clang-private.h"
 #include "ide-clang-service.h"
 
 #define DEFAULT_EVICTION_MSEC (60 * 1000)
+#define MAX_HEADER_INDEXES    512
 
 struct _IdeClangService
 {
@@ -37,6 +39,17 @@ struct _IdeClangService
   CXIndex       index;
   GCancellable *cancellable;
   EggTaskCache *units_cache;
+
+  /*
+   * Highlight indexes for the declarations of each header, shared by all
+   * the translation units including them. Keyed by a hash of the unit's
+   * command line and the header path, since flags and macros change what a
+   * header declares, and only reused while the file is unchanged. At most
+   * MAX_HEADER_INDEXES are kept, dropping the least recently used. Parsing
+   * happens on worker threads, so this is protected by @headers_mutex.
+   */
+  GMutex        headers_mutex;
+  GHashTable   *headers;
 };
 
 typedef struct
@@ -52,9 +65,26 @@ typedef struct
 
 typedef struct
 {
+  IdeHighlightIndex *index;
+  gchar             *key;
+  gchar             *path;
+  gint64             mtime;
+  goffset            size;
+  gint64             last_used;
+  guint              cached : 1;
+  guint              cacheable : 1;
+} HeaderIndex;
+
+typedef struct
+{
+  IdeClangService   *self;
   IdeHighlightIndex *index;
   CXFile             file;
   const gchar       *filename;
+  const gchar       *flags_hash;
+  gint64             parse_time;
+  GHashTable        *unsaved;
+  GHashTable        *headers;
 } IndexRequest;
 
 static void service_iface_init (IdeServiceInterface *iface);
@@ -79,14 +109,201 @@ parse_request_free (gpointer data)
   g_slice_free (ParseRequest, request);
 }
 
+static void
+header_index_free (gpointer data)
+{
+  HeaderIndex *header = data;
+
+  g_clear_pointer (&header->index, ide_highlight_index_unref);
+  g_free (header->key);
+  g_free (header->path);
+  g_slice_free (HeaderIndex, header);
+}
+
+/*
+ * Gets the modification time, in microseconds, and size of @path. Returns
+ * %FALSE if the file cannot be queried, in which case it is not cached.
+ */
+static gboolean
+get_file_stamp (const gchar *path,
+                gint64      *mtime,
+                goffset     *size)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+
+  file = g_file_new_for_path (path);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+
+  if (info == NULL)
+    return FALSE;
+
+  *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+           g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  *size = g_file_info_get_size (info);
+
+  return TRUE;
+}
+
+/*
+ * Hashes the arguments a unit was parsed with. Headers are only shared
+ * between units with the same flags, as defines and include paths change
+ * what a header declares.
+ */
+static gchar *
+get_flags_hash (const gchar * const *argv)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  gsize i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+  for (i = 0; argv[i] != NULL; i++)
+    g_checksum_update (checksum, (const guchar *)argv[i], strlen (argv[i]) + 1);
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static gint
+compare_last_used (gconstpointer a,
+                   gconstpointer b)
+{
+  const HeaderIndex *header_a = *(const HeaderIndex **)a;
+  const HeaderIndex *header_b = *(const HeaderIndex **)b;
+
+  if (header_a->last_used < header_b->last_used)
+    return -1;
+  else if (header_a->last_used > header_b->last_used)
+    return 1;
+  else
+    return 0;
+}
+
+static void
+ide_clang_service_trim_headers_locked (IdeClangService *self)
+{
+  g_autoptr(GPtrArray) headers = NULL;
+  GHashTableIter iter;
+  HeaderIndex *header;
+  guint n_evict;
+  guint i;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+
+  if (g_hash_table_size (self->headers) <= MAX_HEADER_INDEXES)
+    return;
+
+  n_evict = g_hash_table_size (self->headers) - MAX_HEADER_INDEXES;
+  headers = g_ptr_array_sized_new (g_hash_table_size (self->headers));
+
+  g_hash_table_iter_init (&iter, self->headers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&header))
+    g_ptr_array_add (headers, header);
+
+  g_ptr_array_sort (headers, compare_last_used);
+
+  for (i = 0; i < n_evict; i++)
+    {
+      header = g_ptr_array_index (headers, i);
+      g_hash_table_remove (self->headers, header->key);
+    }
+}
+
+static HeaderIndex *
+index_request_add_header (IndexRequest *request,
+                          CXFile        file)
+{
+  HeaderIndex *cached;
+  HeaderIndex *header;
+  CXString cxstr;
+
+  g_assert (request != NULL);
+  g_assert (file != NULL);
+
+  cxstr = clang_getFileName (file);
+
+  header = g_slice_new0 (HeaderIndex);
+  header->path = g_strdup (clang_getCString (cxstr));
+
+  clang_disposeString (cxstr);
+
+  /*
+   * Modified buffers do not match what is on disk, never share them. Nor
+   * files changed since just before the parse, as clang may have read a
+   * different version than the one we stat now, and a change within the
+   * timestamp granularity of the file system would go unnoticed.
+   */
+  header->cacheable = (header->path != NULL &&
+                       !g_hash_table_contains (request->unsaved, header->path) &&
+                       get_file_stamp (header->path, &header->mtime, &header->size) &&
+                       header->mtime < request->parse_time - G_USEC_PER_SEC);
+
+  if (header->cacheable)
+    {
+      header->key = g_strdup_printf ("%s:%s", request->flags_hash, header->path);
+
+      g_mutex_lock (&request->self->headers_mutex);
+      cached = g_hash_table_lookup (request->self->headers, header->key);
+      if (cached != NULL && cached->mtime == header->mtime && cached->size == header->size)
+        {
+          cached->last_used = g_get_monotonic_time ();
+          header->index = ide_highlight_index_ref (cached->index);
+          header->cached = TRUE;
+        }
+      g_mutex_unlock (&request->self->headers_mutex);
+    }
+
+  if (header->index == NULL)
+    header->index = ide_highlight_index_new ();
+
+  g_hash_table_insert (request->headers, file, header);
+
+  return header;
+}
+
+/*
+ * Gets the index that should contain the declaration at @cursor, or %NULL
+ * if it is in a header for which we already have an up to date index.
+ */
+static IdeHighlightIndex *
+index_request_get_index (IndexRequest *request,
+                         CXCursor      cursor)
+{
+  CXSourceLocation location;
+  HeaderIndex *header;
+  CXFile file = NULL;
+
+  g_assert (request != NULL);
+
+  location = clang_getCursorLocation (cursor);
+  clang_getFileLocation (location, &file, NULL, NULL, NULL);
+
+  if (file == NULL || file == request->file)
+    return request->index;
+
+  if (NULL == (header = g_hash_table_lookup (request->headers, file)))
+    header = index_request_add_header (request, file);
+
+  return header->cached ? NULL : header->index;
+}
+
 static enum CXChildVisitResult
 ide_clang_service_build_index_visitor (CXCursor     cursor,
                                        CXCursor     parent,
                                        CXClientData user_data)
 {
   IndexRequest *request = user_data;
+  IdeHighlightIndex *index;
   enum CXCursorKind kind;
   const gchar *style_name = NULL;
+  const gchar *word;
+  CXString cxstr;
 
   g_assert (request != NULL);
 
@@ -107,9 +324,6 @@ ide_clang_service_build_index_visitor (CXCursor     cursor,
 
     case CXCursor_EnumDecl:
       style_name = IDE_CLANG_HIGHLIGHTER_ENUM_NAME;
-      clang_visitChildren (cursor,
-                           ide_clang_service_build_index_visitor,
-                           user_data);
       break;
 
     case CXCursor_EnumConstantDecl:
@@ -124,16 +338,21 @@ ide_clang_service_build_index_visitor (CXCursor     cursor,
       break;
     }
 
-  if (style_name != NULL)
-    {
-      CXString cxstr;
-      const gchar *word;
+  if (style_name == NULL)
+    return CXChildVisit_Continue;
 
-      cxstr = clang_getCursorSpelling (cursor);
-      word = clang_getCString (cxstr);
-      ide_highlight_index_insert (request->index, word, (gpointer)style_name);
-      clang_disposeString (cxstr);
-    }
+  if (NULL == (index = index_request_get_index (request, cursor)))
+    return CXChildVisit_Continue;
+
+  if (kind == CXCursor_EnumDecl)
+    clang_visitChildren (cursor,
+                         ide_clang_service_build_index_visitor,
+                         user_data);
+
+  cxstr = clang_getCursorSpelling (cursor);
+  word = clang_getCString (cxstr);
+  ide_highlight_index_insert (index, word, (gpointer)style_name);
+  clang_disposeString (cxstr);
 
   return CXChildVisit_Continue;
 }
@@ -141,13 +360,19 @@ ide_clang_service_build_index_visitor (CXCursor     cursor,
 static IdeHighlightIndex *
 ide_clang_service_build_index (IdeClangService   *self,
                                CXTranslationUnit  tu,
-                               ParseRequest      *request)
+                               ParseRequest      *request,
+                               gint64             parse_time)
 {
   static const gchar *common_defines[] = {
     "NULL", "MIN", "MAX", "__LINE__", "__FILE__", NULL
   };
+  g_autoptr(GHashTable) unsaved = NULL;
+  g_autoptr(GHashTable) headers = NULL;
+  g_autofree gchar *flags_hash = NULL;
   IdeHighlightIndex *index;
   IndexRequest client_data;
+  GHashTableIter iter;
+  HeaderIndex *header;
   CXCursor cursor;
   CXFile file;
   gsize i;
@@ -162,9 +387,26 @@ ide_clang_service_build_index (IdeClangService   *self,
 
   index = ide_highlight_index_new ();
 
+  unsaved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  headers = g_hash_table_new_full (NULL, NULL, NULL, header_index_free);
+
+  for (i = 0; i < request->unsaved_files->len; i++)
+    {
+      IdeUnsavedFile *uf = g_ptr_array_index (request->unsaved_files, i);
+      gchar *path = g_file_get_path (ide_unsaved_file_get_file (uf));
+
+      if (path != NULL)
+        g_hash_table_add (unsaved, path);
+    }
+
+  client_data.self = self;
   client_data.index = index;
   client_data.file = file;
   client_data.filename = request->source_filename;
+  client_data.flags_hash = flags_hash = get_flags_hash ((const gchar * const *)request->command_line_args);
+  client_data.parse_time = parse_time;
+  client_data.unsaved = unsaved;
+  client_data.headers = headers;
 
   /*
    * Add some common defines so they don't get changed by clang.
@@ -177,9 +419,48 @@ ide_clang_service_build_index (IdeClangService   *self,
   ide_highlight_index_insert (index, "g_auto", "c:storage-class");
   ide_highlight_index_insert (index, "g_autofree", "c:storage-class");
 
+  /*
+   * Declarations are bucketed by the header defining them. Headers we
+   * already have an index for are skipped entirely, which is most of what
+   * gets pulled in by glib.h and gtk.h.
+   */
   cursor = clang_getTranslationUnitCursor (tu);
   clang_visitChildren (cursor, ide_clang_service_build_index_visitor, &client_data);
 
+  g_mutex_lock (&self->headers_mutex);
+
+  g_hash_table_iter_init (&iter, headers);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&header))
+    {
+      if (!header->cached && header->cacheable)
+        {
+          HeaderIndex *copy;
+
+          copy = g_slice_new0 (HeaderIndex);
+          copy->index = ide_highlight_index_ref (header->index);
+          copy->key = g_strdup (header->key);
+          copy->path = g_strdup (header->path);
+          copy->mtime = header->mtime;
+          copy->size = header->size;
+          copy->last_used = g_get_monotonic_time ();
+          copy->cached = TRUE;
+          copy->cacheable = TRUE;
+
+          /* Replace, as the key belongs to the value being freed */
+          g_hash_table_replace (self->headers, copy->key, copy);
+        }
+    }
+
+  ide_clang_service_trim_headers_locked (self);
+
+  g_mutex_unlock (&self->headers_mutex);
+
+  g_hash_table_iter_init (&iter, headers);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&header))
+    ide_highlight_index_merge (index, header->index);
+
   return index;
 }
 
@@ -262,6 +543,7 @@ ide_clang_service_parse_worker (GTask        *task,
   const gchar *detail_error = NULL;
   const gchar *llvm_flags;
   enum CXErrorCode code;
+  gint64 parse_time;
   GArray *ar = NULL;
   gsize i;
 
@@ -304,6 +586,7 @@ ide_clang_service_parse_worker (GTask        *task,
   g_ptr_array_add (built_argv, NULL);
 
   EGG_COUNTER_INC (ParseAttempts);
+  parse_time = g_get_real_time ();
   code = clang_parseTranslationUnit2 (request->index,
                                       request->source_filename,
                                       (const gchar * const *)built_argv->pdata,
@@ -316,7 +599,7 @@ ide_clang_service_parse_worker (GTask        *task,
   switch (code)
     {
     case CXError_Success:
-      index = ide_clang_service_build_index (self, tu, request);
+      index = ide_clang_service_build_index (self, tu, request, parse_time);
 #ifdef IDE_ENABLE_TRACE
       ide_highlight_index_dump (index);
 #endif
@@ -626,6 +909,8 @@ ide_clang_service_start (IdeService *service)
                                           g_object_unref);
 
   egg_task_cache_set_name (self->units_cache, "clang translation-unit cache");
+  egg_task_cache_set_cost_func (self->units_cache,
+                                (EggTaskCacheCostFunc)ide_clang_translation_unit_get_memory_usage);
 
   self->index = clang_createIndex (0, 0);
   clang_CXIndex_setGlobalOptions (self->index,
@@ -642,6 +927,10 @@ ide_clang_service_stop (IdeService *service)
 
   g_cancellable_cancel (self->cancellable);
   g_clear_object (&self->units_cache);
+
+  g_mutex_lock (&self->headers_mutex);
+  g_hash_table_remove_all (self->headers);
+  g_mutex_unlock (&self->headers_mutex);
 }
 
 static void
@@ -663,8 +952,13 @@ ide_clang_service_dispose (GObject *object)
 static void
 ide_clang_service_finalize (GObject *object)
 {
+  IdeClangService *self = (IdeClangService *)object;
+
   IDE_ENTRY;
 
+  g_clear_pointer (&self->headers, g_hash_table_unref);
+  g_mutex_clear (&self->headers_mutex);
+
   G_OBJECT_CLASS (ide_clang_service_parent_class)->finalize (object);
 
   IDE_EXIT;
@@ -689,6 +983,8 @@ service_iface_init (IdeServiceInterface *iface)
 static void
 ide_clang_service_init (IdeClangService *self)
 {
+  g_mutex_init (&self->headers_mutex);
+  self->headers = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, header_index_free);
 }
 
 /**
@@ -467,6 +467,36 @@ ide_clang_translation_unit_get_serial (IdeClangTranslationUnit *self)
   return self->serial;
 }
 
+/**
+ * ide_clang_translation_unit_get_memory_usage:
+ *
+ * Gets the number of bytes used by libclang for the translation unit,
+ * as reported by clang_getCXTUResourceUsage().
+ *
+ * Returns: A number of bytes.
+ */
+gsize
+ide_clang_translation_unit_get_memory_usage (IdeClangTranslationUnit *self)
+{
+  CXTUResourceUsage usage;
+  gsize total = 0;
+  guint i;
+
+  g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), 0);
+
+  if (self->native == NULL)
+    return 0;
+
+  usage = clang_getCXTUResourceUsage (ide_ref_ptr_get (self->native));
+
+  for (i = 0; i < usage.numEntries; i++)
+    total += usage.entries [i].amount;
+
+  clang_disposeCXTUResourceUsage (usage);
+
+  return total;
+}
+
 static void
 ide_clang_translation_unit_set_native (IdeClangTranslationUnit *self,
                                        CXTranslationUnit        native)
@@ -618,7 +648,6 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
   CXTranslationUnit tu;
   g_autoptr(IdeRefPtr) refptr = NULL;
   struct CXUnsavedFile *ufs;
-  GPtrArray *ar;
   gsize i;
   gsize j = 0;
 
@@ -681,20 +710,14 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
 
   /*
    * encapsulate in refptr so we don't need to malloc lots of little strings.
-   * we will inflate result strings as necessary.
+   * we will inflate result strings as necessary. Only the typed text is
+   * resolved here, completion items are created lazily by the provider.
    */
   refptr = ide_ref_ptr_new (results, (GDestroyNotify)clang_disposeCodeCompleteResults);
-  ar = g_ptr_array_new_with_free_func (g_object_unref);
 
-  for (i = 0; i < results->NumResults; i++)
-    {
-      GtkSourceCompletionProposal *proposal;
-
-      proposal = GTK_SOURCE_COMPLETION_PROPOSAL (ide_clang_completion_item_new (refptr, i));
-      g_ptr_array_add (ar, proposal);
-    }
-
-  g_task_return_pointer (task, ar, (GDestroyNotify)g_ptr_array_unref);
+  g_task_return_pointer (task,
+                         _ide_clang_completion_results_new (refptr),
+                         (GDestroyNotify)_ide_clang_completion_results_free);
 
   /* cleanup malloc'd state */
   for (i = 0; i < j; i++)
@@ -756,16 +779,16 @@ ide_clang_translation_unit_code_complete_async (IdeClangTranslationUnit *self,
  *
  * Completes a call to ide_clang_translation_unit_code_complete_async().
  *
- * Returns: (transfer container) (element-type GtkSourceCompletionProposal*): An array of
- *   #GtkSourceCompletionProposal. Upon failure, %NULL is returned.
+ * Returns: (transfer full): The completion results, which should be freed
+ *   with _ide_clang_completion_results_free(). Upon failure, %NULL is returned.
  */
-GPtrArray *
+IdeClangCompletionResults *
 ide_clang_translation_unit_code_complete_finish (IdeClangTranslationUnit  *self,
                                                  GAsyncResult             *result,
                                                  GError                  **error)
 {
   GTask *task = (GTask *)result;
-  GPtrArray *ret;
+  IdeClangCompletionResults *ret;
 
   IDE_ENTRY;
 
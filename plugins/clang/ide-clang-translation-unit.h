@@ -22,6 +22,8 @@
 #include <gtk/gtk.h>
 #include <ide.h>
 
+#include "ide-clang-completion-item.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_CLANG_TRANSLATION_UNIT (ide_clang_translation_unit_get_type())
@@ -29,6 +31,7 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (IdeClangTranslationUnit, ide_clang_translation_unit, IDE, CLANG_TRANSLATION_UNIT, IdeObject)
 
 gint64             ide_clang_translation_unit_get_serial               (IdeClangTranslationUnit  *self);
+gsize              ide_clang_translation_unit_get_memory_usage         (IdeClangTranslationUnit  *self);
 IdeDiagnostics    *ide_clang_translation_unit_get_diagnostics          (IdeClangTranslationUnit  *self);
 IdeDiagnostics    *ide_clang_translation_unit_get_diagnostics_for_file (IdeClangTranslationUnit  *self,
                                                                         GFile                    *file);
@@ -38,7 +41,8 @@ void               ide_clang_translation_unit_code_complete_async      (IdeClang
                                                                         GCancellable             *cancellable,
                                                                         GAsyncReadyCallback       callback,
                                                                         gpointer                  user_data);
-GPtrArray         *ide_clang_translation_unit_code_complete_finish     (IdeClangTranslationUnit  *self,
+IdeClangCompletionResults *
+                   ide_clang_translation_unit_code_complete_finish     (IdeClangTranslationUnit  *self,
                                                                         GAsyncResult             *result,
                                                                         GError                  **error);
 void               ide_clang_translation_unit_get_symbol_tree_async    (IdeClangTranslationUnit  *self,
@@ -22,21 +22,68 @@
 
 #include "gb-color-picker-document-monitor.h"
 
+typedef struct
+{
+  GdkRGBA     rgba;
+  GtkTextTag *tag;
+  guint       ref_count;
+} ColorTag;
+
+typedef struct
+{
+  ColorTag    *color_tag;
+  GtkTextMark *begin;
+  GtkTextMark *end;
+} ColorOccurrence;
+
+typedef struct
+{
+  guint        begin;
+  guint        end;
+  GstyleColor *color;
+} ColorSpan;
+
 struct _GbColorPickerDocumentMonitor
 {
   GObject       parent_instance;
 
   IdeBuffer    *buffer;
 
+  /*
+   * Tags are interned by the color they display so that every occurrence
+   * of a color shares a single GtkTextTag. A tag is removed from the tag
+   * table once its last occurrence is uncolorized.
+   *
+   * Adjacent occurrences of a color merge into a single tagged range, so
+   * occurrences are not told apart by the tag toggles. Each one gets a pair
+   * of marks instead, and @occurrences maps the begin mark to it.
+   */
+  GHashTable   *color_tags;
+  GHashTable   *tags_index;
+  GHashTable   *occurrences;
+
+  /*
+   * The lines waiting to be scanned for colors, and the region being
+   * scanned by the worker. The scan runs over a snapshot of the text and
+   * is discarded if the buffer changed in the mean time.
+   */
+  GtkTextMark  *dirty_begin;
+  GtkTextMark  *dirty_end;
+  GtkTextMark  *scan_begin;
+  GtkTextMark  *scan_end;
+  gsize         scan_change_count;
+  guint         scan_sequence;
+  guint         sequence;
+  guint         colorize_source;
+
   gulong        insert_handler_id;
   gulong        insert_after_handler_id;
   gulong        delete_handler_id;
   gulong        delete_after_handler_id;
   gulong        cursor_notify_handler_id;
 
-  gulong        remove_tag_handler_id;
-
   guint         is_in_user_action : 1;
+  guint         in_scan : 1;
 };
 
 G_DEFINE_TYPE (GbColorPickerDocumentMonitor, gb_color_picker_document_monitor, G_TYPE_OBJECT)
@@ -56,6 +103,301 @@ enum {
 
 static guint signals [LAST_SIGNAL];
 
+static void queue_colorize (GbColorPickerDocumentMonitor *self,
+                            const GtkTextIter            *begin,
+                            const GtkTextIter            *end);
+
+static void
+color_tag_free (gpointer data)
+{
+  ColorTag *color_tag = data;
+
+  g_clear_object (&color_tag->tag);
+  g_slice_free (ColorTag, color_tag);
+}
+
+static void
+color_occurrence_free (gpointer data)
+{
+  ColorOccurrence *occurrence = data;
+  GtkTextBuffer *buffer;
+
+  if (NULL != (buffer = gtk_text_mark_get_buffer (occurrence->begin)))
+    {
+      gtk_text_buffer_delete_mark (buffer, occurrence->begin);
+      gtk_text_buffer_delete_mark (buffer, occurrence->end);
+    }
+
+  g_clear_object (&occurrence->begin);
+  g_clear_object (&occurrence->end);
+  g_slice_free (ColorOccurrence, occurrence);
+}
+
+static void
+color_span_clear (gpointer data)
+{
+  ColorSpan *span = data;
+
+  g_clear_object (&span->color);
+}
+
+static ColorTag *
+acquire_color_tag (GbColorPickerDocumentMonitor *self,
+                   GstyleColor                  *color)
+{
+  ColorTag *color_tag;
+  GdkRGBA rgba;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (GSTYLE_IS_COLOR (color));
+
+  /* Tags are drawn opaque, so the alpha is not part of the key. */
+  gstyle_color_fill_rgba (color, &rgba);
+  rgba.alpha = 1.0;
+
+  color_tag = g_hash_table_lookup (self->color_tags, &rgba);
+
+  if (color_tag == NULL)
+    {
+      color_tag = g_slice_new0 (ColorTag);
+      color_tag->rgba = rgba;
+      color_tag->tag = g_object_ref (gb_color_picker_helper_create_color_tag (GTK_TEXT_BUFFER (self->buffer), color));
+
+      g_hash_table_insert (self->color_tags, &color_tag->rgba, color_tag);
+      g_hash_table_insert (self->tags_index, color_tag->tag, color_tag);
+    }
+
+  color_tag->ref_count++;
+
+  return color_tag;
+}
+
+static void
+release_color_tag (GbColorPickerDocumentMonitor *self,
+                   ColorTag                     *color_tag)
+{
+  GtkTextTagTable *tag_table;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (color_tag != NULL);
+  g_assert (color_tag->ref_count > 0);
+
+  if (--color_tag->ref_count > 0)
+    return;
+
+  tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (self->buffer));
+  gtk_text_tag_table_remove (tag_table, color_tag->tag);
+
+  g_hash_table_remove (self->tags_index, color_tag->tag);
+  g_hash_table_remove (self->color_tags, &color_tag->rgba);
+}
+
+static gboolean
+has_color_tag (GbColorPickerDocumentMonitor *self,
+               const GtkTextIter            *iter)
+{
+  GSList *tags;
+  GSList *l;
+  gboolean ret = FALSE;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (iter != NULL);
+
+  tags = gtk_text_iter_get_tags (iter);
+
+  for (l = tags; l != NULL && !ret; l = l->next)
+    ret = g_hash_table_contains (self->tags_index, l->data);
+
+  g_slist_free (tags);
+
+  return ret;
+}
+
+static void
+add_occurrences_at_iter (GbColorPickerDocumentMonitor *self,
+                         const GtkTextIter            *iter,
+                         GPtrArray                    *found)
+{
+  GSList *marks;
+  GSList *l;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (iter != NULL);
+  g_assert (found != NULL);
+
+  marks = gtk_text_iter_get_marks (iter);
+
+  for (l = marks; l != NULL; l = l->next)
+    {
+      ColorOccurrence *occurrence = g_hash_table_lookup (self->occurrences, l->data);
+
+      if (occurrence != NULL)
+        g_ptr_array_add (found, occurrence);
+    }
+
+  g_slist_free (marks);
+}
+
+static void
+add_occurrence (GbColorPickerDocumentMonitor *self,
+                ColorTag                     *color_tag,
+                const GtkTextIter            *begin,
+                const GtkTextIter            *end)
+{
+  GtkTextBuffer *buffer;
+  ColorOccurrence *occurrence;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (color_tag != NULL);
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  occurrence = g_slice_new0 (ColorOccurrence);
+  occurrence->color_tag = color_tag;
+  occurrence->begin = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, begin, TRUE));
+  occurrence->end = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, end, FALSE));
+
+  gtk_text_buffer_apply_tag (buffer, color_tag->tag, begin, end);
+
+  g_hash_table_insert (self->occurrences, occurrence->begin, occurrence);
+}
+
+static void
+remove_occurrence (GbColorPickerDocumentMonitor *self,
+                   ColorOccurrence              *occurrence)
+{
+  GtkTextBuffer *buffer;
+  ColorTag *color_tag;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (occurrence != NULL);
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+  color_tag = occurrence->color_tag;
+
+  /* Remove from the buffer first, releasing may drop the tag from the table. */
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, occurrence->begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, occurrence->end);
+  gtk_text_buffer_remove_tag (buffer, color_tag->tag, &begin, &end);
+
+  g_hash_table_remove (self->occurrences, occurrence->begin);
+  release_color_tag (self, color_tag);
+}
+
+/*
+ * Finds the occurrence covering the character at @iter. Occurrences are
+ * contiguous tagged text, so we only need to look back while on a color.
+ */
+static ColorOccurrence *
+find_occurrence_at_iter (GbColorPickerDocumentMonitor *self,
+                         const GtkTextIter            *iter)
+{
+  g_autoptr(GPtrArray) found = NULL;
+  GtkTextBuffer *buffer;
+  GtkTextIter pos = *iter;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (iter != NULL);
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+  found = g_ptr_array_new ();
+
+  while (has_color_tag (self, &pos))
+    {
+      guint i;
+
+      add_occurrences_at_iter (self, &pos, found);
+
+      for (i = 0; i < found->len; i++)
+        {
+          ColorOccurrence *occurrence = g_ptr_array_index (found, i);
+          GtkTextIter end;
+
+          gtk_text_buffer_get_iter_at_mark (buffer, &end, occurrence->end);
+
+          if (gtk_text_iter_compare (iter, &end) < 0)
+            return occurrence;
+        }
+
+      /* The occurrences starting here end before @iter */
+      if (found->len > 0 || !gtk_text_iter_backward_char (&pos))
+        break;
+    }
+
+  return NULL;
+}
+
+static GstyleColor *
+get_occurrence_color (GbColorPickerDocumentMonitor *self,
+                      ColorOccurrence              *occurrence,
+                      GtkTextIter                  *begin,
+                      GtkTextIter                  *end)
+{
+  g_autofree gchar *color_text = NULL;
+  GtkTextBuffer *buffer;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (occurrence != NULL);
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, begin, occurrence->begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, end, occurrence->end);
+  color_text = gtk_text_buffer_get_text (buffer, begin, end, FALSE);
+
+  return gstyle_color_new_from_string (NULL, color_text);
+}
+
+static void
+uncolorize_range (GbColorPickerDocumentMonitor *self,
+                  const GtkTextIter            *begin,
+                  const GtkTextIter            *end)
+{
+  g_autoptr(GPtrArray) found = NULL;
+  GtkTextIter iter = *begin;
+  guint i;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+
+  if (g_hash_table_size (self->occurrences) == 0)
+    return;
+
+  found = g_ptr_array_new ();
+
+  /* Colors do not span lines, so this finds those overlapping @begin too. */
+  gtk_text_iter_set_line_offset (&iter, 0);
+
+  /*
+   * Skip over uncolored text using the tag toggles, and look for the begin
+   * marks of occurrences within colored text, where toggles may be merged.
+   */
+  while (gtk_text_iter_compare (&iter, end) < 0)
+    {
+      if (has_color_tag (self, &iter))
+        {
+          add_occurrences_at_iter (self, &iter, found);
+
+          if (!gtk_text_iter_forward_char (&iter))
+            break;
+        }
+      else if (!gtk_text_iter_forward_to_tag_toggle (&iter, NULL))
+        break;
+    }
+
+  for (i = 0; i < found->len; i++)
+    {
+      ColorOccurrence *occurrence = g_ptr_array_index (found, i);
+      GtkTextIter occurrence_end;
+
+      gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (self->buffer), &occurrence_end, occurrence->end);
+
+      if (gtk_text_iter_compare (&occurrence_end, begin) > 0)
+        remove_occurrence (self, occurrence);
+    }
+}
+
 static void
 block_signals (GbColorPickerDocumentMonitor *self)
 {
@@ -84,39 +426,62 @@ void
 gb_color_picker_document_monitor_set_color_tag_at_cursor (GbColorPickerDocumentMonitor *self,
                                                           GstyleColor                  *color)
 {
+  g_autoptr(GstyleColor) current_color = NULL;
+  g_autofree gchar *new_text = NULL;
+  GtkTextBuffer *buffer;
   GtkTextMark *insert;
   GtkTextIter cursor;
+  GtkTextIter begin;
+  GtkTextIter end;
+  ColorOccurrence *occurrence;
+  ColorTag *new_color_tag;
+  gint begin_offset;
+  gint cursor_offset;
+  gint dst_offset;
 
   g_return_if_fail (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_return_if_fail (GSTYLE_IS_COLOR (color));
   g_return_if_fail (self->buffer != NULL);
 
-  insert = gtk_text_buffer_get_insert (GTK_TEXT_BUFFER(self->buffer));
-  gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER(self->buffer), &cursor, insert);
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+  insert = gtk_text_buffer_get_insert (buffer);
+  gtk_text_buffer_get_iter_at_mark (buffer, &cursor, insert);
+
+  if (NULL == (occurrence = find_occurrence_at_iter (self, &cursor)) ||
+      NULL == (current_color = get_occurrence_color (self, occurrence, &begin, &end)))
+    return;
 
   if (!self->is_in_user_action)
     {
-      gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (self->buffer));
+      gtk_text_buffer_begin_user_action (buffer);
       self->is_in_user_action = TRUE;
     }
 
+  new_text = gstyle_color_to_string (color, gstyle_color_get_kind (current_color));
+  cursor_offset = gtk_text_iter_get_line_offset (&cursor);
+  dst_offset = MIN (cursor_offset, gtk_text_iter_get_line_offset (&begin) + g_utf8_strlen (new_text, -1) - 1);
+
   block_signals (self);
-  gb_color_picker_helper_set_color_tag_at_iter (&cursor, color, TRUE);
-  unblock_signals (self);
-}
 
-static void
-remove_color_tag_foreach_cb (GtkTextTag *tag,
-                             GPtrArray  *taglist)
-{
-  const gchar *name;
+  /*
+   * The tag is shared with every other occurrence of the old color, so
+   * rather than changing it we switch this occurrence to the new color's tag.
+   * The new tag is acquired first so that it survives if the color is equal.
+   */
+  new_color_tag = acquire_color_tag (self, color);
+  remove_occurrence (self, occurrence);
+
+  begin_offset = gtk_text_iter_get_offset (&begin);
+  gtk_text_buffer_delete (buffer, &begin, &end);
+  gtk_text_buffer_insert (buffer, &begin, new_text, -1);
 
-  g_assert (GTK_IS_TEXT_TAG (tag));
-  g_assert (taglist != NULL);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, begin_offset);
+  add_occurrence (self, new_color_tag, &end, &begin);
 
-  g_object_get (G_OBJECT (tag), "name", &name, NULL);
-  if (!ide_str_empty0 (name) && g_str_has_prefix (name, COLOR_TAG_PREFIX))
-    g_ptr_array_add (taglist, tag);
+  gtk_text_iter_set_line_offset (&begin, dst_offset);
+  gtk_text_buffer_place_cursor (buffer, &begin);
+
+  unblock_signals (self);
 }
 
 void
@@ -124,27 +489,34 @@ gb_color_picker_document_monitor_uncolorize (GbColorPickerDocumentMonitor *self,
                                              GtkTextIter                  *begin,
                                              GtkTextIter                  *end)
 {
-  g_autoptr (GPtrArray) taglist = NULL;
-  g_autofree gchar *name = NULL;
-  g_autoptr (GSList) tags = NULL;
-  GtkTextTagTable *tag_table;
   GtkTextIter real_begin;
   GtkTextIter real_end;
-  GtkTextTag *color_tag;
-  GtkTextTag *tag;
-  GSList *l;
-  gint n;
 
   g_return_if_fail (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_return_if_fail (self->buffer != NULL);
 
-  tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (self->buffer));
   if (begin == NULL && end == NULL)
     {
-      taglist = g_ptr_array_new ();
-      gtk_text_tag_table_foreach (tag_table, (GtkTextTagTableForeach)remove_color_tag_foreach_cb, taglist);
-      for (n = 0; n < taglist->len; ++n)
-        gtk_text_tag_table_remove (tag_table, g_ptr_array_index (taglist, n));
+      GtkTextTagTable *tag_table;
+      GHashTableIter iter;
+      ColorTag *color_tag;
+
+      /* Forget about pending and in-flight scans too. */
+      self->sequence++;
+      ide_clear_source (&self->colorize_source);
+      gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (self->buffer), &real_begin);
+      gtk_text_buffer_move_mark (GTK_TEXT_BUFFER (self->buffer), self->dirty_begin, &real_begin);
+      gtk_text_buffer_move_mark (GTK_TEXT_BUFFER (self->buffer), self->dirty_end, &real_begin);
+
+      tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (self->buffer));
+
+      g_hash_table_iter_init (&iter, self->color_tags);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&color_tag))
+        gtk_text_tag_table_remove (tag_table, color_tag->tag);
+
+      g_hash_table_remove_all (self->occurrences);
+      g_hash_table_remove_all (self->tags_index);
+      g_hash_table_remove_all (self->color_tags);
 
       return;
     }
@@ -159,53 +531,241 @@ gb_color_picker_document_monitor_uncolorize (GbColorPickerDocumentMonitor *self,
   else
     real_end = *end;
 
-  while (TRUE)
+  uncolorize_range (self, &real_begin, &real_end);
+}
+
+static void
+colorize_worker (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  const gchar *text = task_data;
+  g_autoptr(GPtrArray) items = NULL;
+  GArray *spans;
+  const gchar *pos = text;
+  guint offset = 0;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (text != NULL);
+
+  spans = g_array_new (FALSE, FALSE, sizeof (ColorSpan));
+  g_array_set_clear_func (spans, color_span_clear);
+
+  if (*text != '\0')
+    items = gstyle_color_parse (text);
+
+  /*
+   * The lexer works in bytes while the buffer works in characters. Items are
+   * sorted by position, so convert them as we walk forward through the text.
+   */
+  for (i = 0; items != NULL && i < items->len; i++)
     {
-      color_tag = NULL;
-      tags = gtk_text_iter_get_toggled_tags (&real_begin, TRUE);
-      for (l = tags; l != NULL; l = g_slist_next (l))
-        {
-          tag = l->data;
-          g_object_get (G_OBJECT (tag), "name", &name, NULL);
-          if (!ide_str_empty0 (name) && g_str_has_prefix (name, COLOR_TAG_PREFIX))
-            {
-              color_tag = tag;
-              break;
-            }
-        }
+      GstyleColorItem *item = g_ptr_array_index (items, i);
+      const gchar *item_begin = text + gstyle_color_item_get_start (item);
+      const gchar *item_end = item_begin + gstyle_color_item_get_len (item);
+      ColorSpan span;
+
+      offset += g_utf8_pointer_to_offset (pos, item_begin);
+      span.begin = offset;
+      span.end = offset + g_utf8_pointer_to_offset (item_begin, item_end);
+      span.color = g_object_ref ((GstyleColor *)gstyle_color_item_get_color (item));
+      g_array_append_val (spans, span);
+
+      pos = item_begin;
+    }
+
+  g_task_return_pointer (task, spans, (GDestroyNotify)g_array_unref);
+}
+
+static void
+clear_scan_marks (GbColorPickerDocumentMonitor *self)
+{
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+
+  if (self->scan_begin != NULL)
+    {
+      GtkTextBuffer *buffer = gtk_text_mark_get_buffer (self->scan_begin);
 
-      if (color_tag != NULL)
+      if (buffer != NULL)
         {
-          gtk_text_iter_forward_to_tag_toggle (&real_begin, color_tag);
-          gtk_text_tag_table_remove (tag_table, color_tag);
+          gtk_text_buffer_delete_mark (buffer, self->scan_begin);
+          gtk_text_buffer_delete_mark (buffer, self->scan_end);
         }
 
-      if (!gtk_text_iter_forward_to_tag_toggle (&real_begin, NULL))
-        break;
+      g_clear_object (&self->scan_begin);
+      g_clear_object (&self->scan_end);
+    }
+}
 
-      if (gtk_text_iter_compare (&real_begin, &real_end) != -1)
-        break;
+static void
+colorize_cb (GObject      *object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  GbColorPickerDocumentMonitor *self = (GbColorPickerDocumentMonitor *)object;
+  g_autoptr(GArray) spans = NULL;
+  GtkTextBuffer *buffer;
+  GtkTextIter begin;
+  GtkTextIter end;
+  guint offset;
+  guint i;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (G_IS_TASK (result));
+
+  spans = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  self->in_scan = FALSE;
+
+  if (self->buffer == NULL || self->scan_begin == NULL)
+    return;
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, self->scan_begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, self->scan_end);
+
+  if (self->scan_sequence != self->sequence)
+    goto cleanup;
+
+  /* The snapshot is stale, scan the (moved) region again. */
+  if (self->scan_change_count != ide_buffer_get_change_count (self->buffer))
+    {
+      queue_colorize (self, &begin, &end);
+      goto cleanup;
+    }
+
+  /* Drop what we had so that re-scanning a region does not double count. */
+  uncolorize_range (self, &begin, &end);
+
+  offset = gtk_text_iter_get_offset (&begin);
+
+  for (i = 0; spans != NULL && i < spans->len; i++)
+    {
+      const ColorSpan *span = &g_array_index (spans, ColorSpan, i);
+      ColorTag *color_tag;
+      GtkTextIter tag_begin;
+      GtkTextIter tag_end;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &tag_begin, offset + span->begin);
+      gtk_text_buffer_get_iter_at_offset (buffer, &tag_end, offset + span->end);
+
+      color_tag = acquire_color_tag (self, span->color);
+      add_occurrence (self, color_tag, &tag_begin, &tag_end);
     }
+
+cleanup:
+  clear_scan_marks (self);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, self->dirty_begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, self->dirty_end);
+
+  if (!gtk_text_iter_equal (&begin, &end))
+    queue_colorize (self, &begin, &end);
 }
 
+static gboolean
+colorize_source_cb (gpointer user_data)
+{
+  GbColorPickerDocumentMonitor *self = user_data;
+  g_autoptr(GTask) task = NULL;
+  GtkTextBuffer *buffer;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+
+  self->colorize_source = 0;
+
+  if (self->buffer == NULL || self->in_scan)
+    return G_SOURCE_REMOVE;
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &begin, self->dirty_begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, self->dirty_end);
+
+  if (gtk_text_iter_equal (&begin, &end))
+    return G_SOURCE_REMOVE;
+
+  gtk_text_iter_set_line_offset (&begin, 0);
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+
+  gtk_text_buffer_move_mark (buffer, self->dirty_begin, &end);
+  gtk_text_buffer_move_mark (buffer, self->dirty_end, &end);
+
+  self->scan_begin = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, &begin, TRUE));
+  self->scan_end = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE));
+  self->scan_change_count = ide_buffer_get_change_count (self->buffer);
+  self->scan_sequence = self->sequence;
+  self->in_scan = TRUE;
+
+  task = g_task_new (self, NULL, colorize_cb, NULL);
+  g_task_set_source_tag (task, colorize_source_cb);
+  g_task_set_task_data (task, gtk_text_buffer_get_slice (buffer, &begin, &end, TRUE), g_free);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, colorize_worker);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_colorize (GbColorPickerDocumentMonitor *self,
+                const GtkTextIter            *begin,
+                const GtkTextIter            *end)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter dirty_begin;
+  GtkTextIter dirty_end;
+
+  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &dirty_begin, self->dirty_begin);
+  gtk_text_buffer_get_iter_at_mark (buffer, &dirty_end, self->dirty_end);
+
+  if (gtk_text_iter_equal (&dirty_begin, &dirty_end))
+    {
+      gtk_text_buffer_move_mark (buffer, self->dirty_begin, begin);
+      gtk_text_buffer_move_mark (buffer, self->dirty_end, end);
+    }
+  else
+    {
+      if (gtk_text_iter_compare (begin, &dirty_begin) < 0)
+        gtk_text_buffer_move_mark (buffer, self->dirty_begin, begin);
+      if (gtk_text_iter_compare (end, &dirty_end) > 0)
+        gtk_text_buffer_move_mark (buffer, self->dirty_end, end);
+    }
+
+  /* An in-flight scan picks up the dirty region when it completes. */
+  if (!self->in_scan && self->colorize_source == 0)
+    self->colorize_source = gdk_threads_add_idle_full (G_PRIORITY_LOW,
+                                                       colorize_source_cb,
+                                                       self,
+                                                       NULL);
+}
+
+/**
+ * gb_color_picker_document_monitor_colorize:
+ * @self: a #GbColorPickerDocumentMonitor
+ * @begin: (nullable): the start of the range, or %NULL for the buffer start
+ * @end: (nullable): the end of the range, or %NULL for the buffer end
+ *
+ * Queues the lines between @begin and @end to be scanned for colors. The
+ * scan happens on a worker thread and the tags are applied when it completes.
+ */
 void
 gb_color_picker_document_monitor_colorize (GbColorPickerDocumentMonitor *self,
                                            GtkTextIter                  *begin,
                                            GtkTextIter                  *end)
 {
-  g_autofree gchar *text = NULL;
-  g_autoptr(GPtrArray) items = NULL;
-  GstyleColorItem *item;
-  GstyleColor *color;
-  GtkTextTag *tag;
   GtkTextIter real_begin;
   GtkTextIter real_end;
-  GtkTextIter tag_begin;
-  GtkTextIter tag_end;
-  gint offset;
-  gint len;
-  gint n;
-  gint pos;
 
   g_return_if_fail (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_return_if_fail (self->buffer != NULL);
@@ -223,23 +783,21 @@ gb_color_picker_document_monitor_colorize (GbColorPickerDocumentMonitor *self,
   if (gtk_text_iter_equal (&real_begin, &real_end))
     return;
 
-  offset = gtk_text_iter_get_offset (&real_begin);
-  text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (self->buffer), &real_begin, &real_end, TRUE);
+  queue_colorize (self, &real_begin, &real_end);
+}
 
-  items = gstyle_color_parse (text);
-  for (n = 0; n < items->len; ++n)
-    {
-      item = g_ptr_array_index (items, n);
-      pos = offset + gstyle_color_item_get_start (item);
-      gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (self->buffer), &tag_begin, pos);
-      len = gstyle_color_item_get_len (item);
-      gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (self->buffer), &tag_end, pos + len);
-      color = (GstyleColor *)gstyle_color_item_get_color (item);
-
-      tag = gb_color_picker_helper_create_color_tag (GTK_TEXT_BUFFER (self->buffer), color);
-      gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (self->buffer), tag, &tag_begin, &tag_end);
-      /* FIXME: is the tag added to the tag table or should we handle a hash table/tag table ourself ? */
-    }
+static void
+get_line_bounds (const GtkTextIter *begin,
+                 const GtkTextIter *end,
+                 GtkTextIter       *line_begin,
+                 GtkTextIter       *line_end)
+{
+  *line_begin = *begin;
+  gtk_text_iter_set_line_offset (line_begin, 0);
+
+  *line_end = *end;
+  if (!gtk_text_iter_ends_line (line_end))
+    gtk_text_iter_forward_to_line_end (line_end);
 }
 
 static void
@@ -249,23 +807,15 @@ text_inserted_cb (GbColorPickerDocumentMonitor *self,
                   gint                          len,
                   GtkTextBuffer                *buffer)
 {
-  GtkTextTag *tag;
-  GstyleColor *color;
   GtkTextIter begin, end;
 
   g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_assert (GTK_IS_TEXT_BUFFER (buffer));
   g_assert (cursor != NULL);
 
-  tag = gb_color_picker_helper_get_tag_at_iter (cursor, &color, &begin, &end);
-  if (tag != NULL )
-    {
-      gtk_text_iter_set_line_offset (&begin, 0);
-      if (!gtk_text_iter_ends_line (&end))
-        gtk_text_iter_forward_to_line_end (&end);
-
-      gb_color_picker_document_monitor_uncolorize (self, &begin, &end);
-    }
+  /* Changing tags does not invalidate @cursor, only text changes do. */
+  get_line_bounds (cursor, cursor, &begin, &end);
+  uncolorize_range (self, &begin, &end);
 }
 
 static void
@@ -276,47 +826,16 @@ text_inserted_after_cb (GbColorPickerDocumentMonitor *self,
                         GtkTextBuffer                *buffer)
 {
   GtkTextIter begin, end;
-  gint offset;
 
   g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_assert (GTK_IS_TEXT_BUFFER (buffer));
   g_assert (iter != NULL);
 
   begin = *iter;
-  offset = gtk_text_iter_get_offset (&begin);
-  gtk_text_iter_set_offset (&begin, offset - len);
-  gtk_text_iter_set_line_offset (&begin, 0);
+  gtk_text_iter_backward_chars (&begin, g_utf8_strlen (text, len));
 
-  end = *iter;
-  if (!gtk_text_iter_ends_line (&end))
-    gtk_text_iter_forward_to_line_end (&end);
-
-  gb_color_picker_document_monitor_colorize (self, &begin, &end);
-}
-
-static void
-remove_tag_cb (GbColorPickerDocumentMonitor *self,
-               GtkTextTag                   *tag,
-               GtkTextIter                  *start,
-               GtkTextIter                  *end,
-               GtkTextBuffer                *buffer)
-{
-  GtkTextTagTable *tag_table;
-  g_autofree gchar *name = NULL;
-
-  g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
-  g_assert (GTK_IS_TEXT_BUFFER (buffer));
-  g_assert (GTK_IS_TEXT_TAG (tag));
-
-  tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (self->buffer));
-  g_object_get (G_OBJECT (tag), "name", &name, NULL);
-
-  if (!ide_str_empty0 (name) &&
-      g_str_has_prefix (name, COLOR_TAG_PREFIX) &&
-      gtk_text_tag_table_lookup (tag_table, name))
-    {
-      gtk_text_tag_table_remove (tag_table, tag);
-    }
+  get_line_bounds (&begin, iter, &begin, &end);
+  queue_colorize (self, &begin, &end);
 }
 
 static void
@@ -331,22 +850,8 @@ text_deleted_cb (GbColorPickerDocumentMonitor *self,
   g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
   g_assert (GTK_IS_TEXT_BUFFER (buffer));
 
-  self->remove_tag_handler_id = g_signal_connect_object (GTK_TEXT_BUFFER (self->buffer),
-                                                         "remove-tag",
-                                                         G_CALLBACK (remove_tag_cb),
-                                                         self,
-                                                         G_CONNECT_SWAPPED | G_CONNECT_AFTER);
-
-  recolor_begin = *begin;
-  gtk_text_iter_set_line_offset (&recolor_begin, 0);
-
-  recolor_end = *end;
-  if (!gtk_text_iter_ends_line (&recolor_end))
-    gtk_text_iter_forward_to_line_end (&recolor_end);
-
-  /* FIXME: we only need to remove color tag */
-  gtk_text_buffer_remove_all_tags (buffer, &recolor_begin, &recolor_end);
-  g_signal_handler_disconnect (GTK_TEXT_BUFFER (self->buffer), self->remove_tag_handler_id);
+  get_line_bounds (begin, end, &recolor_begin, &recolor_end);
+  uncolorize_range (self, &recolor_begin, &recolor_end);
 }
 
 static void
@@ -363,14 +868,8 @@ text_deleted_after_cb (GbColorPickerDocumentMonitor *self,
   g_assert (begin != NULL);
   g_assert (end != NULL);
 
-  recolor_begin = *begin;
-  gtk_text_iter_set_line_offset (&recolor_begin, 0);
-
-  recolor_end = *end;
-  if (!gtk_text_iter_ends_line (&recolor_end))
-    gtk_text_iter_forward_to_line_end (&recolor_end);
-
-  gb_color_picker_document_monitor_colorize (self, &recolor_begin, &recolor_end);
+  get_line_bounds (begin, end, &recolor_begin, &recolor_end);
+  queue_colorize (self, &recolor_begin, &recolor_end);
 }
 
 static void
@@ -378,7 +877,7 @@ cursor_moved_cb (GbColorPickerDocumentMonitor *self,
                  GParamSpec                   *prop,
                  GtkTextBuffer                *buffer)
 {
-  GtkTextTag *tag;
+  ColorOccurrence *occurrence;
   GtkTextMark *insert;
   GtkTextIter cursor;
   GstyleColor *current_color;
@@ -397,16 +896,22 @@ cursor_moved_cb (GbColorPickerDocumentMonitor *self,
   gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER(self->buffer), &cursor, insert);
 
   /* TODO: fast path: check if we are in the last already detected color tag */
-  tag = gb_color_picker_helper_get_tag_at_iter (&cursor, &current_color, &begin, &end);
-  if (tag != NULL)
+  if (NULL != (occurrence = find_occurrence_at_iter (self, &cursor)) &&
+      NULL != (current_color = get_occurrence_color (self, occurrence, &begin, &end)))
     g_signal_emit (self, signals [COLOR_FOUND], 0, current_color);
 }
 
 static void
 start_monitor (GbColorPickerDocumentMonitor *self)
 {
+  GtkTextIter begin;
+
   g_assert (GB_IS_COLOR_PICKER_DOCUMENT_MONITOR (self));
 
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (self->buffer), &begin);
+  self->dirty_begin = g_object_ref (gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (self->buffer), NULL, &begin, TRUE));
+  self->dirty_end = g_object_ref (gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (self->buffer), NULL, &begin, FALSE));
+
   self->insert_handler_id = g_signal_connect_object (GTK_TEXT_BUFFER (self->buffer),
                                                      "insert-text",
                                                      G_CALLBACK (text_inserted_cb),
@@ -448,6 +953,14 @@ stop_monitor (GbColorPickerDocumentMonitor *self)
   g_signal_handlers_disconnect_by_func (self->buffer, text_deleted_cb, self);
   g_signal_handlers_disconnect_by_func (self->buffer, text_deleted_after_cb, self);
   g_signal_handlers_disconnect_by_func (self->buffer, cursor_moved_cb, self);
+
+  gb_color_picker_document_monitor_uncolorize (self, NULL, NULL);
+  clear_scan_marks (self);
+
+  gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (self->buffer), self->dirty_begin);
+  gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (self->buffer), self->dirty_end);
+  g_clear_object (&self->dirty_begin);
+  g_clear_object (&self->dirty_end);
 }
 
 void
@@ -459,13 +972,14 @@ gb_color_picker_document_monitor_set_buffer (GbColorPickerDocumentMonitor *self,
 
   if (self->buffer != buffer)
     {
+      if (self->buffer != NULL)
+        stop_monitor (self);
+
       self->buffer = buffer;
       g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_BUFFER]);
 
       if (buffer != NULL)
         start_monitor (self);
-      else
-        stop_monitor (self);
     }
 }
 
@@ -488,6 +1002,17 @@ gb_color_picker_document_monitor_new (IdeBuffer *buffer)
 static void
 gb_color_picker_document_monitor_finalize (GObject *object)
 {
+  GbColorPickerDocumentMonitor *self = (GbColorPickerDocumentMonitor *)object;
+
+  ide_clear_source (&self->colorize_source);
+  g_clear_object (&self->dirty_begin);
+  g_clear_object (&self->dirty_end);
+  g_clear_object (&self->scan_begin);
+  g_clear_object (&self->scan_end);
+  g_clear_pointer (&self->occurrences, g_hash_table_unref);
+  g_clear_pointer (&self->tags_index, g_hash_table_unref);
+  g_clear_pointer (&self->color_tags, g_hash_table_unref);
+
   G_OBJECT_CLASS (gb_color_picker_document_monitor_parent_class)->finalize (object);
 }
 
@@ -572,4 +1097,7 @@ gb_color_picker_document_monitor_class_init (GbColorPickerDocumentMonitorClass *
 static void
 gb_color_picker_document_monitor_init (GbColorPickerDocumentMonitor *self)
 {
+  self->color_tags = g_hash_table_new_full (gdk_rgba_hash, gdk_rgba_equal, NULL, color_tag_free);
+  self->tags_index = g_hash_table_new (NULL, NULL);
+  self->occurrences = g_hash_table_new_full (NULL, NULL, NULL, color_occurrence_free);
 }
@@ -512,6 +512,30 @@ ide_ctags_index_get_size (IdeCtagsIndex *self)
   return 0;
 }
 
+/**
+ * ide_ctags_index_get_heap_size:
+ *
+ * Gets the number of bytes used by the contents of the tags file and the
+ * index of its entries.
+ *
+ * Returns: A number of bytes.
+ */
+gsize
+ide_ctags_index_get_heap_size (IdeCtagsIndex *self)
+{
+  gsize ret = 0;
+
+  g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), 0);
+
+  if (self->index != NULL)
+    ret += self->index->len * sizeof (IdeCtagsIndexEntry);
+
+  if (self->buffer != NULL)
+    ret += g_bytes_get_size (self->buffer);
+
+  return ret;
+}
+
 static const IdeCtagsIndexEntry *
 ide_ctags_index_lookup_full (IdeCtagsIndex *self,
                              const gchar   *keyword,
@@ -72,6 +72,7 @@ gchar                    *ide_ctags_index_resolve_path  (IdeCtagsIndex
                                                          const gchar              *path);
 GFile                    *ide_ctags_index_get_file      (IdeCtagsIndex            *self);
 gsize                     ide_ctags_index_get_size      (IdeCtagsIndex            *self);
+gsize                     ide_ctags_index_get_heap_size (IdeCtagsIndex            *self);
 const gchar              *ide_ctags_index_get_path_root (IdeCtagsIndex            *self);
 const IdeCtagsIndexEntry *ide_ctags_index_lookup        (IdeCtagsIndex            *self,
                                                          const gchar              *keyword,
@@ -585,6 +585,8 @@ ide_ctags_service_init (IdeCtagsService *self)
                                       NULL);
 
   egg_task_cache_set_name (self->indexes, "ctags index cache");
+  egg_task_cache_set_cost_func (self->indexes,
+                                (EggTaskCacheCostFunc)ide_ctags_index_get_heap_size);
 }
 
 void
@@ -0,0 +1,381 @@
+/* gbp-diagnostics-panel.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-diagnostics-panel"
+
+#include <glib/gi18n.h>
+
+#include "gbp-diagnostics-panel.h"
+
+struct _GbpDiagnosticsPanel
+{
+  PnlDockWidget  parent_instance;
+
+  GFile         *workdir;
+  GtkTreeModel  *model;
+  GtkTreeView   *tree_view;
+};
+
+enum {
+  PROP_0,
+  PROP_MODEL,
+  PROP_WORKDIR,
+  N_PROPS
+};
+
+G_DEFINE_TYPE (GbpDiagnosticsPanel, gbp_diagnostics_panel, PNL_TYPE_DOCK_WIDGET)
+
+static GParamSpec *properties [N_PROPS];
+
+static gint
+gbp_diagnostics_panel_compare_location (GtkTreeModel *model,
+                                        GtkTreeIter  *a,
+                                        GtkTreeIter  *b,
+                                        gpointer      user_data)
+{
+  g_autoptr(GFile) file_a = NULL;
+  g_autoptr(GFile) file_b = NULL;
+  g_autofree gchar *uri_a = NULL;
+  g_autofree gchar *uri_b = NULL;
+  guint line_a = 0;
+  guint line_b = 0;
+  gint ret;
+
+  gtk_tree_model_get (model, a,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, &file_a,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, &line_a,
+                      -1);
+  gtk_tree_model_get (model, b,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, &file_b,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, &line_b,
+                      -1);
+
+  if (file_a != NULL)
+    uri_a = g_file_get_uri (file_a);
+
+  if (file_b != NULL)
+    uri_b = g_file_get_uri (file_b);
+
+  if (0 != (ret = g_strcmp0 (uri_a, uri_b)))
+    return ret;
+
+  return (line_a > line_b) - (line_a < line_b);
+}
+
+static void
+gbp_diagnostics_panel_severity_data_func (GtkCellLayout   *layout,
+                                          GtkCellRenderer *cell,
+                                          GtkTreeModel    *model,
+                                          GtkTreeIter     *iter,
+                                          gpointer         user_data)
+{
+  gint severity = 0;
+
+  gtk_tree_model_get (model, iter, IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY, &severity, -1);
+  g_object_set (cell, "text", ide_diagnostic_severity_to_string (severity), NULL);
+}
+
+static void
+gbp_diagnostics_panel_location_data_func (GtkCellLayout   *layout,
+                                          GtkCellRenderer *cell,
+                                          GtkTreeModel    *model,
+                                          GtkTreeIter     *iter,
+                                          gpointer         user_data)
+{
+  GbpDiagnosticsPanel *self = user_data;
+  g_autoptr(GFile) file = NULL;
+  g_autofree gchar *relpath = NULL;
+  g_autofree gchar *text = NULL;
+  guint line = 0;
+
+  gtk_tree_model_get (model, iter,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, &file,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, &line,
+                      -1);
+
+  if (file == NULL)
+    return;
+
+  if (self->workdir == NULL || !(relpath = g_file_get_relative_path (self->workdir, file)))
+    relpath = g_file_get_path (file);
+
+  text = g_strdup_printf ("%s:%u", relpath, line + 1);
+  g_object_set (cell, "text", text, NULL);
+}
+
+static gboolean
+gbp_diagnostics_panel_query_tooltip (GbpDiagnosticsPanel *self,
+                                     gint                 x,
+                                     gint                 y,
+                                     gboolean             keyboard_mode,
+                                     GtkTooltip          *tooltip,
+                                     GtkTreeView         *tree_view)
+{
+  g_autoptr(GtkTreePath) path = NULL;
+  g_autofree gchar *text = NULL;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+
+  g_assert (GBP_IS_DIAGNOSTICS_PANEL (self));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  model = gtk_tree_view_get_model (tree_view);
+
+  gtk_tree_view_convert_widget_to_bin_window_coords (tree_view, x, y, &x, &y);
+
+  if (!gtk_tree_view_get_path_at_pos (tree_view, x, y, &path, NULL, NULL, NULL) ||
+      !gtk_tree_model_get_iter (model, &iter, path))
+    return FALSE;
+
+  gtk_tree_model_get (model, &iter, IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT, &text, -1);
+
+  if (text == NULL)
+    return FALSE;
+
+  gtk_tooltip_set_text (tooltip, text);
+
+  return TRUE;
+}
+
+static void
+gbp_diagnostics_panel_row_activated (GbpDiagnosticsPanel *self,
+                                     GtkTreePath         *path,
+                                     GtkTreeViewColumn   *column,
+                                     GtkTreeView         *tree_view)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(IdeUri) uri = NULL;
+  g_autofree gchar *fragment = NULL;
+  GtkTreeModel *model;
+  GtkWidget *workbench;
+  GtkTreeIter iter;
+  guint line = 0;
+
+  g_assert (GBP_IS_DIAGNOSTICS_PANEL (self));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  model = gtk_tree_view_get_model (tree_view);
+
+  if (!gtk_tree_model_get_iter (model, &iter, path))
+    return;
+
+  gtk_tree_model_get (model, &iter,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, &file,
+                      IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, &line,
+                      -1);
+
+  if (file == NULL)
+    return;
+
+  uri = ide_uri_new_from_file (file);
+  fragment = g_strdup_printf ("L%u", line);
+  ide_uri_set_fragment (uri, fragment);
+
+  workbench = gtk_widget_get_ancestor (GTK_WIDGET (self), IDE_TYPE_WORKBENCH);
+  ide_workbench_open_uri_async (IDE_WORKBENCH (workbench), uri, "editor", 0, NULL, NULL, NULL);
+}
+
+static void
+gbp_diagnostics_panel_constructed (GObject *object)
+{
+  GbpDiagnosticsPanel *self = (GbpDiagnosticsPanel *)object;
+  g_autoptr(GtkTreeModel) sorted = NULL;
+
+  G_OBJECT_CLASS (gbp_diagnostics_panel_parent_class)->constructed (object);
+
+  if (self->model == NULL)
+    return;
+
+  /* Sort without touching the model, which is shared by all views */
+  sorted = gtk_tree_model_sort_new_with_model (self->model);
+  gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (sorted),
+                                   IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE,
+                                   gbp_diagnostics_panel_compare_location,
+                                   NULL, NULL);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (sorted),
+                                        IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY,
+                                        GTK_SORT_DESCENDING);
+  gtk_tree_view_set_model (self->tree_view, sorted);
+}
+
+static void
+gbp_diagnostics_panel_finalize (GObject *object)
+{
+  GbpDiagnosticsPanel *self = (GbpDiagnosticsPanel *)object;
+
+  g_clear_object (&self->workdir);
+  g_clear_object (&self->model);
+
+  G_OBJECT_CLASS (gbp_diagnostics_panel_parent_class)->finalize (object);
+}
+
+static void
+gbp_diagnostics_panel_get_property (GObject    *object,
+                                    guint       prop_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+  GbpDiagnosticsPanel *self = GBP_DIAGNOSTICS_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_MODEL:
+      g_value_set_object (value, self->model);
+      break;
+
+    case PROP_WORKDIR:
+      g_value_set_object (value, self->workdir);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_diagnostics_panel_set_property (GObject      *object,
+                                    guint         prop_id,
+                                    const GValue *value,
+                                    GParamSpec   *pspec)
+{
+  GbpDiagnosticsPanel *self = GBP_DIAGNOSTICS_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_MODEL:
+      self->model = g_value_dup_object (value);
+      break;
+
+    case PROP_WORKDIR:
+      self->workdir = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_diagnostics_panel_class_init (GbpDiagnosticsPanelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = gbp_diagnostics_panel_constructed;
+  object_class->finalize = gbp_diagnostics_panel_finalize;
+  object_class->get_property = gbp_diagnostics_panel_get_property;
+  object_class->set_property = gbp_diagnostics_panel_set_property;
+
+  properties [PROP_MODEL] =
+    g_param_spec_object ("model",
+                         "Model",
+                         "The workspace model of the diagnostics manager",
+                         GTK_TYPE_TREE_MODEL,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_WORKDIR] =
+    g_param_spec_object ("workdir",
+                         "Workdir",
+                         "The working directory used to shorten file names",
+                         G_TYPE_FILE,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+gbp_diagnostics_panel_init (GbpDiagnosticsPanel *self)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *cell;
+  GtkWidget *scroller;
+
+  g_object_set (self,
+                "title", _("Diagnostics"),
+                "expand", TRUE,
+                NULL);
+
+  scroller = g_object_new (GTK_TYPE_SCROLLED_WINDOW,
+                           "visible", TRUE,
+                           NULL);
+  gtk_container_add (GTK_CONTAINER (self), scroller);
+
+  self->tree_view = g_object_new (GTK_TYPE_TREE_VIEW,
+                                  "has-tooltip", TRUE,
+                                  "fixed-height-mode", TRUE,
+                                  "visible", TRUE,
+                                  NULL);
+  g_signal_connect_object (self->tree_view,
+                           "query-tooltip",
+                           G_CALLBACK (gbp_diagnostics_panel_query_tooltip),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->tree_view,
+                           "row-activated",
+                           G_CALLBACK (gbp_diagnostics_panel_row_activated),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (scroller), GTK_WIDGET (self->tree_view));
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "sizing", GTK_TREE_VIEW_COLUMN_FIXED,
+                         "resizable", TRUE,
+                         "title", _("Severity"),
+                         "fixed-width", 100,
+                         "sort-column-id", IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY,
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_diagnostics_panel_severity_data_func,
+                                      NULL, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "sizing", GTK_TREE_VIEW_COLUMN_FIXED,
+                         "resizable", TRUE,
+                         "title", _("File"),
+                         "fixed-width", 300,
+                         "sort-column-id", IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE,
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       "ellipsize", PANGO_ELLIPSIZE_START,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_diagnostics_panel_location_data_func,
+                                      self, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "sizing", GTK_TREE_VIEW_COLUMN_FIXED,
+                         "expand", TRUE,
+                         "title", _("Message"),
+                         "sort-column-id", IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT,
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       "ellipsize", PANGO_ELLIPSIZE_END,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (column), cell,
+                                 "text", IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT);
+  gtk_tree_view_append_column (self->tree_view, column);
+}
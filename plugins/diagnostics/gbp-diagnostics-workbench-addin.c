@@ -0,0 +1,185 @@
+/* gbp-diagnostics-workbench-addin.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-diagnostics-workbench-addin"
+
+#include <ide.h>
+
+#include "gbp-diagnostics-panel.h"
+#include "gbp-diagnostics-workbench-addin.h"
+
+struct _GbpDiagnosticsWorkbenchAddin
+{
+  GObject                parent_instance;
+
+  GbpDiagnosticsPanel   *panel;
+  IdeDiagnosticsManager *diagnostics_manager;
+  GSimpleAction         *action;
+  GCancellable          *cancellable;
+};
+
+static void workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (GbpDiagnosticsWorkbenchAddin, gbp_diagnostics_workbench_addin, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (IDE_TYPE_WORKBENCH_ADDIN, workbench_addin_iface_init))
+
+static void
+gbp_diagnostics_workbench_addin_diagnose_cb (GObject      *object,
+                                             GAsyncResult *result,
+                                             gpointer      user_data)
+{
+  IdeDiagnosticsManager *diagnostics_manager = (IdeDiagnosticsManager *)object;
+  g_autoptr(GbpDiagnosticsWorkbenchAddin) self = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (diagnostics_manager));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (GBP_IS_DIAGNOSTICS_WORKBENCH_ADDIN (self));
+
+  if (!ide_diagnostics_manager_diagnose_workspace_finish (diagnostics_manager, result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+    }
+
+  if (self->action != NULL)
+    g_simple_action_set_enabled (self->action, TRUE);
+}
+
+static void
+gbp_diagnostics_workbench_addin_diagnose (GbpDiagnosticsWorkbenchAddin *self)
+{
+  g_assert (GBP_IS_DIAGNOSTICS_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self->diagnostics_manager));
+
+  g_simple_action_set_enabled (self->action, FALSE);
+
+  /* Files that did not change since the last scan are not diagnosed again */
+  ide_diagnostics_manager_diagnose_workspace_async (self->diagnostics_manager,
+                                                    self->cancellable,
+                                                    gbp_diagnostics_workbench_addin_diagnose_cb,
+                                                    g_object_ref (self));
+}
+
+static void
+gbp_diagnostics_workbench_addin_diagnose_workspace (GSimpleAction *action,
+                                                    GVariant      *param,
+                                                    gpointer       user_data)
+{
+  GbpDiagnosticsWorkbenchAddin *self = user_data;
+
+  g_assert (G_IS_SIMPLE_ACTION (action));
+  g_assert (GBP_IS_DIAGNOSTICS_WORKBENCH_ADDIN (self));
+
+  if (self->panel != NULL)
+    {
+      GtkWidget *workbench = gtk_widget_get_ancestor (GTK_WIDGET (self->panel), IDE_TYPE_WORKBENCH);
+
+      ide_workbench_focus (IDE_WORKBENCH (workbench), GTK_WIDGET (self->panel));
+    }
+
+  gbp_diagnostics_workbench_addin_diagnose (self);
+}
+
+static void
+gbp_diagnostics_workbench_addin_load (IdeWorkbenchAddin *addin,
+                                      IdeWorkbench      *workbench)
+{
+  GbpDiagnosticsWorkbenchAddin *self = (GbpDiagnosticsWorkbenchAddin *)addin;
+  g_autoptr(GSettings) settings = NULL;
+  IdePerspective *editor;
+  IdeContext *context;
+  GtkWidget *pane;
+  GFile *workdir;
+
+  g_assert (GBP_IS_DIAGNOSTICS_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  context = ide_workbench_get_context (workbench);
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+  self->diagnostics_manager = g_object_ref (ide_context_get_diagnostics_manager (context));
+  self->cancellable = g_cancellable_new ();
+
+  editor = ide_workbench_get_perspective_by_name (workbench, "editor");
+  pane = pnl_dock_bin_get_bottom_edge (PNL_DOCK_BIN (editor));
+  self->panel = g_object_new (GBP_TYPE_DIAGNOSTICS_PANEL,
+                              "model", ide_diagnostics_manager_get_workspace_model (self->diagnostics_manager),
+                              "workdir", workdir,
+                              "visible", TRUE,
+                              NULL);
+  g_signal_connect (self->panel,
+                    "destroy",
+                    G_CALLBACK (gtk_widget_destroyed),
+                    &self->panel);
+  gtk_container_add (GTK_CONTAINER (pane), GTK_WIDGET (self->panel));
+
+  self->action = g_simple_action_new ("diagnose-workspace", NULL);
+  g_signal_connect_object (self->action,
+                           "activate",
+                           G_CALLBACK (gbp_diagnostics_workbench_addin_diagnose_workspace),
+                           self,
+                           0);
+  g_action_map_add_action (G_ACTION_MAP (workbench), G_ACTION (self->action));
+
+  /*
+   * Scanning the project runs every diagnostic provider over every file,
+   * which is expensive for large projects, so only do it automatically if
+   * the user asked for it. Otherwise it waits for the action.
+   */
+  settings = g_settings_new ("org.gnome.builder.code-insight");
+  if (g_settings_get_boolean (settings, "diagnose-workspace"))
+    gbp_diagnostics_workbench_addin_diagnose (self);
+}
+
+static void
+gbp_diagnostics_workbench_addin_unload (IdeWorkbenchAddin *addin,
+                                        IdeWorkbench      *workbench)
+{
+  GbpDiagnosticsWorkbenchAddin *self = (GbpDiagnosticsWorkbenchAddin *)addin;
+
+  g_assert (GBP_IS_DIAGNOSTICS_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  g_action_map_remove_action (G_ACTION_MAP (workbench), "diagnose-workspace");
+  g_clear_object (&self->action);
+
+  if (self->panel != NULL)
+    gtk_widget_destroy (GTK_WIDGET (self->panel));
+
+  g_clear_object (&self->diagnostics_manager);
+}
+
+static void
+workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface)
+{
+  iface->load = gbp_diagnostics_workbench_addin_load;
+  iface->unload = gbp_diagnostics_workbench_addin_unload;
+}
+
+static void
+gbp_diagnostics_workbench_addin_class_init (GbpDiagnosticsWorkbenchAddinClass *klass)
+{
+}
+
+static void
+gbp_diagnostics_workbench_addin_init (GbpDiagnosticsWorkbenchAddin *self)
+{
+}
@@ -23,16 +23,27 @@
 #include <ide.h>
 
 #include "gb-file-search-index.h"
-#include "gb-file-search-result.h"
 
 struct _GbFileSearchIndex
 {
   IdeObject     parent_instance;
 
   GFile        *root_directory;
+
+  /*
+   * Queries run on worker threads while files are added and removed from
+   * the main thread, so the fuzzy index is protected by @mutex.
+   */
+  GMutex        mutex;
   Fuzzy        *fuzzy;
 };
 
+typedef struct
+{
+  gchar *query;
+  gsize  max_matches;
+} PopulateRequest;
+
 G_DEFINE_TYPE (GbFileSearchIndex, gb_file_search_index, IDE_TYPE_OBJECT)
 
 enum {
@@ -52,7 +63,9 @@ gb_file_search_index_set_root_directory (GbFileSearchIndex *self,
 
   if (g_set_object (&self->root_directory, root_directory))
     {
+      g_mutex_lock (&self->mutex);
       g_clear_pointer (&self->fuzzy, fuzzy_unref);
+      g_mutex_unlock (&self->mutex);
 
       g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_ROOT_DIRECTORY]);
     }
@@ -65,6 +78,7 @@ gb_file_search_index_finalize (GObject *object)
 
   g_clear_object (&self->root_directory);
   g_clear_pointer (&self->fuzzy, fuzzy_unref);
+  g_mutex_clear (&self->mutex);
 
   G_OBJECT_CLASS (gb_file_search_index_parent_class)->finalize (object);
 }
@@ -129,6 +143,7 @@ gb_file_search_index_class_init (GbFileSearchIndexClass *klass)
 static void
 gb_file_search_index_init (GbFileSearchIndex *self)
 {
+  g_mutex_init (&self->mutex);
 }
 
 static void
@@ -140,7 +155,11 @@ populate_from_dir (Fuzzy        *fuzzy,
 {
   GFileEnumerator *enumerator;
   GPtrArray *children = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) names = NULL;
+  g_autofree gboolean *ignored = NULL;
   gpointer file_info_ptr;
+  gsize i;
 
   g_assert (fuzzy != NULL);
   g_assert (G_IS_FILE (directory));
@@ -159,10 +178,12 @@ populate_from_dir (Fuzzy        *fuzzy,
   if (enumerator == NULL)
     return;
 
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+  names = g_ptr_array_new_with_free_func (g_free);
+
   while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
     {
       g_autoptr(GFileInfo) file_info = file_info_ptr;
-      g_autofree gchar *path = NULL;
       g_autoptr(GFile) file = NULL;
       const gchar *name;
 
@@ -177,21 +198,34 @@ populate_from_dir (Fuzzy        *fuzzy,
           continue;
         }
 
-      if (ide_vcs_is_ignored (vcs, file, NULL))
-        continue;
-
-      if (relpath != NULL)
-        name = path = g_build_filename (relpath, name, NULL);
-
-      fuzzy_insert (fuzzy, name, NULL);
+      g_ptr_array_add (files, g_steal_pointer (&file));
+      g_ptr_array_add (names, g_strdup (name));
     }
 
   g_clear_object (&enumerator);
 
-  if (children != NULL)
+  /* Check the whole directory at once so the VCS can share the lookups */
+  ignored = g_new0 (gboolean, files->len);
+
+  if (ide_vcs_is_ignored_many (vcs, (GFile **)files->pdata, files->len, ignored, NULL))
     {
-      gsize i;
+      for (i = 0; i < files->len; i++)
+        {
+          const gchar *name = g_ptr_array_index (names, i);
+          g_autofree gchar *path = NULL;
+
+          if (ignored [i])
+            continue;
+
+          if (relpath != NULL)
+            path = g_build_filename (relpath, name, NULL);
 
+          fuzzy_insert (fuzzy, path ? path : name, NULL);
+        }
+    }
+
+  if (children != NULL)
+    {
       for (i = 0; i < children->len; i++)
         {
           g_autofree gchar *path = NULL;
@@ -240,7 +274,10 @@ gb_file_search_index_builder (GTask        *task,
   populate_from_dir (fuzzy, vcs, NULL, directory, cancellable);
   fuzzy_end_bulk_insert (fuzzy);
 
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->fuzzy, fuzzy_unref);
   self->fuzzy = fuzzy;
+  g_mutex_unlock (&self->mutex);
 
   g_timer_stop (timer);
   elapsed = g_timer_elapsed (timer, NULL);
@@ -290,65 +327,140 @@ gb_file_search_index_build_finish (GbFileSearchIndex  *self,
   return g_task_propagate_boolean (task, error);
 }
 
-void
-gb_file_search_index_populate (GbFileSearchIndex *self,
-                               IdeSearchContext  *context,
-                               IdeSearchProvider *provider,
-                               const gchar       *query)
+static void
+populate_request_free (gpointer data)
+{
+  PopulateRequest *request = data;
+
+  g_free (request->query);
+  g_slice_free (PopulateRequest, request);
+}
+
+static void
+clear_match (gpointer data)
+{
+  FuzzyMatch *match = data;
+
+  g_free ((gchar *)match->key);
+}
+
+static void
+gb_file_search_index_populate_worker (GTask        *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data,
+                                      GCancellable *cancellable)
 {
+  GbFileSearchIndex *self = source_object;
+  PopulateRequest *request = task_data;
   g_autoptr(GArray) ar = NULL;
-  g_auto(IdeSearchReducer) reducer = { 0 };
-  IdeContext *icontext;
-  gsize max_matches;
+  GArray *matches;
   gsize i;
 
-  g_return_if_fail (GB_IS_FILE_SEARCH_INDEX (self));
-  g_return_if_fail (IDE_IS_SEARCH_CONTEXT (context));
-  g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
-  g_return_if_fail (query != NULL);
+  g_assert (G_IS_TASK (task));
+  g_assert (GB_IS_FILE_SEARCH_INDEX (self));
+  g_assert (request != NULL);
 
-  if (self->fuzzy == NULL)
+  if (g_task_return_error_if_cancelled (task))
     return;
 
-  icontext = ide_object_get_context (IDE_OBJECT (provider));
-  max_matches = ide_search_context_get_max_results (context);
-  ide_search_reducer_init (&reducer, context, provider, max_matches);
+  matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+  g_array_set_clear_func (matches, clear_match);
 
-  ar = fuzzy_match (self->fuzzy, query, max_matches);
+  g_mutex_lock (&self->mutex);
 
-  for (i = 0; i < ar->len; i++)
+  if (self->fuzzy != NULL)
+    ar = fuzzy_match (self->fuzzy, request->query, request->max_matches);
+
+  /*
+   * The keys point into the index, which may change as soon as we release
+   * the lock, so copy them. Only the best matches are kept, so the main
+   * thread only creates result objects for rows that get displayed.
+   */
+  for (i = 0; ar != NULL && i < ar->len; i++)
     {
-      FuzzyMatch *match;
+      FuzzyMatch match = g_array_index (ar, FuzzyMatch, i);
 
-      match = &g_array_index (ar, FuzzyMatch, i);
+      if (request->max_matches != 0 && matches->len >= request->max_matches)
+        break;
 
-      if (ide_search_reducer_accepts (&reducer, match->score))
-        {
-          g_autoptr(GbFileSearchResult) result = NULL;
-          g_autofree gchar *markup = NULL;
-
-          markup = ide_completion_item_fuzzy_highlight (match->key, query);
-          result = g_object_new (GB_TYPE_FILE_SEARCH_RESULT,
-                                 "context", icontext,
-                                 "provider", provider,
-                                 "score", match->score,
-                                 "title", markup,
-                                 "path", match->key,
-                                 NULL);
-          ide_search_reducer_push (&reducer, IDE_SEARCH_RESULT (result));
-        }
+      match.key = g_strdup (match.key);
+      g_array_append_val (matches, match);
     }
+
+  g_mutex_unlock (&self->mutex);
+
+  g_task_return_pointer (task, matches, (GDestroyNotify)g_array_unref);
+}
+
+/**
+ * gb_file_search_index_populate_async:
+ * @self: A #GbFileSearchIndex
+ * @query: the text to fuzzy match
+ * @max_matches: the maximum number of matches, or 0 for no limit
+ *
+ * Asynchronously matches @query against the index on the indexer thread pool.
+ */
+void
+gb_file_search_index_populate_async (GbFileSearchIndex   *self,
+                                     const gchar         *query,
+                                     gsize                max_matches,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  PopulateRequest *request;
+
+  g_return_if_fail (GB_IS_FILE_SEARCH_INDEX (self));
+  g_return_if_fail (query != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  request = g_slice_new0 (PopulateRequest);
+  request->query = g_strdup (query);
+  request->max_matches = max_matches;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gb_file_search_index_populate_async);
+  g_task_set_task_data (task, request, populate_request_free);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER,
+                             task,
+                             gb_file_search_index_populate_worker);
+}
+
+/**
+ * gb_file_search_index_populate_finish:
+ *
+ * Completes a request to gb_file_search_index_populate_async().
+ *
+ * Returns: (transfer full) (element-type FuzzyMatch): An array of
+ *   #FuzzyMatch, sorted by score, whose keys are owned by the array.
+ */
+GArray *
+gb_file_search_index_populate_finish (GbFileSearchIndex  *self,
+                                      GAsyncResult       *result,
+                                      GError            **error)
+{
+  g_return_val_if_fail (GB_IS_FILE_SEARCH_INDEX (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 gboolean
 gb_file_search_index_contains (GbFileSearchIndex *self,
                                const gchar       *relative_path)
 {
+  gboolean ret;
+
   g_return_val_if_fail (GB_IS_FILE_SEARCH_INDEX (self), FALSE);
   g_return_val_if_fail (relative_path != NULL, FALSE);
   g_return_val_if_fail (self->fuzzy != NULL, FALSE);
 
-  return fuzzy_contains (self->fuzzy, relative_path);
+  g_mutex_lock (&self->mutex);
+  ret = fuzzy_contains (self->fuzzy, relative_path);
+  g_mutex_unlock (&self->mutex);
+
+  return ret;
 }
 
 void
@@ -359,7 +471,9 @@ gb_file_search_index_insert (GbFileSearchIndex *self,
   g_return_if_fail (relative_path != NULL);
   g_return_if_fail (self->fuzzy != NULL);
 
+  g_mutex_lock (&self->mutex);
   fuzzy_insert (self->fuzzy, relative_path, NULL);
+  g_mutex_unlock (&self->mutex);
 }
 
 void
@@ -370,5 +484,7 @@ gb_file_search_index_remove (GbFileSearchIndex *self,
   g_return_if_fail (relative_path != NULL);
   g_return_if_fail (self->fuzzy != NULL);
 
+  g_mutex_lock (&self->mutex);
   fuzzy_remove (self->fuzzy, relative_path);
+  g_mutex_unlock (&self->mutex);
 }
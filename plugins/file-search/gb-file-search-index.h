@@ -27,23 +27,28 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GbFileSearchIndex, gb_file_search_index, GB, FILE_SEARCH_INDEX, IdeObject)
 
-void     gb_file_search_index_populate     (GbFileSearchIndex    *self,
-                                            IdeSearchContext     *context,
-                                            IdeSearchProvider    *provider,
-                                            const gchar          *query);
-void     gb_file_search_index_build_async  (GbFileSearchIndex    *self,
-                                            GCancellable         *cancellable,
-                                            GAsyncReadyCallback   callback,
-                                            gpointer              user_data);
-gboolean gb_file_search_index_build_finish (GbFileSearchIndex    *self,
-                                            GAsyncResult         *result,
-                                            GError              **error);
-gboolean gb_file_search_index_contains     (GbFileSearchIndex    *self,
-                                            const gchar          *relative_path);
-void     gb_file_search_index_insert       (GbFileSearchIndex    *self,
-                                            const gchar          *relative_path);
-void     gb_file_search_index_remove       (GbFileSearchIndex    *self,
-                                            const gchar          *relative_path);
+void     gb_file_search_index_populate_async  (GbFileSearchIndex    *self,
+                                               const gchar          *query,
+                                               gsize                 max_matches,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+GArray  *gb_file_search_index_populate_finish (GbFileSearchIndex    *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
+void     gb_file_search_index_build_async     (GbFileSearchIndex    *self,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean gb_file_search_index_build_finish    (GbFileSearchIndex    *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
+gboolean gb_file_search_index_contains        (GbFileSearchIndex    *self,
+                                               const gchar          *relative_path);
+void     gb_file_search_index_insert          (GbFileSearchIndex    *self,
+                                               const gchar          *relative_path);
+void     gb_file_search_index_remove          (GbFileSearchIndex    *self,
+                                               const gchar          *relative_path);
 
 G_END_DECLS
 
@@ -16,12 +16,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fuzzy.h>
 #include <glib/gi18n.h>
 #include <ide.h>
 #include <libpeas/peas.h>
 
 #include "gb-file-search-provider.h"
 #include "gb-file-search-index.h"
+#include "gb-file-search-result.h"
 
 struct _GbFileSearchProvider
 {
@@ -29,6 +31,13 @@ struct _GbFileSearchProvider
   GbFileSearchIndex *index;
 };
 
+typedef struct
+{
+  GbFileSearchProvider *self;
+  IdeSearchContext     *context;
+  gchar                *query;
+} Populate;
+
 static void search_provider_iface_init (IdeSearchProviderInterface *iface);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (GbFileSearchProvider,
@@ -44,6 +53,76 @@ gb_file_search_provider_get_verb (IdeSearchProvider *provider)
   return _("Switch To");
 }
 
+static void
+populate_free (Populate *state)
+{
+  g_clear_object (&state->self);
+  g_clear_object (&state->context);
+  g_free (state->query);
+  g_slice_free (Populate, state);
+}
+
+static void
+gb_file_search_provider_populate_cb (GObject      *object,
+                                     GAsyncResult *result,
+                                     gpointer      user_data)
+{
+  GbFileSearchIndex *index = (GbFileSearchIndex *)object;
+  Populate *state = user_data;
+  g_auto(IdeSearchReducer) reducer = { 0 };
+  g_autoptr(GArray) ar = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeSearchProvider *provider;
+  IdeContext *icontext;
+  gsize i;
+
+  g_assert (GB_IS_FILE_SEARCH_INDEX (index));
+  g_assert (state != NULL);
+  g_assert (GB_IS_FILE_SEARCH_PROVIDER (state->self));
+  g_assert (IDE_IS_SEARCH_CONTEXT (state->context));
+
+  provider = IDE_SEARCH_PROVIDER (state->self);
+  ar = gb_file_search_index_populate_finish (index, result, &error);
+
+  if (ar == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+      goto complete;
+    }
+
+  icontext = ide_object_get_context (IDE_OBJECT (state->self));
+  ide_search_reducer_init (&reducer,
+                           state->context,
+                           provider,
+                           ide_search_context_get_max_results (state->context));
+
+  for (i = 0; i < ar->len; i++)
+    {
+      const FuzzyMatch *match = &g_array_index (ar, FuzzyMatch, i);
+
+      if (ide_search_reducer_accepts (&reducer, match->score))
+        {
+          g_autoptr(GbFileSearchResult) item = NULL;
+          g_autofree gchar *markup = NULL;
+
+          markup = ide_completion_item_fuzzy_highlight (match->key, state->query);
+          item = g_object_new (GB_TYPE_FILE_SEARCH_RESULT,
+                               "context", icontext,
+                               "provider", provider,
+                               "score", match->score,
+                               "title", markup,
+                               "path", match->key,
+                               NULL);
+          ide_search_reducer_push (&reducer, IDE_SEARCH_RESULT (item));
+        }
+    }
+
+complete:
+  ide_search_context_provider_completed (state->context, provider);
+  populate_free (state);
+}
+
 static void
 gb_file_search_provider_populate (IdeSearchProvider *provider,
                                   IdeSearchContext  *context,
@@ -52,16 +131,34 @@ gb_file_search_provider_populate (IdeSearchProvider *provider,
                                   GCancellable      *cancellable)
 {
   GbFileSearchProvider *self = (GbFileSearchProvider *)provider;
+  Populate *state;
 
   g_assert (IDE_IS_SEARCH_PROVIDER (provider));
   g_assert (IDE_IS_SEARCH_CONTEXT (context));
   g_assert (search_terms != NULL);
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  if (self->index != NULL)
-    gb_file_search_index_populate (self->index, context, provider, search_terms);
+  if (self->index == NULL)
+    {
+      ide_search_context_provider_completed (context, provider);
+      return;
+    }
 
-  ide_search_context_provider_completed (context, provider);
+  state = g_slice_new0 (Populate);
+  state->self = g_object_ref (self);
+  state->context = g_object_ref (context);
+  state->query = g_strdup (search_terms);
+
+  /*
+   * Matching happens on a worker thread so that other providers, and the
+   * omnibar itself, are not blocked while a large tree is scanned.
+   */
+  gb_file_search_index_populate_async (self->index,
+                                       search_terms,
+                                       max_results,
+                                       cancellable,
+                                       gb_file_search_provider_populate_cb,
+                                       state);
 }
 
 static void
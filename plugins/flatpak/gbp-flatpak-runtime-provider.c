@@ -37,6 +37,13 @@ struct _GbpFlatpakRuntimeProvider
   GPtrArray           *runtimes;
   GFileMonitor        *system_flatpak_monitor;
   GFileMonitor        *user_flatpak_monitor;
+
+  /*
+   * Parsed manifests (or the lack of one) keyed by path, so that we only
+   * need to parse files that changed when reloading.
+   */
+  GMutex               manifests_mutex;
+  GHashTable          *manifests;
 };
 
 typedef struct
@@ -46,9 +53,18 @@ typedef struct
   gchar *sdk;
   gchar *app_id;
   gchar *primary_module;
+  gchar *hash;
   GFile *file;
 } FlatpakManifest;
 
+typedef struct
+{
+  guint64          mtime;
+  goffset          size;
+  /* NULL if the file is not a flatpak manifest */
+  FlatpakManifest *manifest;
+} ManifestCacheEntry;
+
 static void runtime_provider_iface_init (IdeRuntimeProviderInterface *);
 
 G_DEFINE_TYPE_EXTENDED (GbpFlatpakRuntimeProvider, gbp_flatpak_runtime_provider, G_TYPE_OBJECT, 0,
@@ -97,10 +113,37 @@ flatpak_manifest_free (void *data)
   g_free (manifest->platform);
   g_free (manifest->app_id);
   g_free (manifest->primary_module);
+  g_free (manifest->hash);
   g_clear_object (&manifest->file);
   g_slice_free (FlatpakManifest, manifest);
 }
 
+static FlatpakManifest *
+flatpak_manifest_copy (const FlatpakManifest *manifest)
+{
+  FlatpakManifest *copy;
+
+  copy = g_slice_new0 (FlatpakManifest);
+  copy->platform = g_strdup (manifest->platform);
+  copy->branch = g_strdup (manifest->branch);
+  copy->sdk = g_strdup (manifest->sdk);
+  copy->app_id = g_strdup (manifest->app_id);
+  copy->primary_module = g_strdup (manifest->primary_module);
+  copy->hash = g_strdup (manifest->hash);
+  copy->file = g_object_ref (manifest->file);
+
+  return copy;
+}
+
+static void
+manifest_cache_entry_free (gpointer data)
+{
+  ManifestCacheEntry *entry = data;
+
+  g_clear_pointer (&entry->manifest, flatpak_manifest_free);
+  g_slice_free (ManifestCacheEntry, entry);
+}
+
 static gboolean
 gbp_flatpak_runtime_provider_load_refs (GbpFlatpakRuntimeProvider  *self,
                                         FlatpakInstallation        *installation,
@@ -247,6 +290,115 @@ guess_primary_module (JsonObject *manifest_object,
   return NULL;
 }
 
+static gboolean
+is_manifest_name (const gchar *name)
+{
+  static GRegex *filename_regex;
+  const gchar *dot;
+
+  g_assert (name != NULL);
+
+  /*
+   * Cheap checks first, as projects may contain thousands of JSON files.
+   * Application ids contain at least two components, so "package.json"
+   * and friends never match.
+   */
+  if (!g_str_has_suffix (name, ".json"))
+    return FALSE;
+
+  dot = strchr (name, '.');
+  if (dot == NULL || dot == strrchr (name, '.'))
+    return FALSE;
+
+  if (g_once_init_enter (&filename_regex))
+    {
+      GRegex *regex;
+
+      /* This regex is based on https://wiki.gnome.org/HowDoI/ChooseApplicationID */
+      regex = g_regex_new ("^[[:alnum:]-_]+\\.[[:alnum:]-_]+(\\.[[:alnum:]-_]+)*\\.json$",
+                           G_REGEX_OPTIMIZE, 0, NULL);
+      g_once_init_leave (&filename_regex, regex);
+    }
+
+  return g_regex_match (filename_regex, name, 0, NULL);
+}
+
+static FlatpakManifest *
+flatpak_manifest_parse (GFile *file,
+                        GFile *directory)
+{
+  g_autoptr(JsonParser) parser = NULL;
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *contents = NULL;
+  JsonNode *root_node = NULL;
+  JsonNode *app_id_node = NULL;
+  JsonNode *id_node = NULL;
+  JsonNode *runtime_node = NULL;
+  JsonNode *runtime_version_node = NULL;
+  JsonNode *sdk_node = NULL;
+  JsonNode *modules_node = NULL;
+  JsonObject *root_object = NULL;
+  FlatpakManifest *manifest;
+  gsize len = 0;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE (directory));
+
+  path = g_file_get_path (file);
+
+  if (!g_file_get_contents (path, &contents, &len, NULL))
+    return NULL;
+
+  /* Check if the contents look like a flatpak manifest */
+  parser = json_parser_new ();
+  if (!json_parser_load_from_data (parser, contents, len, NULL))
+    return NULL;
+
+  root_node = json_parser_get_root (parser);
+  if (!JSON_NODE_HOLDS_OBJECT (root_node))
+    return NULL;
+
+  root_object = json_node_get_object (root_node);
+  app_id_node = json_object_get_member (root_object, "app-id");
+  id_node = json_object_get_member (root_object, "id");
+  runtime_node = json_object_get_member (root_object, "runtime");
+  runtime_version_node = json_object_get_member (root_object, "runtime-version");
+  sdk_node = json_object_get_member (root_object, "sdk");
+  modules_node = json_object_get_member (root_object, "modules");
+
+  if (((app_id_node == NULL || !JSON_NODE_HOLDS_VALUE (app_id_node)) && (id_node == NULL || !JSON_NODE_HOLDS_VALUE (id_node))) ||
+      (runtime_node == NULL || !JSON_NODE_HOLDS_VALUE (runtime_node)) ||
+      (sdk_node == NULL || !JSON_NODE_HOLDS_VALUE (sdk_node)) ||
+      (modules_node == NULL || !JSON_NODE_HOLDS_ARRAY (modules_node)))
+    return NULL;
+
+  IDE_TRACE_MSG ("Discovered flatpak manifest at %s", path);
+
+  /* The runtime id contains a hash of the contents, save it while we have them */
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guint8 *)contents, len);
+
+  manifest = g_slice_new0 (FlatpakManifest);
+  manifest->file = g_object_ref (file);
+  manifest->hash = g_strdup (g_checksum_get_string (checksum));
+  manifest->platform = json_node_dup_string (runtime_node);
+  if (runtime_version_node == NULL ||
+      !JSON_NODE_HOLDS_VALUE (runtime_version_node) ||
+      ide_str_empty0 (json_node_get_string (runtime_version_node)))
+    manifest->branch = g_strdup ("master");
+  else
+    manifest->branch = json_node_dup_string (runtime_version_node);
+  manifest->sdk = json_node_dup_string (sdk_node);
+  if (app_id_node != NULL && JSON_NODE_HOLDS_VALUE (app_id_node))
+    manifest->app_id = json_node_dup_string (app_id_node);
+  else
+    manifest->app_id = json_node_dup_string (id_node);
+  manifest->primary_module = guess_primary_module (root_object, directory);
+
+  return manifest;
+}
+
 static GPtrArray *
 gbp_flatpak_runtime_provider_find_flatpak_manifests (GbpFlatpakRuntimeProvider *self,
                                                      GCancellable              *cancellable,
@@ -254,104 +406,96 @@ gbp_flatpak_runtime_provider_find_flatpak_manifests (GbpFlatpakRuntimeProvider *
                                                      GError                   **error)
 {
   g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  GHashTableIter iter;
   GFileInfo *file_info = NULL;
+  const gchar *key;
   GPtrArray *ar;
 
   g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
   g_assert (G_IS_FILE (directory));
 
-  ar = g_ptr_array_new ();
-  g_ptr_array_set_free_func (ar, flatpak_manifest_free);
-
   enumerator = g_file_enumerate_children (directory,
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
                                           G_FILE_QUERY_INFO_NONE,
                                           cancellable,
                                           error);
   if (!enumerator)
     return NULL;
 
+  ar = g_ptr_array_new ();
+  g_ptr_array_set_free_func (ar, flatpak_manifest_free);
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
   while ((file_info = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
     {
-      GFileType file_type;
-      g_autofree gchar *name = NULL;
-      g_autofree gchar *path = NULL;
-      g_autoptr(GRegex) filename_regex = NULL;
-      g_autoptr(GMatchInfo) match_info = NULL;
-      g_autoptr(JsonParser) parser = NULL;
-      JsonNode *root_node = NULL;
-      JsonNode *app_id_node = NULL;
-      JsonNode *id_node = NULL;
-      JsonNode *runtime_node = NULL;
-      JsonNode *runtime_version_node = NULL;
-      JsonNode *sdk_node = NULL;
-      JsonNode *modules_node = NULL;
-      JsonObject *root_object = NULL;
-      g_autoptr(GError) local_error = NULL;
+      g_autoptr(GFileInfo) info = file_info;
       g_autoptr(GFile) file = NULL;
+      g_autofree gchar *path = NULL;
       FlatpakManifest *manifest;
+      ManifestCacheEntry *entry;
+      const gchar *name;
+      guint64 mtime;
+      goffset size;
 
-      file_type = g_file_info_get_file_type (file_info);
-      name = g_strdup (g_file_info_get_name (file_info));
-      g_clear_object (&file_info);
+      name = g_file_info_get_name (info);
 
-      if (name == NULL || file_type == G_FILE_TYPE_DIRECTORY)
+      if (name == NULL ||
+          g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY ||
+          !is_manifest_name (name))
         continue;
 
       file = g_file_get_child (directory, name);
+      if (NULL == (path = g_file_get_path (file)))
+        continue;
 
-      /* This regex is based on https://wiki.gnome.org/HowDoI/ChooseApplicationID */
-      filename_regex = g_regex_new ("^[[:alnum:]-_]+\\.[[:alnum:]-_]+(\\.[[:alnum:]-_]+)*\\.json$",
-                                    0, 0, NULL);
+      mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+              g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+      size = g_file_info_get_size (info);
 
-      g_regex_match (filename_regex, name, 0, &match_info);
-      if (!g_match_info_matches (match_info))
-        continue;
+      g_hash_table_add (seen, g_strdup (path));
 
-      /* Check if the contents look like a flatpak manifest */
-      path = g_file_get_path (file);
-      parser = json_parser_new ();
-      json_parser_load_from_file (parser, path, &local_error);
-      if (local_error != NULL)
-        continue;
+      g_mutex_lock (&self->manifests_mutex);
+      entry = g_hash_table_lookup (self->manifests, path);
+      if (entry != NULL && entry->mtime == mtime && entry->size == size)
+        {
+          if (entry->manifest != NULL)
+            g_ptr_array_add (ar, flatpak_manifest_copy (entry->manifest));
+          g_mutex_unlock (&self->manifests_mutex);
+          continue;
+        }
+      g_mutex_unlock (&self->manifests_mutex);
 
-      root_node = json_parser_get_root (parser);
-      if (!JSON_NODE_HOLDS_OBJECT (root_node))
-        continue;
+      manifest = flatpak_manifest_parse (file, directory);
 
-      root_object = json_node_get_object (root_node);
-      app_id_node = json_object_get_member (root_object, "app-id");
-      id_node = json_object_get_member (root_object, "id");
-      runtime_node = json_object_get_member (root_object, "runtime");
-      runtime_version_node = json_object_get_member (root_object, "runtime-version");
-      sdk_node = json_object_get_member (root_object, "sdk");
-      modules_node = json_object_get_member (root_object, "modules");
-
-      if (((app_id_node == NULL || !JSON_NODE_HOLDS_VALUE (app_id_node)) && (id_node == NULL || !JSON_NODE_HOLDS_VALUE (id_node))) ||
-          (runtime_node == NULL || !JSON_NODE_HOLDS_VALUE (runtime_node)) ||
-          (sdk_node == NULL || !JSON_NODE_HOLDS_VALUE (sdk_node)) ||
-          (modules_node == NULL || !JSON_NODE_HOLDS_ARRAY (modules_node)))
-        continue;
+      if (manifest != NULL)
+        g_ptr_array_add (ar, flatpak_manifest_copy (manifest));
 
-      IDE_TRACE_MSG ("Discovered flatpak manifest at %s", path);
+      entry = g_slice_new0 (ManifestCacheEntry);
+      entry->mtime = mtime;
+      entry->size = size;
+      entry->manifest = manifest;
 
-      manifest = g_slice_new0 (FlatpakManifest);
-      manifest->file = g_steal_pointer (&file);
-      manifest->platform = json_node_dup_string (runtime_node);
-      if (!JSON_NODE_HOLDS_VALUE (runtime_version_node) || ide_str_empty0 (json_node_get_string (runtime_version_node)))
-        manifest->branch = g_strdup ("master");
-      else
-        manifest->branch = json_node_dup_string (runtime_version_node);
-      manifest->sdk = json_node_dup_string (sdk_node);
-      if (app_id_node != NULL && JSON_NODE_HOLDS_VALUE (app_id_node))
-        manifest->app_id = json_node_dup_string (app_id_node);
-      else
-        manifest->app_id = json_node_dup_string (id_node);
-      manifest->primary_module = guess_primary_module (root_object, directory);
+      g_mutex_lock (&self->manifests_mutex);
+      g_hash_table_replace (self->manifests, g_steal_pointer (&path), entry);
+      g_mutex_unlock (&self->manifests_mutex);
+    }
 
-      g_ptr_array_add (ar, manifest);
+  /* Forget about files that were removed */
+  g_mutex_lock (&self->manifests_mutex);
+  g_hash_table_iter_init (&iter, self->manifests);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL))
+    {
+      if (!g_hash_table_contains (seen, key))
+        g_hash_table_iter_remove (&iter);
     }
+  g_mutex_unlock (&self->manifests_mutex);
 
   return ar;
 }
@@ -442,30 +586,11 @@ gbp_flatpak_runtime_provider_load_manifests (GbpFlatpakRuntimeProvider  *self,
     {
       FlatpakManifest *manifest = g_ptr_array_index (ar, i);
       g_autofree gchar *filename = NULL;
-      g_autofree gchar *hash = NULL;
       g_autofree gchar *id = NULL;
-      g_autofree gchar *manifest_data = NULL;
-      g_autofree gchar *path = NULL;
       g_autofree gchar *deploy_dir = NULL;
-      gsize manifest_data_len = 0;
-
-      path = g_file_get_path (manifest->file);
-
-      if (g_file_get_contents (path, &manifest_data, &manifest_data_len, NULL))
-        {
-          g_autoptr(GChecksum) checksum = NULL;
-
-          checksum = g_checksum_new (G_CHECKSUM_SHA1);
-          g_checksum_update (checksum, (const guint8 *)manifest_data, manifest_data_len);
-          hash = g_strdup (g_checksum_get_string (checksum));
-        }
 
       filename = g_file_get_basename (manifest->file);
-
-      if (hash != NULL)
-        id = g_strdup_printf ("%s@%s", filename, hash);
-      else
-        id = g_strdup (filename);
+      id = g_strdup_printf ("%s@%s", filename, manifest->hash);
 
       if (contains_id (runtimes, id))
         continue;
@@ -706,14 +831,30 @@ gbp_flatpak_runtime_provider_unload (IdeRuntimeProvider *provider,
   IDE_EXIT;
 }
 
+static void
+gbp_flatpak_runtime_provider_finalize (GObject *object)
+{
+  GbpFlatpakRuntimeProvider *self = (GbpFlatpakRuntimeProvider *)object;
+
+  g_clear_pointer (&self->manifests, g_hash_table_unref);
+  g_mutex_clear (&self->manifests_mutex);
+
+  G_OBJECT_CLASS (gbp_flatpak_runtime_provider_parent_class)->finalize (object);
+}
+
 static void
 gbp_flatpak_runtime_provider_class_init (GbpFlatpakRuntimeProviderClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_flatpak_runtime_provider_finalize;
 }
 
 static void
 gbp_flatpak_runtime_provider_init (GbpFlatpakRuntimeProvider *self)
 {
+  g_mutex_init (&self->manifests_mutex);
+  self->manifests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, manifest_cache_entry_free);
 }
 
 static void
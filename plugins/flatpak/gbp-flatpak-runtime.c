@@ -97,6 +97,54 @@ gbp_flatpak_runtime_contains_program_in_path (IdeRuntime   *runtime,
   return (subprocess != NULL) && ide_subprocess_wait_check (subprocess, cancellable, NULL);
 }
 
+static gboolean
+gbp_flatpak_runtime_probe_programs (IdeRuntime          *runtime,
+                                    const gchar * const *programs,
+                                    gboolean            *found,
+                                    GCancellable        *cancellable)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autofree gchar *stdout_buf = NULL;
+  g_auto(GStrv) lines = NULL;
+  guint i;
+  guint j;
+
+  g_assert (IDE_IS_RUNTIME (runtime));
+  g_assert (programs != NULL);
+  g_assert (found != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (NULL == (launcher = ide_runtime_create_launcher (runtime, NULL)))
+    return FALSE;
+
+  /* Check all of the programs from a single process within the runtime */
+  ide_subprocess_launcher_push_argv (launcher, "sh");
+  ide_subprocess_launcher_push_argv (launcher, "-c");
+  ide_subprocess_launcher_push_argv (launcher, "for p in \"$@\"; do command -v \"$p\" >/dev/null && echo \"$p\"; done; true");
+  ide_subprocess_launcher_push_argv (launcher, "sh");
+  ide_subprocess_launcher_push_args (launcher, programs);
+
+  if (NULL == (subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, NULL)) ||
+      !ide_subprocess_communicate_utf8 (subprocess, NULL, cancellable, &stdout_buf, NULL, NULL) ||
+      !ide_subprocess_get_if_exited (subprocess) ||
+      ide_subprocess_get_exit_status (subprocess) != 0)
+    return FALSE;
+
+  lines = g_strsplit (stdout_buf, "\n", 0);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      for (j = 0; programs[j] != NULL; j++)
+        {
+          if (g_strcmp0 (lines[i], programs[j]) == 0)
+            found[j] = TRUE;
+        }
+    }
+
+  return TRUE;
+}
+
 /**
  * manifest_has_multiple_modules:
  *
@@ -1157,6 +1205,7 @@ gbp_flatpak_runtime_class_init (GbpFlatpakRuntimeClass *klass)
   runtime_class->create_launcher = gbp_flatpak_runtime_create_launcher;
   runtime_class->create_runner = gbp_flatpak_runtime_create_runner;
   runtime_class->contains_program_in_path = gbp_flatpak_runtime_contains_program_in_path;
+  runtime_class->probe_programs = gbp_flatpak_runtime_probe_programs;
   runtime_class->prepare_configuration = gbp_flatpak_runtime_prepare_configuration;
   runtime_class->translate_file = gbp_flatpak_runtime_translate_file;
 
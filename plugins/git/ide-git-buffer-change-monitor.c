@@ -69,6 +69,7 @@ struct _IdeGitBufferChangeMonitor
 typedef struct
 {
   GgitRepository *repository;
+  IdeGitVcs      *vcs;
   GHashTable     *state;
   GFile          *file;
   GBytes         *content;
@@ -103,6 +104,7 @@ diff_task_free (gpointer data)
       g_clear_object (&diff->file);
       g_clear_object (&diff->blob);
       g_clear_object (&diff->repository);
+      g_clear_object (&diff->vcs);
       g_clear_pointer (&diff->state, g_hash_table_unref);
       g_clear_pointer (&diff->content, g_bytes_unref);
     }
@@ -138,9 +140,11 @@ ide_git_buffer_change_monitor_calculate_async (IdeGitBufferChangeMonitor *self,
                                                gpointer                   user_data)
 {
   g_autoptr(GTask) task = NULL;
+  IdeContext *context;
   DiffTask *diff;
   IdeFile *file;
   GFile *gfile;
+  IdeVcs *vcs;
 
   g_assert (IDE_IS_GIT_BUFFER_CHANGE_MONITOR (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
@@ -170,6 +174,11 @@ ide_git_buffer_change_monitor_calculate_async (IdeGitBufferChangeMonitor *self,
   diff->content = ide_buffer_get_content (self->buffer);
   diff->blob = self->cached_blob ? g_object_ref (self->cached_blob) : NULL;
 
+  context = ide_object_get_context (IDE_OBJECT (self));
+  vcs = ide_context_get_vcs (context);
+  if (IDE_IS_GIT_VCS (vcs))
+    diff->vcs = g_object_ref (vcs);
+
   g_task_set_task_data (task, diff, diff_task_free);
 
   self->in_calculation = TRUE;
@@ -262,6 +271,10 @@ ide_git_buffer_change_monitor_recalculate (IdeGitBufferChangeMonitor *self)
   if (self->in_calculation)
     return;
 
+  /* We will recalculate once the buffer is thawed. */
+  if (self->buffer != NULL && ide_buffer_get_changes_frozen (self->buffer))
+    return;
+
   ide_git_buffer_change_monitor_calculate_async (self,
                                                  NULL,
                                                  ide_git_buffer_change_monitor__calculate_cb,
@@ -401,7 +414,7 @@ ide_git_buffer_change_monitor__buffer_changed_after_cb (IdeGitBufferChangeMonito
 
   self->state_dirty = TRUE;
 
-  if (self->in_calculation)
+  if (self->in_calculation || ide_buffer_get_changes_frozen (buffer))
     IDE_EXIT;
 
   if (self->changed_timeout)
@@ -414,6 +427,26 @@ ide_git_buffer_change_monitor__buffer_changed_after_cb (IdeGitBufferChangeMonito
   IDE_EXIT;
 }
 
+static void
+ide_git_buffer_change_monitor__buffer_notify_changes_frozen_cb (IdeGitBufferChangeMonitor *self,
+                                                                GParamSpec                *pspec,
+                                                                IdeBuffer                 *buffer)
+{
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_GIT_BUFFER_CHANGE_MONITOR (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  /*
+   * Edits made while the buffer was frozen only marked our state as dirty,
+   * so perform a single diff now that the buffer has settled.
+   */
+  if (!ide_buffer_get_changes_frozen (buffer) && self->state_dirty)
+    ide_git_buffer_change_monitor_recalculate (self);
+
+  IDE_EXIT;
+}
+
 static void
 ide_git_buffer_change_monitor_reload (IdeBufferChangeMonitor *monitor)
 {
@@ -582,6 +615,25 @@ ide_git_buffer_change_monitor_calculate_threaded (IdeGitBufferChangeMonitor  *se
 
   diff->is_child_of_workdir = TRUE;
 
+  /*
+   * Files that are new or ignored are not in HEAD. The status snapshot of
+   * the IdeGitVcs lets us skip walking the HEAD tree on every change.
+   */
+  if (!diff->blob && diff->vcs != NULL)
+    {
+      GgitStatusFlags status;
+
+      if (ide_git_vcs_get_file_status (diff->vcs, diff->file, &status, NULL) &&
+          (status & (GGIT_STATUS_INDEX_NEW | GGIT_STATUS_WORKTREE_NEW | GGIT_STATUS_IGNORED)) != 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NOT_FOUND,
+                       _("The requested file does not exist within the git index."));
+          return FALSE;
+        }
+    }
+
   /*
    * Find the blob if necessary. This will be cached by the main thread for us on the way out
    * of the async operation.
@@ -786,6 +838,11 @@ ide_git_buffer_change_monitor_init (IdeGitBufferChangeMonitor *self)
                                    G_CALLBACK (ide_git_buffer_change_monitor__buffer_changed_after_cb),
                                    self,
                                    G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+  egg_signal_group_connect_object (self->signal_group,
+                                   "notify::changes-frozen",
+                                   G_CALLBACK (ide_git_buffer_change_monitor__buffer_notify_changes_frozen_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED);
 
   self->vcs_signal_group = egg_signal_group_new (IDE_TYPE_GIT_VCS);
   egg_signal_group_connect_object (self->vcs_signal_group,
@@ -28,6 +28,26 @@
 
 #define DEFAULT_CHANGED_TIMEOUT_SECS 1
 
+enum {
+  IGNORE_UNKNOWN,
+  IGNORE_YES,
+  IGNORE_NO,
+};
+
+/*
+ * What a change to one of the monitored files in .git or the working
+ * directory invalidates. Only HEAD and refs change what the project tree
+ * and buffer change monitors compare against, so only they cause a reload.
+ */
+enum {
+  MONITOR_RELOAD,
+  MONITOR_STATUS,
+  MONITOR_IGNORE,
+};
+
+/* Set on entries of the status snapshot, so that a zero value is "unknown" */
+#define STATUS_KNOWN (1U << 31)
+
 struct _IdeGitVcs
 {
   IdeObject       parent_instance;
@@ -36,12 +56,33 @@ struct _IdeGitVcs
   GgitRepository *change_monitor_repository;
 
   GFile          *working_directory;
-  GFileMonitor   *monitor;
+  GPtrArray      *monitors;
+
+  /*
+   * Crawlers check every file in the tree from worker threads, so ignored
+   * state is cached by relative path. libgit2 repositories must not be used
+   * from several threads at once, so every use of @repository takes the
+   * mutex, and @repository and the caches are only replaced or cleared on
+   * the main thread with the mutex held. The cache is cleared on reload
+   * and whenever an ignore file changes.
+   */
+  GMutex          repository_mutex;
+  GHashTable     *ignore_cache;
+
+  /*
+   * A snapshot of `git status`, mapping relative paths to GgitStatusFlags
+   * with STATUS_KNOWN set. Paths missing from a loaded snapshot are
+   * unmodified. It is loaded on first use and dropped when the index,
+   * refs or ignore files change. Saving a buffer only marks the entry
+   * for its path as unknown, which is then looked up on its own.
+   */
+  GHashTable     *status_cache;
 
   guint           changed_timeout;
 
   guint           reloading : 1;
   guint           loaded_files : 1;
+  guint           status_loaded : 1;
 };
 
 static void     g_async_initable_init_interface (GAsyncInitableIface  *iface);
@@ -246,6 +287,75 @@ ide_git_vcs_load (IdeGitVcs  *self,
   return repository;
 }
 
+/* Must be called with repository_mutex held */
+static void
+ide_git_vcs_clear_status_locked (IdeGitVcs *self)
+{
+  g_assert (IDE_IS_GIT_VCS (self));
+
+  g_hash_table_remove_all (self->status_cache);
+  self->status_loaded = FALSE;
+}
+
+static void
+ide_git_vcs_clear_status_cache (IdeGitVcs *self)
+{
+  g_assert (IDE_IS_GIT_VCS (self));
+
+  g_mutex_lock (&self->repository_mutex);
+  ide_git_vcs_clear_status_locked (self);
+  g_mutex_unlock (&self->repository_mutex);
+}
+
+static void
+ide_git_vcs_clear_ignore_cache (IdeGitVcs *self)
+{
+  g_assert (IDE_IS_GIT_VCS (self));
+
+  /* The status snapshot contains the ignored files too */
+  g_mutex_lock (&self->repository_mutex);
+  g_hash_table_remove_all (self->ignore_cache);
+  ide_git_vcs_clear_status_locked (self);
+  g_mutex_unlock (&self->repository_mutex);
+}
+
+static void
+ide_git_vcs_buffer_saved_cb (IdeGitVcs        *self,
+                             IdeBuffer        *buffer,
+                             IdeBufferManager *buffer_manager)
+{
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *path = NULL;
+  IdeFile *file;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+
+  if (NULL == (file = ide_buffer_get_file (buffer)))
+    return;
+
+  /* Only the toplevel .gitignore is monitored, this catches nested ones */
+  name = g_file_get_basename (ide_file_get_file (file));
+
+  if (g_strcmp0 (name, ".gitignore") == 0)
+    {
+      ide_git_vcs_clear_ignore_cache (self);
+      return;
+    }
+
+  /* Only the saved file changed, refresh just its status on next use */
+  path = g_file_get_relative_path (self->working_directory, ide_file_get_file (file));
+
+  if (path != NULL)
+    {
+      g_mutex_lock (&self->repository_mutex);
+      if (self->status_loaded)
+        g_hash_table_insert (self->status_cache, g_steal_pointer (&path), NULL);
+      g_mutex_unlock (&self->repository_mutex);
+    }
+}
+
 static void
 handle_reload_from_changed_timeout (GObject      *object,
                                     GAsyncResult *result,
@@ -286,11 +396,33 @@ ide_git_vcs__monitor_changed_cb (IdeGitVcs         *self,
                                  GFile             *file,
                                  GFile             *other_file,
                                  GFileMonitorEvent  event_type,
-                                 gpointer           user_data)
+                                 GFileMonitor      *monitor)
 {
+  guint kind;
+
   IDE_ENTRY;
 
   g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE_MONITOR (monitor));
+
+  kind = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (monitor), "IDE_GIT_VCS_MONITOR_KIND"));
+
+  /*
+   * Staging files or editing ignore rules does not change what the project
+   * tree shows or what buffers are compared against, so only the caches
+   * are dropped rather than reloading and emitting IdeVcs::changed.
+   */
+  if (kind == MONITOR_IGNORE)
+    {
+      ide_git_vcs_clear_ignore_cache (self);
+      IDE_EXIT;
+    }
+  else if (kind == MONITOR_STATUS)
+    {
+      ide_git_vcs_clear_status_cache (self);
+      IDE_EXIT;
+    }
 
   if (self->changed_timeout != 0)
     g_source_remove (self->changed_timeout);
@@ -306,40 +438,81 @@ static gboolean
 ide_git_vcs_load_monitor (IdeGitVcs  *self,
                           GError    **error)
 {
-  gboolean ret = TRUE;
+  g_autoptr(GFile) location = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  static const guint kinds[] = {
+    MONITOR_RELOAD,
+    MONITOR_RELOAD,
+    MONITOR_RELOAD,
+    MONITOR_STATUS,
+    MONITOR_IGNORE,
+    MONITOR_IGNORE,
+  };
+  guint i;
 
   g_assert (IDE_IS_GIT_VCS (self));
 
-  if (self->monitor == NULL)
+  if (self->monitors != NULL)
+    return TRUE;
+
+  g_mutex_lock (&self->repository_mutex);
+  location = ggit_repository_get_location (self->repository);
+  g_mutex_unlock (&self->repository_mutex);
+
+  /*
+   * HEAD changes when switching branches, refs when committing or
+   * fetching, the index when staging. The toplevel ignore files are
+   * watched so the cache of ignored files is not left stale after
+   * editing them. Must match the order of @kinds.
+   */
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_add (files, g_file_get_child (location, "HEAD"));
+  g_ptr_array_add (files, g_file_resolve_relative_path (location, "refs/heads"));
+  g_ptr_array_add (files, g_file_get_child (location, "packed-refs"));
+  g_ptr_array_add (files, g_file_get_child (location, "index"));
+  g_ptr_array_add (files, g_file_resolve_relative_path (location, "info/exclude"));
+  g_ptr_array_add (files, g_file_get_child (self->working_directory, ".gitignore"));
+
+  g_assert (files->len == G_N_ELEMENTS (kinds));
+
+  self->monitors = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < files->len; i++)
     {
-      g_autoptr(GFile) location = NULL;
       g_autoptr(GFileMonitor) monitor = NULL;
-      g_autoptr(GFile) heads_dir = NULL;
       GError *local_error = NULL;
 
-      location = ggit_repository_get_location (self->repository);
-      heads_dir = g_file_get_child (location, "HEAD");
-      monitor = g_file_monitor (heads_dir, 0, NULL, &local_error);
+      monitor = g_file_monitor (g_ptr_array_index (files, i), 0, NULL, &local_error);
 
-      if (monitor == NULL)
+      /* Only HEAD is required, the rest just keep the cache fresh */
+      if (monitor == NULL && i > 0)
         {
-          g_warning ("%s", local_error->message);
-          g_propagate_error (error, local_error);
-          ret = FALSE;
+          g_debug ("%s", local_error->message);
+          g_clear_error (&local_error);
+          continue;
         }
-      else
+      else if (monitor == NULL)
         {
-          IDE_TRACE_MSG ("Git index monitor registered.");
-          g_signal_connect_object (monitor,
-                                   "changed",
-                                   G_CALLBACK (ide_git_vcs__monitor_changed_cb),
-                                   self,
-                                   G_CONNECT_SWAPPED);
-          self->monitor = g_object_ref (monitor);
+          g_warning ("%s", local_error->message);
+          g_propagate_error (error, local_error);
+          g_clear_pointer (&self->monitors, g_ptr_array_unref);
+          return FALSE;
         }
+
+      g_object_set_data (G_OBJECT (monitor),
+                         "IDE_GIT_VCS_MONITOR_KIND",
+                         GUINT_TO_POINTER (kinds [i]));
+      g_signal_connect_object (monitor,
+                               "changed",
+                               G_CALLBACK (ide_git_vcs__monitor_changed_cb),
+                               self,
+                               G_CONNECT_SWAPPED);
+      g_ptr_array_add (self->monitors, g_steal_pointer (&monitor));
     }
 
-  return ret;
+  IDE_TRACE_MSG ("Git index monitor registered.");
+
+  return TRUE;
 }
 
 static void
@@ -351,6 +524,7 @@ ide_git_vcs_reload_worker (GTask        *task,
   IdeGitVcs *self = source_object;
   g_autoptr(GgitRepository) repository1 = NULL;
   g_autoptr(GgitRepository) repository2 = NULL;
+  GPtrArray *repositories;
   GError *error = NULL;
 
   IDE_ENTRY;
@@ -367,16 +541,17 @@ ide_git_vcs_reload_worker (GTask        *task,
       IDE_EXIT;
     }
 
-  g_set_object (&self->repository, repository1);
-  g_set_object (&self->change_monitor_repository, repository2);
+  /*
+   * The repositories are installed by ide_git_vcs_reload_finish() on the
+   * main thread, where the previous ones may still be in use.
+   */
+  repositories = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_add (repositories, g_steal_pointer (&repository1));
+  g_ptr_array_add (repositories, g_steal_pointer (&repository2));
 
-  if (!ide_git_vcs_load_monitor (self, &error))
-    {
-      g_task_return_error (task, error);
-      IDE_EXIT;
-    }
+  g_task_return_pointer (task, repositories, (GDestroyNotify)g_ptr_array_unref);
 
-  g_task_return_boolean (task, TRUE);
+  IDE_EXIT;
 }
 
 static void
@@ -404,6 +579,7 @@ ide_git_vcs_reload_finish (IdeGitVcs     *self,
                            GError       **error)
 {
   GTask *task = (GTask *)result;
+  g_autoptr(GPtrArray) repositories = NULL;
   gboolean ret;
 
   IDE_ENTRY;
@@ -412,7 +588,20 @@ ide_git_vcs_reload_finish (IdeGitVcs     *self,
 
   self->reloading = FALSE;
 
-  ret = g_task_propagate_boolean (task, error);
+  repositories = g_task_propagate_pointer (task, error);
+
+  if (repositories == NULL)
+    IDE_RETURN (FALSE);
+
+  g_mutex_lock (&self->repository_mutex);
+  g_set_object (&self->repository, g_ptr_array_index (repositories, 0));
+  g_hash_table_remove_all (self->ignore_cache);
+  ide_git_vcs_clear_status_locked (self);
+  g_mutex_unlock (&self->repository_mutex);
+
+  g_set_object (&self->change_monitor_repository, g_ptr_array_index (repositories, 1));
+
+  ret = ide_git_vcs_load_monitor (self, error);
 
   if (ret)
     {
@@ -423,6 +612,58 @@ ide_git_vcs_reload_finish (IdeGitVcs     *self,
   IDE_RETURN (ret);
 }
 
+/*
+ * Must be called with repository_mutex held. Files within an ignored directory
+ * are always ignored by git, so the parents are resolved (and cached) first,
+ * which lets everything below an ignored directory skip libgit2 entirely.
+ */
+static gboolean
+ide_git_vcs_path_is_ignored_locked (IdeGitVcs    *self,
+                                    const gchar  *path,
+                                    GError      **error)
+{
+  g_autofree gchar *parent = NULL;
+  GError *local_error = NULL;
+  gboolean ret;
+  guint state;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (path != NULL);
+
+  state = GPOINTER_TO_UINT (g_hash_table_lookup (self->ignore_cache, path));
+  if (state != IGNORE_UNKNOWN)
+    return state == IGNORE_YES;
+
+  if (g_strcmp0 (path, ".git") == 0)
+    return TRUE;
+
+  /* Disposed from the main thread while a crawler was still running */
+  if (self->repository == NULL)
+    return FALSE;
+
+  parent = g_path_get_dirname (path);
+
+  if (g_strcmp0 (parent, ".") != 0 &&
+      ide_git_vcs_path_is_ignored_locked (self, parent, &local_error))
+    ret = TRUE;
+  else if (local_error == NULL)
+    ret = ggit_repository_path_is_ignored (self->repository, path, &local_error);
+  else
+    ret = FALSE;
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, local_error);
+      return FALSE;
+    }
+
+  g_hash_table_insert (self->ignore_cache,
+                       g_strdup (path),
+                       GUINT_TO_POINTER (ret ? IGNORE_YES : IGNORE_NO));
+
+  return ret;
+}
+
 static gboolean
 ide_git_vcs_is_ignored (IdeVcs  *vcs,
                         GFile   *file,
@@ -436,11 +677,166 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
   g_assert (G_IS_FILE (file));
 
   name = g_file_get_relative_path (self->working_directory, file);
-  if (g_strcmp0 (name, ".git") == 0)
-    return TRUE;
 
   if (name != NULL)
-    return ggit_repository_path_is_ignored (self->repository, name, error);
+    {
+      g_mutex_lock (&self->repository_mutex);
+      ret = ide_git_vcs_path_is_ignored_locked (self, name, error);
+      g_mutex_unlock (&self->repository_mutex);
+    }
+
+  return ret;
+}
+
+static gboolean
+ide_git_vcs_is_ignored_many (IdeVcs    *vcs,
+                             GFile    **files,
+                             guint      n_files,
+                             gboolean  *ignored,
+                             GError   **error)
+{
+  IdeGitVcs *self = (IdeGitVcs *)vcs;
+  gboolean ret = TRUE;
+  guint i;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (files != NULL || n_files == 0);
+  g_assert (ignored != NULL || n_files == 0);
+
+  g_mutex_lock (&self->repository_mutex);
+
+  for (i = 0; ret && i < n_files; i++)
+    {
+      g_autofree gchar *name = NULL;
+      GError *local_error = NULL;
+
+      name = g_file_get_relative_path (self->working_directory, files [i]);
+      ignored [i] = FALSE;
+
+      if (name != NULL)
+        {
+          ignored [i] = ide_git_vcs_path_is_ignored_locked (self, name, &local_error);
+
+          if (local_error != NULL)
+            {
+              g_propagate_error (error, local_error);
+              ret = FALSE;
+            }
+        }
+    }
+
+  g_mutex_unlock (&self->repository_mutex);
+
+  return ret;
+}
+
+static gint
+ide_git_vcs_status_foreach_cb (const gchar     *path,
+                               GgitStatusFlags  status,
+                               gpointer         user_data)
+{
+  GHashTable *status_cache = user_data;
+
+  g_hash_table_insert (status_cache,
+                       g_strdup (path),
+                       GUINT_TO_POINTER (status | STATUS_KNOWN));
+
+  return 0;
+}
+
+/**
+ * ide_git_vcs_get_file_status:
+ * @self: An #IdeGitVcs
+ * @file: A #GFile within the working directory
+ * @status: (out): A location for the #GgitStatusFlags of @file
+ * @error: A location for a #GError, or %NULL
+ *
+ * Looks up the status of @file from a snapshot of the repository status,
+ * which is shared by all consumers and only reloaded after the index, refs
+ * or ignore files change. This may be called from any thread, but the first
+ * call after such a change performs a full status scan.
+ *
+ * Returns: %TRUE if successful and @status was set.
+ */
+gboolean
+ide_git_vcs_get_file_status (IdeGitVcs        *self,
+                             GFile            *file,
+                             GgitStatusFlags  *status,
+                             GError          **error)
+{
+  g_autofree gchar *path = NULL;
+  gpointer value = NULL;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (IDE_IS_GIT_VCS (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (status != NULL, FALSE);
+
+  if (NULL == (path = g_file_get_relative_path (self->working_directory, file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_FILENAME,
+                   "File is not within the working directory");
+      return FALSE;
+    }
+
+  g_mutex_lock (&self->repository_mutex);
+
+  if (self->repository == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_CLOSED,
+                   "The repository has been closed");
+      ret = FALSE;
+      goto unlock;
+    }
+
+  if (!self->status_loaded)
+    {
+      if (!ggit_repository_file_status_foreach (self->repository,
+                                                NULL,
+                                                ide_git_vcs_status_foreach_cb,
+                                                self->status_cache,
+                                                error))
+        {
+          g_hash_table_remove_all (self->status_cache);
+          ret = FALSE;
+          goto unlock;
+        }
+
+      self->status_loaded = TRUE;
+    }
+
+  if (!g_hash_table_lookup_extended (self->status_cache, path, NULL, &value))
+    {
+      *status = GGIT_STATUS_CURRENT;
+      goto unlock;
+    }
+
+  if (value == NULL)
+    {
+      GgitStatusFlags flags;
+      GError *local_error = NULL;
+
+      flags = ggit_repository_file_status (self->repository, file, &local_error);
+
+      if (local_error != NULL)
+        {
+          g_propagate_error (error, local_error);
+          ret = FALSE;
+          goto unlock;
+        }
+
+      value = GUINT_TO_POINTER (flags | STATUS_KNOWN);
+      g_hash_table_insert (self->status_cache, g_steal_pointer (&path), value);
+    }
+
+  *status = GPOINTER_TO_UINT (value) & ~STATUS_KNOWN;
+
+unlock:
+  g_mutex_unlock (&self->repository_mutex);
 
   return ret;
 }
@@ -454,7 +850,9 @@ ide_git_vcs_get_branch_name (IdeVcs *vcs)
 
   g_assert (IDE_IS_GIT_VCS (self));
 
+  g_mutex_lock (&self->repository_mutex);
   ref = ggit_repository_get_head (self->repository, NULL);
+  g_mutex_unlock (&self->repository_mutex);
 
   if (ref != NULL)
     {
@@ -493,15 +891,27 @@ ide_git_vcs_dispose (GObject *object)
       self->changed_timeout = 0;
     }
 
-  if (self->monitor)
+  if (self->monitors != NULL)
     {
-      if (!g_file_monitor_is_cancelled (self->monitor))
-        g_file_monitor_cancel (self->monitor);
-      g_clear_object (&self->monitor);
+      guint i;
+
+      for (i = 0; i < self->monitors->len; i++)
+        {
+          GFileMonitor *monitor = g_ptr_array_index (self->monitors, i);
+
+          if (!g_file_monitor_is_cancelled (monitor))
+            g_file_monitor_cancel (monitor);
+        }
+
+      g_clear_pointer (&self->monitors, g_ptr_array_unref);
     }
 
   g_clear_object (&self->change_monitor_repository);
+
+  g_mutex_lock (&self->repository_mutex);
   g_clear_object (&self->repository);
+  g_mutex_unlock (&self->repository_mutex);
+
   g_clear_object (&self->working_directory);
 
   G_OBJECT_CLASS (ide_git_vcs_parent_class)->dispose (object);
@@ -509,6 +919,18 @@ ide_git_vcs_dispose (GObject *object)
   IDE_EXIT;
 }
 
+static void
+ide_git_vcs_finalize (GObject *object)
+{
+  IdeGitVcs *self = (IdeGitVcs *)object;
+
+  g_clear_pointer (&self->ignore_cache, g_hash_table_unref);
+  g_clear_pointer (&self->status_cache, g_hash_table_unref);
+  g_mutex_clear (&self->repository_mutex);
+
+  G_OBJECT_CLASS (ide_git_vcs_parent_class)->finalize (object);
+}
+
 static void
 ide_git_vcs_get_property (GObject    *object,
                           guint       prop_id,
@@ -542,6 +964,7 @@ ide_git_vcs_init_iface (IdeVcsInterface *iface)
   iface->get_working_directory = ide_git_vcs_get_working_directory;
   iface->get_buffer_change_monitor = ide_git_vcs_get_buffer_change_monitor;
   iface->is_ignored = ide_git_vcs_is_ignored;
+  iface->is_ignored_many = ide_git_vcs_is_ignored_many;
   iface->get_config = ide_git_vcs_get_config;
   iface->get_branch_name = ide_git_vcs_get_branch_name;
 }
@@ -552,6 +975,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = ide_git_vcs_dispose;
+  object_class->finalize = ide_git_vcs_finalize;
   object_class->get_property = ide_git_vcs_get_property;
 
   g_object_class_override_property (object_class, PROP_BRANCH_NAME, "branch-name");
@@ -601,6 +1025,9 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
 static void
 ide_git_vcs_init (IdeGitVcs *self)
 {
+  g_mutex_init (&self->repository_mutex);
+  self->ignore_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->status_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 static void
@@ -630,10 +1057,19 @@ ide_git_vcs_init_async (GAsyncInitable      *initable,
 {
   IdeGitVcs *self = (IdeGitVcs *)initable;
   g_autoptr(GTask) task = NULL;
+  IdeContext *context;
 
   g_return_if_fail (IDE_IS_GIT_VCS (self));
 
   task = g_task_new (self, cancellable, callback, user_data);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  g_signal_connect_object (ide_context_get_buffer_manager (context),
+                           "buffer-saved",
+                           G_CALLBACK (ide_git_vcs_buffer_saved_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   ide_git_vcs_reload_async (self,
                             cancellable,
                             ide_git_vcs_init_async__reload_cb,
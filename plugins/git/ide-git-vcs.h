@@ -28,7 +28,11 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (IdeGitVcs, ide_git_vcs, IDE, GIT_VCS, IdeObject)
 
-GgitRepository *ide_git_vcs_get_repository (IdeGitVcs *self);
+GgitRepository *ide_git_vcs_get_repository  (IdeGitVcs        *self);
+gboolean        ide_git_vcs_get_file_status (IdeGitVcs        *self,
+                                             GFile            *file,
+                                             GgitStatusFlags  *status,
+                                             GError          **error);
 
 G_END_DECLS
 
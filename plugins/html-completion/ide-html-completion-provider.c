@@ -459,6 +459,14 @@ ide_html_completion_provider_class_finalize (IdeHtmlCompletionProviderClass *kla
 {
 }
 
+static void
+freeze_attrs_cb (gpointer key,
+                 gpointer value,
+                 gpointer user_data)
+{
+  trie_freeze (value);
+}
+
 static void
 ide_html_completion_provider_class_init (IdeHtmlCompletionProviderClass *klass)
 {
@@ -895,6 +903,11 @@ ide_html_completion_provider_class_init (IdeHtmlCompletionProviderClass *klass)
   ADD_STRING (css_styles, "text-align");
 
 #undef ADD_STRING
+
+  /* The tables are never modified again, compact them for lookups. */
+  trie_freeze (elements);
+  trie_freeze (css_styles);
+  g_hash_table_foreach (element_attrs, freeze_attrs_cb, NULL);
 }
 
 static void
@@ -334,9 +334,6 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
     line_str = None
     line = -1
     line_offset = -1
-    loading_proxy = False
-
-    proxy = None
 
     def do_get_name(self):
         return 'Jedi Provider'
@@ -398,11 +395,11 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
         self.cancellable = cancellable = Gio.Cancellable()
         context.connect('cancelled', lambda *_: cancellable.cancel())
 
-        def async_handler(proxy, result, user_data):
+        def async_handler(app, result, user_data):
             (self, results, context) = user_data
 
             try:
-                variant = proxy.call_finish(result)
+                variant, fd_list = app.call_worker_finish(result)
                 # unwrap outer tuple
                 variant = variant.get_child_value(0)
                 for i in range(variant.n_children()):
@@ -416,25 +413,19 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
                 print(repr(ex))
                 context.add_proposals(self, [], True)
 
-        self.proxy.call('CodeComplete',
-                        GLib.Variant('(siis)', (filename, self.line, self.line_offset, text)),
-                        0, 10000, cancellable, async_handler, (self, results, context))
+        # Send the buffer contents through shared memory so that only the
+        # file descriptor handle is marshalled over D-Bus.
+        fd_list = Gio.UnixFDList.new_from_array([Ide.worker_create_payload(text, -1)])
+
+        app = Gio.Application.get_default()
+        app.call_worker_async('jedi_plugin', 'CodeComplete',
+                              GLib.Variant('(siih)', (filename, self.line, self.line_offset, 0)),
+                              fd_list, cancellable, async_handler, (self, results, context))
 
     def do_match(self, context):
         if not HAS_JEDI:
             return False
 
-        if not self.proxy and not self.loading_proxy:
-            def get_worker_cb(app, result):
-                self.loading_proxy = False
-                self.proxy = app.get_worker_finish(result)
-            self.loading_proxy = True
-            app = Gio.Application.get_default()
-            app.get_worker_async('jedi_plugin', None, get_worker_cb)
-
-        if not self.proxy:
-            return False
-
         if context.get_activation() == GtkSource.CompletionActivation.INTERACTIVE:
             _, iter = context.get_iter()
             iter.backward_char()
@@ -668,8 +659,14 @@ class JediService(Ide.DBusService):
         self.queue = {}
         self.handler_id = 0
 
-    @Ide.DBusMethod('org.gnome.builder.plugins.jedi', in_signature='siis', out_signature='a(issass)', async=True)
-    def CodeComplete(self, invocation, filename, line, column, content):
+    @Ide.DBusMethod('org.gnome.builder.plugins.jedi', in_signature='siih', out_signature='a(issass)', async=True)
+    def CodeComplete(self, invocation, filename, line, column, content_handle):
+        # The buffer contents arrive as a shared-memory payload.
+        fd = invocation.get_message().get_unix_fd_list().get(content_handle)
+        try:
+            content = Ide.worker_read_payload(fd).get_data().decode('utf-8')
+        finally:
+            os.close(fd)
         if filename in self.queue:
             request = self.queue.pop(filename)
             request.cancel()
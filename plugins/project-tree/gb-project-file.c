@@ -17,6 +17,7 @@
  */
 
 #include <glib/gi18n.h>
+#include <string.h>
 
 #include "gb-project-file.h"
 
@@ -26,6 +27,9 @@ struct _GbProjectFile
 
   GFile     *file;
   GFileInfo *file_info;
+
+  /* Lazily computed, sorting large directories compares these a lot */
+  gchar     *collate_key;
 };
 
 G_DEFINE_TYPE (GbProjectFile, gb_project_file, G_TYPE_OBJECT)
@@ -41,25 +45,25 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
-gint
-gb_project_file_compare (GbProjectFile *a,
-                         GbProjectFile *b)
+static const gchar *
+gb_project_file_get_collate_key (GbProjectFile *self)
 {
-  const gchar *display_name_a = g_file_info_get_display_name (a->file_info);
-  const gchar *display_name_b = g_file_info_get_display_name (b->file_info);
-  gchar *casefold_a = NULL;
-  gchar *casefold_b = NULL;
-  gboolean ret;
-
-  casefold_a = g_utf8_collate_key_for_filename (display_name_a, -1);
-  casefold_b = g_utf8_collate_key_for_filename (display_name_b, -1);
+  if (self->collate_key == NULL)
+    {
+      const gchar *display_name = g_file_info_get_display_name (self->file_info);
 
-  ret = strcmp (casefold_a, casefold_b);
+      self->collate_key = g_utf8_collate_key_for_filename (display_name, -1);
+    }
 
-  g_free (casefold_a);
-  g_free (casefold_b);
+  return self->collate_key;
+}
 
-  return ret;
+gint
+gb_project_file_compare (GbProjectFile *a,
+                         GbProjectFile *b)
+{
+  return strcmp (gb_project_file_get_collate_key (a),
+                 gb_project_file_get_collate_key (b));
 }
 
 gint
@@ -87,6 +91,7 @@ gb_project_file_finalize (GObject *object)
 
   g_clear_object (&self->file);
   g_clear_object (&self->file_info);
+  g_clear_pointer (&self->collate_key, g_free);
 
   G_OBJECT_CLASS (gb_project_file_parent_class)->finalize (object);
 }
@@ -238,7 +243,10 @@ gb_project_file_set_file_info (GbProjectFile *self,
   g_return_if_fail (!file_info || G_IS_FILE_INFO (file_info));
 
   if (g_set_object (&self->file_info, file_info))
-    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_FILE_INFO]);
+    {
+      g_clear_pointer (&self->collate_key, g_free);
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_FILE_INFO]);
+    }
 }
 
 gboolean
@@ -23,15 +23,56 @@
 #include "gb-project-tree.h"
 #include "gb-project-tree-builder.h"
 
+#define LISTING_BATCH_SIZE 500
+#define LISTING_ATTRIBUTES \
+  G_FILE_ATTRIBUTE_STANDARD_NAME"," \
+  G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME"," \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE
+
 struct _GbProjectTreeBuilder
 {
   IdeTreeBuilder  parent_instance;
 
   GSettings      *file_chooser_settings;
 
+  /*
+   * GFile of a directory to DirectoryListing. Listings are kept up to date
+   * with a file monitor so that expanding a directory again, or rebuilding
+   * the tree, does not need to enumerate the directory again. They are
+   * released when the directory is collapsed or removed, so that we only
+   * monitor the directories that are visible.
+   */
+  GHashTable     *listings;
+
   guint           sort_directories_first : 1;
 };
 
+typedef struct
+{
+  GWeakRef node;
+  guint    count;
+} ListingWaiter;
+
+typedef struct
+{
+  GbProjectTreeBuilder *self;
+  GFile                *directory;
+  GFileMonitor         *monitor;
+  GCancellable         *cancellable;
+
+  /* Unsorted, nodes are sorted as they are inserted into the tree */
+  GPtrArray            *infos;
+
+  /* Nodes to populate as batches arrive while enumerating */
+  GPtrArray            *waiters;
+
+  /* Files created since enumerating that are not in @infos yet */
+  guint                 n_queries;
+
+  guint                 complete : 1;
+  guint                 dirty : 1;
+} DirectoryListing;
+
 G_DEFINE_TYPE (GbProjectTreeBuilder, gb_project_tree_builder, IDE_TYPE_TREE_BUILDER)
 
 IdeTreeBuilder *
@@ -114,64 +155,282 @@ compare_nodes_func (IdeTreeNode *a,
 }
 
 static void
-build_file (GbProjectTreeBuilder *self,
-            IdeTreeNode          *node)
+listing_waiter_free (gpointer data)
 {
-  g_autoptr(GFileEnumerator) enumerator = NULL;
-  GbProjectFile *project_file;
-  gpointer file_info_ptr;
-  IdeVcs *vcs;
-  GFile *file;
-  IdeTree *tree;
-  gint count = 0;
-  gboolean show_ignored_files;
+  ListingWaiter *waiter = data;
 
-  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
-  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_weak_ref_clear (&waiter->node);
+  g_slice_free (ListingWaiter, waiter);
+}
 
-  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+static void
+directory_listing_free (gpointer data)
+{
+  DirectoryListing *listing = data;
 
-  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
-  show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+  g_cancellable_cancel (listing->cancellable);
 
-  vcs = get_vcs (node);
+  if (listing->monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (listing->monitor, listing);
+      g_file_monitor_cancel (listing->monitor);
+      g_clear_object (&listing->monitor);
+    }
+
+  g_clear_object (&listing->directory);
+  g_clear_object (&listing->cancellable);
+  g_clear_pointer (&listing->infos, g_ptr_array_unref);
+  g_clear_pointer (&listing->waiters, g_ptr_array_unref);
+  g_slice_free (DirectoryListing, listing);
+}
+
+static gint
+directory_listing_find (DirectoryListing *listing,
+                        const gchar      *name)
+{
+  guint i;
+
+  g_assert (listing != NULL);
+  g_assert (name != NULL);
+
+  for (i = 0; i < listing->infos->len; i++)
+    {
+      GFileInfo *file_info = g_ptr_array_index (listing->infos, i);
+
+      if (g_strcmp0 (name, g_file_info_get_name (file_info)) == 0)
+        return i;
+    }
+
+  return -1;
+}
+
+static void
+directory_listing_query_info_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  DirectoryListing *listing = user_data;
+  g_autoptr(GFileInfo) file_info = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_FILE (file));
+
+  file_info = g_file_query_info_finish (file, result, &error);
+
+  /* @listing has been freed, cancelling us */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  listing->n_queries--;
+
+  /* The file might be gone already, in which case there is nothing to add */
+  if (file_info == NULL)
+    return;
+
+  if (directory_listing_find (listing, g_file_info_get_name (file_info)) == -1)
+    g_ptr_array_add (listing->infos, g_steal_pointer (&file_info));
+}
+
+static gboolean
+directory_listing_release_func (gpointer key,
+                                gpointer value,
+                                gpointer user_data)
+{
+  DirectoryListing *listing = value;
+  GFile *directory = user_data;
+
+  if (!g_file_equal (listing->directory, directory) &&
+      !g_file_has_prefix (listing->directory, directory))
+    return FALSE;
 
   /*
-   * TODO: Make this all async.
+   * Nodes that are still being populated would be left half empty if we
+   * cancelled the enumeration, so let it finish and drop the listing then.
    */
+  if (!listing->complete)
+    {
+      listing->dirty = TRUE;
+      return FALSE;
+    }
 
-  if (!gb_project_file_get_is_directory (project_file))
-    return;
+  return TRUE;
+}
 
-  file = gb_project_file_get_file (project_file);
+static gboolean
+directory_listing_invalidate_func (gpointer key,
+                                   gpointer value,
+                                   gpointer user_data)
+{
+  DirectoryListing *listing = value;
+  GFile *directory = user_data;
 
-  enumerator = g_file_enumerate_children (file,
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
-                                          G_FILE_QUERY_INFO_NONE,
-                                          NULL,
-                                          NULL);
+  return g_file_equal (listing->directory, directory) ||
+         g_file_has_prefix (listing->directory, directory);
+}
+
+/*
+ * Drops the listings of @directory and the directories below it, such as
+ * when @directory is collapsed. Listings still being enumerated are dropped
+ * once they complete.
+ */
+static void
+gb_project_tree_builder_release_listings (GbProjectTreeBuilder *self,
+                                          GFile                *directory)
+{
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (G_IS_FILE (directory));
+
+  g_hash_table_foreach_remove (self->listings, directory_listing_release_func, directory);
+}
+
+/*
+ * Like gb_project_tree_builder_release_listings(), but for listings that
+ * must not be used anymore, such as when @directory was removed. Freeing a
+ * listing cancels its in-flight enumeration and queries.
+ */
+static void
+gb_project_tree_builder_invalidate_listings (GbProjectTreeBuilder *self,
+                                             GFile                *directory)
+{
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (G_IS_FILE (directory));
+
+  g_hash_table_foreach_remove (self->listings, directory_listing_invalidate_func, directory);
+}
+
+static void
+directory_listing_changed_cb (GFileMonitor      *monitor,
+                              GFile             *file,
+                              GFile             *other_file,
+                              GFileMonitorEvent  event,
+                              DirectoryListing  *listing)
+{
+  g_autofree gchar *name = NULL;
+  gint position;
 
-  if (enumerator == NULL)
+  g_assert (G_IS_FILE_MONITOR (monitor));
+  g_assert (G_IS_FILE (file));
+  g_assert (listing != NULL);
+
+  if (event != G_FILE_MONITOR_EVENT_CREATED && event != G_FILE_MONITOR_EVENT_DELETED)
     return;
 
-  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+  if (g_file_equal (file, listing->directory))
+    {
+      /* The directory itself is gone, this frees @listing */
+      gb_project_tree_builder_invalidate_listings (listing->self, file);
+      return;
+    }
+
+  /* A removed child directory takes the listings below it along */
+  if (event == G_FILE_MONITOR_EVENT_DELETED)
+    gb_project_tree_builder_invalidate_listings (listing->self, file);
+
+  /*
+   * Applying changes while we are still enumerating could race with the
+   * enumerator, so just remember to drop the listing once it completes.
+   */
+  if (!listing->complete)
     {
-      g_autoptr(GFileInfo) item_file_info = file_info_ptr;
-      g_autoptr(GFile) item_file = NULL;
+      listing->dirty = TRUE;
+      return;
+    }
+
+  if (event == G_FILE_MONITOR_EVENT_DELETED)
+    {
+      name = g_file_get_basename (file);
+      if (-1 != (position = directory_listing_find (listing, name)))
+        g_ptr_array_remove_index_fast (listing->infos, position);
+    }
+  else
+    {
+      listing->n_queries++;
+      g_file_query_info_async (file,
+                               LISTING_ATTRIBUTES,
+                               G_FILE_QUERY_INFO_NONE,
+                               G_PRIORITY_LOW,
+                               listing->cancellable,
+                               directory_listing_query_info_cb,
+                               listing);
+    }
+}
+
+static DirectoryListing *
+directory_listing_new (GbProjectTreeBuilder *self,
+                       GFile                *directory)
+{
+  DirectoryListing *listing;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (G_IS_FILE (directory));
+
+  listing = g_slice_new0 (DirectoryListing);
+  listing->self = self;
+  listing->directory = g_object_ref (directory);
+  listing->cancellable = g_cancellable_new ();
+  listing->infos = g_ptr_array_new_with_free_func (g_object_unref);
+  listing->waiters = g_ptr_array_new_with_free_func (listing_waiter_free);
+  listing->monitor = g_file_monitor_directory (directory, G_FILE_MONITOR_NONE, NULL, NULL);
+
+  /* Without a monitor we could not keep the listing up to date */
+  if (listing->monitor == NULL)
+    listing->dirty = TRUE;
+  else
+    g_signal_connect (listing->monitor,
+                      "changed",
+                      G_CALLBACK (directory_listing_changed_cb),
+                      listing);
+
+  return listing;
+}
+
+static guint
+insert_file_infos (GbProjectTreeBuilder  *self,
+                   IdeTreeNode           *node,
+                   GFile                 *directory,
+                   GFileInfo            **infos,
+                   guint                  n_infos)
+{
+  g_autoptr(GPtrArray) children = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autofree gboolean *ignored = NULL;
+  IdeTree *tree;
+  IdeVcs *vcs;
+  gboolean show_ignored_files;
+  guint i;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (IDE_IS_TREE_NODE (node));
+  g_assert (G_IS_FILE (directory));
+
+  if (n_infos == 0)
+    return 0;
+
+  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
+  show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+
+  vcs = get_vcs (node);
+
+  children = g_ptr_array_new_with_free_func (g_object_unref);
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < n_infos; i++)
+    g_ptr_array_add (files, g_file_get_child (directory, g_file_info_get_name (infos [i])));
+
+  ignored = g_new0 (gboolean, n_infos);
+  ide_vcs_is_ignored_many (vcs, (GFile **)files->pdata, n_infos, ignored, NULL);
+
+  for (i = 0; i < n_infos; i++)
+    {
+      GFileInfo *item_file_info = infos [i];
+      GFile *item_file = g_ptr_array_index (files, i);
       g_autoptr(GbProjectFile) item = NULL;
       IdeTreeNode *child;
-      const gchar *name;
       const gchar *display_name;
       const gchar *icon_name;
-      gboolean ignored;
-
-      name = g_file_info_get_name (item_file_info);
-      item_file = g_file_get_child (file, name);
 
-      ignored = ide_vcs_is_ignored (vcs, item_file, NULL);
-      if (ignored && !show_ignored_files)
+      if (ignored [i] && !show_ignored_files)
         continue;
 
       item = gb_project_file_new (item_file, item_file_info);
@@ -180,35 +439,205 @@ build_file (GbProjectTreeBuilder *self,
       icon_name = gb_project_file_get_icon_name (item);
 
       child = g_object_new (IDE_TYPE_TREE_NODE,
+                            "children-possible", gb_project_file_get_is_directory (item),
                             "icon-name", icon_name,
                             "text", display_name,
                             "item", item,
-                            "use-dim-label", ignored,
+                            "use-dim-label", ignored [i],
                             NULL);
 
-      ide_tree_node_insert_sorted (node, child, compare_nodes_func, self);
+      g_ptr_array_add (children, g_object_ref_sink (child));
+    }
+
+  ide_tree_node_insert_sorted_many (node, children, compare_nodes_func, self);
 
-      if (g_file_info_get_file_type (item_file_info) == G_FILE_TYPE_DIRECTORY)
-        ide_tree_node_set_children_possible (child, TRUE);
+  return children->len;
+}
 
-      count++;
-    }
+static void
+insert_empty (IdeTreeNode *node)
+{
+  IdeTreeNode *child;
+
+  g_assert (IDE_IS_TREE_NODE (node));
 
   /*
    * If we didn't add any children to this node, insert an empty node to
    * notify the user that nothing was found.
    */
-  if (count == 0)
+  child = g_object_new (IDE_TYPE_TREE_NODE,
+                        "icon-name", NULL,
+                        "text", _("Empty"),
+                        "use-dim-label", TRUE,
+                        NULL);
+  ide_tree_node_append (node, child);
+}
+
+static void
+directory_listing_next_files_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  GFileEnumerator *enumerator = (GFileEnumerator *)object;
+  DirectoryListing *listing = user_data;
+  g_autoptr(GError) error = NULL;
+  GbProjectTreeBuilder *self;
+  GList *files;
+  GList *iter;
+  guint begin;
+  guint i;
+
+  g_assert (G_IS_FILE_ENUMERATOR (enumerator));
+
+  files = g_file_enumerator_next_files_finish (enumerator, result, &error);
+
+  /* @listing has been freed, and the builder with it */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     {
-      IdeTreeNode *child;
+      g_object_unref (enumerator);
+      return;
+    }
 
-      child = g_object_new (IDE_TYPE_TREE_NODE,
-                            "icon-name", NULL,
-                            "text", _("Empty"),
-                            "use-dim-label", TRUE,
-                            NULL);
-      ide_tree_node_append (node, child);
+  self = listing->self;
+  begin = listing->infos->len;
+
+  for (iter = files; iter != NULL; iter = iter->next)
+    g_ptr_array_add (listing->infos, iter->data);
+  g_list_free (files);
+
+  for (i = 0; i < listing->waiters->len; i++)
+    {
+      ListingWaiter *waiter = g_ptr_array_index (listing->waiters, i);
+      g_autoptr(IdeTreeNode) node = g_weak_ref_get (&waiter->node);
+      GtkTreeIter tree_iter;
+
+      /* Skip nodes that were removed by a rebuild of the tree */
+      if (node == NULL || !ide_tree_node_get_iter (node, &tree_iter))
+        continue;
+
+      waiter->count += insert_file_infos (self,
+                                          node,
+                                          listing->directory,
+                                          (GFileInfo **)&listing->infos->pdata [begin],
+                                          listing->infos->len - begin);
+
+      if (begin == listing->infos->len && waiter->count == 0)
+        insert_empty (node);
+    }
+
+  if (listing->infos->len > begin)
+    {
+      g_file_enumerator_next_files_async (enumerator,
+                                          LISTING_BATCH_SIZE,
+                                          G_PRIORITY_LOW,
+                                          listing->cancellable,
+                                          directory_listing_next_files_cb,
+                                          listing);
+      return;
+    }
+
+  if (error != NULL)
+    g_warning ("%s", error->message);
+
+  listing->complete = TRUE;
+  g_ptr_array_set_size (listing->waiters, 0);
+  g_object_unref (enumerator);
+
+  if (listing->dirty)
+    g_hash_table_remove (self->listings, listing->directory);
+}
+
+static void
+build_file (GbProjectTreeBuilder *self,
+            IdeTreeNode          *node)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  DirectoryListing *listing;
+  ListingWaiter *waiter;
+  GbProjectFile *project_file;
+  gpointer file_info_ptr;
+  GFile *file;
+  guint count;
+
+  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+
+  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+
+  if (!gb_project_file_get_is_directory (project_file))
+    return;
+
+  file = gb_project_file_get_file (project_file);
+
+  /*
+   * A listing that missed changes, or is still querying files created since
+   * it was enumerated, would build the node without them. Cancel whatever it
+   * is doing and start over.
+   */
+  if (NULL != (listing = g_hash_table_lookup (self->listings, file)) &&
+      (listing->dirty || listing->n_queries > 0))
+    g_hash_table_remove (self->listings, file);
+
+  /*
+   * If we have seen this directory before, everything we need is already in
+   * the listing. Otherwise, the first batch is read synchronously so that
+   * small directories (and ide_tree_find_child_node() on them) behave as if
+   * the node was built immediately. Anything after that is enumerated in
+   * batches in the background, and merged into the tree as it arrives.
+   */
+  if (NULL == (listing = g_hash_table_lookup (self->listings, file)))
+    {
+      listing = directory_listing_new (self, file);
+
+      enumerator = g_file_enumerate_children (file,
+                                              LISTING_ATTRIBUTES,
+                                              G_FILE_QUERY_INFO_NONE,
+                                              NULL,
+                                              NULL);
+
+      if (enumerator == NULL)
+        {
+          directory_listing_free (listing);
+          return;
+        }
+
+      g_hash_table_insert (self->listings, listing->directory, listing);
+
+      while (listing->infos->len < LISTING_BATCH_SIZE &&
+             (file_info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+        g_ptr_array_add (listing->infos, file_info_ptr);
+
+      if (listing->infos->len < LISTING_BATCH_SIZE)
+        listing->complete = TRUE;
+      else
+        g_file_enumerator_next_files_async (g_object_ref (enumerator),
+                                            LISTING_BATCH_SIZE,
+                                            G_PRIORITY_LOW,
+                                            listing->cancellable,
+                                            directory_listing_next_files_cb,
+                                            listing);
     }
+
+  count = insert_file_infos (self,
+                             node,
+                             file,
+                             (GFileInfo **)listing->infos->pdata,
+                             listing->infos->len);
+
+  if (!listing->complete)
+    {
+      waiter = g_slice_new0 (ListingWaiter);
+      g_weak_ref_init (&waiter->node, node);
+      waiter->count = count;
+      g_ptr_array_add (listing->waiters, waiter);
+      return;
+    }
+
+  if (count == 0)
+    insert_empty (node);
+
+  if (listing->dirty)
+    g_hash_table_remove (self->listings, file);
 }
 
 static void
@@ -379,12 +808,70 @@ gb_project_tree_builder_rebuild (GSettings            *settings,
     }
 }
 
+static void
+gb_project_tree_builder_row_collapsed (GbProjectTreeBuilder *self,
+                                       GtkTreeIter          *iter,
+                                       GtkTreePath          *path,
+                                       GtkTreeView          *tree_view)
+{
+  g_autoptr(IdeTreeNode) node = NULL;
+  GObject *item;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  gtk_tree_model_get (gtk_tree_view_get_model (tree_view), iter, 0, &node, -1);
+
+  if (node == NULL)
+    return;
+
+  item = ide_tree_node_get_item (node);
+
+  /*
+   * The children stay in the tree, so expanding the directory again does
+   * not need the listing. It is only needed if the tree is rebuilt, at
+   * which point collapsed directories are not built anyway.
+   */
+  if (GB_IS_PROJECT_FILE (item) && gb_project_file_get_is_directory (GB_PROJECT_FILE (item)))
+    gb_project_tree_builder_release_listings (self, gb_project_file_get_file (GB_PROJECT_FILE (item)));
+}
+
+static void
+gb_project_tree_builder_added (IdeTreeBuilder *builder,
+                               GtkWidget      *tree)
+{
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (builder));
+  g_assert (IDE_IS_TREE (tree));
+
+  g_signal_connect_object (tree,
+                           "row-collapsed",
+                           G_CALLBACK (gb_project_tree_builder_row_collapsed),
+                           builder,
+                           G_CONNECT_SWAPPED);
+}
+
+static void
+gb_project_tree_builder_removed (IdeTreeBuilder *builder,
+                                 GtkWidget      *tree)
+{
+  GbProjectTreeBuilder *self = (GbProjectTreeBuilder *)builder;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (IDE_IS_TREE (tree));
+
+  g_signal_handlers_disconnect_by_func (tree,
+                                        G_CALLBACK (gb_project_tree_builder_row_collapsed),
+                                        self);
+  g_hash_table_remove_all (self->listings);
+}
+
 static void
 gb_project_tree_builder_finalize (GObject *object)
 {
   GbProjectTreeBuilder *self = (GbProjectTreeBuilder *)object;
 
   g_clear_object (&self->file_chooser_settings);
+  g_clear_pointer (&self->listings, g_hash_table_unref);
 
   G_OBJECT_CLASS (gb_project_tree_builder_parent_class)->finalize (object);
 }
@@ -397,6 +884,8 @@ gb_project_tree_builder_class_init (GbProjectTreeBuilderClass *klass)
 
   object_class->finalize = gb_project_tree_builder_finalize;
 
+  tree_builder_class->added = gb_project_tree_builder_added;
+  tree_builder_class->removed = gb_project_tree_builder_removed;
   tree_builder_class->build_node = gb_project_tree_builder_build_node;
   tree_builder_class->node_activated = gb_project_tree_builder_node_activated;
   tree_builder_class->node_popup = gb_project_tree_builder_node_popup;
@@ -405,6 +894,11 @@ gb_project_tree_builder_class_init (GbProjectTreeBuilderClass *klass)
 static void
 gb_project_tree_builder_init (GbProjectTreeBuilder *self)
 {
+  self->listings = g_hash_table_new_full (g_file_hash,
+                                          (GEqualFunc)g_file_equal,
+                                          NULL,
+                                          directory_listing_free);
+
   self->file_chooser_settings = g_settings_new ("org.gtk.Settings.FileChooser");
   self->sort_directories_first = g_settings_get_boolean (self->file_chooser_settings,
                                                          "sort-directories-first");
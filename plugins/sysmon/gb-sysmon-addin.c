@@ -30,6 +30,95 @@ struct _GbSysmonAddin
   GtkWidget   *panel;
 };
 
+static GPid
+parse_pid (const gchar *identifier)
+{
+  gint64 pid;
+
+  if (identifier == NULL)
+    return 0;
+
+  pid = g_ascii_strtoll (identifier, NULL, 10);
+
+  return (pid > 0 && pid <= G_MAXINT) ? (GPid)pid : 0;
+}
+
+static void
+gb_sysmon_addin_build_spawned (GbSysmonAddin  *self,
+                               const gchar    *identifier,
+                               IdeBuildResult *build_result)
+{
+  g_autofree gchar *mode = NULL;
+  g_autofree gchar *title = NULL;
+  GPid pid;
+
+  g_assert (GB_IS_SYSMON_ADDIN (self));
+  g_assert (IDE_IS_BUILD_RESULT (build_result));
+
+  if (self->panel == NULL || !(pid = parse_pid (identifier)))
+    return;
+
+  mode = ide_build_result_get_mode (build_result);
+  /* translators: %s is the current build step */
+  title = g_strdup_printf (_("Build: %s"), mode ? mode : "");
+
+  gb_sysmon_panel_monitor_process (GB_SYSMON_PANEL (self->panel), title, pid);
+}
+
+static void
+gb_sysmon_addin_build_started (GbSysmonAddin   *self,
+                               IdeBuildResult  *build_result,
+                               IdeBuildManager *build_manager)
+{
+  g_assert (GB_IS_SYSMON_ADDIN (self));
+  g_assert (IDE_IS_BUILD_RESULT (build_result));
+  g_assert (IDE_IS_BUILD_MANAGER (build_manager));
+
+  g_signal_connect_object (build_result,
+                           "spawned",
+                           G_CALLBACK (gb_sysmon_addin_build_spawned),
+                           self,
+                           G_CONNECT_SWAPPED);
+}
+
+static void
+gb_sysmon_addin_runner_spawned (GbSysmonAddin *self,
+                                const gchar   *identifier,
+                                IdeRunner     *runner)
+{
+  g_auto(GStrv) argv = NULL;
+  g_autofree gchar *title = NULL;
+  GPid pid;
+
+  g_assert (GB_IS_SYSMON_ADDIN (self));
+  g_assert (IDE_IS_RUNNER (runner));
+
+  if (self->panel == NULL || !(pid = parse_pid (identifier)))
+    return;
+
+  argv = ide_runner_get_argv (runner);
+  /* translators: %s is the program being run */
+  title = g_strdup_printf (_("Run: %s"), (argv && argv [0]) ? argv [0] : "");
+
+  gb_sysmon_panel_monitor_process (GB_SYSMON_PANEL (self->panel), title, pid);
+}
+
+static void
+gb_sysmon_addin_run (GbSysmonAddin *self,
+                     IdeRunner     *runner,
+                     IdeRunManager *run_manager)
+{
+  g_assert (GB_IS_SYSMON_ADDIN (self));
+  g_assert (IDE_IS_RUNNER (runner));
+  g_assert (IDE_IS_RUN_MANAGER (run_manager));
+
+  g_signal_connect_object (runner,
+                           "spawned",
+                           G_CALLBACK (gb_sysmon_addin_runner_spawned),
+                           self,
+                           G_CONNECT_SWAPPED);
+}
+
 static void workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (GbSysmonAddin, gb_sysmon_addin, G_TYPE_OBJECT, 0,
@@ -42,12 +131,15 @@ gb_sysmon_addin_load (IdeWorkbenchAddin *addin,
 {
   GbSysmonAddin *self = (GbSysmonAddin *)addin;
   IdePerspective *editor;
+  IdeContext *context;
   GtkWidget *pane;
   GtkWidget *panel;
 
   g_assert (GB_IS_SYSMON_ADDIN (self));
   g_assert (IDE_IS_WORKBENCH (workbench));
 
+  context = ide_workbench_get_context (workbench);
+
   editor = ide_workbench_get_perspective_by_name (workbench, "editor");
 
   g_assert (editor != NULL);
@@ -60,6 +152,21 @@ gb_sysmon_addin_load (IdeWorkbenchAddin *addin,
                         NULL);
   ide_set_weak_pointer (&self->panel, panel);
   gtk_container_add (GTK_CONTAINER (pane), GTK_WIDGET (panel));
+
+  /*
+   * Sample the process trees of builds and runs so that their cost can be
+   * reviewed from the panel. The handlers are tied to our lifetime.
+   */
+  g_signal_connect_object (ide_context_get_build_manager (context),
+                           "build-started",
+                           G_CALLBACK (gb_sysmon_addin_build_started),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (ide_context_get_run_manager (context),
+                           "run",
+                           G_CALLBACK (gb_sysmon_addin_run),
+                           self,
+                           G_CONNECT_SWAPPED);
 }
 
 static void
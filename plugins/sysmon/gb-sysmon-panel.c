@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <glib/gi18n.h>
 #include <realtime-graphs.h>
 
 #include "gb-sysmon-panel.h"
@@ -23,11 +24,82 @@
 struct _GbSysmonPanel
 {
   PnlDockWidget  parent_instance;
+
   RgCpuGraph    *cpu_graph;
+  GtkBox        *process_box;
+  RgGraph       *process_graph;
+  GtkLabel      *process_peaks;
+  GtkLabel      *process_title;
 };
 
 G_DEFINE_TYPE (GbSysmonPanel, gb_sysmon_panel, PNL_TYPE_DOCK_WIDGET)
 
+static void
+gb_sysmon_panel_update_peaks (GbSysmonPanel  *self,
+                              GParamSpec     *pspec,
+                              RgProcessTable *table)
+{
+  g_autofree gchar *rss = NULL;
+  g_autofree gchar *text = NULL;
+
+  g_assert (GB_IS_SYSMON_PANEL (self));
+  g_assert (RG_IS_PROCESS_TABLE (table));
+
+  /* Ignore tables that have been replaced by a newer process */
+  if (rg_graph_get_table (self->process_graph) != RG_TABLE (table))
+    return;
+
+  rss = g_format_size ((guint64)rg_process_table_get_peak_rss (table));
+  /* translators: the first value is CPU usage in percent, the second is a memory size */
+  text = g_strdup_printf (_("Peak CPU %.0f%% · Peak memory %s"),
+                          rg_process_table_get_peak_cpu (table),
+                          rss);
+  gtk_label_set_label (self->process_peaks, text);
+}
+
+/**
+ * gb_sysmon_panel_monitor_process:
+ * @self: A #GbSysmonPanel
+ * @title: the title to display above the graph
+ * @pid: the process to monitor along with its children
+ *
+ * Starts graphing the resource usage of @pid and its descendants. The
+ * samples of the previous process are kept until a new one is monitored
+ * so that peaks can be reviewed after a build or run has completed.
+ */
+void
+gb_sysmon_panel_monitor_process (GbSysmonPanel *self,
+                                 const gchar   *title,
+                                 GPid           pid)
+{
+  g_autoptr(RgTable) table = NULL;
+
+  g_return_if_fail (GB_IS_SYSMON_PANEL (self));
+  g_return_if_fail (pid > 0);
+
+  table = g_object_new (RG_TYPE_PROCESS_TABLE,
+                        "pid", pid,
+                        "timespan", G_GINT64_CONSTANT (30000000),
+                        "max-samples", 61,
+                        NULL);
+
+  g_signal_connect_object (table,
+                           "notify::peak-cpu",
+                           G_CALLBACK (gb_sysmon_panel_update_peaks),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (table,
+                           "notify::peak-rss",
+                           G_CALLBACK (gb_sysmon_panel_update_peaks),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  rg_graph_set_table (self->process_graph, table);
+  gtk_label_set_label (self->process_title, title);
+  gtk_label_set_label (self->process_peaks, NULL);
+  gtk_widget_show (GTK_WIDGET (self->process_box));
+}
+
 static void
 gb_sysmon_panel_finalize (GObject *object)
 {
@@ -44,12 +116,25 @@ gb_sysmon_panel_class_init (GbSysmonPanelClass *klass)
 
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/builder/plugins/sysmon/gb-sysmon-panel.ui");
   gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, cpu_graph);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, process_box);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, process_graph);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, process_peaks);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, process_title);
 
   g_type_ensure (RG_TYPE_CPU_GRAPH);
+  g_type_ensure (RG_TYPE_GRAPH);
 }
 
 static void
 gb_sysmon_panel_init (GbSysmonPanel *self)
 {
+  g_autoptr(RgRenderer) renderer = NULL;
+
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  renderer = g_object_new (RG_TYPE_LINE_RENDERER,
+                           "column", RG_PROCESS_TABLE_COLUMN_CPU,
+                           "stroke-color", "#3465a4",
+                           NULL);
+  rg_graph_add_renderer (self->process_graph, renderer);
 }
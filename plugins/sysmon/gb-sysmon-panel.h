@@ -27,6 +27,10 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GbSysmonPanel, gb_sysmon_panel, GB, SYSMON_PANEL, PnlDockWidget)
 
+void gb_sysmon_panel_monitor_process (GbSysmonPanel *self,
+                                      const gchar   *title,
+                                      GPid           pid);
+
 G_END_DECLS
 
 #endif /* GB_SYSMON_PANEL_H */
@@ -0,0 +1,715 @@
+/* gbp-todo-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-todo-index"
+
+#include <egg-counter.h>
+#include <string.h>
+
+#include "gbp-todo-index.h"
+#include "gbp-todo-item.h"
+#include "gbp-todo-scanner.h"
+
+/*
+ * GbpTodoIndex keeps the todo items for every file we have scanned, keyed by
+ * path and modification time. When mining a directory, files whose mtime has
+ * not changed are served from the index and only the remainder is read and
+ * scanned. The index is persisted to the user cache directory so that the
+ * next session starts warm.
+ *
+ * Crawling the tree happens on the indexer thread pool. Scanning is fanned
+ * out in batches onto the compiler thread pool, and whichever batch finishes
+ * last completes the task.
+ */
+
+#define FILES_PER_BATCH 32
+#define INDEX_VERSION   1
+#define INDEX_TYPE      "(ua{s(xa(us))})"
+
+struct _GbpTodoIndex
+{
+  GObject         parent_instance;
+
+  GMutex          mutex;
+  GFile          *storage;
+  GbpTodoScanner *scanner;
+  GHashTable     *entries;
+
+  guint           loaded : 1;
+  guint           dirty : 1;
+};
+
+typedef struct
+{
+  gint64    mtime;
+  GVariant *items;
+} IndexEntry;
+
+typedef struct
+{
+  GFile  *file;
+  gchar  *path;
+  gint64  mtime;
+} ScanFile;
+
+typedef struct
+{
+  IdeVcs        *vcs;
+  GFile         *file;
+  GPtrArray     *to_scan;
+  GPtrArray     *results;
+  GMutex         mutex;
+  volatile gint  n_active;
+} Mine;
+
+typedef struct
+{
+  GTask *task;
+  guint  begin;
+  guint  end;
+} MineBatch;
+
+G_DEFINE_TYPE (GbpTodoIndex, gbp_todo_index, G_TYPE_OBJECT)
+
+EGG_DEFINE_COUNTER (files_scanned, "Todo", "Files Scanned", "Number of files scanned for todo items")
+EGG_DEFINE_COUNTER (files_cached, "Todo", "Files Cached", "Number of files served from the todo index")
+
+static const gchar *keywords[] = { "FIXME:", "XXX:", "TODO:", NULL };
+
+static void
+index_entry_free (gpointer data)
+{
+  IndexEntry *entry = data;
+
+  g_clear_pointer (&entry->items, g_variant_unref);
+  g_slice_free (IndexEntry, entry);
+}
+
+static void
+scan_file_free (gpointer data)
+{
+  ScanFile *sf = data;
+
+  g_clear_object (&sf->file);
+  g_clear_pointer (&sf->path, g_free);
+  g_slice_free (ScanFile, sf);
+}
+
+static void
+mine_free (gpointer data)
+{
+  Mine *mine = data;
+
+  g_clear_object (&mine->vcs);
+  g_clear_object (&mine->file);
+  g_clear_pointer (&mine->to_scan, g_ptr_array_unref);
+  g_clear_pointer (&mine->results, g_ptr_array_unref);
+  g_mutex_clear (&mine->mutex);
+  g_slice_free (Mine, mine);
+}
+
+static gboolean
+should_skip (const gchar *name)
+{
+  /* Ignore libtool/autoconf macros and translations */
+  return g_str_has_suffix (name, ".m4") || g_str_has_suffix (name, ".po");
+}
+
+static void
+gbp_todo_index_finalize (GObject *object)
+{
+  GbpTodoIndex *self = (GbpTodoIndex *)object;
+
+  g_clear_object (&self->storage);
+  g_clear_pointer (&self->scanner, gbp_todo_scanner_unref);
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (gbp_todo_index_parent_class)->finalize (object);
+}
+
+static void
+gbp_todo_index_class_init (GbpTodoIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_todo_index_finalize;
+}
+
+static void
+gbp_todo_index_init (GbpTodoIndex *self)
+{
+  g_mutex_init (&self->mutex);
+  self->scanner = gbp_todo_scanner_new (keywords);
+  self->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, index_entry_free);
+}
+
+/**
+ * gbp_todo_index_new:
+ * @storage: the file to persist the index to
+ *
+ * Returns: (transfer full): A #GbpTodoIndex.
+ */
+GbpTodoIndex *
+gbp_todo_index_new (GFile *storage)
+{
+  GbpTodoIndex *self;
+
+  g_return_val_if_fail (G_IS_FILE (storage), NULL);
+
+  self = g_object_new (GBP_TYPE_TODO_INDEX, NULL);
+  self->storage = g_object_ref (storage);
+
+  return self;
+}
+
+static void
+gbp_todo_index_load_locked (GbpTodoIndex *self)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GVariant) files = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree gchar *path = NULL;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *items;
+  gint64 mtime;
+  guint version = 0;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  self->loaded = TRUE;
+
+  if (!(path = g_file_get_path (self->storage)) ||
+      !(mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (INDEX_TYPE), bytes, FALSE));
+
+  g_variant_get (variant, "(u@a{s(xa(us))})", &version, &files);
+
+  if (version != INDEX_VERSION)
+    return;
+
+  g_variant_iter_init (&iter, files);
+
+  while (g_variant_iter_next (&iter, "{&s(x@a(us))}", &key, &mtime, &items))
+    {
+      IndexEntry *entry;
+
+      /* The item arrays keep the mapped file alive until they are replaced */
+      entry = g_slice_new0 (IndexEntry);
+      entry->mtime = mtime;
+      entry->items = items;
+
+      g_hash_table_insert (self->entries, g_strdup (key), entry);
+    }
+}
+
+static GVariant *
+gbp_todo_index_serialize_locked (GbpTodoIndex *self)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(xa(us))}"));
+
+  g_hash_table_iter_init (&iter, self->entries);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      const gchar *path = key;
+      IndexEntry *entry = value;
+
+      g_variant_builder_add (&builder, "{s(x@a(us))}", path, entry->mtime, entry->items);
+    }
+
+  return g_variant_ref_sink (g_variant_new ("(ua{s(xa(us))})", INDEX_VERSION, &builder));
+}
+
+static void
+gbp_todo_index_save (GbpTodoIndex *self)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *dir = NULL;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  g_mutex_lock (&self->mutex);
+  if (self->dirty)
+    variant = gbp_todo_index_serialize_locked (self);
+  self->dirty = FALSE;
+  g_mutex_unlock (&self->mutex);
+
+  if (variant == NULL || !(path = g_file_get_path (self->storage)))
+    return;
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0750);
+
+  if (!g_file_set_contents (path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_warning ("Failed to save todo index: %s", error->message);
+}
+
+static gboolean
+gbp_todo_index_lookup (GbpTodoIndex *self,
+                       GFile        *file,
+                       const gchar  *path,
+                       gint64        mtime,
+                       GPtrArray    *results)
+{
+  g_autoptr(GVariant) items = NULL;
+  IndexEntry *entry;
+  GVariantIter iter;
+  const gchar *message;
+  guint lineno;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (path != NULL);
+  g_assert (results != NULL);
+
+  g_mutex_lock (&self->mutex);
+  if ((entry = g_hash_table_lookup (self->entries, path)) && entry->mtime == mtime)
+    items = g_variant_ref (entry->items);
+  g_mutex_unlock (&self->mutex);
+
+  if (items == NULL)
+    return FALSE;
+
+  g_variant_iter_init (&iter, items);
+
+  while (g_variant_iter_next (&iter, "(u&s)", &lineno, &message))
+    g_ptr_array_add (results, gbp_todo_item_new (file, lineno, message));
+
+  EGG_COUNTER_INC (files_cached);
+
+  return TRUE;
+}
+
+static void
+gbp_todo_index_insert (GbpTodoIndex *self,
+                       const gchar  *path,
+                       gint64        mtime,
+                       GPtrArray    *items)
+{
+  GVariantBuilder builder;
+  IndexEntry *entry;
+  guint i;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (path != NULL);
+  g_assert (items != NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(us)"));
+
+  for (i = 0; i < items->len; i++)
+    {
+      GbpTodoItem *item = g_ptr_array_index (items, i);
+
+      g_variant_builder_add (&builder, "(us)",
+                             gbp_todo_item_get_lineno (item),
+                             gbp_todo_item_get_message (item));
+    }
+
+  entry = g_slice_new0 (IndexEntry);
+  entry->mtime = mtime;
+  entry->items = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_insert (self->entries, g_strdup (path), entry);
+  self->dirty = TRUE;
+  g_mutex_unlock (&self->mutex);
+}
+
+static void
+gbp_todo_index_prune (GbpTodoIndex *self,
+                      const gchar  *directory,
+                      GHashTable   *seen)
+{
+  g_autofree gchar *prefix = NULL;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (directory != NULL);
+  g_assert (seen != NULL);
+
+  prefix = g_strconcat (directory, G_DIR_SEPARATOR_S, NULL);
+
+  g_mutex_lock (&self->mutex);
+
+  g_hash_table_iter_init (&iter, self->entries);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (g_str_has_prefix (key, prefix) && !g_hash_table_contains (seen, key))
+        {
+          g_hash_table_iter_remove (&iter);
+          self->dirty = TRUE;
+        }
+    }
+
+  g_mutex_unlock (&self->mutex);
+}
+
+static gint64
+get_mtime (GFileInfo *file_info)
+{
+  return g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+         g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static void
+gbp_todo_index_add_file (GbpTodoIndex *self,
+                         Mine         *mine,
+                         GFile        *file,
+                         GFileInfo    *file_info,
+                         GHashTable   *seen)
+{
+  ScanFile *sf;
+  gchar *path;
+  gint64 mtime;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (mine != NULL);
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE_INFO (file_info));
+
+  if (should_skip (g_file_info_get_name (file_info)) ||
+      !(path = g_file_get_path (file)))
+    return;
+
+  mtime = get_mtime (file_info);
+
+  if (seen != NULL)
+    g_hash_table_add (seen, g_strdup (path));
+
+  if (gbp_todo_index_lookup (self, file, path, mtime, mine->results))
+    {
+      g_free (path);
+      return;
+    }
+
+  sf = g_slice_new0 (ScanFile);
+  sf->file = g_object_ref (file);
+  sf->path = path;
+  sf->mtime = mtime;
+
+  g_ptr_array_add (mine->to_scan, sf);
+}
+
+static void
+gbp_todo_index_crawl (GbpTodoIndex *self,
+                      Mine         *mine,
+                      GFile        *directory,
+                      GHashTable   *seen,
+                      GCancellable *cancellable)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) infos = NULL;
+  g_autofree gboolean *ignored = NULL;
+  gpointer file_info_ptr;
+  guint i;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (mine != NULL);
+  g_assert (G_IS_FILE (directory));
+
+  if (ide_vcs_is_ignored (mine->vcs, directory, NULL))
+    return;
+
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  children = g_ptr_array_new_with_free_func (g_object_unref);
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+  infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) file_info = file_info_ptr;
+      g_autoptr(GFile) file = NULL;
+
+      file = g_file_get_child (directory, g_file_info_get_name (file_info));
+
+      switch (g_file_info_get_file_type (file_info))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+          g_ptr_array_add (children, g_steal_pointer (&file));
+          break;
+
+        case G_FILE_TYPE_REGULAR:
+          g_ptr_array_add (files, g_steal_pointer (&file));
+          g_ptr_array_add (infos, g_steal_pointer (&file_info));
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  ignored = g_new0 (gboolean, files->len);
+
+  if (ide_vcs_is_ignored_many (mine->vcs, (GFile **)files->pdata, files->len, ignored, NULL))
+    {
+      for (i = 0; i < files->len; i++)
+        {
+          if (!ignored [i])
+            gbp_todo_index_add_file (self,
+                                     mine,
+                                     g_ptr_array_index (files, i),
+                                     g_ptr_array_index (infos, i),
+                                     seen);
+        }
+    }
+
+  for (i = 0; i < children->len; i++)
+    gbp_todo_index_crawl (self, mine, g_ptr_array_index (children, i), seen, cancellable);
+}
+
+static void
+gbp_todo_index_complete (GTask *task)
+{
+  GbpTodoIndex *self;
+  Mine *mine;
+
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  mine = g_task_get_task_data (task);
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (mine != NULL);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  gbp_todo_index_save (self);
+
+  g_task_return_pointer (task,
+                         g_ptr_array_ref (mine->results),
+                         (GDestroyNotify)g_ptr_array_unref);
+}
+
+static void
+gbp_todo_index_scan_batch (gpointer data)
+{
+  MineBatch *batch = data;
+  GCancellable *cancellable;
+  GbpTodoIndex *self;
+  Mine *mine;
+  guint i;
+
+  g_assert (batch != NULL);
+  g_assert (G_IS_TASK (batch->task));
+
+  self = g_task_get_source_object (batch->task);
+  mine = g_task_get_task_data (batch->task);
+  cancellable = g_task_get_cancellable (batch->task);
+
+  for (i = batch->begin; i < batch->end; i++)
+    {
+      ScanFile *sf = g_ptr_array_index (mine->to_scan, i);
+      g_autoptr(GMappedFile) mapped = NULL;
+      g_autoptr(GPtrArray) items = NULL;
+      guint j;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        break;
+
+      if (!(mapped = g_mapped_file_new (sf->path, FALSE, NULL)))
+        continue;
+
+      items = gbp_todo_scanner_scan (self->scanner,
+                                     sf->file,
+                                     g_mapped_file_get_contents (mapped),
+                                     g_mapped_file_get_length (mapped));
+
+      EGG_COUNTER_INC (files_scanned);
+
+      gbp_todo_index_insert (self, sf->path, sf->mtime, items);
+
+      g_mutex_lock (&mine->mutex);
+      for (j = 0; j < items->len; j++)
+        g_ptr_array_add (mine->results, g_object_ref (g_ptr_array_index (items, j)));
+      g_mutex_unlock (&mine->mutex);
+    }
+
+  if (g_atomic_int_dec_and_test (&mine->n_active))
+    gbp_todo_index_complete (batch->task);
+
+  g_object_unref (batch->task);
+  g_slice_free (MineBatch, batch);
+}
+
+static void
+gbp_todo_index_mine_worker (GTask        *task,
+                            gpointer      source_object,
+                            gpointer      task_data,
+                            GCancellable *cancellable)
+{
+  GbpTodoIndex *self = source_object;
+  g_autoptr(GFileInfo) file_info = NULL;
+  g_autoptr(GError) error = NULL;
+  Mine *mine = task_data;
+  guint n_batches;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (mine != NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (!self->loaded)
+    gbp_todo_index_load_locked (self);
+  g_mutex_unlock (&self->mutex);
+
+  file_info = g_file_query_info (mine->file,
+                                 G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                 G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 cancellable,
+                                 &error);
+
+  if (file_info == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY)
+    {
+      g_autoptr(GHashTable) seen = NULL;
+      g_autofree gchar *path = NULL;
+
+      seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      gbp_todo_index_crawl (self, mine, mine->file, seen, cancellable);
+
+      if (!g_cancellable_is_cancelled (cancellable) &&
+          (path = g_file_get_path (mine->file)))
+        gbp_todo_index_prune (self, path, seen);
+    }
+  else
+    {
+      gbp_todo_index_add_file (self, mine, mine->file, file_info, NULL);
+    }
+
+  if (mine->to_scan->len == 0)
+    {
+      gbp_todo_index_complete (task);
+      return;
+    }
+
+  n_batches = (mine->to_scan->len + FILES_PER_BATCH - 1) / FILES_PER_BATCH;
+  mine->n_active = n_batches;
+
+  for (i = 0; i < n_batches; i++)
+    {
+      MineBatch *batch;
+
+      batch = g_slice_new0 (MineBatch);
+      batch->task = g_object_ref (task);
+      batch->begin = i * FILES_PER_BATCH;
+      batch->end = MIN (batch->begin + FILES_PER_BATCH, mine->to_scan->len);
+
+      ide_thread_pool_push (IDE_THREAD_POOL_COMPILER, gbp_todo_index_scan_batch, batch);
+    }
+}
+
+/**
+ * gbp_todo_index_mine_async:
+ * @self: A #GbpTodoIndex
+ * @vcs: the #IdeVcs used to skip ignored files
+ * @file: a file or directory to mine
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: the callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Mines @file for todo items. If @file is a directory, it is crawled
+ * recursively and files that have not changed since they were last scanned
+ * are served from the index.
+ */
+void
+gbp_todo_index_mine_async (GbpTodoIndex        *self,
+                           IdeVcs              *vcs,
+                           GFile               *file,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  Mine *mine;
+
+  g_return_if_fail (GBP_IS_TODO_INDEX (self));
+  g_return_if_fail (IDE_IS_VCS (vcs));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  mine = g_slice_new0 (Mine);
+  mine->vcs = g_object_ref (vcs);
+  mine->file = g_object_ref (file);
+  mine->to_scan = g_ptr_array_new_with_free_func (scan_file_free);
+  mine->results = g_ptr_array_new_with_free_func (g_object_unref);
+  g_mutex_init (&mine->mutex);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gbp_todo_index_mine_async);
+  g_task_set_task_data (task, mine, mine_free);
+
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, gbp_todo_index_mine_worker);
+}
+
+/**
+ * gbp_todo_index_mine_finish:
+ *
+ * Returns: (transfer full) (element-type GbpTodoItem): An array of items.
+ */
+GPtrArray *
+gbp_todo_index_mine_finish (GbpTodoIndex  *self,
+                            GAsyncResult  *result,
+                            GError       **error)
+{
+  g_return_val_if_fail (GBP_IS_TODO_INDEX (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,43 @@
+/* gbp-todo-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_TODO_INDEX_H
+#define GBP_TODO_INDEX_H
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_TODO_INDEX (gbp_todo_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpTodoIndex, gbp_todo_index, GBP, TODO_INDEX, GObject)
+
+GbpTodoIndex *gbp_todo_index_new         (GFile                *storage);
+void          gbp_todo_index_mine_async  (GbpTodoIndex         *self,
+                                          IdeVcs               *vcs,
+                                          GFile                *file,
+                                          GCancellable         *cancellable,
+                                          GAsyncReadyCallback   callback,
+                                          gpointer              user_data);
+GPtrArray    *gbp_todo_index_mine_finish (GbpTodoIndex         *self,
+                                          GAsyncResult         *result,
+                                          GError              **error);
+
+G_END_DECLS
+
+#endif /* GBP_TODO_INDEX_H */
@@ -0,0 +1,135 @@
+/* gbp-todo-item.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-todo-item"
+
+#include <string.h>
+
+#include "gbp-todo-item.h"
+
+struct _GbpTodoItem
+{
+  GObject  parent_instance;
+  GFile   *file;
+  gchar   *message;
+  guint    lineno;
+};
+
+G_DEFINE_TYPE (GbpTodoItem, gbp_todo_item, G_TYPE_OBJECT)
+
+static void
+gbp_todo_item_finalize (GObject *object)
+{
+  GbpTodoItem *self = (GbpTodoItem *)object;
+
+  g_clear_object (&self->file);
+  g_clear_pointer (&self->message, g_free);
+
+  G_OBJECT_CLASS (gbp_todo_item_parent_class)->finalize (object);
+}
+
+static void
+gbp_todo_item_class_init (GbpTodoItemClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_todo_item_finalize;
+}
+
+static void
+gbp_todo_item_init (GbpTodoItem *self)
+{
+}
+
+/**
+ * gbp_todo_item_new:
+ * @file: the #GFile containing the item
+ * @lineno: the 1-based line number of the keyword
+ * @message: the line containing the keyword followed by its context lines
+ *
+ * Creates a new todo item. This is safe to call from a worker thread, which
+ * is where the scanner creates them.
+ *
+ * Returns: (transfer full): A #GbpTodoItem.
+ */
+GbpTodoItem *
+gbp_todo_item_new (GFile       *file,
+                   guint        lineno,
+                   const gchar *message)
+{
+  GbpTodoItem *self;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (message != NULL, NULL);
+
+  self = g_object_new (GBP_TYPE_TODO_ITEM, NULL);
+  self->file = g_object_ref (file);
+  self->lineno = lineno;
+  self->message = g_strdup (message);
+
+  return self;
+}
+
+/**
+ * gbp_todo_item_get_file:
+ *
+ * Returns: (transfer none): A #GFile.
+ */
+GFile *
+gbp_todo_item_get_file (GbpTodoItem *self)
+{
+  g_return_val_if_fail (GBP_IS_TODO_ITEM (self), NULL);
+
+  return self->file;
+}
+
+guint
+gbp_todo_item_get_lineno (GbpTodoItem *self)
+{
+  g_return_val_if_fail (GBP_IS_TODO_ITEM (self), 0);
+
+  return self->lineno;
+}
+
+const gchar *
+gbp_todo_item_get_message (GbpTodoItem *self)
+{
+  g_return_val_if_fail (GBP_IS_TODO_ITEM (self), NULL);
+
+  return self->message;
+}
+
+/**
+ * gbp_todo_item_get_shortdesc:
+ *
+ * Gets the first line of the message, stripped of surrounding whitespace.
+ *
+ * Returns: (transfer full): A newly allocated string.
+ */
+gchar *
+gbp_todo_item_get_shortdesc (GbpTodoItem *self)
+{
+  const gchar *endptr;
+
+  g_return_val_if_fail (GBP_IS_TODO_ITEM (self), NULL);
+
+  if (!(endptr = strchr (self->message, '\n')))
+    endptr = self->message + strlen (self->message);
+
+  return g_strstrip (g_strndup (self->message, endptr - self->message));
+}
@@ -0,0 +1,381 @@
+/* gbp-todo-panel.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-todo-panel"
+
+#include <glib/gi18n.h>
+
+#include "gbp-todo-item.h"
+#include "gbp-todo-panel.h"
+
+struct _GbpTodoPanel
+{
+  PnlDockWidget  parent_instance;
+
+  GFile         *workdir;
+  GtkListStore  *model;
+  GtkTreeView   *tree_view;
+};
+
+enum {
+  PROP_0,
+  PROP_WORKDIR,
+  N_PROPS
+};
+
+G_DEFINE_TYPE (GbpTodoPanel, gbp_todo_panel, PNL_TYPE_DOCK_WIDGET)
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+gbp_todo_panel_file_data_func (GtkCellLayout   *layout,
+                               GtkCellRenderer *cell,
+                               GtkTreeModel    *model,
+                               GtkTreeIter     *iter,
+                               gpointer         user_data)
+{
+  GbpTodoPanel *self = user_data;
+  g_autoptr(GbpTodoItem) item = NULL;
+  g_autofree gchar *relpath = NULL;
+  g_autofree gchar *text = NULL;
+  GFile *file;
+
+  gtk_tree_model_get (model, iter, 0, &item, -1);
+
+  if (item == NULL)
+    return;
+
+  file = gbp_todo_item_get_file (item);
+
+  if (self->workdir == NULL || !(relpath = g_file_get_relative_path (self->workdir, file)))
+    relpath = g_file_get_path (file);
+
+  text = g_strdup_printf ("%s:%u", relpath, gbp_todo_item_get_lineno (item));
+  g_object_set (cell, "text", text, NULL);
+}
+
+static void
+gbp_todo_panel_message_data_func (GtkCellLayout   *layout,
+                                  GtkCellRenderer *cell,
+                                  GtkTreeModel    *model,
+                                  GtkTreeIter     *iter,
+                                  gpointer         user_data)
+{
+  g_autoptr(GbpTodoItem) item = NULL;
+  g_autofree gchar *shortdesc = NULL;
+
+  gtk_tree_model_get (model, iter, 0, &item, -1);
+
+  if (item != NULL)
+    shortdesc = gbp_todo_item_get_shortdesc (item);
+
+  g_object_set (cell, "text", shortdesc, NULL);
+}
+
+static gboolean
+gbp_todo_panel_query_tooltip (GbpTodoPanel *self,
+                              gint          x,
+                              gint          y,
+                              gboolean      keyboard_mode,
+                              GtkTooltip   *tooltip,
+                              GtkTreeView  *tree_view)
+{
+  g_autoptr(GtkTreePath) path = NULL;
+  g_autoptr(GbpTodoItem) item = NULL;
+  g_autofree gchar *escaped = NULL;
+  g_autofree gchar *markup = NULL;
+  GtkTreeIter iter;
+
+  g_assert (GBP_IS_TODO_PANEL (self));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  gtk_tree_view_convert_widget_to_bin_window_coords (tree_view, x, y, &x, &y);
+
+  if (!gtk_tree_view_get_path_at_pos (tree_view, x, y, &path, NULL, NULL, NULL) ||
+      !gtk_tree_model_get_iter (GTK_TREE_MODEL (self->model), &iter, path))
+    return FALSE;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (self->model), &iter, 0, &item, -1);
+
+  if (item == NULL)
+    return FALSE;
+
+  escaped = g_markup_escape_text (gbp_todo_item_get_message (item), -1);
+  markup = g_strdup_printf ("<tt>%s</tt>", escaped);
+  gtk_tooltip_set_markup (tooltip, markup);
+
+  return TRUE;
+}
+
+static void
+gbp_todo_panel_row_activated (GbpTodoPanel      *self,
+                              GtkTreePath       *path,
+                              GtkTreeViewColumn *column,
+                              GtkTreeView       *tree_view)
+{
+  g_autoptr(GbpTodoItem) item = NULL;
+  g_autoptr(IdeUri) uri = NULL;
+  g_autofree gchar *fragment = NULL;
+  GtkWidget *workbench;
+  GtkTreeIter iter;
+
+  g_assert (GBP_IS_TODO_PANEL (self));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (self->model), &iter, path))
+    return;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (self->model), &iter, 0, &item, -1);
+
+  if (item == NULL)
+    return;
+
+  uri = ide_uri_new_from_file (gbp_todo_item_get_file (item));
+  fragment = g_strdup_printf ("L%u", MAX (1, gbp_todo_item_get_lineno (item) - 1));
+  ide_uri_set_fragment (uri, fragment);
+
+  workbench = gtk_widget_get_ancestor (GTK_WIDGET (self), IDE_TYPE_WORKBENCH);
+  ide_workbench_open_uri_async (IDE_WORKBENCH (workbench), uri, "editor", 0, NULL, NULL, NULL);
+}
+
+static void
+gbp_todo_panel_finalize (GObject *object)
+{
+  GbpTodoPanel *self = (GbpTodoPanel *)object;
+
+  g_clear_object (&self->workdir);
+  g_clear_object (&self->model);
+
+  G_OBJECT_CLASS (gbp_todo_panel_parent_class)->finalize (object);
+}
+
+static void
+gbp_todo_panel_get_property (GObject    *object,
+                             guint       prop_id,
+                             GValue     *value,
+                             GParamSpec *pspec)
+{
+  GbpTodoPanel *self = GBP_TODO_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_WORKDIR:
+      g_value_set_object (value, self->workdir);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_todo_panel_set_property (GObject      *object,
+                             guint         prop_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  GbpTodoPanel *self = GBP_TODO_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_WORKDIR:
+      self->workdir = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_todo_panel_class_init (GbpTodoPanelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_todo_panel_finalize;
+  object_class->get_property = gbp_todo_panel_get_property;
+  object_class->set_property = gbp_todo_panel_set_property;
+
+  properties [PROP_WORKDIR] =
+    g_param_spec_object ("workdir",
+                         "Workdir",
+                         "The working directory used to shorten file names",
+                         G_TYPE_FILE,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+gbp_todo_panel_init (GbpTodoPanel *self)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *cell;
+  GtkWidget *scroller;
+
+  self->model = gtk_list_store_new (1, GBP_TYPE_TODO_ITEM);
+
+  g_object_set (self,
+                "title", _("Todo"),
+                "expand", TRUE,
+                NULL);
+
+  scroller = g_object_new (GTK_TYPE_SCROLLED_WINDOW,
+                           "visible", TRUE,
+                           NULL);
+  gtk_container_add (GTK_CONTAINER (self), scroller);
+
+  self->tree_view = g_object_new (GTK_TYPE_TREE_VIEW,
+                                  "has-tooltip", TRUE,
+                                  "fixed-height-mode", TRUE,
+                                  "model", self->model,
+                                  "visible", TRUE,
+                                  NULL);
+  g_signal_connect_object (self->tree_view,
+                           "query-tooltip",
+                           G_CALLBACK (gbp_todo_panel_query_tooltip),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->tree_view,
+                           "row-activated",
+                           G_CALLBACK (gbp_todo_panel_row_activated),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (scroller), GTK_WIDGET (self->tree_view));
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "sizing", GTK_TREE_VIEW_COLUMN_FIXED,
+                         "resizable", TRUE,
+                         "title", _("File"),
+                         "fixed-width", 300,
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       "ellipsize", PANGO_ELLIPSIZE_START,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_todo_panel_file_data_func,
+                                      self, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "sizing", GTK_TREE_VIEW_COLUMN_FIXED,
+                         "expand", TRUE,
+                         "title", _("Message"),
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       "ellipsize", PANGO_ELLIPSIZE_END,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_todo_panel_message_data_func,
+                                      NULL, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+}
+
+/**
+ * gbp_todo_panel_add_items:
+ * @self: A #GbpTodoPanel
+ * @items: (element-type GbpTodoItem): the items to add
+ * @prepend: if the items should be placed at the top of the list
+ *
+ * Adds @items to the panel. When @prepend is %TRUE, the items are placed at
+ * the top of the list and the first of them is selected so that recently
+ * saved files can be navigated to quickly.
+ */
+void
+gbp_todo_panel_add_items (GbpTodoPanel *self,
+                          GPtrArray    *items,
+                          gboolean      prepend)
+{
+  GtkTreeIter iter;
+  guint i;
+
+  g_return_if_fail (GBP_IS_TODO_PANEL (self));
+  g_return_if_fail (items != NULL);
+
+  if (items->len == 0)
+    return;
+
+  /* Detach the model so the tree view does not process every insertion */
+  g_object_ref (self->model);
+  gtk_tree_view_set_model (self->tree_view, NULL);
+
+  if (prepend)
+    {
+      for (i = items->len; i > 0; i--)
+        gtk_list_store_insert_with_values (self->model, &iter, 0,
+                                           0, g_ptr_array_index (items, i - 1),
+                                           -1);
+    }
+  else
+    {
+      for (i = 0; i < items->len; i++)
+        gtk_list_store_insert_with_values (self->model, &iter, -1,
+                                           0, g_ptr_array_index (items, i),
+                                           -1);
+    }
+
+  gtk_tree_view_set_model (self->tree_view, GTK_TREE_MODEL (self->model));
+  g_object_unref (self->model);
+
+  if (prepend && gtk_tree_model_get_iter_first (GTK_TREE_MODEL (self->model), &iter))
+    {
+      g_autoptr(GtkTreePath) path = NULL;
+
+      gtk_tree_selection_select_iter (gtk_tree_view_get_selection (self->tree_view), &iter);
+      path = gtk_tree_model_get_path (GTK_TREE_MODEL (self->model), &iter);
+      gtk_tree_view_scroll_to_cell (self->tree_view, path, NULL, TRUE, 0.0, 0.0);
+    }
+}
+
+void
+gbp_todo_panel_clear_file (GbpTodoPanel *self,
+                           GFile        *file)
+{
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+
+  g_return_if_fail (GBP_IS_TODO_PANEL (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  model = GTK_TREE_MODEL (self->model);
+
+  if (!gtk_tree_model_get_iter_first (model, &iter))
+    return;
+
+  for (;;)
+    {
+      g_autoptr(GbpTodoItem) item = NULL;
+
+      gtk_tree_model_get (model, &iter, 0, &item, -1);
+
+      if (item != NULL && g_file_equal (file, gbp_todo_item_get_file (item)))
+        {
+          /* Advances @iter, or returns FALSE if it was the last row */
+          if (!gtk_list_store_remove (self->model, &iter))
+            break;
+          continue;
+        }
+
+      if (!gtk_tree_model_iter_next (model, &iter))
+        break;
+    }
+}
@@ -0,0 +1,297 @@
+/* gbp-todo-scanner.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-todo-scanner"
+
+#include <string.h>
+
+#include "gbp-todo-item.h"
+#include "gbp-todo-scanner.h"
+
+/*
+ * The scanner is a multi-pattern Aho-Corasick matcher compiled into a dense
+ * DFA. Every state has a full row of 256 transitions so the inner loop is a
+ * single table lookup per byte with no failure-link chasing and no branches
+ * other than the accepting check. Newlines are never part of a keyword, so
+ * line numbers are only computed (with memchr(), which is vectorized by the
+ * C library) when a match is found.
+ *
+ * Once created, a scanner is immutable and may be shared between threads.
+ */
+
+#define N_CONTEXT_LINES   5
+#define MAX_LINE_LENGTH   1024
+#define BINARY_PROBE_SIZE 8000
+
+struct _GbpTodoScanner
+{
+  volatile gint  ref_count;
+  guint          n_states;
+  guint16       *transitions;
+  guint8        *accepting;
+};
+
+GbpTodoScanner *
+gbp_todo_scanner_new (const gchar * const *keywords)
+{
+  GbpTodoScanner *self;
+  g_autofree guint16 *fail = NULL;
+  g_autofree guint16 *queue = NULL;
+  guint max_states = 1;
+  guint head = 0;
+  guint tail = 0;
+  guint i;
+
+  g_return_val_if_fail (keywords != NULL, NULL);
+
+  for (i = 0; keywords [i] != NULL; i++)
+    max_states += strlen (keywords [i]);
+
+  g_return_val_if_fail (max_states <= G_MAXUINT16, NULL);
+
+  self = g_slice_new0 (GbpTodoScanner);
+  self->ref_count = 1;
+  self->n_states = 1;
+  self->transitions = g_new0 (guint16, max_states * 256);
+  self->accepting = g_new0 (guint8, max_states);
+
+  /*
+   * Build the keyword trie. State 0 is the root and can never be the target
+   * of a trie edge, so a zero transition means "no child" until the row is
+   * completed below.
+   */
+  for (i = 0; keywords [i] != NULL; i++)
+    {
+      const guint8 *p = (const guint8 *)keywords [i];
+      guint state = 0;
+
+      g_return_val_if_fail (*p != '\0', self);
+
+      for (; *p; p++)
+        {
+          guint16 *next = &self->transitions [(state << 8) | *p];
+
+          if (*next == 0)
+            *next = self->n_states++;
+          state = *next;
+        }
+
+      self->accepting [state] = TRUE;
+    }
+
+  /*
+   * Compute failure links breadth first and fill in the missing transitions
+   * from the failure state, whose row is already complete since it is
+   * shallower than the state being processed.
+   */
+  fail = g_new0 (guint16, self->n_states);
+  queue = g_new0 (guint16, self->n_states);
+
+  queue [tail++] = 0;
+
+  while (head < tail)
+    {
+      guint state = queue [head++];
+      guint16 *row = &self->transitions [state << 8];
+
+      for (i = 0; i < 256; i++)
+        {
+          if (row [i] != 0)
+            {
+              guint child = row [i];
+
+              fail [child] = state == 0 ? 0 : self->transitions [(fail [state] << 8) | i];
+              self->accepting [child] |= self->accepting [fail [child]];
+              queue [tail++] = child;
+            }
+          else if (state != 0)
+            {
+              row [i] = self->transitions [(fail [state] << 8) | i];
+            }
+        }
+    }
+
+  return self;
+}
+
+GbpTodoScanner *
+gbp_todo_scanner_ref (GbpTodoScanner *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gbp_todo_scanner_unref (GbpTodoScanner *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      g_free (self->transitions);
+      g_free (self->accepting);
+      g_slice_free (GbpTodoScanner, self);
+    }
+}
+
+static guint
+count_lines (const gchar *begin,
+             const gchar *end)
+{
+  guint count = 0;
+
+  while (begin < end && (begin = memchr (begin, '\n', end - begin)))
+    {
+      count++;
+      begin++;
+    }
+
+  return count;
+}
+
+static const gchar *
+find_line_end (const gchar *begin,
+               const gchar *end)
+{
+  const gchar *eol;
+
+  if ((eol = memchr (begin, '\n', end - begin)))
+    return eol;
+
+  return end;
+}
+
+static void
+append_line (GString     *str,
+             const gchar *line,
+             gsize        len)
+{
+  const gchar *valid_end = NULL;
+
+  if (len > 0 && line [len - 1] == '\r')
+    len--;
+
+  /* Truncate at the first invalid byte rather than dropping the line */
+  g_utf8_validate (line, len, &valid_end);
+
+  if (str->len > 0)
+    g_string_append_c (str, '\n');
+  g_string_append_len (str, line, valid_end - line);
+}
+
+/**
+ * gbp_todo_scanner_scan:
+ * @self: A #GbpTodoScanner
+ * @file: the #GFile that @data was read from
+ * @data: the contents of @file
+ * @length: the length of @data in bytes
+ *
+ * Scans @data for keywords. Like `grep -I`, files that look binary (a NUL
+ * byte within the first few kilobytes) are skipped, as are overly long lines
+ * such as those found in minified or generated files.
+ *
+ * Returns: (transfer full) (element-type GbpTodoItem): An array of items.
+ */
+GPtrArray *
+gbp_todo_scanner_scan (GbpTodoScanner *self,
+                       GFile          *file,
+                       const gchar    *data,
+                       gsize           length)
+{
+  const guint16 *transitions;
+  const guint8 *accepting;
+  const gchar *counted = data;
+  const gchar *end = data + length;
+  const gchar *p;
+  GPtrArray *ret;
+  guint lineno = 1;
+  guint state = 0;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (data != NULL || length == 0, NULL);
+
+  ret = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (length == 0 || memchr (data, '\0', MIN (length, BINARY_PROBE_SIZE)) != NULL)
+    return ret;
+
+  transitions = self->transitions;
+  accepting = self->accepting;
+
+  for (p = data; p < end; p++)
+    {
+      const gchar *line_begin;
+      const gchar *line_end;
+
+      state = transitions [(state << 8) | (guint8)*p];
+
+      if G_LIKELY (!accepting [state])
+        continue;
+
+      state = 0;
+
+      for (line_begin = p; line_begin > data && line_begin [-1] != '\n'; line_begin--)
+        {
+          if (p - line_begin > MAX_LINE_LENGTH)
+            break;
+        }
+
+      line_end = find_line_end (p, end);
+
+      lineno += count_lines (counted, line_begin);
+      counted = line_begin;
+
+      if (line_end - line_begin <= MAX_LINE_LENGTH)
+        {
+          g_autoptr(GString) message = g_string_new (NULL);
+          const gchar *iter = line_end < end ? line_end + 1 : end;
+          guint i;
+
+          append_line (message, line_begin, line_end - line_begin);
+
+          for (i = 0; i < N_CONTEXT_LINES && iter < end; i++)
+            {
+              const gchar *eol = find_line_end (iter, end);
+
+              if (eol - iter <= MAX_LINE_LENGTH)
+                append_line (message, iter, eol - iter);
+
+              if (eol == end)
+                break;
+
+              iter = eol + 1;
+            }
+
+          g_ptr_array_add (ret, gbp_todo_item_new (file, lineno, message->str));
+        }
+
+      /* Continue after this line, any keyword within it is the same item */
+      if (line_end == end)
+        break;
+
+      p = line_end;
+    }
+
+  return ret;
+}
@@ -0,0 +1,40 @@
+/* gbp-todo-scanner.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_TODO_SCANNER_H
+#define GBP_TODO_SCANNER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GbpTodoScanner GbpTodoScanner;
+
+GbpTodoScanner *gbp_todo_scanner_new   (const gchar * const *keywords);
+GbpTodoScanner *gbp_todo_scanner_ref   (GbpTodoScanner      *self);
+void            gbp_todo_scanner_unref (GbpTodoScanner      *self);
+GPtrArray      *gbp_todo_scanner_scan  (GbpTodoScanner      *self,
+                                        GFile               *file,
+                                        const gchar         *data,
+                                        gsize                length);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GbpTodoScanner, gbp_todo_scanner_unref)
+
+G_END_DECLS
+
+#endif /* GBP_TODO_SCANNER_H */
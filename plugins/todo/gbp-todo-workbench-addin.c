@@ -0,0 +1,239 @@
+/* gbp-todo-workbench-addin.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-todo-workbench-addin"
+
+#include <ide.h>
+
+#include "gbp-todo-index.h"
+#include "gbp-todo-panel.h"
+#include "gbp-todo-workbench-addin.h"
+
+struct _GbpTodoWorkbenchAddin
+{
+  GObject        parent_instance;
+
+  GbpTodoPanel  *panel;
+  GbpTodoIndex  *index;
+  IdeVcs        *vcs;
+  GCancellable  *cancellable;
+  gulong         buffer_saved_handler;
+};
+
+typedef struct
+{
+  GbpTodoWorkbenchAddin *self;
+  GFile                 *file;
+  guint                  prepend : 1;
+} MineState;
+
+static void workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (GbpTodoWorkbenchAddin, gbp_todo_workbench_addin, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (IDE_TYPE_WORKBENCH_ADDIN, workbench_addin_iface_init))
+
+static void
+mine_state_free (MineState *state)
+{
+  g_clear_object (&state->self);
+  g_clear_object (&state->file);
+  g_slice_free (MineState, state);
+}
+
+static void
+gbp_todo_workbench_addin_mine_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  GbpTodoIndex *index = (GbpTodoIndex *)object;
+  MineState *state = user_data;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (GBP_IS_TODO_INDEX (index));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (state != NULL);
+
+  items = gbp_todo_index_mine_finish (index, result, &error);
+
+  if (items == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        g_warning ("%s", error->message);
+      goto cleanup;
+    }
+
+  if (state->self->panel == NULL)
+    goto cleanup;
+
+  if (state->prepend)
+    gbp_todo_panel_clear_file (state->self->panel, state->file);
+
+  gbp_todo_panel_add_items (state->self->panel, items, state->prepend);
+
+cleanup:
+  mine_state_free (state);
+}
+
+static void
+gbp_todo_workbench_addin_mine (GbpTodoWorkbenchAddin *self,
+                               GFile                 *file,
+                               gboolean               prepend)
+{
+  MineState *state;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (G_IS_FILE (file));
+
+  state = g_slice_new0 (MineState);
+  state->self = g_object_ref (self);
+  state->file = g_object_ref (file);
+  state->prepend = !!prepend;
+
+  gbp_todo_index_mine_async (self->index,
+                             self->vcs,
+                             file,
+                             self->cancellable,
+                             gbp_todo_workbench_addin_mine_cb,
+                             state);
+}
+
+static void
+gbp_todo_workbench_addin_buffer_saved (GbpTodoWorkbenchAddin *self,
+                                       IdeBuffer             *buffer,
+                                       IdeBufferManager      *buffer_manager)
+{
+  IdeFile *file;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+
+  /*
+   * We place just updated files at the top so they can be navigated to
+   * quickly. Existing items for the file are removed when the results
+   * arrive so the panel does not flicker while the file is rescanned.
+   */
+  if ((file = ide_buffer_get_file (buffer)))
+    gbp_todo_workbench_addin_mine (self, ide_file_get_file (file), TRUE);
+}
+
+static void
+gbp_todo_workbench_addin_load (IdeWorkbenchAddin *addin,
+                               IdeWorkbench      *workbench)
+{
+  GbpTodoWorkbenchAddin *self = (GbpTodoWorkbenchAddin *)addin;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *path = NULL;
+  g_autoptr(GFile) storage = NULL;
+  IdeBufferManager *buffer_manager;
+  IdePerspective *editor;
+  IdeContext *context;
+  IdeProject *project;
+  GtkWidget *pane;
+  GFile *workdir;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  context = ide_workbench_get_context (workbench);
+  project = ide_context_get_project (context);
+  buffer_manager = ide_context_get_buffer_manager (context);
+  self->vcs = g_object_ref (ide_context_get_vcs (context));
+  workdir = ide_vcs_get_working_directory (self->vcs);
+
+  name = g_strconcat (ide_project_get_id (project), ".todo", NULL);
+  path = g_build_filename (g_get_user_cache_dir (),
+                           ide_get_program_name (),
+                           "todo",
+                           name,
+                           NULL);
+  storage = g_file_new_for_path (path);
+
+  self->cancellable = g_cancellable_new ();
+  self->index = gbp_todo_index_new (storage);
+
+  editor = ide_workbench_get_perspective_by_name (workbench, "editor");
+  pane = pnl_dock_bin_get_bottom_edge (PNL_DOCK_BIN (editor));
+  self->panel = g_object_new (GBP_TYPE_TODO_PANEL,
+                              "workdir", workdir,
+                              "visible", TRUE,
+                              NULL);
+  g_signal_connect (self->panel,
+                    "destroy",
+                    G_CALLBACK (gtk_widget_destroyed),
+                    &self->panel);
+  gtk_container_add (GTK_CONTAINER (pane), GTK_WIDGET (self->panel));
+
+  self->buffer_saved_handler =
+    g_signal_connect_object (buffer_manager,
+                             "buffer-saved",
+                             G_CALLBACK (gbp_todo_workbench_addin_buffer_saved),
+                             self,
+                             G_CONNECT_SWAPPED);
+
+  gbp_todo_workbench_addin_mine (self, workdir, FALSE);
+}
+
+static void
+gbp_todo_workbench_addin_unload (IdeWorkbenchAddin *addin,
+                                 IdeWorkbench      *workbench)
+{
+  GbpTodoWorkbenchAddin *self = (GbpTodoWorkbenchAddin *)addin;
+  IdeBufferManager *buffer_manager;
+  IdeContext *context;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  context = ide_workbench_get_context (workbench);
+  buffer_manager = ide_context_get_buffer_manager (context);
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  if (self->buffer_saved_handler != 0)
+    {
+      g_signal_handler_disconnect (buffer_manager, self->buffer_saved_handler);
+      self->buffer_saved_handler = 0;
+    }
+
+  if (self->panel != NULL)
+    gtk_widget_destroy (GTK_WIDGET (self->panel));
+
+  g_clear_object (&self->index);
+  g_clear_object (&self->vcs);
+}
+
+static void
+workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface)
+{
+  iface->load = gbp_todo_workbench_addin_load;
+  iface->unload = gbp_todo_workbench_addin_unload;
+}
+
+static void
+gbp_todo_workbench_addin_class_init (GbpTodoWorkbenchAddinClass *klass)
+{
+}
+
+static void
+gbp_todo_workbench_addin_init (GbpTodoWorkbenchAddin *self)
+{
+}
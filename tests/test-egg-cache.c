@@ -58,11 +58,94 @@ test_task_cache (void)
   g_assert (foo == NULL);
 }
 
+static gsize
+cost_func (gconstpointer value)
+{
+  return 100;
+}
+
+static void
+populate_object_cb (EggTaskCache  *self,
+                    gconstpointer  key,
+                    GTask         *task,
+                    gpointer       user_data)
+{
+  g_task_return_pointer (task, g_object_new (G_TYPE_OBJECT, NULL), g_object_unref);
+}
+
+static void
+get_cb (GObject      *object,
+        GAsyncResult *result,
+        gpointer      user_data)
+{
+  GError *error = NULL;
+  GObject *ret;
+
+  ret = egg_task_cache_get_finish (EGG_TASK_CACHE (object), result, &error);
+  g_assert_no_error (error);
+  g_assert (G_IS_OBJECT (ret));
+  g_object_unref (ret);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+fetch (EggTaskCache *self,
+       const gchar  *key)
+{
+  egg_task_cache_get_async (self, key, FALSE, NULL, get_cb, NULL);
+  g_main_loop_run (main_loop);
+}
+
+static void
+test_task_cache_budget (void)
+{
+  EggTaskCache *budget_cache;
+  gsize old_budget;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+  budget_cache = egg_task_cache_new (g_str_hash,
+                                     g_str_equal,
+                                     (GBoxedCopyFunc)g_strdup,
+                                     (GBoxedFreeFunc)g_free,
+                                     g_object_ref,
+                                     g_object_unref,
+                                     0,
+                                     populate_object_cb, NULL, NULL);
+  egg_task_cache_set_cost_func (budget_cache, cost_func);
+
+  old_budget = egg_task_cache_get_memory_budget ();
+  egg_task_cache_set_memory_budget (250);
+
+  fetch (budget_cache, "a");
+  fetch (budget_cache, "b");
+  g_assert (egg_task_cache_peek (budget_cache, "a"));
+  g_assert (egg_task_cache_peek (budget_cache, "b"));
+
+  /* "a" was used last, so "b" is the least recently used */
+  g_assert (egg_task_cache_peek (budget_cache, "a"));
+  fetch (budget_cache, "c");
+  g_assert (egg_task_cache_peek (budget_cache, "a"));
+  g_assert (!egg_task_cache_peek (budget_cache, "b"));
+  g_assert (egg_task_cache_peek (budget_cache, "c"));
+
+  /* Lowering the budget evicts right away */
+  egg_task_cache_set_memory_budget (150);
+  g_assert (!egg_task_cache_peek (budget_cache, "a"));
+  g_assert (egg_task_cache_peek (budget_cache, "c"));
+
+  egg_task_cache_set_memory_budget (old_budget);
+
+  g_object_unref (budget_cache);
+  g_main_loop_unref (main_loop);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Egg/TaskCache/basic", test_task_cache);
+  g_test_add_func ("/Egg/TaskCache/budget", test_task_cache_budget);
   return g_test_run ();
 }
@@ -158,6 +158,45 @@ test_EggHeap_extract_int (void)
    egg_heap_unref (heap);
 }
 
+static void
+set_tuple_index (gpointer element,
+                 guint    index_)
+{
+   Tuple *t = element;
+
+   t->pointer = GUINT_TO_POINTER (index_);
+}
+
+static void
+test_EggHeap_index_func (void)
+{
+   EggHeap *heap;
+   Tuple t;
+   guint i;
+
+   heap = egg_heap_new (sizeof (Tuple), cmptuple_rev);
+   egg_heap_set_index_func (heap, set_tuple_index);
+
+   for (i = 0; i < 1000; i++) {
+      t.size = (i * 7919) % 1009;
+      egg_heap_insert_val (heap, t);
+   }
+
+   /* Every element knows its position, remove them by it */
+   while (heap->len > 0) {
+      guint pos = g_random_int_range (0, heap->len);
+      Tuple removed;
+
+      for (i = 0; i < heap->len; i++)
+         g_assert_cmpint (GPOINTER_TO_UINT (egg_heap_index (heap, Tuple, i).pointer), ==, i);
+
+      egg_heap_extract_index (heap, pos, &removed);
+      g_assert_cmpint (GPOINTER_TO_UINT (removed.pointer), ==, pos);
+   }
+
+   egg_heap_unref (heap);
+}
+
 int
 main (gint   argc,
       gchar *argv[])
@@ -168,6 +207,7 @@ main (gint   argc,
    g_test_add_func ("/EggHeap/insert_and_extract<gpointer>", test_EggHeap_insert_val_ptr);
    g_test_add_func ("/EggHeap/insert_and_extract<Tuple>", test_EggHeap_insert_val_tuple);
    g_test_add_func ("/EggHeap/extract_index<int>", test_EggHeap_extract_int);
+   g_test_add_func ("/EggHeap/index_func<Tuple>", test_EggHeap_index_func);
 
    return g_test_run ();
 }
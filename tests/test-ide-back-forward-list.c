@@ -21,6 +21,7 @@
 #include <ide.h>
 
 #include "application/ide-application-tests.h"
+#include "history/ide-back-forward-list-private.h"
 
 typedef struct
 {
@@ -139,6 +140,185 @@ test_basic (GCancellable        *cancellable,
   ide_context_new_async (project_file, cancellable, test_basic_cb, task);
 }
 
+static const gchar *save_items[] = {
+  "file:///home/christian/Projects/gnome-builder/libide/ide-context.c#L10_0",
+  "file:///home/christian/Projects/gnome-builder/libide/ide-context.h#L20_4",
+  "file:///home/christian/Projects/gnome-builder/libide/ide-object.c#L30_2",
+  "file:///home/christian/Projects/%20spaces/foo#L40_1",
+};
+
+typedef struct
+{
+  GTask              *task;
+  IdeContext         *context;
+  IdeBackForwardList *list;
+  GFile              *file;
+} SaveLoadState;
+
+static void
+save_load_state_free (SaveLoadState *state)
+{
+  g_file_delete (state->file, NULL, NULL);
+  g_clear_object (&state->file);
+  g_clear_object (&state->list);
+  g_clear_object (&state->context);
+  g_clear_object (&state->task);
+  g_slice_free (SaveLoadState, state);
+}
+
+static guint
+count_items (IdeBackForwardList *list,
+             const gchar        *current_uri)
+{
+  g_autofree gchar *str = NULL;
+  IdeBackForwardItem *item;
+  guint count = 1;
+
+  item = ide_back_forward_list_get_current_item (list);
+  g_assert (item != NULL);
+
+  str = ide_uri_to_string (ide_back_forward_item_get_uri (item), 0);
+  g_assert_cmpstr (str, ==, current_uri);
+
+  while (ide_back_forward_list_get_can_go_backward (list))
+    {
+      ide_back_forward_list_go_backward (list);
+      count++;
+    }
+
+  return count;
+}
+
+static void
+test_save_load_load2_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  IdeBackForwardList *list = (IdeBackForwardList *)object;
+  SaveLoadState *state = user_data;
+  GError *error = NULL;
+
+  _ide_back_forward_list_load_finish (list, result, &error);
+  g_assert_no_error (error);
+
+  /* The appended item follows those written by the first save */
+  g_assert_cmpint (count_items (list, "file:///tmp/appended.c#L1_1"), ==, G_N_ELEMENTS (save_items) + 1);
+
+  g_task_return_boolean (state->task, TRUE);
+  g_object_unref (list);
+  save_load_state_free (state);
+}
+
+static void
+test_save_load_save2_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  SaveLoadState *state = user_data;
+  IdeBackForwardList *list;
+  GError *error = NULL;
+
+  _ide_back_forward_list_save_finish (state->list, result, &error);
+  g_assert_no_error (error);
+
+  list = g_object_new (IDE_TYPE_BACK_FORWARD_LIST,
+                       "context", state->context,
+                       NULL);
+  _ide_back_forward_list_load_async (list, state->file, NULL, test_save_load_load2_cb, state);
+}
+
+static void
+test_save_load_load1_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  IdeBackForwardList *list = (IdeBackForwardList *)object;
+  SaveLoadState *state = user_data;
+  IdeBackForwardItem *item;
+  GError *error = NULL;
+
+  _ide_back_forward_list_load_finish (list, result, &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (count_items (list, save_items [G_N_ELEMENTS (save_items) - 1]), ==, G_N_ELEMENTS (save_items));
+  g_object_unref (list);
+
+  /* Nothing was pushed since saving, so this appends a single record */
+  item = parse_item (state->context, "file:///tmp/appended.c#L1_1");
+  ide_back_forward_list_push (state->list, item);
+  g_object_unref (item);
+
+  _ide_back_forward_list_save_async (state->list, state->file, NULL, test_save_load_save2_cb, state);
+}
+
+static void
+test_save_load_save1_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  SaveLoadState *state = user_data;
+  IdeBackForwardList *list;
+  GError *error = NULL;
+
+  _ide_back_forward_list_save_finish (state->list, result, &error);
+  g_assert_no_error (error);
+
+  list = g_object_new (IDE_TYPE_BACK_FORWARD_LIST,
+                       "context", state->context,
+                       NULL);
+  _ide_back_forward_list_load_async (list, state->file, NULL, test_save_load_load1_cb, state);
+}
+
+static void
+test_save_load_cb (GObject      *object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+  g_autoptr(GFileIOStream) stream = NULL;
+  SaveLoadState *state;
+  GError *error = NULL;
+  gsize i;
+
+  state = g_slice_new0 (SaveLoadState);
+  state->task = user_data;
+  state->context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (state->context != NULL);
+
+  state->file = g_file_new_tmp ("test-back-forward-list-XXXXXX", &stream, &error);
+  g_assert_no_error (error);
+
+  state->list = g_object_new (IDE_TYPE_BACK_FORWARD_LIST,
+                              "context", state->context,
+                              NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (save_items); i++)
+    {
+      IdeBackForwardItem *item;
+
+      item = parse_item (state->context, save_items [i]);
+      ide_back_forward_list_push (state->list, item);
+      g_object_unref (item);
+    }
+
+  _ide_back_forward_list_save_async (state->list, state->file, NULL, test_save_load_save1_cb, state);
+}
+
+static void
+test_save_load (GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr(GFile) project_file = NULL;
+  GTask *task;
+
+  path = g_build_filename (TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  ide_context_new_async (project_file, cancellable, test_save_load_cb, task);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -153,6 +333,7 @@ main (gint   argc,
 
   app = ide_application_new ();
   ide_application_add_test (app, "/Ide/BackForwardList/basic", test_basic, NULL);
+  ide_application_add_test (app, "/Ide/BackForwardList/save-load", test_save_load, NULL);
   ret = g_application_run (G_APPLICATION (app), argc, argv);
   g_object_unref (app);
 
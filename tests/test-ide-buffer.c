@@ -23,6 +23,7 @@
 #include <ide.h>
 
 #include "application/ide-application-tests.h"
+#include "ide-internal.h"
 
 static void
 test_buffer_basic_cb2 (GObject      *object,
@@ -100,6 +101,147 @@ test_buffer_basic (GCancellable        *cancellable,
   IDE_EXIT;
 }
 
+static const gchar *structure_snippets[] = {
+  "(", ")", "[", "]", "{", "}", "\n", " ", "x",
+  "/*", "*/", "//", "\"", "'", "\\",
+  "#if A\n", "#ifdef B\n", "#elif C\n", "#else\n", "#endif\n",
+  "foo (bar[1], {2});\n",
+  "/* ( */",
+  "\"s)\"",
+  "{\n  (\n",
+  "}\n}\n",
+};
+
+static void
+assert_structure_equal (GtkTextBuffer      *buffer,
+                        IdeBufferStructure *incremental)
+{
+  g_autoptr(IdeBufferStructure) fresh = NULL;
+  static const gunichar open_chars[] = { '(', '[', '{' };
+  GtkTextIter iter;
+
+  fresh = _ide_buffer_structure_new (buffer);
+  _ide_buffer_structure_set_language_id (fresh, "c");
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+
+  do
+    {
+      GtkTextIter a_begin, a_end;
+      GtkTextIter b_begin, b_end;
+      IdeBufferSpanKind kind;
+      gboolean found;
+      guint i;
+      guint depth;
+
+      kind = ide_buffer_structure_get_span (fresh, &iter, &b_begin, &b_end);
+      g_assert_cmpint (ide_buffer_structure_get_span (incremental, &iter, &a_begin, &a_end), ==, kind);
+      if (kind != IDE_BUFFER_SPAN_NONE)
+        {
+          g_assert (gtk_text_iter_equal (&a_begin, &b_begin));
+          g_assert (gtk_text_iter_equal (&a_end, &b_end));
+        }
+
+      found = ide_buffer_structure_find_matching_bracket (fresh, &iter, &b_begin);
+      g_assert_cmpint (ide_buffer_structure_find_matching_bracket (incremental, &iter, &a_begin), ==, found);
+      if (found)
+        g_assert (gtk_text_iter_equal (&a_begin, &b_begin));
+
+      for (i = 0; i < G_N_ELEMENTS (open_chars); i++)
+        {
+          for (depth = 1; depth <= 2; depth++)
+            {
+              found = ide_buffer_structure_find_enclosing_bracket (fresh, &iter, open_chars [i], depth, &b_begin);
+              g_assert_cmpint (ide_buffer_structure_find_enclosing_bracket (incremental, &iter, open_chars [i], depth, &a_begin), ==, found);
+              if (found)
+                g_assert (gtk_text_iter_equal (&a_begin, &b_begin));
+            }
+        }
+
+      found = ide_buffer_structure_find_matching_conditional (fresh, &iter, &b_begin);
+      g_assert_cmpint (ide_buffer_structure_find_matching_conditional (incremental, &iter, &a_begin), ==, found);
+      if (found)
+        g_assert (gtk_text_iter_equal (&a_begin, &b_begin));
+    }
+  while (gtk_text_iter_forward_char (&iter));
+}
+
+/*
+ * Applies random edits, notifying the structure the way IdeBuffer does,
+ * and checks that every query agrees with a structure built from scratch.
+ */
+static void
+test_buffer_structure_incremental (GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autoptr(IdeBufferStructure) structure = NULL;
+  GRand *rand;
+  guint i;
+
+  IDE_ENTRY;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  rand = g_rand_new_with_seed (31);
+
+  buffer = gtk_text_buffer_new (NULL);
+  structure = _ide_buffer_structure_new (buffer);
+  _ide_buffer_structure_set_language_id (structure, "c");
+
+  /* Enough text to span several chunks of tokens */
+  for (i = 0; i < 600; i++)
+    {
+      const gchar *snippet = structure_snippets [g_rand_int_range (rand, 0, G_N_ELEMENTS (structure_snippets))];
+      GtkTextIter iter;
+
+      gtk_text_buffer_get_end_iter (buffer, &iter);
+      gtk_text_buffer_insert (buffer, &iter, snippet, -1);
+    }
+
+  /* Index the initial text, after which edits are tracked incrementally */
+  assert_structure_equal (buffer, structure);
+
+  for (i = 0; i < 150; i++)
+    {
+      gint n_chars = gtk_text_buffer_get_char_count (buffer);
+      gint offset = g_rand_int_range (rand, 0, n_chars + 1);
+      GtkTextIter begin;
+      GtkTextIter end;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &begin, offset);
+
+      if (offset < n_chars && g_rand_boolean (rand))
+        {
+          gint len = g_rand_int_range (rand, 1, MIN (n_chars - offset, 16) + 1);
+
+          gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + len);
+          gtk_text_buffer_delete (buffer, &begin, &end);
+          _ide_buffer_structure_delete (structure, offset, len);
+        }
+      else
+        {
+          const gchar *snippet = structure_snippets [g_rand_int_range (rand, 0, G_N_ELEMENTS (structure_snippets))];
+
+          gtk_text_buffer_insert (buffer, &begin, snippet, -1);
+          _ide_buffer_structure_insert (structure, offset, g_utf8_strlen (snippet, -1));
+        }
+
+      /* Several edits may be pending before the next query */
+      if (g_rand_int_range (rand, 0, 3) == 0)
+        assert_structure_equal (buffer, structure);
+    }
+
+  assert_structure_equal (buffer, structure);
+
+  g_rand_free (rand);
+
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -114,6 +256,7 @@ main (gint   argc,
 
   app = ide_application_new ();
   ide_application_add_test (app, "/Ide/Buffer/basic", test_buffer_basic, NULL);
+  ide_application_add_test (app, "/Ide/Buffer/structure-incremental", test_buffer_structure_incremental, NULL);
   ret = g_application_run (G_APPLICATION (app), argc, argv);
   g_object_unref (app);
 
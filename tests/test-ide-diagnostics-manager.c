@@ -0,0 +1,520 @@
+/* test-ide-diagnostics-manager.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "test-ide-diagnostics-manager"
+
+#include <ide.h>
+#include <libpeas/peas.h>
+
+#include "application/ide-application-tests.h"
+
+/*
+ * A diagnostic provider reporting a warning for the second line of every
+ * file it is asked about. It is registered by test-diagnostics-plugin.c
+ * for automake files, which no other provider handles.
+ */
+#define TEST_TYPE_DIAGNOSTIC_PROVIDER (test_diagnostic_provider_get_type())
+
+G_DECLARE_FINAL_TYPE (TestDiagnosticProvider, test_diagnostic_provider, TEST, DIAGNOSTIC_PROVIDER, IdeObject)
+
+struct _TestDiagnosticProvider
+{
+  IdeObject parent_instance;
+};
+
+static void diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestDiagnosticProvider, test_diagnostic_provider, IDE_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (IDE_TYPE_DIAGNOSTIC_PROVIDER,
+                                                diagnostic_provider_iface_init))
+
+#define TEST_DIAGNOSTIC_LINE 1
+
+static guint n_diagnose;
+
+static void
+test_diagnostic_provider_diagnose_async (IdeDiagnosticProvider *provider,
+                                         IdeFile               *file,
+                                         GCancellable          *cancellable,
+                                         GAsyncReadyCallback    callback,
+                                         gpointer               user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(IdeSourceLocation) location = NULL;
+  GPtrArray *array;
+
+  g_assert (TEST_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (IDE_IS_FILE (file));
+
+  n_diagnose++;
+
+  location = ide_source_location_new (file, TEST_DIAGNOSTIC_LINE, 0, 0);
+  array = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_diagnostic_unref);
+  g_ptr_array_add (array, ide_diagnostic_new (IDE_DIAGNOSTIC_WARNING, "test warning", location));
+
+  task = g_task_new (provider, cancellable, callback, user_data);
+  g_task_return_pointer (task, ide_diagnostics_new (array), (GDestroyNotify)ide_diagnostics_unref);
+}
+
+static IdeDiagnostics *
+test_diagnostic_provider_diagnose_finish (IdeDiagnosticProvider  *provider,
+                                          GAsyncResult           *result,
+                                          GError                **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface)
+{
+  iface->diagnose_async = test_diagnostic_provider_diagnose_async;
+  iface->diagnose_finish = test_diagnostic_provider_diagnose_finish;
+}
+
+static void
+test_diagnostic_provider_class_init (TestDiagnosticProviderClass *klass)
+{
+}
+
+static void
+test_diagnostic_provider_init (TestDiagnosticProvider *self)
+{
+}
+
+static void
+load_test_plugin (void)
+{
+  PeasEngine *engine = peas_engine_get_default ();
+  PeasPluginInfo *plugin_info;
+
+  /* The plugin module resolves the provider type from this executable */
+  g_type_ensure (TEST_TYPE_DIAGNOSTIC_PROVIDER);
+
+  if (NULL == (plugin_info = peas_engine_get_plugin_info (engine, "test-diagnostics-plugin")))
+    {
+      const gchar *builddir = g_test_get_dir (G_TEST_BUILT);
+
+      peas_engine_prepend_search_path (engine, builddir, builddir);
+      peas_engine_rescan_plugins (engine);
+
+      plugin_info = peas_engine_get_plugin_info (engine, "test-diagnostics-plugin");
+      g_assert (plugin_info != NULL);
+    }
+
+  if (!peas_plugin_info_is_loaded (plugin_info))
+    g_assert (peas_engine_load_plugin (engine, plugin_info));
+}
+
+static void
+assert_line_tagged (IdeBuffer *buffer,
+                    guint      line,
+                    gboolean   tagged)
+{
+  GtkTextTagTable *table;
+  GtkTextTag *tag;
+  GtkTextIter iter;
+
+  table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (buffer));
+  tag = gtk_text_tag_table_lookup (table, "diagnostician::warning");
+  g_assert (GTK_IS_TEXT_TAG (tag));
+
+  gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &iter, line);
+  g_assert (!gtk_text_iter_ends_line (&iter));
+
+  do
+    {
+      if (tagged)
+        g_assert (gtk_text_iter_has_tag (&iter, tag));
+      else if (gtk_text_iter_has_tag (&iter, tag))
+        return;
+    }
+  while (gtk_text_iter_forward_char (&iter) && !gtk_text_iter_ends_line (&iter));
+
+  g_assert (tagged);
+}
+
+typedef struct
+{
+  GTask      *task;
+  IdeContext *context;
+  guint       n_scans;
+  guint       n_diagnose;
+} WorkspaceState;
+
+static void test_workspace_scan (WorkspaceState *state);
+
+static void
+workspace_state_free (WorkspaceState *state)
+{
+  g_clear_object (&state->task);
+  g_clear_object (&state->context);
+  g_slice_free (WorkspaceState, state);
+}
+
+/*
+ * Checks the model is consistent and returns how many rows it has for the
+ * Makefile.am of project1, which must be those of our test provider.
+ */
+static guint
+assert_workspace_model (IdeDiagnosticsManager *manager)
+{
+  g_autoptr(GFile) makefile = NULL;
+  g_autofree gchar *path = NULL;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  guint n_rows = 0;
+
+  model = ide_diagnostics_manager_get_workspace_model (manager);
+  g_assert (GTK_IS_TREE_MODEL (model));
+  g_assert (model == ide_diagnostics_manager_get_workspace_model (manager));
+
+  g_assert_cmpint (gtk_tree_model_get_n_columns (model), ==, IDE_DIAGNOSTICS_MANAGER_N_COLUMNS);
+  g_assert (gtk_tree_model_get_column_type (model, IDE_DIAGNOSTICS_MANAGER_COLUMN_DIAGNOSTIC) == IDE_TYPE_DIAGNOSTIC);
+  g_assert (gtk_tree_model_get_column_type (model, IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE) == G_TYPE_FILE);
+  g_assert (gtk_tree_model_get_column_type (model, IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY) == G_TYPE_INT);
+  g_assert (gtk_tree_model_get_column_type (model, IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE) == G_TYPE_UINT);
+  g_assert (gtk_tree_model_get_column_type (model, IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT) == G_TYPE_STRING);
+
+  if (gtk_tree_model_get_iter_first (model, &iter))
+    {
+      do
+        {
+          g_autoptr(IdeDiagnostic) diagnostic = NULL;
+          g_autoptr(GFile) file = NULL;
+          g_autofree gchar *text = NULL;
+          gint severity = 0;
+          guint line = 0;
+
+          gtk_tree_model_get (model, &iter,
+                              IDE_DIAGNOSTICS_MANAGER_COLUMN_DIAGNOSTIC, &diagnostic,
+                              IDE_DIAGNOSTICS_MANAGER_COLUMN_FILE, &file,
+                              IDE_DIAGNOSTICS_MANAGER_COLUMN_SEVERITY, &severity,
+                              IDE_DIAGNOSTICS_MANAGER_COLUMN_LINE, &line,
+                              IDE_DIAGNOSTICS_MANAGER_COLUMN_TEXT, &text,
+                              -1);
+
+          g_assert (diagnostic != NULL);
+          g_assert (G_IS_FILE (file));
+          g_assert_cmpint (severity, ==, ide_diagnostic_get_severity (diagnostic));
+          g_assert_cmpstr (text, ==, ide_diagnostic_get_text (diagnostic));
+
+          if (makefile == NULL)
+            {
+              path = g_build_filename (TEST_DATA_DIR, "project1", "Makefile.am", NULL);
+              makefile = g_file_new_for_path (path);
+            }
+
+          if (g_file_equal (file, makefile))
+            {
+              g_assert_cmpint (severity, ==, IDE_DIAGNOSTIC_WARNING);
+              g_assert_cmpint (line, ==, TEST_DIAGNOSTIC_LINE);
+              g_assert_cmpstr (text, ==, "test warning");
+              n_rows++;
+            }
+        }
+      while (gtk_tree_model_iter_next (model, &iter));
+    }
+
+  return n_rows;
+}
+
+typedef struct
+{
+  GTask      *task;
+  IdeContext *context;
+  IdeBuffer  *buffer;
+  guint       n_changed;
+} RetagState;
+
+static void
+retag_state_free (RetagState *state)
+{
+  g_clear_object (&state->task);
+  g_clear_object (&state->buffer);
+  g_clear_object (&state->context);
+  g_slice_free (RetagState, state);
+}
+
+static void
+test_retag_changed_cb (IdeDiagnosticsManager *manager,
+                       RetagState            *state)
+{
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (state->buffer);
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (manager));
+
+  assert_line_tagged (state->buffer, TEST_DIAGNOSTIC_LINE, TRUE);
+
+  if (state->n_changed++ == 0)
+    {
+      /*
+       * Retype a character of the diagnostic. The inserted text is not
+       * tagged, and the provider reports the very same diagnostic again,
+       * which must still cause the buffer to restore the tag.
+       */
+      gtk_text_buffer_get_iter_at_line_offset (buffer, &begin, TEST_DIAGNOSTIC_LINE, 1);
+      gtk_text_buffer_get_iter_at_line_offset (buffer, &end, TEST_DIAGNOSTIC_LINE, 2);
+      gtk_text_buffer_delete (buffer, &begin, &end);
+      gtk_text_buffer_insert (buffer, &begin, "i", 1);
+
+      assert_line_tagged (state->buffer, TEST_DIAGNOSTIC_LINE, FALSE);
+
+      IDE_EXIT;
+    }
+
+  g_signal_handlers_disconnect_by_func (manager, test_retag_changed_cb, state);
+
+  g_task_return_boolean (state->task, TRUE);
+  retag_state_free (state);
+
+  IDE_EXIT;
+}
+
+static void
+test_retag_load_cb (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  IdeBufferManager *buffer_manager = (IdeBufferManager *)object;
+  RetagState *state = user_data;
+  IdeDiagnosticsManager *manager;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  state->buffer = ide_buffer_manager_load_file_finish (buffer_manager, result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_BUFFER (state->buffer));
+
+  /* Run after the buffer has applied the diagnostics */
+  manager = ide_context_get_diagnostics_manager (state->context);
+  g_signal_connect_after (manager,
+                          "changed",
+                          G_CALLBACK (test_retag_changed_cb),
+                          state);
+
+  IDE_EXIT;
+}
+
+static void
+test_retag_context_cb (GObject      *object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeFile) file = NULL;
+  g_autofree gchar *path = NULL;
+  RetagState *state;
+  IdeContext *context;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  state = g_slice_new0 (RetagState);
+  state->task = g_object_ref (task);
+  state->context = context;
+
+  path = g_build_filename (TEST_DATA_DIR, "project1", "Makefile.am", NULL);
+  file = ide_project_get_file_for_path (ide_context_get_project (context), path);
+
+  ide_buffer_manager_load_file_async (ide_context_get_buffer_manager (context),
+                                      file,
+                                      FALSE,
+                                      IDE_WORKBENCH_OPEN_FLAGS_NONE,
+                                      NULL,
+                                      g_task_get_cancellable (task),
+                                      test_retag_load_cb,
+                                      state);
+
+  IDE_EXIT;
+}
+
+static void
+test_retag (GCancellable        *cancellable,
+            GAsyncReadyCallback  callback,
+            gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  GTask *task;
+
+  IDE_ENTRY;
+
+  load_test_plugin ();
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  path = g_build_filename (TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+  ide_context_new_async (project_file, cancellable, test_retag_context_cb, task);
+
+  IDE_EXIT;
+}
+
+static void
+test_workspace_pending_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  IdeDiagnosticsManager *manager = (IdeDiagnosticsManager *)object;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (manager));
+
+  ret = ide_diagnostics_manager_diagnose_workspace_finish (manager, result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_PENDING);
+  g_assert (ret == FALSE);
+}
+
+static void
+test_workspace_scan_cb (GObject      *object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  IdeDiagnosticsManager *manager = (IdeDiagnosticsManager *)object;
+  WorkspaceState *state = user_data;
+  GError *error = NULL;
+  gboolean ret;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (manager));
+
+  ret = ide_diagnostics_manager_diagnose_workspace_finish (manager, result, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_assert_cmpint (assert_workspace_model (manager), ==, 1);
+
+  if (++state->n_scans < 2)
+    {
+      /* The only automake file of the project was diagnosed */
+      g_assert_cmpint (n_diagnose, ==, state->n_diagnose + 1);
+      state->n_diagnose = n_diagnose;
+
+      test_workspace_scan (state);
+      IDE_EXIT;
+    }
+
+  /* The second scan is answered from the cache of the first one */
+  g_assert_cmpint (n_diagnose, ==, state->n_diagnose);
+
+  g_task_return_boolean (state->task, TRUE);
+  workspace_state_free (state);
+
+  IDE_EXIT;
+}
+
+static void
+test_workspace_scan (WorkspaceState *state)
+{
+  IdeDiagnosticsManager *manager;
+
+  manager = ide_context_get_diagnostics_manager (state->context);
+
+  ide_diagnostics_manager_diagnose_workspace_async (manager,
+                                                    g_task_get_cancellable (state->task),
+                                                    test_workspace_scan_cb,
+                                                    state);
+
+  /* Only one scan may run at a time */
+  ide_diagnostics_manager_diagnose_workspace_async (manager,
+                                                    NULL,
+                                                    test_workspace_pending_cb,
+                                                    NULL);
+}
+
+static void
+test_workspace_context_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  WorkspaceState *state;
+  IdeContext *context;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  state = g_slice_new0 (WorkspaceState);
+  state->task = g_object_ref (task);
+  state->context = context;
+
+  state->n_diagnose = n_diagnose;
+
+  /* The model may be requested before any scan has run */
+  g_assert_cmpint (assert_workspace_model (ide_context_get_diagnostics_manager (context)), ==, 0);
+
+  test_workspace_scan (state);
+
+  IDE_EXIT;
+}
+
+static void
+test_workspace (GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  GTask *task;
+
+  IDE_ENTRY;
+
+  load_test_plugin ();
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  path = g_build_filename (TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+  ide_context_new_async (project_file, cancellable, test_workspace_context_cb, task);
+
+  IDE_EXIT;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  IdeApplication *app;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ide_log_init (TRUE, NULL);
+  ide_log_set_verbosity (4);
+
+  app = ide_application_new ();
+  ide_application_add_test (app, "/Ide/DiagnosticsManager/retag", test_retag, NULL);
+  ide_application_add_test (app, "/Ide/DiagnosticsManager/workspace", test_workspace, NULL);
+  ret = g_application_run (G_APPLICATION (app), argc, argv);
+  g_object_unref (app);
+
+  return ret;
+}
@@ -0,0 +1,403 @@
+/* test-ide-host-spawner.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs IdeBreakoutSubprocess against a stand-in for the flatpak session
+ * helper, owning its name on a private session bus, so the host spawning
+ * paths can be tested without flatpak.
+ */
+
+#include <gio/gunixfdlist.h>
+#include <ide.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV
+# define FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV (1 << 0)
+#endif
+
+#define DEVELOPMENT_NAME      "org.freedesktop.Flatpak"
+#define DEVELOPMENT_PATH      "/org/freedesktop/Flatpak/Development"
+#define DEVELOPMENT_INTERFACE "org.freedesktop.Flatpak.Development"
+
+typedef struct
+{
+  GDBusConnection *connection;
+  GPid             pid;
+} ServiceWait;
+
+static const gchar service_xml[] =
+  "<node>"
+  "  <interface name='" DEVELOPMENT_INTERFACE "'>"
+  "    <method name='HostCommand'>"
+  "      <arg type='ay' name='cwd_path' direction='in'/>"
+  "      <arg type='aay' name='argv' direction='in'/>"
+  "      <arg type='a{uh}' name='fds' direction='in'/>"
+  "      <arg type='a{ss}' name='envs' direction='in'/>"
+  "      <arg type='u' name='flags' direction='in'/>"
+  "      <arg type='u' name='pid' direction='out'/>"
+  "    </method>"
+  "    <method name='HostCommandSignal'>"
+  "      <arg type='u' name='pid' direction='in'/>"
+  "      <arg type='u' name='signal' direction='in'/>"
+  "      <arg type='b' name='to_process_group' direction='in'/>"
+  "    </method>"
+  "    <signal name='HostCommandExited'>"
+  "      <arg type='u' name='pid'/>"
+  "      <arg type='u' name='exit_status'/>"
+  "    </signal>"
+  "  </interface>"
+  "</node>";
+
+static GDBusConnection *service_connection;
+
+static void
+service_wait_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GSubprocess *subprocess = (GSubprocess *)object;
+  ServiceWait *wait = user_data;
+
+  g_assert (G_IS_SUBPROCESS (subprocess));
+  g_assert (wait != NULL);
+
+  g_subprocess_wait_finish (subprocess, result, NULL);
+
+  g_dbus_connection_emit_signal (wait->connection,
+                                 NULL,
+                                 DEVELOPMENT_PATH,
+                                 DEVELOPMENT_INTERFACE,
+                                 "HostCommandExited",
+                                 g_variant_new ("(uu)",
+                                                (guint32)wait->pid,
+                                                (guint32)g_subprocess_get_status (subprocess)),
+                                 NULL);
+
+  g_object_unref (wait->connection);
+  g_slice_free (ServiceWait, wait);
+}
+
+static void
+service_host_command (GDBusConnection       *connection,
+                      GVariant              *parameters,
+                      GDBusMethodInvocation *invocation)
+{
+  g_autoptr(GSubprocessLauncher) launcher = NULL;
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GVariantIter) fds_iter = NULL;
+  g_autoptr(GVariantIter) env_iter = NULL;
+  g_autofree const gchar **argv = NULL;
+  GUnixFDList *fd_list;
+  const gchar *cwd = NULL;
+  const gchar *key;
+  const gchar *value;
+  ServiceWait *wait;
+  GError *error = NULL;
+  guint32 flags = 0;
+  guint32 dest;
+  gint32 handle;
+
+  g_variant_get (parameters, "(^&ay^a&aya{uh}a{ss}u)",
+                 &cwd, &argv, &fds_iter, &env_iter, &flags);
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+  g_subprocess_launcher_set_cwd (launcher, cwd);
+
+  if (flags & FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV)
+    {
+      static gchar *empty[] = { NULL };
+      g_subprocess_launcher_set_environ (launcher, empty);
+    }
+
+  while (g_variant_iter_next (env_iter, "{&s&s}", &key, &value))
+    g_subprocess_launcher_setenv (launcher, key, value, TRUE);
+
+  fd_list = g_dbus_message_get_unix_fd_list (g_dbus_method_invocation_get_message (invocation));
+
+  while (g_variant_iter_next (fds_iter, "{uh}", &dest, &handle))
+    {
+      gint fd = -1;
+
+      if (fd_list != NULL)
+        fd = g_unix_fd_list_get (fd_list, handle, NULL);
+
+      if (fd == -1)
+        continue;
+
+      if (dest == STDIN_FILENO)
+        g_subprocess_launcher_take_stdin_fd (launcher, fd);
+      else if (dest == STDOUT_FILENO)
+        g_subprocess_launcher_take_stdout_fd (launcher, fd);
+      else if (dest == STDERR_FILENO)
+        g_subprocess_launcher_take_stderr_fd (launcher, fd);
+      else
+        g_subprocess_launcher_take_fd (launcher, fd, dest);
+    }
+
+  subprocess = g_subprocess_launcher_spawnv (launcher, (const gchar * const *)argv, &error);
+
+  if (subprocess == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      return;
+    }
+
+  wait = g_slice_new0 (ServiceWait);
+  wait->connection = g_object_ref (connection);
+  wait->pid = (GPid)atoi (g_subprocess_get_identifier (subprocess));
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", (guint32)wait->pid));
+
+  /* The exit signal is dispatched from this context, so always after the reply */
+  g_subprocess_wait_async (subprocess, NULL, service_wait_cb, wait);
+}
+
+static void
+service_method_call (GDBusConnection       *connection,
+                     const gchar           *sender,
+                     const gchar           *object_path,
+                     const gchar           *interface_name,
+                     const gchar           *method_name,
+                     GVariant              *parameters,
+                     GDBusMethodInvocation *invocation,
+                     gpointer               user_data)
+{
+  if (g_strcmp0 (method_name, "HostCommand") == 0)
+    {
+      service_host_command (connection, parameters, invocation);
+    }
+  else if (g_strcmp0 (method_name, "HostCommandSignal") == 0)
+    {
+      guint32 pid = 0;
+      guint32 signum = 0;
+      gboolean to_process_group = FALSE;
+
+      /*
+       * Our children share our process group, so only signal the process
+       * itself regardless of to_process_group.
+       */
+      g_variant_get (parameters, "(uub)", &pid, &signum, &to_process_group);
+      if (pid != 0)
+        kill ((GPid)pid, signum);
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "No such method %s",
+                                             method_name);
+    }
+}
+
+static const GDBusInterfaceVTable service_vtable = {
+  service_method_call,
+};
+
+static gpointer
+service_thread (gpointer data)
+{
+  GMainContext *context = data;
+  g_autoptr(GMainLoop) loop = g_main_loop_new (context, FALSE);
+
+  /* Spawned processes are waited for from this context */
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+
+  return NULL;
+}
+
+/*
+ * Serves the stand-in from a thread of its own, as the spawner blocks the
+ * main thread while it waits for HostCommand() to reply.
+ */
+static void
+service_start (GTestDBus *bus)
+{
+  g_autoptr(GDBusNodeInfo) info = NULL;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GError) error = NULL;
+  GMainContext *context;
+  guint32 result = 0;
+
+  service_connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (bus),
+                                                               (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                                G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                               NULL,
+                                                               NULL,
+                                                               &error);
+  g_assert_no_error (error);
+
+  info = g_dbus_node_info_new_for_xml (service_xml, &error);
+  g_assert_no_error (error);
+
+  /* Method calls are dispatched to the context active when registering */
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+  g_dbus_connection_register_object (service_connection,
+                                     DEVELOPMENT_PATH,
+                                     info->interfaces[0],
+                                     &service_vtable,
+                                     NULL,
+                                     NULL,
+                                     &error);
+  g_main_context_pop_thread_default (context);
+  g_assert_no_error (error);
+
+  reply = g_dbus_connection_call_sync (service_connection,
+                                       "org.freedesktop.DBus",
+                                       "/org/freedesktop/DBus",
+                                       "org.freedesktop.DBus",
+                                       "RequestName",
+                                       g_variant_new ("(su)", DEVELOPMENT_NAME, 0x4),
+                                       G_VARIANT_TYPE ("(u)"),
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1,
+                                       NULL,
+                                       &error);
+  g_assert_no_error (error);
+
+  /* DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER */
+  g_variant_get (reply, "(u)", &result);
+  g_assert_cmpint (result, ==, 1);
+
+  g_thread_unref (g_thread_new ("test-host-spawner-service", service_thread, context));
+}
+
+static void
+test_exit_status (void)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) process = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean r;
+
+  launcher = ide_subprocess_launcher_new (0);
+  ide_subprocess_launcher_push_argv (launcher, "true");
+
+  process = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (process != NULL);
+
+  r = ide_subprocess_wait_check (process, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+
+  g_clear_object (&process);
+  g_clear_object (&launcher);
+
+  launcher = ide_subprocess_launcher_new (0);
+  ide_subprocess_launcher_push_argv (launcher, "false");
+
+  process = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (process != NULL);
+
+  r = ide_subprocess_wait_check (process, NULL, &error);
+  g_assert (error != NULL);
+  g_assert_cmpint (r, ==, FALSE);
+}
+
+static void
+test_communicate (void)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) process = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *stdout_buf = NULL;
+  gboolean r;
+
+  launcher = ide_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE);
+  ide_subprocess_launcher_set_clear_env (launcher, TRUE);
+  ide_subprocess_launcher_setenv (launcher, "IDE_HOST_SPAWNER_TEST", "hello", TRUE);
+  ide_subprocess_launcher_push_argv (launcher, "sh");
+  ide_subprocess_launcher_push_argv (launcher, "-c");
+  ide_subprocess_launcher_push_argv (launcher, "echo $IDE_HOST_SPAWNER_TEST");
+
+  process = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (process != NULL);
+
+  r = ide_subprocess_communicate_utf8 (process, NULL, NULL, &stdout_buf, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+  g_assert_cmpstr (stdout_buf, ==, "hello\n");
+}
+
+static void
+test_many (void)
+{
+  g_autoptr(GPtrArray) processes = g_ptr_array_new_with_free_func (g_object_unref);
+  guint i;
+
+  /* All of these share the spawner connection */
+  for (i = 0; i < 25; i++)
+    {
+      g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+      g_autoptr(GError) error = NULL;
+      IdeSubprocess *process;
+
+      launcher = ide_subprocess_launcher_new (0);
+      ide_subprocess_launcher_push_argv (launcher, "true");
+
+      process = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+      g_assert_no_error (error);
+      g_assert (process != NULL);
+
+      g_ptr_array_add (processes, process);
+    }
+
+  for (i = 0; i < processes->len; i++)
+    {
+      IdeSubprocess *process = g_ptr_array_index (processes, i);
+      g_autoptr(GError) error = NULL;
+
+      g_assert_cmpint (ide_subprocess_wait_check (process, NULL, &error), ==, TRUE);
+      g_assert_no_error (error);
+    }
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GTestDBus) bus = NULL;
+  gint ret;
+
+  g_setenv ("IDE_USE_BREAKOUT_SUBPROCESS", "1", TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+
+  /* Sets DBUS_SESSION_BUS_ADDRESS, which the spawner connects to */
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+  service_start (bus);
+
+  g_test_add_func ("/Ide/HostSpawner/exit-status", test_exit_status);
+  g_test_add_func ("/Ide/HostSpawner/communicate", test_communicate);
+  g_test_add_func ("/Ide/HostSpawner/many", test_many);
+  ret = g_test_run ();
+
+  g_clear_object (&service_connection);
+  g_test_dbus_down (bus);
+
+  return ret;
+}
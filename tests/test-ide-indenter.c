@@ -137,6 +137,40 @@ assert_keypress_equal (GtkWidget   *widget,
   gtk_text_buffer_set_text (buffer, "", 0);
 }
 
+/*
+ * Replaces the buffer contents with input_str, reindents all of it, and
+ * ensures that we get the proper string back out.
+ */
+static void
+assert_reindent_equal (GtkWidget   *widget,
+                       const gchar *input_str,
+                       const gchar *output_str)
+{
+  g_autofree gchar *result = NULL;
+  GtkTextBuffer *buffer;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_SOURCE_VIEW (widget));
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (widget));
+  gtk_text_buffer_set_text (buffer, input_str, -1);
+
+  gtk_text_buffer_get_bounds (buffer, &begin, &end);
+  gtk_text_buffer_select_range (buffer, &begin, &end);
+  g_signal_emit_by_name (widget, "reindent");
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  gtk_text_buffer_get_bounds (buffer, &begin, &end);
+  result = gtk_text_buffer_get_text (buffer, &begin, &end, TRUE);
+
+  g_assert_cmpstr (result, ==, output_str);
+
+  gtk_text_buffer_set_text (buffer, "", 0);
+}
+
 static void
 test_cindenter_basic_check (IdeContext *context,
                             GtkWidget  *widget)
@@ -152,6 +186,16 @@ test_cindenter_basic_check (IdeContext *context,
   assert_keypress_equal (widget,
                          "static void\nfoo (GtkWidget *widget,\nGError **error)",
                          "static void\nfoo (GtkWidget  *widget,\n     GError    **error)");
+
+  /*
+   * Reindenting applies the rules for pressing Return before each line, so
+   * lines get the indentation they would get when typed. The alignment of
+   * parameters done when typing the closing parenthesis is not applied.
+   */
+  assert_reindent_equal (widget, "  #include <glib.h>", "#include <glib.h>");
+  assert_reindent_equal (widget,
+                         "static void\n  foo (GtkWidget *widget,\nGError **error)",
+                         "static void\nfoo (GtkWidget *widget,\n     GError **error)");
 }
 
 static void
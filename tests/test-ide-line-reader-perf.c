@@ -0,0 +1,185 @@
+/* test-ide-line-reader-perf.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares reading build output line by line with GDataInputStream against
+ * ide_line_reader_read_stream(). The output is generated on the fly so that
+ * large sizes do not need to be kept in memory.
+ *
+ * usage: test-ide-line-reader-perf [MEGABYTES]
+ */
+
+#include <ide.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MEGABYTES 1024
+
+static const gchar build_output[] =
+  "  CC       libide_1_0_la-ide-build-result.lo\n"
+  "  CC       libide_1_0_la-ide-subprocess-launcher.lo\n"
+  "libtool: compile:  gcc -DHAVE_CONFIG_H -I. -I.. -DG_LOG_DOMAIN=\\\"ide\\\" -g -O2 -MT libide_1_0_la-ide-line-reader.lo -c ide-line-reader.c -fPIC -DPIC -o .libs/libide_1_0_la-ide-line-reader.o\n"
+  "../../libide/buildsystem/ide-build-result.c: In function 'ide_build_result_tail_into':\n"
+  "../../libide/buildsystem/ide-build-result.c:366:3: warning: unused variable 'data_reader' [-Wunused-variable]\n"
+  "make[3]: Entering directory '/home/user/Projects/gnome-builder/build/libide'\n"
+  "\n"
+  "  CCLD     libide-1.0.la\n";
+
+#define FAKE_TYPE_BUILD_STREAM (fake_build_stream_get_type())
+
+G_DECLARE_FINAL_TYPE (FakeBuildStream, fake_build_stream, FAKE, BUILD_STREAM, GInputStream)
+
+struct _FakeBuildStream
+{
+  GInputStream parent_instance;
+  guint64      remaining;
+  gsize        pos;
+};
+
+G_DEFINE_TYPE (FakeBuildStream, fake_build_stream, G_TYPE_INPUT_STREAM)
+
+static gssize
+fake_build_stream_read_fn (GInputStream  *stream,
+                           void          *buffer,
+                           gsize          count,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  FakeBuildStream *self = (FakeBuildStream *)stream;
+  gchar *dest = buffer;
+  gsize n_read;
+
+  n_read = MIN (count, self->remaining);
+
+  for (gsize i = 0; i < n_read;)
+    {
+      gsize n = MIN (n_read - i, sizeof build_output - 1 - self->pos);
+
+      memcpy (&dest [i], &build_output [self->pos], n);
+      self->pos = (self->pos + n) % (sizeof build_output - 1);
+      i += n;
+    }
+
+  self->remaining -= n_read;
+
+  return n_read;
+}
+
+static void
+fake_build_stream_class_init (FakeBuildStreamClass *klass)
+{
+  GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS (klass);
+
+  stream_class->read_fn = fake_build_stream_read_fn;
+}
+
+static void
+fake_build_stream_init (FakeBuildStream *self)
+{
+}
+
+static GInputStream *
+fake_build_stream_new (guint64 size)
+{
+  FakeBuildStream *self;
+
+  self = g_object_new (FAKE_TYPE_BUILD_STREAM, NULL);
+  self->remaining = size;
+
+  return G_INPUT_STREAM (self);
+}
+
+static void
+report (const gchar *name,
+        guint64      size,
+        guint64      n_lines,
+        gint64       begin,
+        gint64       end)
+{
+  gdouble secs = (end - begin) / (gdouble)G_USEC_PER_SEC;
+
+  g_print ("%-20s %"G_GUINT64_FORMAT" lines in %.3lf sec (%.1lf MB/sec)\n",
+           name, n_lines, secs, size / secs / (1024.0 * 1024.0));
+}
+
+static void
+bench_data_input_stream (guint64 size)
+{
+  g_autoptr(GInputStream) stream = fake_build_stream_new (size);
+  g_autoptr(GDataInputStream) data_stream = g_data_input_stream_new (stream);
+  guint64 n_lines = 0;
+  gchar *line;
+  gsize len;
+  gint64 begin;
+
+  begin = g_get_monotonic_time ();
+
+  while (NULL != (line = g_data_input_stream_read_line (data_stream, &len, NULL, NULL)))
+    {
+      n_lines++;
+      g_free (line);
+    }
+
+  report ("GDataInputStream", size, n_lines, begin, g_get_monotonic_time ());
+}
+
+static gboolean
+count_lines (IdeLineReader *reader,
+             gpointer       user_data)
+{
+  guint64 *n_lines = user_data;
+  gsize len;
+
+  while (NULL != ide_line_reader_next (reader, &len))
+    (*n_lines)++;
+
+  return TRUE;
+}
+
+static void
+bench_line_reader (guint64 size)
+{
+  g_autoptr(GInputStream) stream = fake_build_stream_new (size);
+  guint64 n_lines = 0;
+  gint64 begin;
+
+  begin = g_get_monotonic_time ();
+
+  ide_line_reader_read_stream (stream, count_lines, &n_lines, NULL, NULL);
+
+  report ("IdeLineReader", size, n_lines, begin, g_get_monotonic_time ());
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  guint64 size = DEFAULT_MEGABYTES;
+
+  if (argc > 1)
+    size = MAX (1, atoi (argv[1]));
+
+  size *= 1024 * 1024;
+
+  g_print ("Reading %"G_GUINT64_FORMAT" MB of build output\n", size / (1024 * 1024));
+
+  bench_data_input_stream (size);
+  bench_line_reader (size);
+
+  return EXIT_SUCCESS;
+}
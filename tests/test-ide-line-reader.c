@@ -0,0 +1,208 @@
+/* test-ide-line-reader.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+static gboolean
+collect_lines (IdeLineReader *reader,
+               gpointer       user_data)
+{
+  GPtrArray *lines = user_data;
+  gchar *line;
+  gsize len;
+
+  while (NULL != (line = ide_line_reader_next (reader, &len)))
+    g_ptr_array_add (lines, g_strndup (line, len));
+
+  return TRUE;
+}
+
+static gboolean
+stop_after_first (IdeLineReader *reader,
+                  gpointer       user_data)
+{
+  guint *count = user_data;
+
+  (*count)++;
+
+  return FALSE;
+}
+
+static GString *
+create_contents (void)
+{
+  GString *str = g_string_new (NULL);
+  guint i;
+
+  /* Short lines straddling the internal buffer boundaries */
+  for (i = 0; i < 20000; i++)
+    g_string_append_printf (str, "line %u\n", i);
+
+  /* A single line larger than the internal buffer */
+  for (i = 0; i < 300000; i++)
+    g_string_append_c (str, 'a' + (i % 26));
+  g_string_append_c (str, '\n');
+
+  /* Empty lines and a trailing unterminated line */
+  g_string_append (str, "\n\nlast");
+
+  return str;
+}
+
+static void
+assert_lines (GPtrArray   *lines,
+              const gchar *contents)
+{
+  g_auto(GStrv) expected = g_strsplit (contents, "\n", 0);
+  guint i;
+
+  g_assert_cmpint (lines->len, ==, g_strv_length (expected));
+
+  for (i = 0; i < lines->len; i++)
+    g_assert_cmpstr (g_ptr_array_index (lines, i), ==, expected [i]);
+}
+
+static void
+test_read_stream (void)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GPtrArray) lines = NULL;
+  g_autoptr(GError) error = NULL;
+  GString *contents;
+  gboolean r;
+
+  contents = create_contents ();
+  stream = g_memory_input_stream_new_from_data (contents->str, contents->len, NULL);
+  lines = g_ptr_array_new_with_free_func (g_free);
+
+  r = ide_line_reader_read_stream (stream, collect_lines, lines, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+
+  assert_lines (lines, contents->str);
+
+  g_string_free (contents, TRUE);
+}
+
+static void
+test_read_stream_stop (void)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GError) error = NULL;
+  GString *contents;
+  guint count = 0;
+  gboolean r;
+
+  contents = create_contents ();
+  stream = g_memory_input_stream_new_from_data (contents->str, contents->len, NULL);
+
+  r = ide_line_reader_read_stream (stream, stop_after_first, &count, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+  g_assert_cmpint (count, ==, 1);
+
+  g_string_free (contents, TRUE);
+}
+
+static void
+read_stream_async_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  GMainLoop *main_loop = user_data;
+  g_autoptr(GError) error = NULL;
+  gboolean r;
+
+  r = ide_line_reader_read_stream_finish (G_INPUT_STREAM (object), result, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_read_stream_async (void)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GPtrArray) lines = NULL;
+  GMainLoop *main_loop;
+  GString *contents;
+
+  contents = create_contents ();
+  stream = g_memory_input_stream_new_from_data (contents->str, contents->len, NULL);
+  lines = g_ptr_array_new_with_free_func (g_free);
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  ide_line_reader_read_stream_async (stream,
+                                     collect_lines,
+                                     g_ptr_array_ref (lines),
+                                     (GDestroyNotify)g_ptr_array_unref,
+                                     NULL,
+                                     read_stream_async_cb,
+                                     main_loop);
+
+  g_main_loop_run (main_loop);
+
+  assert_lines (lines, contents->str);
+
+  g_main_loop_unref (main_loop);
+  g_string_free (contents, TRUE);
+}
+
+static void
+test_subprocess_read_lines (void)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) process = NULL;
+  g_autoptr(GPtrArray) lines = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean r;
+
+  launcher = ide_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE);
+  ide_subprocess_launcher_push_argv (launcher, "printf");
+  ide_subprocess_launcher_push_argv (launcher, "a\\nb\\nc");
+
+  process = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (process != NULL);
+
+  lines = g_ptr_array_new_with_free_func (g_free);
+
+  r = ide_subprocess_read_lines (process, collect_lines, lines, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+
+  assert_lines (lines, "a\nb\nc");
+
+  r = ide_subprocess_wait_check (process, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (r, ==, TRUE);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/LineReader/read-stream", test_read_stream);
+  g_test_add_func ("/Ide/LineReader/read-stream-stop", test_read_stream_stop);
+  g_test_add_func ("/Ide/LineReader/read-stream-async", test_read_stream_async);
+  g_test_add_func ("/Ide/LineReader/subprocess", test_subprocess_read_lines);
+  return g_test_run ();
+}
@@ -0,0 +1,194 @@
+/* test-macro-replay.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks replaying a recorded vim macro with a large count.
+ *
+ * usage: test-macro-replay [COUNT]
+ */
+
+#include <ide.h>
+#include <stdlib.h>
+
+#include "application/ide-application-tests.h"
+#include "util/ide-gdk.h"
+
+#define DEFAULT_REPLAY_COUNT 1000
+
+static guint replay_count = DEFAULT_REPLAY_COUNT;
+
+static void
+load_vim_css (void)
+{
+  GtkCssProvider *provider;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_resource (provider, "/org/gnome/builder/keybindings/vim.css");
+  gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
+                                             GTK_STYLE_PROVIDER (provider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  g_clear_object (&provider);
+}
+
+static void
+send_keys (GtkWidget   *widget,
+           const gchar *input_chars)
+{
+  GdkWindow *window;
+
+  window = gtk_text_view_get_window (GTK_TEXT_VIEW (widget), GTK_TEXT_WINDOW_TEXT);
+  g_assert (GDK_IS_WINDOW (window));
+
+  for (; *input_chars; input_chars = g_utf8_next_char (input_chars))
+    {
+      gunichar ch = g_utf8_get_char (input_chars);
+      GdkEventKey *event;
+
+      while (gtk_events_pending ())
+        gtk_main_iteration ();
+
+      event = ide_gdk_synthesize_event_key (window, ch);
+      gtk_main_do_event ((GdkEvent *)event);
+      gdk_event_free ((GdkEvent *)event);
+    }
+}
+
+static void
+run_benchmark (GtkWidget *widget)
+{
+  g_autofree gchar *count_str = NULL;
+  GtkTextBuffer *buffer;
+  gint64 begin;
+  gint64 end;
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (widget));
+
+  /* Record "insert a line" as the macro to repeat. */
+  send_keys (widget, "ofoo (bar, baz);\e");
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 2);
+
+  count_str = g_strdup_printf ("%u.", replay_count);
+
+  begin = g_get_monotonic_time ();
+  send_keys (widget, count_str);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  end = g_get_monotonic_time ();
+
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, replay_count + 2);
+
+  g_print ("Replayed macro %u times in %.3lf msec (%.3lf usec per replay)\n",
+           replay_count,
+           (end - begin) / 1000.0,
+           (end - begin) / (gdouble)replay_count);
+}
+
+static void
+new_context_cb (GObject      *object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  GtkSourceCompletion *completion;
+  IdeProject *project;
+  IdeBuffer *buffer;
+  GtkWidget *window;
+  GtkWidget *widget;
+  IdeFile *file;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  project = ide_context_get_project (context);
+  file = ide_project_get_file_for_path (project, "test.c");
+
+  buffer = g_object_new (IDE_TYPE_BUFFER,
+                         "context", context,
+                         "file", file,
+                         NULL);
+
+  window = gtk_offscreen_window_new ();
+  widget = g_object_new (IDE_TYPE_SOURCE_VIEW,
+                         "auto-indent", TRUE,
+                         "buffer", buffer,
+                         "visible", TRUE,
+                         NULL);
+  gtk_container_add (GTK_CONTAINER (window), widget);
+
+  completion = gtk_source_view_get_completion (GTK_SOURCE_VIEW (widget));
+  gtk_source_completion_block_interactive (completion);
+
+  gtk_window_present (GTK_WINDOW (window));
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  run_benchmark (widget);
+
+  gtk_widget_destroy (window);
+  g_object_unref (buffer);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+test_macro_replay (GCancellable        *cancellable,
+                   GAsyncReadyCallback  callback,
+                   gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  GTask *task;
+
+  load_vim_css ();
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  project_file = g_file_new_for_path (TEST_DATA_DIR"/project1/configure.ac");
+  ide_context_new_async (project_file,
+                         NULL,
+                         new_context_cb,
+                         task);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  IdeApplication *app;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  if (argc > 1)
+    {
+      replay_count = MAX (1, atoi (argv [1]));
+      argv [1] = argv [0];
+      argc--, argv++;
+    }
+
+  ide_log_init (TRUE, NULL);
+
+  app = ide_application_new ();
+  ide_application_add_test (app, "/Ide/SourceView/macro-replay", test_macro_replay, NULL);
+  ret = g_application_run (G_APPLICATION (app), argc, argv);
+  g_object_unref (app);
+
+  return ret;
+}
@@ -0,0 +1,189 @@
+/* test-trie.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trie.h"
+
+#define N_KEYS 10000
+
+static gchar *
+make_key (guint i)
+{
+   return g_strdup_printf("key-%u-%x", (i * 7919) % 100003, i);
+}
+
+static gboolean
+count_cb (Trie        *trie,
+          const gchar *key,
+          gpointer     value,
+          gpointer     user_data)
+{
+   guint *count = user_data;
+
+   g_assert_cmpstr(key, ==, value);
+   (*count)++;
+
+   return FALSE;
+}
+
+static gboolean
+collect_cb (Trie        *trie,
+            const gchar *key,
+            gpointer     value,
+            gpointer     user_data)
+{
+   g_ptr_array_add(user_data, g_strdup(key));
+   return FALSE;
+}
+
+static Trie *
+create_trie (void)
+{
+   Trie *trie;
+   guint i;
+
+   trie = trie_new(g_free);
+
+   for (i = 0; i < N_KEYS; i++) {
+      gchar *key = make_key(i);
+      trie_insert(trie, key, key);
+   }
+
+   return trie;
+}
+
+static void
+assert_contents (Trie *trie)
+{
+   guint count = 0;
+   guint i;
+
+   for (i = 0; i < N_KEYS; i++) {
+      gchar *key = make_key(i);
+      g_assert_cmpstr(trie_lookup(trie, key), ==, key);
+      g_free(key);
+   }
+
+   g_assert(!trie_lookup(trie, "key-"));
+   g_assert(!trie_lookup(trie, "missing"));
+
+   trie_traverse(trie, NULL, G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
+                 count_cb, &count);
+   g_assert_cmpint(count, ==, N_KEYS);
+
+   count = 0;
+   trie_traverse(trie, "key-1", G_POST_ORDER, G_TRAVERSE_LEAVES, -1,
+                 count_cb, &count);
+   g_assert_cmpint(count, >, 0);
+   g_assert_cmpint(count, <, N_KEYS);
+}
+
+static void
+test_Trie_freeze (void)
+{
+   Trie *trie;
+
+   trie = create_trie();
+   assert_contents(trie);
+
+   trie_freeze(trie);
+   assert_contents(trie);
+
+   /* Freezing twice is a no-op */
+   trie_freeze(trie);
+   assert_contents(trie);
+
+   trie_destroy(trie);
+}
+
+static void
+test_Trie_thaw (void)
+{
+   Trie *trie;
+
+   trie = create_trie();
+   trie_freeze(trie);
+
+   g_assert(!trie_remove(trie, "missing"));
+   g_assert(trie_remove(trie, "key-0-0"));
+   g_assert(!trie_lookup(trie, "key-0-0"));
+
+   trie_insert(trie, "key-0-0", g_strdup("key-0-0"));
+   assert_contents(trie);
+
+   trie_freeze(trie);
+   assert_contents(trie);
+
+   trie_destroy(trie);
+}
+
+static void
+test_Trie_sorted (void)
+{
+   static const gchar *keys[] = { "b", "ab", "a", "abc", "c", "ba" };
+   GPtrArray *ar;
+   Trie *trie;
+   guint i;
+
+   trie = trie_new(NULL);
+   for (i = 0; i < G_N_ELEMENTS(keys); i++) {
+      trie_insert(trie, keys[i], (gpointer)keys[i]);
+   }
+   trie_freeze(trie);
+
+   ar = g_ptr_array_new_with_free_func(g_free);
+   trie_traverse(trie, "", G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
+                 collect_cb, ar);
+
+   g_assert_cmpint(ar->len, ==, 6);
+   g_assert_cmpstr(g_ptr_array_index(ar, 0), ==, "a");
+   g_assert_cmpstr(g_ptr_array_index(ar, 1), ==, "ab");
+   g_assert_cmpstr(g_ptr_array_index(ar, 2), ==, "abc");
+   g_assert_cmpstr(g_ptr_array_index(ar, 3), ==, "b");
+   g_assert_cmpstr(g_ptr_array_index(ar, 4), ==, "ba");
+   g_assert_cmpstr(g_ptr_array_index(ar, 5), ==, "c");
+
+   g_ptr_array_unref(ar);
+   trie_destroy(trie);
+}
+
+static void
+test_Trie_empty (void)
+{
+   Trie *trie;
+
+   trie = trie_new(NULL);
+   trie_freeze(trie);
+   g_assert(!trie_lookup(trie, "a"));
+   trie_insert(trie, "a", GINT_TO_POINTER(1));
+   g_assert(trie_lookup(trie, "a"));
+   trie_destroy(trie);
+}
+
+int
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+
+   g_test_add_func("/Trie/freeze", test_Trie_freeze);
+   g_test_add_func("/Trie/thaw", test_Trie_thaw);
+   g_test_add_func("/Trie/sorted", test_Trie_sorted);
+   g_test_add_func("/Trie/empty", test_Trie_empty);
+
+   return g_test_run();
+}